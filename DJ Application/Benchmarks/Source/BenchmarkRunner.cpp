@@ -0,0 +1,198 @@
+#include "BenchmarkRunner.h"
+
+BenchmarkRunner::BenchmarkRunner(const StringArray& arguments)
+{
+    auto workingDirectory = File::getCurrentWorkingDirectory();
+
+    for (int i = 0; i + 1 < arguments.size(); ++i)
+    {
+        auto value = arguments[i + 1].unquoted();
+
+        if (arguments[i] == "--filter")            filter = value;
+        else if (arguments[i] == "--repetitions")  defaultRepetitions = jmax(3, value.getIntValue());
+        else if (arguments[i] == "--json")         jsonFile = workingDirectory.getChildFile(value);
+        else if (arguments[i] == "--baseline")     baselineFile = workingDirectory.getChildFile(value);
+        else if (arguments[i] == "--threshold")    regressionThreshold = jmax(0.0, value.getDoubleValue() / 100.0);
+    }
+
+   #if JUCE_DEBUG
+    std::cout << "Warning: this is a debug build, the timings will not mean much" << std::endl;
+   #endif
+
+    std::cout << String("benchmark").paddedRight(' ', 44)
+              << String("median").paddedLeft(' ', 12)
+              << String("min").paddedLeft(' ', 12)
+              << String("stddev").paddedLeft(' ', 10) << std::endl;
+}
+
+bool BenchmarkRunner::shouldRun(const String& name) const
+{
+    return filter.isEmpty() || name.containsIgnoreCase(filter);
+}
+
+void BenchmarkRunner::addResult(const String& name, const String& parameter, int iterations, std::vector<double>& samples)
+{
+    if (samples.empty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = name;
+    result.parameter = parameter;
+    result.repetitions = (int) samples.size();
+    result.iterations = iterations;
+    result.minimum = samples.front();
+    result.maximum = samples.back();
+
+    auto middle = samples.size() / 2;
+    result.median = (samples.size() % 2 != 0) ? samples[middle] : (samples[middle - 1] + samples[middle]) * 0.5;
+
+    for (auto sample : samples)
+        result.mean += sample;
+
+    result.mean /= (double) samples.size();
+
+    for (auto sample : samples)
+        result.standardDeviation += (sample - result.mean) * (sample - result.mean);
+
+    result.standardDeviation = std::sqrt(result.standardDeviation / (double) jmax((size_t) 1, samples.size() - 1));
+
+    results.push_back(result);
+    printResult(result);
+}
+
+String BenchmarkRunner::formatDuration(double nanoseconds)
+{
+    if (nanoseconds >= 1.0e9)  return String(nanoseconds / 1.0e9, 2) + " s";
+    if (nanoseconds >= 1.0e6)  return String(nanoseconds / 1.0e6, 2) + " ms";
+    if (nanoseconds >= 1.0e3)  return String(nanoseconds / 1.0e3, 2) + " us";
+    return String(nanoseconds, 0) + " ns";
+}
+
+void BenchmarkRunner::printResult(const Result& result) const
+{
+    auto spread = result.mean > 0 ? result.standardDeviation / result.mean * 100.0 : 0.0;
+
+    std::cout << result.getKey().paddedRight(' ', 44)
+              << formatDuration(result.median).paddedLeft(' ', 12)
+              << formatDuration(result.minimum).paddedLeft(' ', 12)
+              << (String(spread, 1) + "%").paddedLeft(' ', 10) << std::endl;
+}
+
+var BenchmarkRunner::toJSON() const
+{
+    auto* machine = new DynamicObject();
+    machine->setProperty("os", SystemStats::getOperatingSystemName());
+    machine->setProperty("cpu", SystemStats::getCpuModel());
+    machine->setProperty("cores", SystemStats::getNumCpus());
+
+    Array<var> resultList;
+
+    for (auto& result : results)
+    {
+        auto* object = new DynamicObject();
+        object->setProperty("name", result.name);
+        object->setProperty("parameter", result.parameter);
+        object->setProperty("unit", "ns");
+        object->setProperty("repetitions", result.repetitions);
+        object->setProperty("iterations", result.iterations);
+        object->setProperty("median", result.median);
+        object->setProperty("mean", result.mean);
+        object->setProperty("stddev", result.standardDeviation);
+        object->setProperty("min", result.minimum);
+        object->setProperty("max", result.maximum);
+        resultList.add(var(object));
+    }
+
+    auto* root = new DynamicObject();
+    root->setProperty("time", Time::getCurrentTime().toISO8601(true));
+   #if JUCE_DEBUG
+    root->setProperty("build", "debug");
+   #else
+    root->setProperty("build", "release");
+   #endif
+    root->setProperty("machine", var(machine));
+    root->setProperty("results", resultList);
+
+    return var(root);
+}
+
+int BenchmarkRunner::compareWithBaseline(const File& baseline) const
+{
+    auto parsed = JSON::parse(baseline);
+    auto* baselineResults = parsed["results"].getArray();
+
+    if (baselineResults == nullptr)
+    {
+        std::cerr << "Could not read a baseline from " << baseline.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    std::cout << std::endl << "Compared with " << baseline.getFileName()
+              << " (regression above " << String(regressionThreshold * 100.0, 0) << "%)" << std::endl;
+
+    int regressions = 0;
+
+    for (auto& result : results)
+    {
+        for (auto& old : *baselineResults)
+        {
+            if (old["name"].toString() != result.name || old["parameter"].toString() != result.parameter)
+                continue;
+
+            auto oldMedian = (double) old["median"];
+
+            if (oldMedian <= 0)
+                break;
+
+            auto change = result.median / oldMedian - 1.0;
+            auto isRegression = change > regressionThreshold;
+            regressions += isRegression ? 1 : 0;
+
+            std::cout << result.getKey().paddedRight(' ', 44)
+                      << ((change >= 0 ? "+" : "") + String(change * 100.0, 1) + "%").paddedLeft(' ', 10)
+                      << (isRegression ? "  REGRESSION" : "") << std::endl;
+            break;
+        }
+    }
+
+    return regressions;
+}
+
+const BenchmarkRunner::Result* BenchmarkRunner::findResult(const String& name, const String& parameter) const
+{
+    for (auto& result : results)
+        if (result.name == name && result.parameter == parameter)
+            return &result;
+
+    return nullptr;
+}
+
+void BenchmarkRunner::check(bool passed, const String& description)
+{
+    if (passed)
+        return;
+
+    std::cout << "FAILED: " << description << std::endl;
+    ++failedChecks;
+}
+
+int BenchmarkRunner::finish()
+{
+    if (failedChecks > 0)
+        std::cout << std::endl << failedChecks << " check(s) failed" << std::endl;
+
+    if (jsonFile != File())
+    {
+        if (! jsonFile.replaceWithText(JSON::toString(toJSON())))
+        {
+            std::cerr << "Could not write " << jsonFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    auto regressions = baselineFile != File() ? compareWithBaseline(baselineFile) : 0;
+
+    return (regressions > 0 || failedChecks > 0) ? 1 : 0;
+}
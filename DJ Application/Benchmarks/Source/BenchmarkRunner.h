@@ -0,0 +1,105 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Runs each benchmark as a number of timed repetitions after a few untimed ones
+// and reports the spread, so one noisy repetition can't pass for a regression.
+//
+//   --filter text       only runs benchmarks whose name contains text
+//   --repetitions n     timed repetitions per benchmark (default 15)
+//   --json file         writes every result as JSON
+//   --baseline file     compares medians against an earlier --json file
+//   --threshold pct     slowdown that counts as a regression (default 10)
+class BenchmarkRunner
+{
+public:
+    // Accumulates only the time spent inside time(), so setup stays out of the figures
+    class Stopwatch
+    {
+    public:
+        template <typename Function>
+        void time(Function&& function)
+        {
+            auto start = Time::getHighResolutionTicks();
+            function();
+            ticks += Time::getHighResolutionTicks() - start;
+        }
+
+        int64 getTicks() const { return ticks; }
+
+    private:
+        int64 ticks = 0;
+    };
+
+    // Nanoseconds per iteration over the timed repetitions
+    struct Result
+    {
+        String name;
+        String parameter;
+        int repetitions = 0;
+        int iterations = 0;
+        double median = 0, mean = 0, standardDeviation = 0, minimum = 0, maximum = 0;
+
+        String getKey() const { return name + " [" + parameter + "]"; }
+    };
+
+    explicit BenchmarkRunner(const StringArray& arguments);
+
+    bool shouldRun(const String& name) const;
+
+    // Calls body(stopwatch) iterations times per repetition. A repetition count of zero
+    // uses the command line's, a warm-up count below zero uses the default of two
+    template <typename Body>
+    void run(const String& name, const String& parameter, int iterations, Body&& body,
+             int repetitions = 0, int warmUpRepetitions = -1)
+    {
+        if (! shouldRun(name))
+            return;
+
+        repetitions = repetitions > 0 ? repetitions : defaultRepetitions;
+        warmUpRepetitions = warmUpRepetitions >= 0 ? warmUpRepetitions : 2;
+
+        std::vector<double> samples;
+
+        for (int repetition = -warmUpRepetitions; repetition < repetitions; ++repetition)
+        {
+            Stopwatch stopwatch;
+
+            for (int i = 0; i < iterations; ++i)
+                body(stopwatch);
+
+            if (repetition >= 0)
+                samples.push_back(Time::highResolutionTicksToSeconds(stopwatch.getTicks()) * 1.0e9 / iterations);
+        }
+
+        addResult(name, parameter, iterations, samples);
+    }
+
+    // The result of an earlier run, or nullptr if it was filtered out
+    const Result* findResult(const String& name, const String& parameter) const;
+
+    // For benchmarks that also verify behaviour. A failure is printed and fails the run
+    void check(bool passed, const String& description);
+
+    // Writes the JSON file and compares with the baseline if asked to, returns the exit code
+    int finish();
+
+private:
+    void addResult(const String& name, const String& parameter, int iterations, std::vector<double>& samples);
+    void printResult(const Result& result) const;
+
+    // Number of results whose median is slower than the baseline by more than the threshold,
+    // or one if the baseline can't be read
+    int compareWithBaseline(const File& baselineFile) const;
+
+    static String formatDuration(double nanoseconds);
+    var toJSON() const;
+
+    String filter;
+    int defaultRepetitions = 15;
+    double regressionThreshold = 0.1;
+    File jsonFile, baselineFile;
+
+    std::vector<Result> results;
+    int failedChecks = 0;
+};
@@ -0,0 +1,877 @@
+/*
+  Console benchmarks for the audio and library hot paths.
+
+  Shares sources with the app, which include ../JuceLibraryCode/JuceHeader.h,
+  so save OtoDecks.jucer in the Projucer once before building this project.
+  Build in Release, timings from a debug build mean nothing.
+
+  Save a run with --json, then pass it to later runs as --baseline to have
+  slowdowns reported and the exit code set. See BenchmarkRunner.h for the options.
+  Some benchmarks also check behaviour, a failed check is printed and sets the exit code too.
+*/
+
+#include <JuceHeader.h>
+#include "BenchmarkRunner.h"
+#include "../../Source/BandAnalysis.h"
+#include "../../Source/BeatAnalyser.h"
+#include "../../Source/DeckEngine.h"
+#include "../../Source/OfflineRenderer.h"
+#include "../../Source/ReverbEffect.h"
+#include "../../Source/TrackLibrary.h"
+#include "../../Source/TrackSearchIndex.h"
+
+using Stopwatch = BenchmarkRunner::Stopwatch;
+
+// The reverb path as DJAudioPlayer ran it before effects processed in place,
+// kept here so the two can be compared on the same machine
+class LegacyReverbPath
+{
+public:
+    void prepare(double sampleRate, int samplesPerBlock)
+    {
+        params.roomSize = 0.5f;
+        params.damping = 0.5f;
+        params.wetLevel = 1.0f;
+        params.dryLevel = 0.0f;
+        params.width = 1.0f;
+        params.freezeMode = 0.0f;
+
+        reverb.setSampleRate(sampleRate);
+        tempBuffer.setSize(2, samplesPerBlock);
+        dryBuffer.setSize(2, samplesPerBlock);
+    }
+
+    void process(AudioBuffer<float>& output, int startSample, int numSamples)
+    {
+        tempBuffer.clear();
+        for (int channel = 0; channel < output.getNumChannels(); ++channel)
+            tempBuffer.copyFrom(channel, 0, output, channel, startSample, numSamples);
+
+        dryBuffer.clear();
+        for (int channel = 0; channel < tempBuffer.getNumChannels(); ++channel)
+            dryBuffer.copyFrom(channel, 0, tempBuffer, channel, 0, numSamples);
+
+        reverb.setParameters(params);
+        reverb.processStereo(tempBuffer.getWritePointer(0), tempBuffer.getWritePointer(1), numSamples);
+
+        for (int channel = 0; channel < tempBuffer.getNumChannels(); ++channel)
+        {
+            float* channelData = tempBuffer.getWritePointer(channel);
+            const float* dryData = dryBuffer.getReadPointer(channel);
+
+            for (int sample = 0; sample < numSamples; ++sample)
+                channelData[sample] = (dryData[sample] * (1.0f - wetDryMix)) + (channelData[sample] * wetDryMix);
+        }
+
+        for (int channel = 0; channel < output.getNumChannels(); ++channel)
+            output.copyFrom(channel, startSample, tempBuffer, channel, 0, numSamples);
+    }
+
+    float wetDryMix = 0.5f;
+
+private:
+    Reverb reverb;
+    Reverb::Parameters params;
+    AudioBuffer<float> tempBuffer, dryBuffer;
+};
+
+// Noise with a slow sine on top, long enough that the decks rarely have to wrap
+static File writeTestTrack(const File& folder, double seconds, double sampleRate)
+{
+    auto file = folder.getChildFile("track " + String(seconds, 0) + "s.wav");
+
+    if (file.existsAsFile())
+        return file;
+
+    std::unique_ptr<FileOutputStream> stream (file.createOutputStream());
+    WavAudioFormat wavFormat;
+    std::unique_ptr<AudioFormatWriter> writer (wavFormat.createWriterFor(stream.get(), sampleRate, 2, 16, {}, 0));
+
+    if (writer == nullptr)
+        return {};
+
+    stream.release();
+
+    AudioBuffer<float> buffer (2, 8192);
+    Random random (42);
+    auto totalSamples = (int64) (seconds * sampleRate);
+
+    for (int64 position = 0; position < totalSamples; position += buffer.getNumSamples())
+    {
+        auto numSamples = (int) jmin((int64) buffer.getNumSamples(), totalSamples - position);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto tone = 0.3f * (float) std::sin(MathConstants<double>::twoPi * 110.0 * (double) (position + i) / sampleRate);
+            buffer.setSample(0, i, tone + 0.2f * (random.nextFloat() * 2.0f - 1.0f));
+            buffer.setSample(1, i, tone + 0.2f * (random.nextFloat() * 2.0f - 1.0f));
+        }
+
+        writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+    }
+
+    return file;
+}
+
+static void benchmarkReverb(BenchmarkRunner& runner, double sampleRate)
+{
+    const int blockSizes[] = { 64, 128, 256, 512, 1024, 2048 };
+
+    for (auto blockSize : blockSizes)
+    {
+        AudioBuffer<float> input (2, blockSize), output (2, blockSize);
+        Random random (1234);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                input.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+        // Same amount of audio per repetition whatever the block size
+        auto iterations = 2000 * 512 / blockSize;
+
+        LegacyReverbPath legacy;
+        legacy.prepare(sampleRate, blockSize);
+
+        runner.run("reverb/copy", String(blockSize), iterations, [&](Stopwatch& stopwatch)
+        {
+            output.makeCopyOf(input, true);
+            stopwatch.time([&] { legacy.process(output, 0, blockSize); });
+        });
+
+        ReverbEffect effect;
+        effect.setWetDryMix(0.5f);
+        effect.setActive(true);
+        effect.prepareToPlay(sampleRate, blockSize);
+
+        runner.run("reverb/in-place", String(blockSize), iterations, [&](Stopwatch& stopwatch)
+        {
+            output.makeCopyOf(input, true);
+            stopwatch.time([&] { effect.processBlock(output, 0, blockSize); });
+        });
+    }
+}
+
+// Keeps a deck inside its track so every block does real work
+static void rewindIfNearEnd(DJAudioPlayer& player)
+{
+    if (player.getPositionRelative() > 0.9)
+        player.setPosition(0);
+}
+
+static void benchmarkPlayer(BenchmarkRunner& runner, TrackLoader& trackLoader, const File& track, double sampleRate)
+{
+    const double speeds[] = { 0.5, 0.9, 1.0, 1.1, 1.5, 2.0 };
+    const int blockSize = 512;
+
+    for (auto keyLock : { false, true })
+    {
+        auto name = keyLock ? "player/key-lock" : "player";
+
+        if (! runner.shouldRun(name))
+            continue;
+
+        for (auto speed : speeds)
+        {
+            DJAudioPlayer player (trackLoader);
+            player.setReadAheadSize(0);
+            player.setSpeed(speed);
+            player.setKeyLock(keyLock);
+            player.prepareToPlay(blockSize, sampleRate);
+            player.loadURLSynchronously(URL(track));
+            player.start();
+
+            AudioBuffer<float> buffer (2, blockSize);
+
+            runner.run(name, "speed " + String(speed, 2), 500, [&](Stopwatch& stopwatch)
+            {
+                rewindIfNearEnd(player);
+                AudioSourceChannelInfo info (&buffer, 0, blockSize);
+                stopwatch.time([&] { player.getNextAudioBlock(info); });
+            });
+
+            player.releaseResources();
+        }
+    }
+}
+
+// Starts every deck on the same track, spread out so they don't share cache lines
+static void startDecks(const Array<DJAudioPlayer*>& decks, const File& track)
+{
+    for (int i = 0; i < decks.size(); ++i)
+    {
+        decks[i]->setReadAheadSize(0);
+        decks[i]->loadURLSynchronously(URL(track));
+        decks[i]->setPositionRelative(0.1 * (i % 8));
+        decks[i]->start();
+    }
+}
+
+static void benchmarkMixing(BenchmarkRunner& runner, TrackLoader& trackLoader, const File& track, double sampleRate)
+{
+    const int deckCounts[] = { 2, 4, 8 };
+    const int blockSize = 512;
+    AudioBuffer<float> buffer (2, blockSize);
+
+    for (auto numDecks : deckCounts)
+    {
+        if (runner.shouldRun("mix/MixerAudioSource"))
+        {
+            OwnedArray<DJAudioPlayer> players;
+            Array<DJAudioPlayer*> decks;
+            MixerAudioSource mixer;
+
+            for (int i = 0; i < numDecks; ++i)
+            {
+                auto* player = players.add(new DJAudioPlayer(trackLoader));
+                mixer.addInputSource(player, false);
+                decks.add(player);
+            }
+
+            mixer.prepareToPlay(blockSize, sampleRate);
+            startDecks(decks, track);
+
+            runner.run("mix/MixerAudioSource", String(numDecks) + " decks", 200, [&](Stopwatch& stopwatch)
+            {
+                for (auto* deck : decks)
+                    rewindIfNearEnd(*deck);
+
+                AudioSourceChannelInfo info (&buffer, 0, blockSize);
+                stopwatch.time([&] { mixer.getNextAudioBlock(info); });
+            });
+
+            mixer.removeAllInputs();
+        }
+
+        for (auto parallel : { false, true })
+        {
+            auto name = parallel ? "mix/DeckEngine" : "mix/DeckEngine-serial";
+
+            if (! runner.shouldRun(name))
+                continue;
+
+            // Waits for every deck, otherwise a late one would be dropped and look like a speedup
+            DeckEngine engine (trackLoader, numDecks);
+            engine.setParallelRendering(parallel);
+            engine.setNonRealtime(true);
+            engine.prepareToPlay(blockSize, sampleRate);
+
+            Array<DJAudioPlayer*> decks;
+            for (int i = 0; i < numDecks; ++i)
+                decks.add(engine.getDeck(i));
+
+            startDecks(decks, track);
+
+            runner.run(name, String(numDecks) + " decks", 200, [&](Stopwatch& stopwatch)
+            {
+                for (auto* deck : decks)
+                    rewindIfNearEnd(*deck);
+
+                AudioSourceChannelInfo info (&buffer, 0, blockSize);
+                stopwatch.time([&] { engine.getNextAudioBlock(info); });
+            });
+
+            engine.releaseResources();
+        }
+    }
+}
+
+// Four key-locked decks rendered one after another on one thread, which should fit in the
+// block's real-time budget with room to spare at the medium tier
+static void benchmarkKeyLockMixing(BenchmarkRunner& runner, TrackLoader& trackLoader, const File& track, double sampleRate)
+{
+    const String name ("mix/key-lock");
+    const int numDecks = 4;
+    const int blockSize = 512;
+
+    if (! runner.shouldRun(name))
+        return;
+
+    const std::pair<TimeStretchAudioSource::Quality, const char*> tiers[] = {
+        { TimeStretchAudioSource::Quality::low, "low" },
+        { TimeStretchAudioSource::Quality::medium, "medium" },
+        { TimeStretchAudioSource::Quality::high, "high" }
+    };
+
+    AudioBuffer<float> buffer (2, blockSize);
+
+    for (auto& tier : tiers)
+    {
+        DeckEngine engine (trackLoader, numDecks);
+        engine.setParallelRendering(false);
+        engine.setNonRealtime(true);
+        engine.prepareToPlay(blockSize, sampleRate);
+
+        Array<DJAudioPlayer*> decks;
+        for (int i = 0; i < numDecks; ++i)
+        {
+            auto* deck = engine.getDeck(i);
+            deck->setKeyLock(true);
+            deck->setKeyLockQuality(tier.first);
+            deck->setSpeed(1.1);
+            decks.add(deck);
+        }
+
+        startDecks(decks, track);
+
+        auto parameter = String(numDecks) + " decks, " + tier.second;
+
+        runner.run(name, parameter, 200, [&](Stopwatch& stopwatch)
+        {
+            for (auto* deck : decks)
+                rewindIfNearEnd(*deck);
+
+            AudioSourceChannelInfo info (&buffer, 0, blockSize);
+            stopwatch.time([&] { engine.getNextAudioBlock(info); });
+        });
+
+        engine.releaseResources();
+
+        auto* result = runner.findResult(name, parameter);
+
+        if (result == nullptr)
+            continue;
+
+        auto budget = blockSize / sampleRate * 1.0e9;
+        std::cout << "    " << String(result->median / budget * 100.0, 1) << "% of one core" << std::endl;
+
+       #if ! JUCE_DEBUG
+        if (tier.first == TimeStretchAudioSource::Quality::medium)
+            runner.check(result->median < budget * 0.5, name + " [" + parameter + "] uses more than half of one core");
+       #endif
+    }
+}
+
+// Wall-clock time from setSource until the whole file has been scanned on the cache's thread
+static void benchmarkThumbnail(BenchmarkRunner& runner, AudioFormatManager& formatManager,
+                               const File& folder, double sampleRate)
+{
+    if (! runner.shouldRun("thumbnail"))
+        return;
+
+    AudioThumbnailCache cache (1);
+
+    for (auto minutes : { 5, 20 })
+    {
+        auto track = writeTestTrack(folder, minutes * 60.0, sampleRate);
+
+        runner.run("thumbnail", String(minutes) + " min", 1, [&](Stopwatch& stopwatch)
+        {
+            // A cached thumbnail would load without reading the file at all
+            cache.clear();
+            AudioThumbnail thumbnail (1000, formatManager, cache);
+
+            stopwatch.time([&]
+            {
+                thumbnail.setSource(new FileInputSource(track));
+
+                while (! thumbnail.isFullyLoaded())
+                    Thread::sleep(1);
+            });
+        }, 5, 1);
+    }
+}
+
+// Low/mid/high band analysis of a whole track, including reading the file
+static void benchmarkBandAnalysis(BenchmarkRunner& runner, AudioFormatManager& formatManager,
+                                  const File& folder, double sampleRate)
+{
+    if (! runner.shouldRun("band-analysis"))
+        return;
+
+    auto track = writeTestTrack(folder, 600.0, sampleRate);
+
+    runner.run("band-analysis", "10 min", 1, [&](Stopwatch& stopwatch)
+    {
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(track));
+        BandAnalysis::Ptr bands;
+
+        stopwatch.time([&] { bands = BandAnalysis::analyse(*reader); });
+
+        jassert (bands != nullptr && bands->getNumFrames() > 0);
+    }, 5, 1);
+}
+
+// Kicks on the beat and hats off it over a little noise, a grid the analysis should find
+static File writeBeatTrack(const File& folder, double seconds, double bpm, double sampleRate)
+{
+    auto file = folder.getChildFile("beats " + String(bpm, 1) + " bpm.wav");
+
+    if (file.existsAsFile())
+        return file;
+
+    std::unique_ptr<FileOutputStream> stream (file.createOutputStream());
+    WavAudioFormat wavFormat;
+    std::unique_ptr<AudioFormatWriter> writer (wavFormat.createWriterFor(stream.get(), sampleRate, 2, 16, {}, 0));
+
+    if (writer == nullptr)
+        return {};
+
+    stream.release();
+
+    AudioBuffer<float> buffer (2, (int) (seconds * sampleRate));
+    Random random (42);
+    auto beatLength = (int) (60.0 * sampleRate / bpm);
+
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+        auto sinceBeat = i % beatLength;
+        auto sinceHat = (i + beatLength / 2) % beatLength;
+
+        auto kick = 0.8f * std::exp(-sinceBeat / 800.0f)
+                         * (float) std::sin(MathConstants<double>::twoPi * 60.0 * sinceBeat / sampleRate);
+        auto hat = 0.3f * std::exp(-sinceHat / 150.0f) * (random.nextFloat() * 2.0f - 1.0f);
+        auto noise = 0.05f * (random.nextFloat() * 2.0f - 1.0f);
+
+        buffer.setSample(0, i, kick + hat + noise);
+        buffer.setSample(1, i, kick + hat + noise);
+    }
+
+    writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+    return file;
+}
+
+static void benchmarkBeatAnalysis(BenchmarkRunner& runner, AudioFormatManager& formatManager,
+                                  const File& folder, double sampleRate)
+{
+    if (! runner.shouldRun("beat-analysis"))
+        return;
+
+    auto track = writeBeatTrack(folder, 240.0, 126.0, sampleRate);
+
+    runner.run("beat-analysis", "4 min, 126 BPM", 1, [&](Stopwatch& stopwatch)
+    {
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(track));
+        BeatGrid grid;
+
+        stopwatch.time([&] { grid = BeatAnalyser::findBeatGrid(*reader); });
+
+        runner.check(std::abs(grid.bpm - 126.0) < 0.1, "beat-analysis finds 126 BPM, found " + String(grid.bpm, 2));
+    }, 5, 1);
+}
+
+// Cost of a deck following the master clock, with the leader and follower on different tempos.
+// The follower starts out of phase and has to be holding the beat by the end
+static void benchmarkSync(BenchmarkRunner& runner, TrackLoader& trackLoader, const File& folder, double sampleRate)
+{
+    if (! runner.shouldRun("sync"))
+        return;
+
+    const int blockSize = 512;
+    const double tempos[] = { 126.0, 120.0 };
+
+    DeckEngine engine (trackLoader, 2);
+    engine.setNonRealtime(true);
+    engine.prepareToPlay(blockSize, sampleRate);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        // The tracks' beats fall on whole samples, which makes the tempo very slightly off the nominal one
+        BeatGrid grid;
+        grid.bpm = 60.0 * sampleRate / (int) (60.0 * sampleRate / tempos[i]);
+
+        auto* deck = engine.getDeck(i);
+        deck->setReadAheadSize(0);
+        deck->loadURLSynchronously(URL(writeBeatTrack(folder, 240.0, tempos[i], sampleRate)), grid);
+    }
+
+    auto* leader = engine.getDeck(0);
+    auto* follower = engine.getDeck(1);
+    AudioBuffer<float> buffer (2, blockSize);
+
+    // One block for the clock to pick up the leader's tempo, which starting the follower snaps to
+    leader->setTempoMaster(true);
+    leader->start();
+
+    AudioSourceChannelInfo firstBlock (&buffer, 0, blockSize);
+    engine.getNextAudioBlock(firstBlock);
+
+    follower->setPosition(0.2);
+    follower->setSyncEnabled(true);
+    follower->start();
+
+    runner.run("sync", "2 decks, 126 and 120 BPM", 200, [&](Stopwatch& stopwatch)
+    {
+        AudioSourceChannelInfo info (&buffer, 0, blockSize);
+        stopwatch.time([&] { engine.getNextAudioBlock(info); });
+    }, 5, 1);
+
+    double beat, bpm;
+    bool following = follower->getBeatPosition(beat, bpm);
+    auto error = following ? beat - engine.getMasterClock().getBeatPosition() : 0.0;
+    error -= std::floor(error + 0.5);
+
+    runner.check(following && std::abs(error) < 0.01,
+                 "sync holds the follower on the master beat, " + String(error, 4) + " beats out");
+
+    engine.releaseResources();
+}
+
+static std::vector<std::string> makeTitles(int count)
+{
+    const char* const words[] = { "night", "bass", "deep", "city", "summer", "light", "drive", "echo",
+                                  "rhythm", "soul", "groove", "sunset", "dream", "fire", "ocean", "motion" };
+    const char* const versions[] = { "", " (Original Mix)", " (Extended Mix)", " (Remix)", " (Dub)", " (Radio Edit)" };
+
+    std::vector<std::string> titles;
+    titles.reserve((size_t) count);
+    Random random (7);
+
+    for (int i = 0; i < count; ++i)
+    {
+        String title;
+        title << "Artist " << random.nextInt(5000) << " - "
+              << words[random.nextInt(16)] << " " << words[random.nextInt(16)]
+              << versions[random.nextInt(6)];
+
+        titles.push_back(title.toStdString());
+    }
+
+    return titles;
+}
+
+// The playlist search before it had an index, lower-cases every title on every keystroke
+static void legacyFindMatchingTitles(const std::vector<std::string>& titles, const String& lowerCaseSearchText,
+                                     std::vector<int>& matchingIndices)
+{
+    matchingIndices.clear();
+
+    for (int i = 0; i < (int) titles.size(); ++i)
+    {
+        String title = String(titles[(size_t) i]).toLowerCase();
+        if (title.contains(lowerCaseSearchText))
+            matchingIndices.push_back(i);
+    }
+}
+
+static void benchmarkPlaylistFilter(BenchmarkRunner& runner)
+{
+    const int titleCounts[] = { 10000, 100000, 1000000 };
+
+    // A common word, a rare one and one that never matches
+    const char* const searches[] = { "mix", "sunset dream", "zzz" };
+
+    for (auto count : titleCounts)
+    {
+        if (! runner.shouldRun("playlist-filter"))
+            return;
+
+        auto titles = makeTitles(count);
+        std::vector<int> matches;
+        TrackSearchIndex index;
+
+        runner.run("playlist-filter/index-build", String(count) + " titles", 1, [&](Stopwatch& stopwatch)
+        {
+            stopwatch.time([&]
+            {
+                index.clear();
+
+                for (auto& title : titles)
+                    index.add(title);
+            });
+        }, 3, 0);
+
+        for (auto search : searches)
+        {
+            auto parameter = String(count) + " titles, '" + search + "'";
+
+            runner.run("playlist-filter/linear", parameter, jmax(1, 100000 / count), [&](Stopwatch& stopwatch)
+            {
+                stopwatch.time([&] { legacyFindMatchingTitles(titles, search, matches); });
+            }, 0, 1);
+
+            // An empty search forgets the last query, so each one is answered from scratch
+            runner.run("playlist-filter/index", parameter, jmax(1, 100000 / count), [&](Stopwatch& stopwatch)
+            {
+                index.search({});
+                stopwatch.time([&] { index.search(search); });
+            }, 0, 1);
+
+            // Every prefix in turn, as the search box sees them while the query is typed
+            runner.run("playlist-filter/typing", parameter, jmax(1, 10000 / count), [&](Stopwatch& stopwatch)
+            {
+                index.search({});
+                String typed (search);
+
+                stopwatch.time([&]
+                {
+                    for (int length = 1; length <= typed.length(); ++length)
+                        index.search(typed.substring(0, length));
+                });
+            }, 0, 1);
+        }
+
+        // Deleting rows with a search showing, as the playlist does: each removal is
+        // followed by the search again. Runs last, as it leaves fewer titles behind
+        const int numDeletes = 100;
+        Random random (7);
+        index.search("mix");
+
+        runner.run("playlist-filter/delete", String(count) + " titles, " + String(numDeletes) + " deletes with 'mix' showing", 1, [&](Stopwatch& stopwatch)
+        {
+            for (int i = 0; i < numDeletes; ++i)
+            {
+                auto row = random.nextInt(index.size());
+                titles.erase(titles.begin() + row);
+
+                stopwatch.time([&]
+                {
+                    index.remove(row);
+                    index.search("mix");
+                });
+            }
+        }, 0, 1);
+
+        legacyFindMatchingTitles(titles, "mix", matches);
+        runner.check(index.search("mix") == matches,
+                     "playlist-filter finds the same titles after deletes from " + String(count));
+    }
+}
+
+static void benchmarkTrackLibrary(BenchmarkRunner& runner, const File& folder)
+{
+    const int trackCounts[] = { 10000, 200000 };
+
+    for (auto count : trackCounts)
+    {
+        if (! runner.shouldRun("track-library"))
+            return;
+
+        auto libraryFile = folder.getChildFile("Library" + String(count) + ".otolib");
+        auto titles = makeTitles(count);
+
+        // Closing with that many edits in the log folds them into the library file
+        {
+            TrackLibrary library (libraryFile);
+
+            for (auto& title : titles)
+            {
+                TrackLibrary::TrackInfo track;
+                track.url = URL(folder.getChildFile(String(title) + ".wav"));
+                track.title = title;
+                track.lengthInSeconds = 240.0;
+                track.sampleRate = 44100.0;
+                track.numChannels = 2;
+                library.addTrack(track);
+            }
+        }
+
+        // Every track comes back from the index, in the order it was added
+        {
+            TrackLibrary library (libraryFile);
+            auto last = library.getNumTracks() - 1;
+
+            runner.check(library.getNumTracks() == count
+                           && library.getTitle(0) == String(titles[0])
+                           && library.getTitle(last) == String(titles[(size_t) last]),
+                         "track-library reopens " + String(count) + " tracks from its index");
+        }
+
+        // Opening the library and reading the rows a playlist shows first
+        runner.run("track-library/open", String(count) + " tracks", 1, [&](Stopwatch& stopwatch)
+        {
+            stopwatch.time([&]
+            {
+                TrackLibrary library (libraryFile);
+
+                for (int i = 0; i < jmin(30, library.getNumTracks()); ++i)
+                    library.getTitle(i);
+            });
+        }, 0, 1);
+
+        // Removing from the middle, which used to shift every track after it
+        // On a copy, so every repetition starts from the full library
+        auto scratchFile = libraryFile.getSiblingFile("Scratch.otolib");
+
+        runner.run("track-library/remove", String(count) + " tracks", 1, [&](Stopwatch& stopwatch)
+        {
+            libraryFile.copyFileTo(scratchFile);
+
+            {
+                TrackLibrary library (scratchFile);
+
+                stopwatch.time([&]
+                {
+                    for (int i = 0; i < 1000; ++i)
+                        library.removeTrack(library.getNumTracks() / 2);
+                });
+
+                // Ids go up in the order tracks were added, so they still do if no track moved
+                auto inOrder = library.getNumTracks() == count - 1000;
+
+                for (int i = 1; i < library.getNumTracks() && inOrder; ++i)
+                    inOrder = library.getTrackId(i - 1) < library.getTrackId(i);
+
+                runner.check(inOrder, "track-library keeps its order after removals from " + String(count) + " tracks");
+            }
+
+            scratchFile.deleteFile();
+            scratchFile.withFileExtension("log").deleteFile();
+        }, 0, 1);
+
+        libraryFile.deleteFile();
+    }
+}
+
+// A 441 Hz sine whose phase carries on from startSeconds, so tracks written back to back
+// join without a step whatever their sample rates
+static File writeSineTrack(const File& folder, const String& name, double startSeconds, double seconds, double sampleRate)
+{
+    auto file = folder.getChildFile(name + ".wav");
+    file.deleteFile();
+
+    std::unique_ptr<FileOutputStream> stream (file.createOutputStream());
+    WavAudioFormat wavFormat;
+    std::unique_ptr<AudioFormatWriter> writer (wavFormat.createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+
+    if (writer == nullptr)
+        return {};
+
+    stream.release();
+
+    AudioBuffer<float> buffer (2, (int) (seconds * sampleRate));
+
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+        auto sample = 0.5f * (float) std::sin(MathConstants<double>::twoPi * 441.0 * (startSeconds + i / sampleRate));
+        buffer.setSample(0, i, sample);
+        buffer.setSample(1, i, sample);
+    }
+
+    writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+    return file;
+}
+
+// A deck playing out a 44.1kHz track into a 48kHz one, rendered offline. Across the switch
+// the output may not step further than a steady stretch of the sine does, or drop out
+static void benchmarkNextTrack(BenchmarkRunner& runner, const File& folder, double sampleRate)
+{
+    if (! runner.shouldRun("next-track"))
+        return;
+
+    const double firstLength = 2.0;
+
+    for (auto crossfade : { 0.0, 0.5 })
+    {
+        auto parameter = crossfade > 0 ? String("crossfade, 44.1 to 48 kHz") : String("cut, 44.1 to 48 kHz");
+
+        auto first = writeSineTrack(folder, "first", 0.0, firstLength, 44100.0);
+        auto next = writeSineTrack(folder, "next", firstLength - crossfade, 2.0, 48000.0);
+
+        auto session = folder.getChildFile("next track.json");
+        auto output = folder.getChildFile("next track.wav");
+
+        DynamicObject::Ptr deck (new DynamicObject());
+        deck->setProperty("file", first.getFileName());
+        deck->setProperty("next", next.getFileName());
+        deck->setProperty("crossfade", crossfade);
+
+        DynamicObject::Ptr play (new DynamicObject());
+        play->setProperty("time", 0.0);
+        play->setProperty("deck", 0);
+        play->setProperty("action", "play");
+
+        DynamicObject::Ptr settings (new DynamicObject());
+        settings->setProperty("sampleRate", sampleRate);
+        settings->setProperty("blockSize", 512);
+        settings->setProperty("duration", firstLength + 1.0);
+        settings->setProperty("decks", Array<var> { var(deck.get()) });
+        settings->setProperty("events", Array<var> { var(play.get()) });
+        session.replaceWithText(JSON::toString(var(settings.get())));
+
+        OfflineRenderer::Result result;
+
+        runner.run("next-track", parameter, 1, [&](Stopwatch& stopwatch)
+        {
+            OfflineRenderer renderer;
+            stopwatch.time([&] { result = renderer.render(session, output); });
+        }, 1, 1);
+
+        runner.check(result.succeeded, "next-track [" + parameter + "] renders: " + result.errorMessage);
+
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(output));
+
+        if (! result.succeeded || reader == nullptr)
+            continue;
+
+        AudioBuffer<float> rendered (1, (int) reader->lengthInSamples);
+        reader->read(&rendered, 0, rendered.getNumSamples(), 0, true, false);
+        auto* samples = rendered.getReadPointer(0);
+
+        // Largest step between samples, and the longest stretch quieter than a fifth of the peak
+        auto measure = [&](double from, double to, float& maxStep, int& longestQuiet)
+        {
+            auto start = jmax(1, (int) (from * sampleRate));
+            auto end = jmin(rendered.getNumSamples(), (int) (to * sampleRate));
+            auto peak = 0.0f;
+
+            for (int i = start; i < end; ++i)
+                peak = jmax(peak, std::abs(samples[i]));
+
+            maxStep = 0.0f;
+            longestQuiet = 0;
+            int quiet = 0;
+
+            for (int i = start; i < end; ++i)
+            {
+                maxStep = jmax(maxStep, std::abs(samples[i] - samples[i - 1]));
+                quiet = std::abs(samples[i]) < 0.2f * peak ? quiet + 1 : 0;
+                longestQuiet = jmax(longestQuiet, quiet);
+            }
+        };
+
+        float steadyStep, switchStep;
+        int steadyQuiet, switchQuiet;
+        measure(0.5, 1.0, steadyStep, steadyQuiet);
+        measure(firstLength - crossfade - 0.1, firstLength + 0.1, switchStep, switchQuiet);
+
+        runner.check(steadyStep > 0.0f && switchStep <= steadyStep * 1.75f,
+                     "next-track [" + parameter + "] joins without a step, " + String(switchStep / jmax(steadyStep, 1.0e-6f), 2)
+                        + " times the steady sine's");
+        runner.check(switchQuiet < 16, "next-track [" + parameter + "] plays without a gap, "
+                                          + String(switchQuiet) + " quiet samples in a row");
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    // AudioThumbnail and the decks post change messages, which need a message manager
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    StringArray arguments;
+    for (int i = 1; i < argc; ++i)
+        arguments.add(argv[i]);
+
+    BenchmarkRunner runner (arguments);
+    const double sampleRate = 44100.0;
+
+    auto folder = File::getSpecialLocation(File::tempDirectory).getChildFile("OtoDecksBenchmarks");
+    folder.createDirectory();
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    TimeSliceThread diskThread ("Benchmark disk reader");
+    diskThread.startThread();
+    TrackLoader trackLoader (formatManager, diskThread, 1);
+
+    auto track = writeTestTrack(folder, 120.0, sampleRate);
+
+    benchmarkReverb(runner, sampleRate);
+    benchmarkPlayer(runner, trackLoader, track, sampleRate);
+    benchmarkMixing(runner, trackLoader, track, sampleRate);
+    benchmarkKeyLockMixing(runner, trackLoader, track, sampleRate);
+    benchmarkThumbnail(runner, formatManager, folder, sampleRate);
+    benchmarkBandAnalysis(runner, formatManager, folder, sampleRate);
+    benchmarkBeatAnalysis(runner, formatManager, folder, sampleRate);
+    benchmarkSync(runner, trackLoader, folder, sampleRate);
+    benchmarkNextTrack(runner, folder, sampleRate);
+    benchmarkPlaylistFilter(runner);
+    benchmarkTrackLibrary(runner, folder);
+
+    diskThread.stopThread(2000);
+    folder.deleteRecursively();
+
+    return runner.finish();
+}
@@ -0,0 +1,143 @@
+#include "AudioProfiler.h"
+
+AudioProfiler::AudioProfiler(int fifoSize, int historySize)
+: startTicks(Time::getHighResolutionTicks()),
+  fifo(fifoSize),
+  fifoRecords((size_t) fifoSize),
+  history((size_t) jmax(1, historySize))
+{
+}
+
+double AudioProfiler::getTime() const
+{
+    return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+}
+
+void AudioProfiler::pushBlock(const BlockRecord& record)
+{
+    // resetCounters can run on another thread, so a plain compare and store could undo it
+    auto worst = worstCallbackMs.load();
+
+    while (record.callbackMs > worst && ! worstCallbackMs.compare_exchange_weak(worst, record.callbackMs))
+    {
+    }
+
+    // Took longer than the audio it produced, the device will have glitched
+    if (record.budgetMs > 0 && record.callbackMs > record.budgetMs)
+        ++overruns;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+    {
+        ++droppedRecords;
+        return;
+    }
+
+    fifoRecords[(size_t) (size1 > 0 ? start1 : start2)] = record;
+    fifo.finishedWrite(1);
+}
+
+void AudioProfiler::resetCounters()
+{
+    worstCallbackMs = 0;
+    overruns = 0;
+    droppedRecords = 0;
+}
+
+const AudioProfiler::Summary& AudioProfiler::collect()
+{
+    Summary newSummary;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+    auto addRecords = [this, &newSummary](int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            auto& record = fifoRecords[(size_t) i];
+
+            history[historyWritePosition] = record;
+            historyWritePosition = (historyWritePosition + 1) % history.size();
+            historyFull = historyFull || historyWritePosition == 0;
+
+            ++newSummary.numBlocks;
+            newSummary.numDecks = jmax(newSummary.numDecks, record.numDecks);
+            newSummary.averageLoad += record.getLoad();
+            newSummary.peakLoad = jmax(newSummary.peakLoad, record.getLoad());
+            newSummary.averageMixMs += record.mixMs;
+
+            for (int deck = 0; deck < record.numDecks; ++deck)
+                for (int stage = 0; stage < numDeckStages; ++stage)
+                    newSummary.averageDeckMs[deck][stage] += record.deckMs[deck][stage];
+        }
+    };
+
+    addRecords(start1, size1);
+    addRecords(start2, size2);
+    fifo.finishedRead(size1 + size2);
+
+    // Keep showing the last figures if the audio has stopped
+    if (newSummary.numBlocks == 0)
+        return summary;
+
+    auto scale = 1.0f / (float) newSummary.numBlocks;
+    newSummary.averageLoad *= scale;
+    newSummary.averageMixMs *= scale;
+
+    for (auto& deck : newSummary.averageDeckMs)
+        for (auto& stageMs : deck)
+            stageMs *= scale;
+
+    summary = newSummary;
+    return summary;
+}
+
+bool AudioProfiler::writeCsv(const File& file) const
+{
+    FileOutputStream stream (file);
+
+    if (! stream.openedOk())
+        return false;
+
+    stream.setPosition(0);
+    stream.truncate();
+
+    auto numRecords = historyFull ? history.size() : historyWritePosition;
+    auto firstRecord = historyFull ? historyWritePosition : 0;
+
+    int numDecks = 0;
+    for (size_t i = 0; i < numRecords; ++i)
+        numDecks = jmax(numDecks, history[(firstRecord + i) % history.size()].numDecks);
+
+    static const char* const stageNames[numDeckStages] = { "resample", "effects", "gain" };
+
+    stream << "time_s,samples,callback_ms,budget_ms,load_pct,mix_ms,late_decks";
+
+    for (int deck = 0; deck < numDecks; ++deck)
+        for (auto* stageName : stageNames)
+            stream << ",deck" << (deck + 1) << "_" << stageName << "_ms";
+
+    stream << "\n";
+
+    for (size_t i = 0; i < numRecords; ++i)
+    {
+        auto& record = history[(firstRecord + i) % history.size()];
+
+        stream << String(record.time, 6) << "," << record.numSamples << ","
+               << String(record.callbackMs, 4) << "," << String(record.budgetMs, 4) << ","
+               << String(record.getLoad() * 100.0f, 2) << "," << String(record.mixMs, 4) << ","
+               << record.lateDecks;
+
+        for (int deck = 0; deck < numDecks; ++deck)
+            for (int stage = 0; stage < numDeckStages; ++stage)
+                stream << "," << String(record.deckMs[deck][stage], 4);
+
+        stream << "\n";
+    }
+
+    stream.flush();
+    return stream.getStatus().wasOk();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Always-on timing of the audio callback. The audio thread pushes one fixed-size
+// record per callback into a lock-free FIFO and updates a few atomics, the message
+// thread drains the FIFO into a history that can be shown or written out as CSV
+class AudioProfiler
+{
+public:
+    static constexpr int maxDecks = 8;
+
+    // Stages timed inside each deck's getNextAudioBlock
+    enum DeckStage
+    {
+        resampleStage = 0,  // track reading, time-stretching and resampling
+        effectsStage,
+        gainStage,
+        numDeckStages
+    };
+
+    struct BlockRecord
+    {
+        double time = 0;          // seconds since the profiler was created
+        int numSamples = 0;
+        int numDecks = 0;
+        int lateDecks = 0;        // decks that missed the join deadline in this block
+        float callbackMs = 0;
+        float budgetMs = 0;       // duration of the block's audio
+        float mixMs = 0;
+        float deckMs[maxDecks][numDeckStages] = {};
+
+        float getLoad() const { return budgetMs > 0 ? callbackMs / budgetMs : 0; }
+    };
+
+    // Averages over the records collected by the last call to collect()
+    struct Summary
+    {
+        int numBlocks = 0;
+        int numDecks = 0;
+        float averageLoad = 0;
+        float peakLoad = 0;
+        float averageMixMs = 0;
+        float averageDeckMs[maxDecks][numDeckStages] = {};
+    };
+
+    AudioProfiler(int fifoSize = 2048, int historySize = 32768);
+
+    // Audio thread: adds a record and updates the running counters, never blocks
+    void pushBlock(const BlockRecord& record);
+
+    // Seconds since creation, for stamping records
+    double getTime() const;
+
+    // Running counters, safe from any thread
+    float getWorstCallbackMs() const { return worstCallbackMs.load(); }
+    int getOverrunCount() const { return overruns.load(); }
+    int getDroppedRecordCount() const { return droppedRecords.load(); }
+    void resetCounters();
+
+    // Message thread: moves everything the audio thread has pushed into the history
+    const Summary& collect();
+    const Summary& getSummary() const { return summary; }
+
+    // Message thread: writes the history, oldest first
+    bool writeCsv(const File& file) const;
+
+private:
+    const int64 startTicks;
+
+    AbstractFifo fifo;
+    std::vector<BlockRecord> fifoRecords;
+
+    std::atomic<float> worstCallbackMs { 0 };
+    std::atomic<int> overruns { 0 };
+    std::atomic<int> droppedRecords { 0 };
+
+    // Only touched on the message thread
+    std::vector<BlockRecord> history;
+    size_t historyWritePosition = 0;
+    bool historyFull = false;
+    Summary summary;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioProfiler)
+};
@@ -0,0 +1,221 @@
+#include "BandAnalysis.h"
+
+namespace
+{
+    const char bandsMagic[8] = { 'O', 'T', 'O', 'B', 'A', 'N', 'D', 'S' };
+    const int bandsVersion = 1;
+
+    // Mixed into the file's identity so the analysis never takes the thumbnail's key
+    const int64 storeKeySalt = 0x42414e4453763031;   // "BANDSv01"
+}
+
+//==============================================================================
+// Reuses a stored analysis if there is one, otherwise reads the track and stores the result
+class BandAnalysis::AnalysisJob : public ThreadPoolJob
+{
+public:
+    AnalysisJob(const URL& _url, AudioFormatManager& _formatManager, PersistentThumbnailCache& _store,
+                std::function<void (Ptr)> _onFinished)
+    : ThreadPoolJob("Band analysis"), url(_url), formatManager(_formatManager), store(_store),
+      onFinished(std::move(_onFinished))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        auto key = PersistentThumbnailCache::getIdentity(url) ^ storeKeySalt;
+        Ptr result;
+
+        MemoryBlock stored;
+        if (store.loadData(key, stored))
+            result = fromMemoryBlock(stored);
+
+        if (result == nullptr)
+        {
+            std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(url.createInputStream(false)));
+
+            if (reader == nullptr || reader->lengthInSamples <= 0)
+                return jobHasFinished;
+
+            result = analyse(*reader, this);
+
+            if (result == nullptr)
+                return jobHasFinished;
+
+            store.storeData(key, result->toMemoryBlock());
+        }
+
+        auto callback = onFinished;
+        MessageManager::callAsync([callback, result] { callback(result); });
+        return jobHasFinished;
+    }
+
+private:
+    const URL url;
+    AudioFormatManager& formatManager;
+    PersistentThumbnailCache& store;
+    std::function<void (Ptr)> onFinished;
+};
+
+//==============================================================================
+BandAnalysis::BandAnalysis(double _sampleRate, std::vector<uint8> _levels)
+: sampleRate(_sampleRate), levels(std::move(_levels))
+{
+}
+
+void BandAnalysis::analyseAsync(const URL& url, AudioFormatManager& formatManager, ThreadPool& pool,
+                                PersistentThumbnailCache& store, std::function<void (Ptr)> onFinished)
+{
+    pool.addJob(new AnalysisJob(url, formatManager, store, std::move(onFinished)), true);
+}
+
+BandAnalysis::Ptr BandAnalysis::analyse(AudioFormatReader& reader, ThreadPoolJob* job)
+{
+    const int framesPerRead = 64;
+
+    auto length = reader.lengthInSamples;
+    auto numFrames = (size_t) ((length + frameSize - 1) / frameSize);
+    auto numChannels = (int) jlimit(1u, 2u, reader.numChannels);
+    auto rate = reader.sampleRate > 0 ? reader.sampleRate : 44100.0;
+
+    // Last bin of each band, bin 0 is DC and left out
+    auto binFor = [rate](double hz) { return jlimit(2, frameSize / 2, roundToInt(hz * frameSize / rate)); };
+    const int bandEnds[numBands] = { binFor(200.0), binFor(2000.0), frameSize / 2 };
+
+    dsp::FFT fft (fftOrder);
+    dsp::WindowingFunction<float> window ((size_t) frameSize, dsp::WindowingFunction<float>::hann, false);
+
+    AudioBuffer<float> buffer (numChannels, framesPerRead * frameSize);
+    HeapBlock<float> fftData ((size_t) frameSize * 2);
+
+    std::vector<float> energies (numFrames * numBands);
+    float peaks[numBands] = {};
+
+    for (size_t frame = 0; frame < numFrames; frame += framesPerRead)
+    {
+        if (job != nullptr && job->shouldExit())
+            return nullptr;
+
+        auto position = (int64) frame * frameSize;
+        auto numSamples = (int) jmin((int64) buffer.getNumSamples(), length - position);
+
+        reader.read(&buffer, 0, numSamples, position, true, numChannels > 1);
+
+        // The last frame is padded with silence
+        if (numSamples < buffer.getNumSamples())
+            buffer.clear(numSamples, buffer.getNumSamples() - numSamples);
+
+        for (size_t i = frame; i < jmin(numFrames, frame + framesPerRead); ++i)
+        {
+            auto offset = (int) (i - frame) * frameSize;
+
+            // Channels are folded together, the colour is for the whole mix
+            FloatVectorOperations::copy(fftData, buffer.getReadPointer(0, offset), frameSize);
+
+            for (int channel = 1; channel < numChannels; ++channel)
+                FloatVectorOperations::add(fftData, buffer.getReadPointer(channel, offset), frameSize);
+
+            window.multiplyWithWindowingTable(fftData, (size_t) frameSize);
+            fft.performFrequencyOnlyForwardTransform(fftData);
+
+            int bin = 1;
+
+            for (int band = 0; band < numBands; ++band)
+            {
+                auto firstBin = bin;
+                float sumOfSquares = 0;
+
+                for (; bin < bandEnds[band]; ++bin)
+                    sumOfSquares += fftData[bin] * fftData[bin];
+
+                auto energy = std::sqrt(sumOfSquares / (float) jmax(1, bin - firstBin));
+                energies[i * numBands + (size_t) band] = energy;
+                peaks[band] = jmax(peaks[band], energy);
+            }
+        }
+    }
+
+    std::vector<uint8> newLevels (energies.size());
+
+    for (size_t i = 0; i < energies.size(); ++i)
+    {
+        auto peak = peaks[i % numBands];
+        newLevels[i] = peak > 0 ? (uint8) roundToInt(255.0f * energies[i] / peak) : 0;
+    }
+
+    return new BandAnalysis(rate, std::move(newLevels));
+}
+
+void BandAnalysis::getLevels(double startSeconds, double endSeconds, float (&bandLevels)[numBands]) const
+{
+    for (auto& level : bandLevels)
+        level = 0;
+
+    auto numFrames = getNumFrames();
+
+    if (numFrames == 0)
+        return;
+
+    auto first = jlimit(0, numFrames - 1, (int) (startSeconds * sampleRate / frameSize));
+    auto last = jlimit(first, numFrames - 1, (int) std::ceil(endSeconds * sampleRate / frameSize) - 1);
+
+    uint8 loudest[numBands] = {};
+
+    for (auto frame = first; frame <= last; ++frame)
+        for (int band = 0; band < numBands; ++band)
+            loudest[band] = jmax(loudest[band], levels[(size_t) (frame * numBands + band)]);
+
+    for (int band = 0; band < numBands; ++band)
+        bandLevels[band] = loudest[band] / 255.0f;
+}
+
+Colour BandAnalysis::getColour(double startSeconds, double endSeconds) const
+{
+    float bandLevels[numBands];
+    getLevels(startSeconds, endSeconds, bandLevels);
+
+    auto loudest = jmax(bandLevels[lowBand], bandLevels[midBand], bandLevels[highBand]);
+
+    if (loudest <= 0)
+        return Colours::grey;
+
+    return Colour::fromFloatRGBA(bandLevels[lowBand] / loudest, bandLevels[midBand] / loudest,
+                                 bandLevels[highBand] / loudest, 1.0f);
+}
+
+MemoryBlock BandAnalysis::toMemoryBlock() const
+{
+    MemoryOutputStream stream;
+    stream.write(bandsMagic, sizeof(bandsMagic));
+    stream.writeInt(bandsVersion);
+    stream.writeInt(frameSize);
+    stream.writeDouble(sampleRate);
+    stream.writeInt(getNumFrames());
+    stream.write(levels.data(), levels.size());
+    return stream.getMemoryBlock();
+}
+
+BandAnalysis::Ptr BandAnalysis::fromMemoryBlock(const MemoryBlock& data)
+{
+    MemoryInputStream stream (data, false);
+
+    char magic[sizeof(bandsMagic)];
+
+    if (stream.read(magic, sizeof(magic)) != (int) sizeof(magic) || memcmp(magic, bandsMagic, sizeof(magic)) != 0)
+        return nullptr;
+
+    // Analyses made with other settings are redone
+    if (stream.readInt() != bandsVersion || stream.readInt() != frameSize)
+        return nullptr;
+
+    auto rate = stream.readDouble();
+    auto numFrames = stream.readInt();
+
+    if (rate <= 0 || numFrames < 0 || stream.getNumBytesRemaining() != (int64) numFrames * numBands)
+        return nullptr;
+
+    std::vector<uint8> storedLevels ((size_t) numFrames * numBands);
+    stream.read(storedLevels.data(), (int) storedLevels.size());
+
+    return new BandAnalysis(rate, std::move(storedLevels));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PersistentThumbnailCache.h"
+
+// Low, mid and high band levels through a track, for colouring its waveform red,
+// green and blue. Each frame is an FFT of frameSize samples, and each band is scaled
+// so that its loudest frame in the track is full level.
+//
+// Results are kept in the thumbnail pack, so a track is only analysed once
+class BandAnalysis : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<BandAnalysis>;
+
+    static constexpr int fftOrder = 10;
+    static constexpr int frameSize = 1 << fftOrder;
+
+    enum Band
+    {
+        lowBand = 0,    // below 200 Hz
+        midBand,        // 200 Hz to 2 kHz
+        highBand,
+        numBands
+    };
+
+    // Loads the stored analysis for the file, or analyses it on the pool and stores it.
+    // onFinished is called on the message thread, and never if the file can't be read
+    static void analyseAsync(const URL& url, AudioFormatManager& formatManager, ThreadPool& pool,
+                             PersistentThumbnailCache& store, std::function<void (Ptr)> onFinished);
+
+    // Analyses the whole track, nullptr if the job was asked to exit
+    static Ptr analyse(AudioFormatReader& reader, ThreadPoolJob* job = nullptr);
+
+    int getNumFrames() const { return (int) (levels.size() / numBands); }
+    double getSampleRate() const { return sampleRate; }
+
+    // Loudest level of each band, from 0 to 1, over the frames from start to end
+    void getLevels(double startSeconds, double endSeconds, float (&bandLevels)[numBands]) const;
+
+    // Mix of red for the lows, green for the mids and blue for the highs, at full brightness
+    Colour getColour(double startSeconds, double endSeconds) const;
+
+    // Compact form kept in the thumbnail pack, fromMemoryBlock returns nullptr if it's not valid
+    MemoryBlock toMemoryBlock() const;
+    static Ptr fromMemoryBlock(const MemoryBlock& data);
+
+private:
+    class AnalysisJob;
+
+    BandAnalysis(double sampleRate, std::vector<uint8> levels);
+
+    const double sampleRate;
+
+    // numBands levels per frame, 255 is the band's loudest
+    const std::vector<uint8> levels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BandAnalysis)
+};
@@ -0,0 +1,347 @@
+#include "BeatAnalyser.h"
+
+namespace
+{
+    // Onsets are found in the track decimated to about this rate, which keeps the kicks,
+    // snares and hats and cuts the number of FFTs by four
+    const double analysisRate = 11025.0;
+    const int fftOrder = 8;
+    const int frameSize = 1 << fftOrder;
+    const int hopSize = frameSize / 2;
+
+    // Enough to settle the tempo and phase, and bounds the decoding time of long mixes
+    const double maxAnalysisSeconds = 120.0;
+    const double minAnalysisSeconds = 10.0;
+
+    const double minBpm = 60.0, maxBpm = 200.0;
+
+    // Kicks are where a DJ puts the beat, so onsets below this weigh most in placing the grid
+    const double kickHz = 200.0;
+
+    // Four partial sums, which the compiler keeps in one SIMD register
+    float sum(const float* values, int num)
+    {
+        float sums[4] = {};
+        int i = 0;
+
+        for (; i + 4 <= num; i += 4)
+            for (int lane = 0; lane < 4; ++lane)
+                sums[lane] += values[i + lane];
+
+        for (; i < num; ++i)
+            sums[0] += values[i];
+
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    float dotProduct(const float* a, const float* b, int num)
+    {
+        float sums[4] = {};
+        int i = 0;
+
+        for (; i + 4 <= num; i += 4)
+            for (int lane = 0; lane < 4; ++lane)
+                sums[lane] += a[i + lane] * b[i + lane];
+
+        for (; i < num; ++i)
+            sums[0] += a[i] * b[i];
+
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    // Takes away the average of the surrounding half second, leaving only the onsets
+    // standing out of sustained sound
+    std::vector<float> removeLocalAverage(const std::vector<float>& flux, int halfWindow)
+    {
+        auto numFrames = (int) flux.size();
+        std::vector<double> runningTotal ((size_t) numFrames + 1);
+
+        for (int frame = 0; frame < numFrames; ++frame)
+            runningTotal[(size_t) frame + 1] = runningTotal[(size_t) frame] + flux[(size_t) frame];
+
+        std::vector<float> onsets ((size_t) numFrames);
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            auto start = jmax(0, frame - halfWindow);
+            auto end = jmin(numFrames, frame + halfWindow + 1);
+            auto average = (runningTotal[(size_t) end] - runningTotal[(size_t) start]) / (end - start);
+
+            onsets[(size_t) frame] = jmax(0.0f, flux[(size_t) frame] - (float) average);
+        }
+
+        return onsets;
+    }
+
+    // Where the peak of a parabola through three points lies, relative to the middle one
+    double parabolicOffset(double before, double peak, double after)
+    {
+        auto curvature = before - 2.0 * peak + after;
+        return curvature < 0 ? jlimit(-0.5, 0.5, 0.5 * (before - after) / curvature) : 0.0;
+    }
+}
+
+//==============================================================================
+class BeatAnalyser::AnalysisJob : public ThreadPoolJob
+{
+public:
+    AnalysisJob(AudioFormatManager& _formatManager, WeakReference<BeatAnalyser> _owner,
+                TrackLibrary::TrackId _id, const URL& _url)
+    : ThreadPoolJob("Beat analysis"), formatManager(_formatManager), owner(_owner), id(_id), url(_url)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        BeatGrid grid;
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(url.createInputStream(false)));
+
+        if (reader != nullptr)
+            grid = findBeatGrid(*reader, this);
+
+        // Reported even when nothing was found, so the next request can start. Only a
+        // track read to the end is known to have no beat
+        auto weakOwner = owner;
+        auto trackId = id;
+        auto completed = reader != nullptr && ! shouldExit();
+
+        MessageManager::callAsync([weakOwner, trackId, grid, completed]
+        {
+            if (auto* analyser = weakOwner.get())
+                analyser->jobFinished(trackId, grid, completed);
+        });
+
+        return jobHasFinished;
+    }
+
+private:
+    AudioFormatManager& formatManager;
+    WeakReference<BeatAnalyser> owner;
+    const TrackLibrary::TrackId id;
+    const URL url;
+};
+
+//==============================================================================
+BeatAnalyser::BeatAnalyser(AudioFormatManager& _formatManager)
+: formatManager(_formatManager)
+{
+    selfReference = this;
+}
+
+BeatAnalyser::~BeatAnalyser()
+{
+    pool.removeAllJobs(true, 10000);
+}
+
+void BeatAnalyser::analyse(TrackLibrary::TrackId id, const URL& url, bool urgent)
+{
+    if (! requested.insert(id).second)
+    {
+        if (urgent)
+        {
+            auto request = std::find_if(pending.begin(), pending.end(), [id](const Request& r) { return r.id == id; });
+
+            if (request != pending.end())
+            {
+                auto moved = *request;
+                pending.erase(request);
+                pending.push_front(moved);
+            }
+        }
+
+        return;
+    }
+
+    if (urgent)
+        pending.push_front({ id, url });
+    else
+        pending.push_back({ id, url });
+
+    startJobs();
+}
+
+// The pool only ever holds the running jobs, so the queue order decides what runs next
+void BeatAnalyser::startJobs()
+{
+    while (jobsRunning < maxJobs && ! pending.empty())
+    {
+        auto request = pending.front();
+        pending.pop_front();
+
+        ++jobsRunning;
+        pool.addJob(new AnalysisJob(formatManager, selfReference, request.id, request.url), true);
+    }
+}
+
+void BeatAnalyser::jobFinished(TrackLibrary::TrackId id, BeatGrid grid, bool completed)
+{
+    --jobsRunning;
+
+    if (completed && onAnalysed != nullptr)
+        onAnalysed(id, grid);
+
+    startJobs();
+}
+
+BeatGrid BeatAnalyser::findBeatGrid(AudioFormatReader& reader, ThreadPoolJob* job)
+{
+    auto rate = reader.sampleRate;
+
+    if (rate <= 0 || reader.lengthInSamples <= 0)
+        return {};
+
+    auto decimation = jmax(1, roundToInt(rate / analysisRate));
+    auto envelopeRate = rate / decimation / hopSize;
+    auto length = jmin(reader.lengthInSamples, (int64) (maxAnalysisSeconds * rate));
+    auto numChannels = (int) jlimit(1u, 2u, reader.numChannels);
+
+    // Channels folded together and decimated by averaging, crude but enough for onsets
+    std::vector<float> signal ((size_t) (length / decimation));
+    AudioBuffer<float> buffer (numChannels, decimation * 8192);
+    auto gain = 1.0f / (float) (decimation * numChannels);
+
+    for (int64 position = 0; position < length; position += buffer.getNumSamples())
+    {
+        if (job != nullptr && job->shouldExit())
+            return {};
+
+        auto numSamples = (int) jmin((int64) buffer.getNumSamples(), length - position);
+        reader.read(&buffer, 0, numSamples, position, true, numChannels > 1);
+
+        if (numChannels > 1)
+            FloatVectorOperations::add(buffer.getWritePointer(0), buffer.getReadPointer(1), numSamples);
+
+        auto* mono = buffer.getReadPointer(0);
+        auto* dest = signal.data() + position / decimation;
+
+        for (int i = 0; i + decimation <= numSamples; i += decimation)
+            *dest++ = gain * sum(mono + i, decimation);
+    }
+
+    auto numFrames = signal.size() >= (size_t) frameSize ? (int) ((signal.size() - frameSize) / hopSize) + 1 : 0;
+
+    if (numFrames < minAnalysisSeconds * envelopeRate)
+        return {};
+
+    // Spectral flux, how much louder each bin got since the previous frame summed over
+    // the bins. Log magnitudes let quiet hats count as well as loud kicks
+    const int numBins = frameSize / 2;
+    auto numKickBins = jlimit(2, numBins, roundToInt(kickHz * frameSize * decimation / rate));
+
+    dsp::FFT fft (fftOrder);
+    dsp::WindowingFunction<float> window ((size_t) frameSize, dsp::WindowingFunction<float>::hann, false);
+
+    HeapBlock<float> fftData ((size_t) frameSize * 2);
+    HeapBlock<float> previous ((size_t) numBins, true);
+    HeapBlock<float> difference ((size_t) numBins);
+    std::vector<float> flux ((size_t) numFrames), kickFlux ((size_t) numFrames);
+
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        FloatVectorOperations::copy(fftData, signal.data() + frame * hopSize, frameSize);
+        window.multiplyWithWindowingTable(fftData, (size_t) frameSize);
+        fft.performFrequencyOnlyForwardTransform(fftData);
+
+        for (int bin = 0; bin < numBins; ++bin)
+            fftData[bin] = std::log1p(100.0f * fftData[bin]);
+
+        FloatVectorOperations::subtract(difference, fftData, previous, numBins);
+        FloatVectorOperations::max(difference, difference, 0.0f, numBins);
+        FloatVectorOperations::copy(previous, fftData, numBins);
+
+        // Bin 0 is DC and left out of the kicks
+        flux[(size_t) frame] = frame > 0 ? sum(difference, numBins) : 0.0f;
+        kickFlux[(size_t) frame] = frame > 0 ? sum(difference + 1, numKickBins - 1) : 0.0f;
+    }
+
+    if (job != nullptr && job->shouldExit())
+        return {};
+
+    auto halfWindow = roundToInt(0.25 * envelopeRate);
+    auto onsets = removeLocalAverage(flux, halfWindow);
+    auto kickOnsets = removeLocalAverage(kickFlux, halfWindow);
+
+    // Autocorrelation of the onsets about their mean, out to sixteen beats at the slowest tempo
+    const int longestMultiple = 16;
+    auto minLag = (int) std::floor(60.0 * envelopeRate / maxBpm);
+    auto maxLag = (int) std::ceil(60.0 * envelopeRate / minBpm);
+    auto numLags = longestMultiple * maxLag + 4;
+
+    if (numLags >= numFrames)
+        return {};
+
+    std::vector<float> centred (onsets);
+    FloatVectorOperations::add(centred.data(), -sum(onsets.data(), numFrames) / (float) numFrames, numFrames);
+
+    std::vector<double> correlation ((size_t) numLags + 1);
+
+    for (int lag = 0; lag <= numLags; ++lag)
+        correlation[(size_t) lag] = dotProduct(centred.data(), centred.data() + lag, numFrames - lag) / (double) (numFrames - lag);
+
+    // Multiples of the beat correlate as well, so tempos far from 120 are weighed down
+    // to pick the one a DJ would count
+    int bestLag = 0;
+    double bestScore = 0;
+
+    for (int lag = jmax(1, minLag); lag <= maxLag; ++lag)
+    {
+        auto octaves = std::log2(60.0 * envelopeRate / lag / 120.0);
+        auto score = correlation[(size_t) lag] * std::exp(-0.5 * octaves * octaves);
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestLag = lag;
+        }
+    }
+
+    // A correlation this weak is noise rather than a beat
+    if (bestLag == 0 || correlation[(size_t) bestLag] < 0.1 * correlation[0])
+        return {};
+
+    // Each peak further out pins the period down more finely, and a grid across a
+    // whole track needs it to a small fraction of a frame
+    auto period = bestLag + parabolicOffset(correlation[(size_t) bestLag - 1], correlation[(size_t) bestLag],
+                                            correlation[(size_t) bestLag + 1]);
+
+    for (int multiple = 2; multiple <= longestMultiple; multiple *= 2)
+    {
+        auto centre = roundToInt(period * multiple);
+        auto peak = jlimit(1, numLags - 1, centre);
+
+        for (int lag = jmax(1, centre - 2); lag <= jmin(numLags - 1, centre + 2); ++lag)
+            if (correlation[(size_t) lag] > correlation[(size_t) peak])
+                peak = lag;
+
+        period = (peak + parabolicOffset(correlation[(size_t) peak - 1], correlation[(size_t) peak],
+                                         correlation[(size_t) peak + 1])) / multiple;
+    }
+
+    // The beats fall where the onsets line up best with the period. Kicks count double,
+    // so a grid doesn't land on the off-beat hats, both scaled to the same average first
+    auto onsetScale = 1.0 / jmax(1.0e-6, (double) sum(onsets.data(), numFrames));
+    auto kickScale = 2.0 / jmax(1.0e-6, (double) sum(kickOnsets.data(), numFrames));
+
+    auto numPhases = (int) std::ceil(period);
+    std::vector<double> phaseScores ((size_t) numPhases);
+
+    for (int phase = 0; phase < numPhases; ++phase)
+    {
+        for (auto position = (double) phase; position < numFrames - 1; position += period)
+        {
+            auto frame = (size_t) roundToInt(position);
+            phaseScores[(size_t) phase] += onsetScale * onsets[frame] + kickScale * kickOnsets[frame];
+        }
+    }
+
+    auto bestPhase = (int) (std::max_element(phaseScores.begin(), phaseScores.end()) - phaseScores.begin());
+    auto phase = bestPhase + parabolicOffset(phaseScores[(size_t) ((bestPhase + numPhases - 1) % numPhases)],
+                                             phaseScores[(size_t) bestPhase],
+                                             phaseScores[(size_t) ((bestPhase + 1) % numPhases)]);
+
+    // Flux peaks once an onset reaches the middle of a frame, a hop after the frame starts
+    BeatGrid grid;
+    grid.bpm = 60.0 * envelopeRate / period;
+    grid.firstBeatSeconds = std::fmod((phase + 1.0) * hopSize * decimation / rate, grid.getBeatLengthSeconds());
+    return grid;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "TrackLibrary.h"
+#include <deque>
+#include <set>
+
+// Tempo of a track and where its beats fall
+struct BeatGrid
+{
+    double bpm = 0;
+    double firstBeatSeconds = 0;
+
+    bool isValid() const { return bpm > 0; }
+    double getBeatLengthSeconds() const { return 60.0 / bpm; }
+};
+
+// Finds the beat grids of library tracks on a few workers, leaving the other cores
+// for the decks and imports.
+//
+// Requests wait in a queue and are started a worker at a time, so an urgent one
+// (a track that has just been queued on a deck) goes ahead of everything waiting.
+// Each track is analysed at most once a session, the results are kept in the library
+class BeatAnalyser
+{
+public:
+    BeatAnalyser(AudioFormatManager& formatManager);
+    ~BeatAnalyser();
+
+    // Queues the track unless it has been requested before, in which case an urgent
+    // request only moves it to the front
+    void analyse(TrackLibrary::TrackId id, const URL& url, bool urgent);
+
+    // Called on the message thread for each track analysed to the end, with an invalid
+    // grid if it has no steady beat. Tracks that couldn't be read aren't reported
+    std::function<void (TrackLibrary::TrackId, BeatGrid)> onAnalysed;
+
+    // Onset detection, tempo estimation and beat placement over the first couple of
+    // minutes of the track. Invalid if no steady beat is found or the job was asked to exit
+    static BeatGrid findBeatGrid(AudioFormatReader& reader, ThreadPoolJob* job = nullptr);
+
+private:
+    class AnalysisJob;
+
+    struct Request
+    {
+        TrackLibrary::TrackId id;
+        URL url;
+    };
+
+    void startJobs();
+    void jobFinished(TrackLibrary::TrackId id, BeatGrid grid, bool completed);
+
+    AudioFormatManager& formatManager;
+
+    const int maxJobs = jmax(1, SystemStats::getNumCpus() / 2);
+    ThreadPool pool { maxJobs };
+
+    std::deque<Request> pending;
+    std::set<TrackLibrary::TrackId> requested;
+    int jobsRunning = 0;
+
+    WeakReference<BeatAnalyser> selfReference;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (BeatAnalyser)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BeatAnalyser)
+};
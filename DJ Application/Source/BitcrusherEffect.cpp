@@ -0,0 +1,55 @@
+#include "BitcrusherEffect.h"
+
+BitcrusherEffect::BitcrusherEffect()
+{
+}
+
+BitcrusherEffect::~BitcrusherEffect()
+{
+}
+
+void BitcrusherEffect::reset()
+{
+    heldSample[0] = heldSample[1] = 0.0f;
+    holdCounter = 0.0f;
+}
+
+// Applies bitcrusher effect
+void BitcrusherEffect::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // Fractional bit depths and factors let the knobs move smoothly
+    auto levels = std::pow(2.0f, bitDepth.load() - 1.0f);
+    auto step = 1.0f / downsampleFactor.load();
+    auto numChannels = juce::jmin(2, buffer.getNumChannels());
+
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        holdCounter -= step;
+        bool takeNewSample = holdCounter <= 0.0f;
+
+        if (takeNewSample)
+            holdCounter += 1.0f;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* channelData = buffer.getWritePointer(channel, startSample);
+
+            if (takeNewSample)
+                heldSample[channel] = std::round(channelData[sample] * levels) / levels;
+
+            channelData[sample] = heldSample[channel];
+        }
+    }
+}
+
+// Sets bit depth
+void BitcrusherEffect::setBitDepth(float bits)
+{
+    bitDepth = juce::jlimit(2.0f, 16.0f, bits);
+}
+
+// Sets downsample factor
+void BitcrusherEffect::setDownsampleFactor(float factor)
+{
+    downsampleFactor = juce::jlimit(1.0f, 32.0f, factor);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "DJAudioEffect.h"
+
+// Lo-fi effect that reduces bit depth and holds samples to fake a lower sample rate
+class BitcrusherEffect : public DJAudioEffect
+{
+public:
+    BitcrusherEffect();
+    ~BitcrusherEffect() override;
+
+    // Set the bit depth (2.0 to 16.0)
+    void setBitDepth(float bits);
+    float getBitDepth() const { return bitDepth.load(); }
+
+    // Set how many samples each held sample lasts (1.0 to 32.0)
+    void setDownsampleFactor(float factor);
+    float getDownsampleFactor() const { return downsampleFactor.load(); }
+
+protected:
+    void prepare(double sampleRate, int samplesPerBlock) override {}
+
+    // Replaces a range of the buffer with the crushed signal
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) override;
+
+    void reset() override;
+
+private:
+    // Sample-and-hold state carried between blocks
+    float heldSample[2] = { 0.0f, 0.0f };
+    float holdCounter = 0.0f;
+
+    // Written by the GUI, applied at the start of the next block
+    std::atomic<float> bitDepth { 8.0f };
+    std::atomic<float> downsampleFactor { 4.0f };
+};
@@ -0,0 +1,158 @@
+#include "DJAudioEffect.h"
+
+// Two vector passes when the gains are steady
+void DJAudioEffect::mixDryWet(float* wet, const float* dry, float dryGain, float wetGain, int numSamples)
+{
+    juce::FloatVectorOperations::multiply(wet, wetGain, numSamples);
+    juce::FloatVectorOperations::addWithMultiply(wet, dry, dryGain, numSamples);
+}
+
+// Plain loop over four arrays the compiler turns into SIMD
+void DJAudioEffect::mixDryWet(float* wet, const float* dry, const float* dryGain, const float* wetGain, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+        wet[i] = dry[i] * dryGain[i] + wet[i] * wetGain[i];
+}
+
+void DJAudioEffect::prepareToPlay(double sampleRate, int samplesPerBlock)
+{
+    samplesPerBlock = juce::jmax(1, samplesPerBlock);
+
+    dryBuffer.setSize(2, samplesPerBlock);
+    inputRamp.allocate((size_t) samplesPerBlock, true);
+    dryRamp.allocate((size_t) samplesPerBlock, true);
+    wetRamp.allocate((size_t) samplesPerBlock, true);
+
+    inputGain.reset(sampleRate, 0.05);
+    dryGain.reset(sampleRate, 0.05);
+    wetGain.reset(sampleRate, 0.05);
+
+    // Start from wherever the settings are now
+    updateTargets();
+    inputGain.setCurrentAndTargetValue(inputGain.getTargetValue());
+    dryGain.setCurrentAndTargetValue(dryGain.getTargetValue());
+    wetGain.setCurrentAndTargetValue(wetGain.getTargetValue());
+
+    prepare(sampleRate, samplesPerBlock);
+    reset();
+
+    quietSamples = 0;
+    tailDecayed = true;
+    idle = true;
+}
+
+// Switched off, a tail effect stops getting input but keeps its wet level so the tail rings out
+void DJAudioEffect::updateTargets()
+{
+    auto mix = wetDryMix.load();
+
+    if (isActive.load())
+    {
+        inputGain.setTargetValue(1.0f);
+        dryGain.setTargetValue(1.0f - mix);
+        wetGain.setTargetValue(mix);
+    }
+    else
+    {
+        inputGain.setTargetValue(hasTail ? 0.0f : 1.0f);
+        dryGain.setTargetValue(1.0f);
+        wetGain.setTargetValue(hasTail ? mix : 0.0f);
+    }
+}
+
+bool DJAudioEffect::isSmoothing() const
+{
+    return inputGain.isSmoothing() || dryGain.isSmoothing() || wetGain.isSmoothing();
+}
+
+void DJAudioEffect::processBlock(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    updateTargets();
+
+    // Nothing audible and nothing left to ring out
+    auto silentTail = hasTail && inputGain.getTargetValue() == 0.0f && tailDecayed;
+    auto shouldBeIdle = ! isSmoothing() && (wetGain.getTargetValue() == 0.0f || silentTail);
+
+    if (shouldBeIdle)
+    {
+        idle = true;
+        return;
+    }
+
+    // Don't let an old tail come back when the effect is switched on again
+    if (idle)
+    {
+        reset();
+        idle = false;
+    }
+
+    // Anything that isn't a quiet stretch of tail starts the count again
+    if (tailDecayed || inputGain.getTargetValue() != 0.0f)
+        quietSamples = 0;
+
+    tailDecayed = false;
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), dryBuffer.getNumChannels());
+    auto maxChunkSize = dryBuffer.getNumSamples();
+
+    // Blocks longer than the prepared size are handled in chunks
+    for (int offset = 0; offset < numSamples; offset += maxChunkSize)
+    {
+        auto start = startSample + offset;
+        auto chunkSize = juce::jmin(maxChunkSize, numSamples - offset);
+        auto ramping = isSmoothing();
+
+        if (ramping)
+        {
+            for (int i = 0; i < chunkSize; ++i)
+            {
+                inputRamp[i] = inputGain.getNextValue();
+                dryRamp[i] = dryGain.getNextValue();
+                wetRamp[i] = wetGain.getNextValue();
+            }
+        }
+
+        // One copy of the dry signal, then the effect runs in place
+        for (int channel = 0; channel < numChannels; ++channel)
+            dryBuffer.copyFrom(channel, 0, buffer, channel, start, chunkSize);
+
+        if (ramping)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+                juce::FloatVectorOperations::multiply(buffer.getWritePointer(channel, start), inputRamp.get(), chunkSize);
+        }
+        else if (inputGain.getTargetValue() != 1.0f)
+        {
+            buffer.applyGain(start, chunkSize, inputGain.getTargetValue());
+        }
+
+        process(buffer, start, chunkSize);
+
+        // With the input muted whatever comes out is tail. One quiet chunk could just be
+        // the gap between echoes, so it has to stay quiet for the subclass's quiet time
+        if (hasTail && ! ramping && inputGain.getTargetValue() == 0.0f)
+        {
+            if (buffer.getMagnitude(start, chunkSize) < tailThreshold)
+                quietSamples += chunkSize;
+            else
+                quietSamples = 0;
+
+            tailDecayed = quietSamples >= getQuietSamplesBeforeIdle();
+        }
+        else
+        {
+            quietSamples = 0;
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* wet = buffer.getWritePointer(channel, start);
+            auto* dry = dryBuffer.getReadPointer(channel);
+
+            if (ramping)
+                mixDryWet(wet, dry, dryRamp.get(), wetRamp.get(), chunkSize);
+            else
+                mixDryWet(wet, dry, dryGain.getTargetValue(), wetGain.getTargetValue(), chunkSize);
+        }
+    }
+}
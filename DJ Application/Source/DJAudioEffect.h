@@ -1,36 +1,79 @@
-#pragma once
-
-#include "../JuceLibraryCode/JuceHeader.h"
-
-// Class for audio effects
-class DJAudioEffect
-{
-public:
-    DJAudioEffect() : wetDryMix(0.0f), isActive(false) {}
-    virtual ~DJAudioEffect() {}
-    
-    // Set the wet/dry mix of the effect (0.0 = dry, 1.0 = wet)
-    void setWetDryMix(float mix)
-    {
-        wetDryMix = juce::jlimit(0.0f, 1.0f, mix);
-    }
-    
-    // Get the current wet/dry mix value
-    float getWetDryMix() const { return wetDryMix; }
-    
-    // Enable or disable the effect
-    void setActive(bool shouldBeActive) { isActive = shouldBeActive; }
-    
-    // Check if the effect is currently active
-    bool getActive() const { return isActive; }
-    
-    // Process the audio block with the effect
-    virtual void process(juce::AudioBuffer<float>& buffer, int numSamples) = 0;
-    
-    // Prepare the effect for playback
-    virtual void prepare(double sampleRate, int samplesPerBlock) = 0;
-    
-    protected:
-    float wetDryMix;  // 0.0 = dry (no effect), 1.0 = wet (full effect)
-    bool isActive;    // Whether the effect is enabled
-};
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Class for audio effects. Settings are written by the GUI and read by the
+// audio thread, so they are atomics and the gains are smoothed once they get there.
+// Subclasses only produce the wet signal, mixing and bypass are handled here
+class DJAudioEffect
+{
+public:
+    // Effects with a tail keep ringing out after they are switched off
+    DJAudioEffect(bool _hasTail = false) : wetDryMix(0.0f), isActive(false), hasTail(_hasTail) {}
+    virtual ~DJAudioEffect() {}
+
+    // Set the wet/dry mix of the effect (0.0 = dry, 1.0 = wet)
+    void setWetDryMix(float mix)
+    {
+        wetDryMix = juce::jlimit(0.0f, 1.0f, mix);
+    }
+
+    // Get the current wet/dry mix value
+    float getWetDryMix() const { return wetDryMix.load(); }
+
+    // Enable or disable the effect, it fades or rings out rather than cutting off
+    void setActive(bool shouldBeActive) { isActive = shouldBeActive; }
+
+    // Check if the effect is currently active
+    bool getActive() const { return isActive.load(); }
+
+    // Allocates everything the effect needs, call before playback starts
+    void prepareToPlay(double sampleRate, int samplesPerBlock);
+
+    // Mixes the effect into a range of the buffer in place, returns straight
+    // away without calling into the subclass while the effect is idle
+    void processBlock(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // True when the effect is off and has nothing left to play, audio thread only
+    bool isIdle() const { return idle; }
+
+    // wet = dry * dryGain + wet * wetGain, in place on the wet samples
+    static void mixDryWet(float* wet, const float* dry, float dryGain, float wetGain, int numSamples);
+    static void mixDryWet(float* wet, const float* dry, const float* dryGain, const float* wetGain, int numSamples);
+
+    protected:
+    // Prepare the effect for playback
+    virtual void prepare(double sampleRate, int samplesPerBlock) = 0;
+
+    // Replace a range of at most samplesPerBlock samples with the wet signal
+    virtual void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) = 0;
+
+    // Clear delay lines and filter state before the effect comes back from idle
+    virtual void reset() = 0;
+
+    // How long a tail can go quiet and still have more to come, e.g. a whole delay line
+    virtual int getQuietSamplesBeforeIdle() const { return 0; }
+
+    std::atomic<float> wetDryMix;  // 0.0 = dry (no effect), 1.0 = wet (full effect)
+    std::atomic<bool> isActive;    // Whether the effect is enabled
+
+    private:
+    // Picks up the latest settings, once per block
+    void updateTargets();
+    bool isSmoothing() const;
+
+    const bool hasTail;
+
+    // Ramped on the audio thread so mix changes and bypass are click-free
+    juce::SmoothedValue<float> inputGain, dryGain, wetGain;
+
+    // Tail effects are fed silence once switched off and go idle once their output
+    // has stayed below the threshold for the subclass's quiet time
+    static constexpr float tailThreshold = 0.0001f;
+    int quietSamples = 0;
+    bool tailDecayed = true;
+    bool idle = true;
+
+    juce::AudioBuffer<float> dryBuffer;
+    juce::HeapBlock<float> inputRamp, dryRamp, wetRamp;
+};
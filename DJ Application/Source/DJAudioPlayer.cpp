@@ -1,156 +1,699 @@
-#include "DJAudioPlayer.h"
-
-// Initialises audio player with given audio format manager
-DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager)
-: formatManager(_formatManager)
-{
-}
-DJAudioPlayer::~DJAudioPlayer()
-{
-}
-
-// Prepares to play, intialises buffers
-void DJAudioPlayer::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
-{
-    // Prepare transport and resampling sources
-    transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    resampleSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    // Initialises reverb effect
-    reverbEffect.prepare(sampleRate, samplesPerBlockExpected);
-        tempBuffer.setSize(2, samplesPerBlockExpected);
-}
-
-// Fetch next audio block
-void DJAudioPlayer::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
-{
-    resampleSource.getNextAudioBlock(bufferToFill);
-    // Apply the reverb effect if active
-    if (reverbEffect.getActive() && reverbEffect.getWetDryMix() > 0.0f)
-    {
-        tempBuffer.clear();
-        for (int channel = 0; channel <bufferToFill.buffer->getNumChannels(); ++channel)
-        {
-            tempBuffer.copyFrom(channel, 0,
-                                *bufferToFill.buffer,
-                                channel,
-                                bufferToFill.startSample,
-                                bufferToFill.numSamples);
-        }
-            
-        // Process temporary buffer with reverb
-        reverbEffect.process(tempBuffer, bufferToFill.numSamples);
-            
-        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
-        {
-            bufferToFill.buffer->copyFrom(channel,
-                                        bufferToFill.startSample,
-                                        tempBuffer,
-                                            channel,
-                                            0,
-                                            bufferToFill.numSamples);
-        }
-    }
-
-}
-
-// Release resources
-void DJAudioPlayer::releaseResources()
-{
-    transportSource.releaseResources();
-    resampleSource.releaseResources();
-}
-
-// Loads audio file from URL
-void DJAudioPlayer::loadURL(URL audioURL)
-{
-    auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
-    if (reader != nullptr) // good file!
-    {       
-        std::unique_ptr<AudioFormatReaderSource> newSource (new AudioFormatReaderSource (reader, true));
-        transportSource.setSource (newSource.get(), 0, nullptr, reader->sampleRate);             
-        readerSource.reset (newSource.release());          
-    }
-}
-
-// Set gain(volume) of audio player
-void DJAudioPlayer::setGain(double gain)
-{
-    if (gain < 0 || gain > 1.0)
-    {
-        std::cout << "DJAudioPlayer::setGain gain should be between 0 and 1" << std::endl;
-    }
-    else
-    {
-        transportSource.setGain(gain);
-    }
-   
-}
-
-// Adjusts playback speed of audio file
-void DJAudioPlayer::setSpeed(double ratio)
-{
-  if (ratio < 0.1 || ratio > 100.0)
-    {
-        std::cout << "DJAudioPlayer::setSpeed ratio should be between 0 and 100" << std::endl;
-    }
-    else
-    {
-        resampleSource.setResamplingRatio(ratio);
-    }
-}
-
-// Set playback position and also as a relative value
-void DJAudioPlayer::setPosition(double posInSecs)
-{
-    transportSource.setPosition(posInSecs);
-}
-
-void DJAudioPlayer::setPositionRelative(double pos)
-{
-    if (pos < 0 || pos > 1.0)
-    {
-        std::cout << "DJAudioPlayer::setPositionRelative pos should be between 0 and 1" << std::endl;
-    }
-    else
-    {
-        double posInSecs = transportSource.getLengthInSeconds() * pos;
-        setPosition(posInSecs);
-    }
-}
-
-
-// Reverb effect controls
-void DJAudioPlayer::setReverbWetDry(float mix)
-{
-    reverbEffect.setWetDryMix(mix);
-}
-
-void DJAudioPlayer::setReverbActive(bool isActive)
-{
-    reverbEffect.setActive(isActive);
-}
-
-void DJAudioPlayer::setReverbRoomSize(float size)
-{
-    reverbEffect.setRoomSize(size);
-}
-
-void DJAudioPlayer::setReverbDamping(float damping)
-{
-    reverbEffect.setDamping(damping);
-}
-
-// Start audio playback
-void DJAudioPlayer::start()
-{
-    transportSource.start();
-}
-void DJAudioPlayer::stop()
-{
-    transportSource.stop();
-}
-
-double DJAudioPlayer::getPositionRelative()
-{
-    return transportSource.getCurrentPosition() / transportSource.getLengthInSeconds();
-}
+#include "DJAudioPlayer.h"
+
+namespace
+{
+    // Half and double time count as the same tempo, so a deck never plays at twice its speed to sync
+    double matchTempoRange(double bpm, double masterTempo)
+    {
+        for (int i = 0; i < 4 && bpm * 1.5 < masterTempo; ++i)
+            bpm *= 2.0;
+
+        for (int i = 0; i < 4 && bpm > masterTempo * 1.5; ++i)
+            bpm *= 0.5;
+
+        return bpm;
+    }
+
+    // Distance to the nearest master beat, in beats from -0.5 to 0.5
+    double wrapPhase(double beats)
+    {
+        return beats - std::floor(beats + 0.5);
+    }
+}
+
+// Initialises audio player with the shared track loader
+DJAudioPlayer::DJAudioPlayer(TrackLoader& _trackLoader)
+: trackLoader(_trackLoader)
+{
+    // The slot stays attached for the player's lifetime, tracks are swapped inside it
+    transportSource.setSource(&trackSlot);
+
+    trackSlot.onNextTrackDropped = [this](const URL& url)
+    {
+        listeners.call([this, &url](Listener& l) { l.nextTrackDropped(this, url); });
+    };
+}
+DJAudioPlayer::~DJAudioPlayer()
+{
+    stopTimer();
+    transportSource.setSource(nullptr);
+
+    if (auto* cache = trackLoader.getTrackCache())
+        if (! loadedURL.isEmpty())
+            cache->unpin(loadedURL);
+}
+
+void DJAudioPlayer::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void DJAudioPlayer::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+// Prepares to play, intialises buffers
+void DJAudioPlayer::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    deviceSampleRate = sampleRate;
+    deviceBlockSize = samplesPerBlockExpected;
+
+    smoothedSpeed.reset(sampleRate, 0.05);
+    smoothedSpeed.setCurrentAndTargetValue(speedRatio.load());
+    smoothedGain.reset(sampleRate, 0.02);
+    smoothedGain.setCurrentAndTargetValue(gain.load());
+
+    // Prepare transport and resampling sources
+    transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    resampleSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    // Initialises the effects
+    effects.prepare(sampleRate, samplesPerBlockExpected);
+}
+
+// Fetch next audio block
+void DJAudioPlayer::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    // Reading the clock costs something, so it is only read while a profiler is listening
+    auto timeStages = stageTiming.load();
+    auto startTicks = timeStages ? Time::getHighResolutionTicks() : 0;
+
+    // A newly loaded track only ever takes over at a block boundary
+    trackSlot.swapInQueuedTrack();
+
+    // Resampling covers the track's own sample rate and whatever part of the speed isn't stretched
+    auto trackRate = trackSlot.getTrackSampleRate();
+    auto rateCorrection = (trackRate > 0 && deviceSampleRate > 0) ? trackRate / deviceSampleRate : 1.0;
+
+    // GUI settings are picked up once per block
+    auto speed = speedRatio.load();
+
+    if (syncEnabled.load())
+        speed = getSyncedSpeed(speed, trackRate, bufferToFill.numSamples);
+
+    smoothedSpeed.setTargetValue(speed);
+    smoothedGain.setTargetValue(gain.load());
+    timeStretchSource.setEnabled(keyLock.load());
+
+    if (! smoothedSpeed.isSmoothing())
+    {
+        setPlaybackRatio(smoothedSpeed.getTargetValue(), rateCorrection);
+        resampleSource.getNextAudioBlock(bufferToFill);
+    }
+    else
+    {
+        // The resampler takes one ratio per call, so glide through the block in short steps
+        const int stepSize = 32;
+
+        for (int offset = 0; offset < bufferToFill.numSamples; offset += stepSize)
+        {
+            auto numSamples = jmin(stepSize, bufferToFill.numSamples - offset);
+            setPlaybackRatio(smoothedSpeed.skip(numSamples), rateCorrection);
+
+            AudioSourceChannelInfo step (bufferToFill.buffer, bufferToFill.startSample + offset, numSamples);
+            resampleSource.getNextAudioBlock(step);
+        }
+    }
+
+    auto resampledTicks = timeStages ? Time::getHighResolutionTicks() : 0;
+
+    // Effects run in place on our part of the output
+    effects.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+    auto effectsTicks = timeStages ? Time::getHighResolutionTicks() : 0;
+
+    applyGain(bufferToFill);
+
+    if (! timeStages)
+        return;
+
+    auto endTicks = Time::getHighResolutionTicks();
+
+    stageMs[AudioProfiler::resampleStage] = ticksToMs(resampledTicks - startTicks);
+    stageMs[AudioProfiler::effectsStage] = ticksToMs(effectsTicks - resampledTicks);
+    stageMs[AudioProfiler::gainStage] = ticksToMs(endTicks - effectsTicks);
+}
+
+float DJAudioPlayer::ticksToMs(int64 ticks)
+{
+    return (float) (Time::highResolutionTicksToSeconds(ticks) * 1000.0);
+}
+
+// The stretcher takes as much of the speed as its range allows, the resampler the rest
+void DJAudioPlayer::setPlaybackRatio(double speed, double rateCorrection)
+{
+    if (keyLock.load())
+    {
+        auto tempo = jlimit(TimeStretchAudioSource::minTempo, TimeStretchAudioSource::maxTempo, speed);
+        timeStretchSource.setTempo(tempo);
+        resampleSource.setResamplingRatio(speed / tempo * rateCorrection);
+    }
+    else
+    {
+        resampleSource.setResamplingRatio(speed * rateCorrection);
+    }
+}
+
+// A proportional-integral loop on the beat phase. The master tempo over the track's
+// sets the speed, the phase error only trims it, and both the trim and the integral are
+// clamped so the correction stays small
+double DJAudioPlayer::getSyncedSpeed(double speed, double trackRate, int numSamples)
+{
+    auto* clock = masterClock;
+    auto grid = trackSlot.getCurrentBeatGrid();
+
+    if (clock == nullptr || clock->getLeader() == this || clock->getTempo() <= 0
+        || ! grid.isValid() || trackRate <= 0 || deviceSampleRate.load() <= 0 || ! transportSource.isPlaying())
+    {
+        syncIntegral = 0;
+        return speed;
+    }
+
+    auto masterTempo = clock->getTempo();
+    auto deckTempo = matchTempoRange(grid.bpm, masterTempo);
+
+    auto seconds = getAudibleSeconds(trackRate);
+    auto error = wrapPhase((seconds - grid.firstBeatSeconds) * deckTempo / 60.0 - clock->getBeatPosition());
+
+    // A seek or a new track starts the loop afresh
+    if (std::abs(error - lastSyncError) > 0.1)
+        syncIntegral = 0;
+
+    lastSyncError = error;
+
+    // Trim that would close the error over the time constant, in fractions of the speed
+    auto proportional = -error * 60.0 / (masterTempo * syncTimeConstant);
+    auto blockSeconds = numSamples / deviceSampleRate.load();
+
+    // Only integrates while the trim has room, so a large error can't wind it up into an overshoot
+    if (std::abs(proportional + syncIntegral) < maxSyncTrim)
+        syncIntegral = jlimit(-maxSyncTrim / 2, maxSyncTrim / 2,
+                              syncIntegral + proportional * blockSeconds / syncIntegralTime);
+
+    auto trim = jlimit(-maxSyncTrim, maxSyncTrim, proportional + syncIntegral);
+    return masterTempo / deckTempo * (1.0 + trim);
+}
+
+// Read between blocks, so it lines up with the other decks' positions
+bool DJAudioPlayer::getBeatPosition(double& beat, double& bpm) const
+{
+    auto grid = trackSlot.getCurrentBeatGrid();
+    auto trackRate = trackSlot.getTrackSampleRate();
+
+    if (! grid.isValid() || trackRate <= 0 || ! transportSource.isPlaying())
+        return false;
+
+    auto seconds = getAudibleSeconds(trackRate);
+    beat = (seconds - grid.firstBeatSeconds) * grid.bpm / 60.0;
+    bpm = grid.bpm * smoothedSpeed.getCurrentValue();
+    return true;
+}
+
+// The stretcher only looks ahead while stretching, the resampler's input is stretched output
+double DJAudioPlayer::getAudibleSeconds(double trackRate) const
+{
+    auto stretchTempo = timeStretchSource.isEnabled() ? timeStretchSource.getTempo() : 1.0;
+    auto latency = timeStretchSource.getLatencyInSamples() + resamplerLatency * stretchTempo;
+
+    return ((double) trackSlot.getNextReadPosition() - latency) / trackRate;
+}
+
+void DJAudioPlayer::setSyncEnabled(bool shouldSync)
+{
+    syncEnabled = shouldSync;
+
+    if (shouldSync)
+        alignToMasterBeat();
+}
+
+void DJAudioPlayer::setTempoMaster(bool shouldLead)
+{
+    if (masterClock == nullptr)
+        return;
+
+    if (shouldLead)
+        masterClock->setLeader(this);
+    else if (isTempoMaster())
+        masterClock->setLeader(nullptr);
+}
+
+bool DJAudioPlayer::isTempoMaster() const
+{
+    return masterClock != nullptr && masterClock->getLeader() == this;
+}
+
+// Seeking a playing deck would be heard as a jump. The clock keeps moving until the deck
+// starts, so this can land up to a block out, which the loop then takes up
+void DJAudioPlayer::alignToMasterBeat()
+{
+    auto grid = trackSlot.getCurrentBeatGrid();
+    auto trackRate = trackSlot.getTrackSampleRate();
+
+    if (masterClock == nullptr || isTempoMaster() || masterClock->getTempo() <= 0
+        || ! grid.isValid() || trackRate <= 0 || isPlaying())
+        return;
+
+    auto deckTempo = matchTempoRange(grid.bpm, masterClock->getTempo());
+    auto seconds = (double) trackSlot.getNextReadPosition() / trackRate;
+    auto error = wrapPhase((seconds - grid.firstBeatSeconds) * deckTempo / 60.0 - masterClock->getBeatPosition());
+
+    setPosition(jmax(0.0, seconds - error * 60.0 / deckTempo));
+}
+
+// Volume is applied last, ramped per sample while it is changing
+void DJAudioPlayer::applyGain(const AudioSourceChannelInfo& bufferToFill)
+{
+    auto* buffer = bufferToFill.buffer;
+
+    if (! smoothedGain.isSmoothing())
+    {
+        auto level = smoothedGain.getTargetValue();
+
+        if (level != 1.0f)
+            buffer->applyGain(bufferToFill.startSample, bufferToFill.numSamples, level);
+
+        return;
+    }
+
+    for (int sample = 0; sample < bufferToFill.numSamples; ++sample)
+    {
+        auto level = smoothedGain.getNextValue();
+
+        for (int channel = 0; channel < buffer->getNumChannels(); ++channel)
+            buffer->getWritePointer(channel)[bufferToFill.startSample + sample] *= level;
+    }
+}
+
+// Release resources
+void DJAudioPlayer::releaseResources()
+{
+    transportSource.releaseResources();
+    resampleSource.releaseResources();
+}
+
+// Loads audio file from URL on the loader threads
+void DJAudioPlayer::loadURL(URL audioURL, BeatGrid beatGrid)
+{
+    auto generation = ++loadGeneration;
+    WeakReference<DJAudioPlayer> weakThis (this);
+
+    // Held until the load finishes, so a decoded copy can't be evicted before the deck pins it
+    auto* cache = trackLoader.getTrackCache();
+
+    if (cache != nullptr)
+        cache->pin(audioURL);
+
+    TrackLoader::Request request;
+    request.url = audioURL;
+    request.readAheadSize = readAheadSize;
+    request.blockSize = deviceBlockSize;
+    request.sampleRate = deviceSampleRate;
+
+    trackLoader.loadAsync(request,
+        [weakThis, generation](float progress)
+        {
+            auto* player = weakThis.get();
+            if (player != nullptr && generation == player->loadGeneration)
+                player->listeners.call([player, progress](Listener& l) { l.trackLoadProgress(player, progress); });
+        },
+        [weakThis, generation, audioURL, beatGrid, cache](std::unique_ptr<PreparedTrack> track)
+        {
+            auto* player = weakThis.get();
+
+            if (player != nullptr && generation == player->loadGeneration)
+            {
+                if (track != nullptr)
+                    track->beatGrid = beatGrid;
+
+                player->trackPrepared(audioURL, std::move(track));
+            }
+
+            if (cache != nullptr)
+                cache->unpin(audioURL);
+        });
+}
+
+// Prepared like any other load, but handed to the slot to follow the current track
+void DJAudioPlayer::loadNextURL(URL audioURL, double crossfadeSeconds, BeatGrid beatGrid)
+{
+    cancelNextLoad();
+
+    auto generation = nextLoadGeneration;
+    nextLoadPending = true;
+    nextLoadURL = audioURL;
+    WeakReference<DJAudioPlayer> weakThis (this);
+
+    // Once loaded the track holds its decoded copy itself, the pin only has to last until then
+    auto* cache = trackLoader.getTrackCache();
+
+    if (cache != nullptr)
+        cache->pin(audioURL);
+
+    TrackLoader::Request request;
+    request.url = audioURL;
+    request.readAheadSize = readAheadSize;
+    request.blockSize = deviceBlockSize;
+    request.sampleRate = deviceSampleRate;
+
+    trackLoader.loadAsync(request, nullptr,
+        [weakThis, generation, crossfadeSeconds, beatGrid, cache, audioURL](std::unique_ptr<PreparedTrack> track)
+        {
+            if (cache != nullptr)
+                cache->unpin(audioURL);
+
+            auto* player = weakThis.get();
+            if (player == nullptr || generation != player->nextLoadGeneration)
+                return;
+
+            player->nextLoadPending = false;
+
+            if (track == nullptr)
+            {
+                player->listeners.call([player, &audioURL](Listener& l) { l.nextTrackDropped(player, audioURL); });
+                return;
+            }
+
+            track->beatGrid = beatGrid;
+            player->trackSlot.queueNextTrack(std::move(track), crossfadeSeconds);
+        });
+}
+
+void DJAudioPlayer::clearNextURL()
+{
+    cancelNextLoad();
+    trackSlot.clearNextTrack();
+}
+
+void DJAudioPlayer::cancelNextLoad()
+{
+    ++nextLoadGeneration;
+
+    if (! nextLoadPending)
+        return;
+
+    nextLoadPending = false;
+    auto url = nextLoadURL;
+    listeners.call([this, &url](Listener& l) { l.nextTrackDropped(this, url); });
+}
+
+void DJAudioPlayer::setTrackEndWarning(double secondsBeforeEnd)
+{
+    trackEndWarningSeconds = jmax(0.0, secondsBeforeEnd);
+}
+
+// Polled rather than pushed from the audio thread, a tenth of a second late is early enough
+void DJAudioPlayer::timerCallback()
+{
+    auto advances = trackSlot.getNumAdvances();
+
+    if (advances != advancesSeen)
+    {
+        advancesSeen = advances;
+        trackEndingNotified = false;
+
+        auto url = trackSlot.getCurrentURL();
+        setLoadedURL(url);
+        ++trackGeneration;
+
+        if (! trackSlot.isCurrentTrackRandomAccess())
+            switchToCachedCopy(url);
+
+        listeners.call([this, &url](Listener& l) { l.nextTrackStarted(this, url); });
+        listeners.call([this, &url](Listener& l) { l.trackLoaded(this, url, true); });
+    }
+
+    if (! isPlaying())
+    {
+        // Kept running while a next track could still take over in the last block
+        if (! trackSlot.hasNextTrack())
+            stopTimer();
+
+        return;
+    }
+
+    auto trackRate = trackSlot.getTrackSampleRate();
+
+    if (trackEndWarningSeconds > 0 && ! trackEndingNotified && trackRate > 0)
+    {
+        auto remaining = (double) (trackSlot.getTotalLength() - trackSlot.getNextReadPosition()) / trackRate;
+
+        // Speed changes how long the rest of the track takes to play
+        if (remaining / speedRatio.load() <= trackEndWarningSeconds)
+        {
+            trackEndingNotified = true;
+            listeners.call([this](Listener& l) { l.trackEnding(this); });
+        }
+    }
+}
+
+bool DJAudioPlayer::loadURLSynchronously(const URL& audioURL, BeatGrid beatGrid)
+{
+    ++loadGeneration;
+
+    TrackLoader::Request request;
+    request.url = audioURL;
+    request.readAheadSize = readAheadSize;
+    request.blockSize = deviceBlockSize;
+    request.sampleRate = deviceSampleRate;
+
+    auto track = trackLoader.prepareTrack(request, nullptr);
+    bool success = (track != nullptr);
+
+    if (success)
+        track->beatGrid = beatGrid;
+
+    trackPrepared(audioURL, std::move(track));
+
+    // Nothing else is pulling audio, so there is no block boundary to wait for
+    trackSlot.swapInQueuedTrack();
+
+    return success;
+}
+
+// Queued straight into the slot, which takes it up on the next block rendered
+bool DJAudioPlayer::loadNextURLSynchronously(const URL& audioURL, double crossfadeSeconds, BeatGrid beatGrid)
+{
+    cancelNextLoad();
+
+    TrackLoader::Request request;
+    request.url = audioURL;
+    request.readAheadSize = readAheadSize;
+    request.blockSize = deviceBlockSize;
+    request.sampleRate = deviceSampleRate;
+
+    auto track = trackLoader.prepareTrack(request, nullptr);
+
+    if (track == nullptr)
+    {
+        listeners.call([this, &audioURL](Listener& l) { l.nextTrackDropped(this, audioURL); });
+        return false;
+    }
+
+    track->beatGrid = beatGrid;
+    trackSlot.queueNextTrack(std::move(track), crossfadeSeconds);
+    return true;
+}
+
+// Hands the prepared track to the audio thread
+void DJAudioPlayer::trackPrepared(const URL& audioURL, std::unique_ptr<PreparedTrack> track)
+{
+    bool success = (track != nullptr);
+
+    if (success) // good file!
+    {
+        bool randomAccess = track->isRandomAccess();
+
+        transportSource.stop();
+        trackSlot.queueTrack(std::move(track));
+        timeStretchSource.reset();
+        setLoadedURL(audioURL);
+        ++trackGeneration;
+
+        // A next track lined up for the old one doesn't follow this one
+        clearNextURL();
+        trackEndingNotified = false;
+
+        // Compressed files are decoded in the background so seeks stop hitting the decoder
+        if (! randomAccess)
+            switchToCachedCopy(audioURL);
+    }
+
+    listeners.call([this, &audioURL, success](Listener& l) { l.trackLoaded(this, audioURL, success); });
+}
+
+void DJAudioPlayer::setLoadedURL(const URL& audioURL)
+{
+    if (auto* cache = trackLoader.getTrackCache())
+    {
+        cache->pin(audioURL);
+
+        if (! loadedURL.isEmpty())
+            cache->unpin(loadedURL);
+    }
+
+    loadedURL = audioURL;
+}
+
+// Streams from the file until the decoded copy is ready, then seeks become memory reads
+void DJAudioPlayer::switchToCachedCopy(const URL& audioURL)
+{
+    auto* cache = trackLoader.getTrackCache();
+    if (cache == nullptr || ! cache->isEnabled())
+        return;
+
+    auto generation = trackGeneration;
+    WeakReference<DJAudioPlayer> weakThis (this);
+
+    cache->requestDecode(audioURL, [weakThis, generation, audioURL](CachedTrack::Ptr cached)
+    {
+        auto* player = weakThis.get();
+
+        // Skip it if another track has been loaded or advanced to in the meantime. The
+        // generation only moves when the timer sees an advance, the slot counts them at once
+        if (player == nullptr || cached == nullptr || generation != player->trackGeneration
+            || player->trackSlot.getNumAdvances() != player->advancesSeen)
+            return;
+
+        auto track = TrackLoader::prepareCachedTrack(audioURL, cached);
+        track->continuesCurrentTrack = true;
+        track->beatGrid = player->trackSlot.getCurrentBeatGrid();
+        player->trackSlot.queueTrack(std::move(track));
+    });
+}
+
+// Sets how far ahead of the playhead the disk thread decodes
+void DJAudioPlayer::setReadAheadSize(int numSamples)
+{
+    readAheadSize = numSamples <= 0 ? 0 : jmax(1024, numSamples);
+}
+
+// Underruns are accumulated across loaded tracks
+int DJAudioPlayer::getUnderrunCount() const
+{
+    return trackSlot.getNumUnderruns() - underrunsAtLastReset;
+}
+
+void DJAudioPlayer::resetUnderrunCount()
+{
+    underrunsAtLastReset += getUnderrunCount();
+}
+
+// Set gain(volume) of audio player
+void DJAudioPlayer::setGain(double gain)
+{
+    if (gain < 0 || gain > 1.0)
+    {
+        std::cout << "DJAudioPlayer::setGain gain should be between 0 and 1" << std::endl;
+    }
+    else
+    {
+        this->gain = (float) gain;
+    }
+   
+}
+
+// Adjusts playback speed of audio file
+void DJAudioPlayer::setSpeed(double ratio)
+{
+  if (ratio < 0.1 || ratio > 100.0)
+    {
+        std::cout << "DJAudioPlayer::setSpeed ratio should be between 0 and 100" << std::endl;
+    }
+    else
+    {
+        speedRatio = ratio;
+    }
+}
+
+void DJAudioPlayer::setKeyLock(bool shouldLockKey)
+{
+    keyLock = shouldLockKey;
+}
+
+void DJAudioPlayer::setKeyLockQuality(TimeStretchAudioSource::Quality quality)
+{
+    timeStretchSource.setQuality(quality);
+}
+
+// Set playback position and also as a relative value
+void DJAudioPlayer::setPosition(double posInSecs)
+{
+    auto trackRate = trackSlot.getTrackSampleRate();
+
+    if (trackRate > 0)
+    {
+        transportSource.setNextReadPosition((int64) (posInSecs * trackRate));
+        timeStretchSource.reset();
+    }
+}
+
+void DJAudioPlayer::setPositionRelative(double pos)
+{
+    if (pos < 0 || pos > 1.0)
+    {
+        std::cout << "DJAudioPlayer::setPositionRelative pos should be between 0 and 1" << std::endl;
+    }
+    else
+    {
+        double posInSecs = getLengthInSeconds() * pos;
+        setPosition(posInSecs);
+    }
+}
+
+
+// Reverb effect controls
+void DJAudioPlayer::setReverbWetDry(float mix)
+{
+    effects.getReverb().setWetDryMix(mix);
+}
+
+void DJAudioPlayer::setReverbActive(bool isActive)
+{
+    effects.getReverb().setActive(isActive);
+}
+
+void DJAudioPlayer::setReverbRoomSize(float size)
+{
+    effects.getReverb().setRoomSize(size);
+}
+
+void DJAudioPlayer::setReverbDamping(float damping)
+{
+    effects.getReverb().setDamping(damping);
+}
+
+// Start audio playback
+void DJAudioPlayer::start()
+{
+    // Lined up while still stopped, so it starts in phase rather than jumping
+    if (syncEnabled.load())
+        alignToMasterBeat();
+
+    transportSource.start();
+    startTimer(100);
+}
+void DJAudioPlayer::stop()
+{
+    transportSource.stop();
+}
+
+double DJAudioPlayer::getPositionRelative()
+{
+    auto length = trackSlot.getTotalLength();
+
+    if (length <= 0)
+        return 0;
+
+    return (double) trackSlot.getNextReadPosition() / (double) length;
+}
+
+// Length in the track's own sample rate, which may differ from the device's
+double DJAudioPlayer::getLengthInSeconds() const
+{
+    auto trackRate = trackSlot.getTrackSampleRate();
+
+    if (trackRate <= 0)
+        return 0;
+
+    return (double) trackSlot.getTotalLength() / trackRate;
+}
@@ -1,56 +1,238 @@
-#pragma once
-
-#include "../JuceLibraryCode/JuceHeader.h"
-#include "ReverbEffect.h"
-
-// Class to handle playback, resampling and audio effects
-class DJAudioPlayer : public AudioSource {
-  public:
-    // Initialises audio player
-    DJAudioPlayer(AudioFormatManager& _formatManager);
-    ~DJAudioPlayer();
-
-    // Audio samples prepare to play, play next block and release
-    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
-    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
-    void releaseResources() override;
-
-    // Load audio file
-    void loadURL(URL audioURL);
-    void setGain(double gain);
-    void setSpeed(double ratio);
-    void setPosition(double posInSecs);
-    void setPositionRelative(double pos);
-    
-    // Control reverb effect
-    void setReverbWetDry(float mix);
-    void setReverbActive(bool isActive);
-    void setReverbRoomSize(float size);
-    void setReverbDamping(float damping);
-    
-    bool isReverbActive() const { return reverbEffect.getActive(); }
-    float getReverbWetDry() const { return reverbEffect.getWetDryMix(); }
-
-    // Starts and stops audio
-    void start();
-    void stop();
-
-    // Relative position of playback
-    double getPositionRelative();
-
-
-private:
-    // Audio file handling
-    AudioFormatManager& formatManager;
-    std::unique_ptr<AudioFormatReaderSource> readerSource;
-    AudioTransportSource transportSource; 
-    ResamplingAudioSource resampleSource{&transportSource, false, 2};
-    
-    ReverbEffect reverbEffect;
-    AudioBuffer<float> tempBuffer;
-};
-
-
-
-
-
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioProfiler.h"
+#include "EffectChain.h"
+#include "MasterClock.h"
+#include "TimeStretchAudioSource.h"
+#include "TrackLoader.h"
+#include "TrackSlot.h"
+
+// Class to handle playback, resampling and audio effects
+class DJAudioPlayer : public AudioSource,
+                      private Timer {
+  public:
+    // Initialises audio player, tracks are opened by the shared loader
+    DJAudioPlayer(TrackLoader& _trackLoader);
+    ~DJAudioPlayer();
+
+    // Receives load progress and completion on the message thread
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        virtual void trackLoadProgress(DJAudioPlayer* player, float progress) {}
+        virtual void trackLoaded(DJAudioPlayer* player, const URL& url, bool success) {}
+
+        // Once per track, when it is playing within the warning time of its end.
+        // A next track loaded from here takes over without a gap
+        virtual void trackEnding(DJAudioPlayer* player) {}
+
+        // A track from loadNextURL took over, called just before its trackLoaded
+        virtual void nextTrackStarted(DJAudioPlayer* player, const URL& url) {}
+
+        // A track from loadNextURL was cleared, replaced or failed to open before it took over
+        virtual void nextTrackDropped(DJAudioPlayer* player, const URL& url) {}
+    };
+
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
+    // Audio samples prepare to play, play next block and release
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+    void releaseResources() override;
+
+    // Load audio file in the background, playback stops once it is ready.
+    // The beat grid is the track's, if it has been analysed, for syncing
+    void loadURL(URL audioURL, BeatGrid beatGrid = {});
+
+    // Opens a track in the background to follow the current one, replacing any already
+    // waiting. It starts on the sample after the current track's last one, or fades in over
+    // the given seconds before the end, resampled if its sample rate differs.
+    // Listener::nextTrackStarted is called when it takes over, loading a track the usual way drops it
+    void loadNextURL(URL audioURL, double crossfadeSeconds = 0, BeatGrid beatGrid = {});
+    void clearNextURL();
+    bool hasNextURL() const { return nextLoadPending || trackSlot.hasNextTrack(); }
+
+    // Seconds of playing time left before Listener::trackEnding, zero turns it off
+    void setTrackEndWarning(double secondsBeforeEnd);
+
+    // Loads on the calling thread and swaps the track straight in.
+    // Only for offline rendering, where no audio callback is running
+    bool loadURLSynchronously(const URL& audioURL, BeatGrid beatGrid = {});
+    bool loadNextURLSynchronously(const URL& audioURL, double crossfadeSeconds = 0, BeatGrid beatGrid = {});
+    void setGain(double gain);
+    void setSpeed(double ratio);
+
+    // With key lock on, speed changes the tempo but not the pitch
+    void setKeyLock(bool shouldLockKey);
+    bool isKeyLocked() const { return keyLock.load(); }
+
+    // Trades stretching quality against CPU, applies straight away
+    void setKeyLockQuality(TimeStretchAudioSource::Quality quality);
+    TimeStretchAudioSource::Quality getKeyLockQuality() const { return timeStretchSource.getQuality(); }
+
+    // The clock synced decks follow, set by the engine before playback
+    void setMasterClock(MasterClock* clock) { masterClock = clock; }
+
+    // A synced deck plays at the master tempo, trimming its speed a little each block to
+    // hold its beats on the clock's. Without a beat grid for the track it plays at its own speed.
+    // A stopped deck jumps into phase, a playing one is pulled in by the trim so it never skips
+    void setSyncEnabled(bool shouldSync);
+    bool isSyncEnabled() const { return syncEnabled.load(); }
+
+    // The leading deck sets the master clock's tempo and beat instead of following them
+    void setTempoMaster(bool shouldLead);
+    bool isTempoMaster() const;
+
+    // Audio thread, between blocks. The beat being heard and the tempo the deck is playing
+    // at, false if it isn't playing a track with a beat grid
+    bool getBeatPosition(double& beat, double& bpm) const;
+
+    // Gives the loaded track beats analysed after it was loaded, if it is still at the URL
+    void setAnalysedBeatGrid(const URL& audioURL, BeatGrid beatGrid) { trackSlot.setAnalysedBeatGrid(audioURL, beatGrid); }
+    void setPosition(double posInSecs);
+    void setPositionRelative(double pos);
+    
+    // Control reverb effect
+    void setReverbWetDry(float mix);
+    void setReverbActive(bool isActive);
+    void setReverbRoomSize(float size);
+    void setReverbDamping(float damping);
+    
+    bool isReverbActive() const { return effects.getEffect(EffectChain::reverb).getActive(); }
+    float getReverbWetDry() const { return effects.getEffect(EffectChain::reverb).getWetDryMix(); }
+
+    // Settings for every effect on this deck, safe to change from the message thread
+    EffectChain& getEffects() { return effects; }
+
+    // Read-ahead buffer size in samples, applied to the next loaded track.
+    // Zero reads straight from the file on the audio thread, only sensible offline
+    void setReadAheadSize(int numSamples);
+    int getReadAheadSize() const { return readAheadSize; }
+
+    // Deletes replaced tracks, which a timer does while a device plays. Offline renders have
+    // no message loop and call it between blocks
+    void releaseRetiredTracks() { trackSlot.releaseRetiredTracks(); }
+
+    // Number of audio blocks that ran out of decoded audio since the last reset
+    int getUnderrunCount() const;
+    void resetUnderrunCount();
+
+    // Starts and stops audio
+    void start();
+    void stop();
+    bool isPlaying() const { return transportSource.isPlaying(); }
+
+    // Relative position of playback
+    double getPositionRelative();
+    double getLengthInSeconds() const;
+
+    // Milliseconds the last getNextAudioBlock spent in each AudioProfiler::DeckStage.
+    // Only valid on the thread that rendered the block, or after it has been joined.
+    // Stages are only timed while enabled, which the engine does when a profiler is attached
+    float getLastStageMs(int stage) const { return stageMs[stage]; }
+    void setStageTimingEnabled(bool shouldTimeStages) { stageTiming = shouldTimeStages; }
+
+private:
+    // Watches for the end of the track and for the next track taking over while playing
+    void timerCallback() override;
+
+    // Swaps the finished track in on the message thread
+    void trackPrepared(const URL& audioURL, std::unique_ptr<PreparedTrack> track);
+
+    // Drops a next track that is still loading, telling listeners it won't play
+    void cancelNextLoad();
+
+    // Keeps the loaded track pinned in the decoded cache
+    void setLoadedURL(const URL& audioURL);
+
+    // Moves playback over to the decoded copy once the cache has it
+    void switchToCachedCopy(const URL& audioURL);
+
+    // Applies the smoothed deck volume, audio thread only
+    void applyGain(const AudioSourceChannelInfo& bufferToFill);
+
+    // Splits the speed between the stretcher and the resampler, audio thread only
+    void setPlaybackRatio(double speed, double rateCorrection);
+
+    // Speed that holds a synced deck on the master beat, audio thread only
+    double getSyncedSpeed(double speed, double trackRate, int numSamples);
+
+    // Seconds into the track of the sample heard next, audio thread only. The slot's read
+    // position is ahead of it by what the stretcher and the resampler hold buffered
+    double getAudibleSeconds(double trackRate) const;
+
+    // Jumps a stopped deck to the nearest position in phase with the master beat,
+    // so the trim starts with only a small error to take up
+    void alignToMasterBeat();
+
+    static float ticksToMs(int64 ticks);
+
+    // Audio file handling
+    TrackLoader& trackLoader;
+    TrackSlot trackSlot;
+    AudioTransportSource transportSource; 
+    TimeStretchAudioSource timeStretchSource{&transportSource, 2};
+    ResamplingAudioSource resampleSource{&timeStretchSource, false, 2};
+    
+    EffectChain effects;
+
+    // Speed is combined with the track's sample rate on the audio thread
+    std::atomic<double> speedRatio { 1.0 };
+    std::atomic<float> gain { 1.0f };
+    std::atomic<bool> keyLock { false };
+
+    // Ramped on the audio thread so slider moves don't step or zip
+    SmoothedValue<double> smoothedSpeed { 1.0 };
+    SmoothedValue<float> smoothedGain { 1.0f };
+    std::atomic<double> deviceSampleRate { 0 };
+    std::atomic<int> deviceBlockSize { 0 };
+
+    // Written at the end of every block by the thread that rendered it
+    float stageMs[AudioProfiler::numDeckStages] = {};
+    std::atomic<bool> stageTiming { false };
+
+    // Sync, the trim is bounded so the pitch never bends by more than a third of a semitone
+    MasterClock* masterClock = nullptr;
+    std::atomic<bool> syncEnabled { false };
+    static constexpr double maxSyncTrim = 0.02;
+    static constexpr double syncTimeConstant = 2.0;
+    static constexpr double syncIntegralTime = 8.0;
+
+    // ResamplingAudioSource keeps this many input samples past the one it plays next
+    static constexpr double resamplerLatency = 3.0;
+
+    // Phase tracking state, audio thread only
+    double lastSyncError = 0;
+    double syncIntegral = 0;
+
+    // Default of two seconds at 44.1kHz rides out most USB drive stalls
+    int readAheadSize = 88200;
+    int underrunsAtLastReset = 0;
+
+    // Only the most recent load request is allowed to replace the track
+    int loadGeneration = 0;
+
+    // Bumped whenever a different track takes over, so a decoded copy of the old one is dropped
+    int trackGeneration = 0;
+
+    // Next track state, the generation drops loads that were cleared while in flight
+    int nextLoadGeneration = 0;
+    bool nextLoadPending = false;
+    URL nextLoadURL;
+    int advancesSeen = 0;
+    double trackEndWarningSeconds = 0;
+    bool trackEndingNotified = false;
+
+    URL loadedURL;
+    ListenerList<Listener> listeners;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (DJAudioPlayer)
+};
+
+
+
+
+
@@ -0,0 +1,324 @@
+#include "DeckEngine.h"
+
+// Waits for the audio thread to have decks to share out. Waking is only an atomic store,
+// as signalling an event can take a lock on the audio thread. So the worker polls instead,
+// yielding between checks while blocks keep coming and sleeping a millisecond at a time
+// once the engine has gone quiet
+class DeckEngine::RenderWorker : public Thread
+{
+public:
+    RenderWorker(DeckEngine& _owner, int index)
+    : Thread("Deck renderer " + String(index)), owner(_owner)
+    {
+    }
+
+    ~RenderWorker() override
+    {
+        stopThread(2000);
+    }
+
+    void wake() { workReady.store(true); }
+
+    void run() override
+    {
+        auto lastWork = Time::getMillisecondCounter();
+
+        while (! threadShouldExit())
+        {
+            if (workReady.exchange(false))
+            {
+                owner.renderClaimedDecks();
+                lastWork = Time::getMillisecondCounter();
+            }
+            else if (Time::getMillisecondCounter() - lastWork < spinTimeMs)
+            {
+                Thread::yield();
+            }
+            else
+            {
+                Thread::sleep(1);
+            }
+        }
+    }
+
+private:
+    // Long enough to span the gap between blocks at any usual buffer size
+    static constexpr uint32 spinTimeMs = 100;
+
+    DeckEngine& owner;
+    std::atomic<bool> workReady { false };
+};
+
+//==============================================================================
+DeckEngine::DeckEngine(TrackLoader& trackLoader, int numDecks, int numWorkerThreads)
+{
+    for (int i = 0; i < numDecks; ++i)
+    {
+        auto* deck = decks.add(new DJAudioPlayer(trackLoader));
+        deck->setMasterClock(&masterClock);
+        deckBuffers.add(new AudioBuffer<float>(2, 0));
+    }
+
+    deckFinishedCycle.reset(new std::atomic<uint32>[(size_t) jmax(1, numDecks)]);
+    deckBusy.reset(new std::atomic<bool>[(size_t) jmax(1, numDecks)]);
+    deckRenderedSamples.calloc((size_t) jmax(1, numDecks));
+    deckMixedCycle.calloc((size_t) jmax(1, numDecks));
+    deckMixingLate.calloc((size_t) jmax(1, numDecks));
+
+    for (int i = 0; i < numDecks; ++i)
+    {
+        deckFinishedCycle[(size_t) i] = 0;
+        deckBusy[(size_t) i] = false;
+    }
+
+    // Nothing to claim until the first parallel chunk
+    claimState = (uint64) jmax(0, numDecks);
+
+    // The audio thread renders decks too, so one deck never needs a worker
+    if (numWorkerThreads < 0)
+        numWorkerThreads = jmin(numDecks - 1, SystemStats::getNumCpus() - 1);
+
+    for (int i = 0; i < numWorkerThreads; ++i)
+    {
+        auto* worker = workers.add(new RenderWorker(*this, i + 1));
+        worker->startThread(Thread::realtimeAudioPriority);
+    }
+}
+
+DeckEngine::~DeckEngine()
+{
+    workers.clear();
+}
+
+void DeckEngine::setJoinDeadline(double fractionOfBlock)
+{
+    joinDeadline = jlimit(0.1, 0.95, fractionOfBlock);
+}
+
+// Decks only time their stages while someone is looking
+void DeckEngine::setProfiler(AudioProfiler* profilerToUse)
+{
+    profiler = profilerToUse;
+
+    for (auto* deck : decks)
+        deck->setStageTimingEnabled(profilerToUse != nullptr);
+}
+
+void DeckEngine::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    maxBlockSize = jmax(1, samplesPerBlockExpected);
+    masterClock.prepare(sampleRate);
+
+    for (int i = 0; i < decks.size(); ++i)
+    {
+        decks[i]->prepareToPlay(samplesPerBlockExpected, sampleRate);
+        deckBuffers[i]->setSize(2, maxBlockSize);
+    }
+}
+
+void DeckEngine::releaseResources()
+{
+    for (auto* deck : decks)
+        deck->releaseResources();
+}
+
+void DeckEngine::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    auto* currentProfiler = profiler.load();
+    auto startTicks = Time::getHighResolutionTicks();
+
+    if (currentProfiler != nullptr)
+    {
+        blockRecord = {};
+        blockRecord.time = currentProfiler->getTime();
+        blockRecord.numSamples = bufferToFill.numSamples;
+        blockRecord.numDecks = jmin(decks.size(), AudioProfiler::maxDecks);
+    }
+
+    // Hosts can go over the size they promised, deck buffers stay the prepared size
+    for (int offset = 0; offset < bufferToFill.numSamples; offset += maxBlockSize)
+        renderChunk(*bufferToFill.buffer,
+                    bufferToFill.startSample + offset,
+                    jmin(maxBlockSize, bufferToFill.numSamples - offset));
+
+    if (currentProfiler != nullptr)
+    {
+        auto elapsed = Time::getHighResolutionTicks() - startTicks;
+        blockRecord.callbackMs = (float) (Time::highResolutionTicksToSeconds(elapsed) * 1000.0);
+        blockRecord.budgetMs = currentSampleRate > 0 ? (float) (bufferToFill.numSamples * 1000.0 / currentSampleRate) : 0.0f;
+        currentProfiler->pushBlock(blockRecord);
+    }
+}
+
+bool DeckEngine::shouldRenderInParallel() const
+{
+    if (! parallelRendering.load() || workers.isEmpty())
+        return false;
+
+    int numPlaying = 0;
+
+    for (auto* deck : decks)
+        if (deck->isPlaying() && ++numPlaying >= 2)
+            return true;
+
+    return false;
+}
+
+void DeckEngine::renderDeck(int index, int numSamples)
+{
+    AudioSourceChannelInfo info (deckBuffers[index], 0, numSamples);
+    decks[index]->getNextAudioBlock(info);
+    deckRenderedSamples[index] = numSamples;
+}
+
+// The cycle and the deck are claimed together, and a deck still busy with an earlier
+// chunk is skipped rather than waited for. It stays unfinished and is mixed when it is done
+void DeckEngine::renderClaimedDecks()
+{
+    for (;;)
+    {
+        auto state = claimState.load();
+        uint32 thisCycle;
+        int index;
+
+        do
+        {
+            thisCycle = (uint32) (state >> 32);
+            index = (int) (uint32) state;
+
+            if (index >= decks.size())
+                return;
+        }
+        while (! claimState.compare_exchange_weak(state, state + 1));
+
+        if (deckBusy[(size_t) index].exchange(true))
+            continue;
+
+        renderDeck(index, chunkSize.load());
+
+        deckFinishedCycle[(size_t) index].store(thisCycle);
+        deckBusy[(size_t) index] = false;
+    }
+}
+
+void DeckEngine::renderChunk(AudioBuffer<float>& output, int startSample, int numSamples)
+{
+    auto numDecks = decks.size();
+
+    // Offline there is no deadline to keep, so a deck left running by a real-time block is waited for
+    if (nonRealtime.load())
+        for (int i = 0; i < numDecks; ++i)
+            while (deckBusy[(size_t) i].load())
+                Thread::yield();
+
+    // The leader's position is where this chunk starts, unless it is still late with the last
+    // one. The clock then just runs on by its own count
+    if (auto* leader = masterClock.getLeader())
+    {
+        auto index = decks.indexOf(leader);
+
+        if (index >= 0 && ! deckBusy[(size_t) index].exchange(true))
+        {
+            double beat, bpm;
+
+            if (leader->getBeatPosition(beat, bpm))
+                masterClock.follow(beat, bpm);
+
+            deckBusy[(size_t) index] = false;
+        }
+    }
+
+    auto parallel = shouldRenderInParallel();
+    auto thisCycle = ++cycle;
+
+    // A deck that has finished a late block plays that in this chunk instead of rendering
+    // a new one. Holding it busy keeps the workers off it until it has been mixed
+    for (int i = 0; i < numDecks; ++i)
+        deckMixingLate[i] = deckFinishedCycle[(size_t) i].load() != deckMixedCycle[i]
+                             && ! deckBusy[(size_t) i].exchange(true);
+
+    if (parallel)
+    {
+        chunkSize = numSamples;
+        claimState = (uint64) thisCycle << 32;
+
+        for (int i = 0; i < jmin(workers.size(), numDecks - 1); ++i)
+            workers[i]->wake();
+
+        renderClaimedDecks();
+
+        // Wait for the workers, but never past the point where the device would underrun
+        auto deadline = Time::getHighResolutionTicks()
+                      + (int64) (Time::getHighResolutionTicksPerSecond() * joinDeadline.load() * numSamples / jmax(1.0, currentSampleRate));
+
+        auto waitForever = nonRealtime.load();
+
+        for (int i = 0; i < numDecks; ++i)
+            while (! deckMixingLate[i] && deckFinishedCycle[(size_t) i].load() != thisCycle
+                     && (waitForever || Time::getHighResolutionTicks() < deadline))
+                Thread::yield();
+    }
+    else
+    {
+        // A worker can still be running late from a parallel chunk
+        for (int i = 0; i < numDecks; ++i)
+        {
+            if (deckBusy[(size_t) i].exchange(true))
+                continue;
+
+            renderDeck(i, numSamples);
+            deckFinishedCycle[(size_t) i].store(thisCycle);
+            deckBusy[(size_t) i] = false;
+        }
+    }
+
+    // Sum the decks that made it
+    auto timeStages = profiler.load() != nullptr;
+    auto mixStartTicks = timeStages ? Time::getHighResolutionTicks() : 0;
+    output.clear(startSample, numSamples);
+
+    for (int i = 0; i < numDecks; ++i)
+    {
+        auto finishedCycle = deckFinishedCycle[(size_t) i].load();
+
+        if (deckMixingLate[i])
+        {
+            // The deck was silent for the block it missed, so its late block fades in.
+            // Chunk sizes only differ when the host overruns, anything left over is dropped
+            auto numLate = jmin(numSamples, deckRenderedSamples[i]);
+
+            for (int channel = 0; channel < jmin(2, output.getNumChannels()); ++channel)
+                output.addFromWithRamp(channel, startSample, deckBuffers[i]->getReadPointer(channel), numLate, 0.0f, 1.0f);
+        }
+        else if (finishedCycle != thisCycle)
+        {
+            ++lateDecks;
+            ++blockRecord.lateDecks;
+            continue;
+        }
+        else
+        {
+            for (int channel = 0; channel < jmin(2, output.getNumChannels()); ++channel)
+                output.addFrom(channel, startSample, *deckBuffers[i], channel, 0, numSamples);
+        }
+
+        deckMixedCycle[i] = finishedCycle;
+
+        // A late deck may still be writing its timings, so only finished ones are read
+        if (timeStages && i < AudioProfiler::maxDecks)
+            for (int stage = 0; stage < AudioProfiler::numDeckStages; ++stage)
+                blockRecord.deckMs[i][stage] += decks[i]->getLastStageMs(stage);
+
+        if (deckMixingLate[i])
+            deckBusy[(size_t) i] = false;
+    }
+
+    if (timeStages)
+    {
+        auto mixTicks = Time::getHighResolutionTicks() - mixStartTicks;
+        blockRecord.mixMs += (float) (Time::highResolutionTicksToSeconds(mixTicks) * 1000.0);
+    }
+
+    masterClock.advance(numSamples);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DJAudioPlayer.h"
+#include "MasterClock.h"
+
+// Owns any number of decks and mixes them. Inside each audio callback the decks
+// are shared out between the audio thread and a pool of real-time worker threads,
+// which claim them one at a time from an atomic counter. The join waits only until
+// a deadline inside the block, a deck that misses it is left out of that block's mix.
+// Once it has finished, its block is faded in one block late in place of rendering
+// the next one, so nothing ever waits for it and none of its audio is thrown away
+class DeckEngine : public AudioSource
+{
+public:
+    // A negative worker count uses one thread per spare core, up to one per deck
+    DeckEngine(TrackLoader& trackLoader, int numDecks, int numWorkerThreads = -1);
+    ~DeckEngine() override;
+
+    int getNumDecks() const { return decks.size(); }
+    DJAudioPlayer* getDeck(int index) const { return decks[index]; }
+
+    // Counted in the blocks the engine renders, every deck syncs to it
+    MasterClock& getMasterClock() { return masterClock; }
+
+    // Parallel rendering can be switched off, decks are then rendered one after another
+    void setParallelRendering(bool shouldRenderInParallel) { parallelRendering = shouldRenderInParallel; }
+    bool isParallelRenderingEnabled() const { return parallelRendering.load(); }
+    int getNumWorkerThreads() const { return workers.size(); }
+
+    // Fraction of the block's duration the audio thread waits for the workers (0.1 to 0.95)
+    void setJoinDeadline(double fractionOfBlock);
+
+    // Offline rendering waits for every deck instead of dropping late ones
+    void setNonRealtime(bool isNonRealtime) { nonRealtime = isNonRealtime; }
+
+    // Deck blocks that missed the join deadline and were mixed a block late
+    int getLateDeckCount() const { return lateDecks.load(); }
+
+    // Receives a timing record for every callback, pass nullptr to stop.
+    // The profiler must outlive the engine or be removed first
+    void setProfiler(AudioProfiler* profilerToUse);
+
+    // AudioSource overrides
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    class RenderWorker;
+
+    // Renders decks until there are none left to claim, called on any render thread
+    void renderClaimedDecks();
+    void renderDeck(int index, int numSamples);
+
+    // Renders and mixes one chunk of at most the prepared block size
+    void renderChunk(AudioBuffer<float>& output, int startSample, int numSamples);
+
+    // Parallel only pays off when at least two decks have real work to do
+    bool shouldRenderInParallel() const;
+
+    MasterClock masterClock;
+    OwnedArray<DJAudioPlayer> decks;
+    OwnedArray<AudioBuffer<float>> deckBuffers;
+    OwnedArray<RenderWorker> workers;
+
+    // Deck i has finished the current cycle when deckFinishedCycle[i] == cycle,
+    // and deckBusy[i] is set for as long as any thread is rendering it
+    std::unique_ptr<std::atomic<uint32>[]> deckFinishedCycle;
+    std::unique_ptr<std::atomic<bool>[]> deckBusy;
+    uint32 cycle = 0;
+
+    // Written before deckFinishedCycle is stored, so it is safe to read once that has been seen
+    HeapBlock<int> deckRenderedSamples;
+
+    // Audio thread only. A finished cycle that differs from deckMixedCycle is a late block
+    // still waiting to be mixed, and deckMixingLate marks the decks doing that this chunk
+    HeapBlock<uint32> deckMixedCycle;
+    HeapBlock<bool> deckMixingLate;
+
+    // The cycle in the top half and the next deck to claim in the bottom one, so a
+    // worker still running from an earlier cycle can never claim a deck for the wrong one
+    std::atomic<uint64> claimState { 0 };
+    std::atomic<int> chunkSize { 0 };
+
+    std::atomic<bool> parallelRendering { true };
+    std::atomic<double> joinDeadline { 0.8 };
+    std::atomic<bool> nonRealtime { false };
+    std::atomic<int> lateDecks { 0 };
+
+    double currentSampleRate = 0;
+    int maxBlockSize = 0;
+
+    // Filled in across the chunks of one callback, audio thread only
+    std::atomic<AudioProfiler*> profiler { nullptr };
+    AudioProfiler::BlockRecord blockRecord;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DeckEngine)
+};
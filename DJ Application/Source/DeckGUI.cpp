@@ -1,398 +1,687 @@
-#include "../JuceLibraryCode/JuceHeader.h"
-#include "DeckGUI.h"
-
-// Initialises the graphical user interface for a DJ deck
-DeckGUI::DeckGUI(DJAudioPlayer* _player,
-                AudioFormatManager & formatManagerToUse,
-                AudioThumbnailCache & cacheToUse
-           ) : player(_player),
-               waveformDisplay(formatManagerToUse, cacheToUse)
-{
-    // Custom colour theme for deck gui
-    Colour backgroundColour = Colour::fromRGB(5, 5, 16);
-    Colour primaryAccent = Colour::fromRGB(0, 245, 212);     // Electric teal
-    Colour secondaryAccent = Colour::fromRGB(255, 0, 184);   // Neon magenta
-    Colour tertiaryAccent = Colour::fromRGB(255, 240, 31);   // Cyber yellow
-    Colour quaternaryAccent = Colour::fromRGB(112, 0, 255);  // Plasma blue
-    Colour textColour = Colour::fromRGB(248, 253, 255);      // Ice white
-    Colour waveformColour = Colour::fromRGB(123, 255, 0);    // Radioactive green
-
-    // Sliders and buttons with custom colors
-    getLookAndFeel().setColour(Slider::thumbColourId, primaryAccent);
-    getLookAndFeel().setColour(Slider::trackColourId, secondaryAccent.withAlpha(0.6f));
-    getLookAndFeel().setColour(Slider::backgroundColourId, Colours::black.withAlpha(0.8f));
-    getLookAndFeel().setColour(Slider::textBoxTextColourId, textColour);
-    getLookAndFeel().setColour(Slider::textBoxOutlineColourId, quaternaryAccent.withAlpha(0.5f));
-    getLookAndFeel().setColour(Slider::rotarySliderFillColourId, primaryAccent);
-    getLookAndFeel().setColour(Slider::rotarySliderOutlineColourId, secondaryAccent);
-    getLookAndFeel().setColour(Label::textColourId, textColour);
-    getLookAndFeel().setColour(TextButton::buttonColourId, quaternaryAccent.withAlpha(0.8f));
-    getLookAndFeel().setColour(TextButton::textColourOffId, textColour);
-    getLookAndFeel().setColour(TextButton::textColourOnId, tertiaryAccent);
-
-    // Add control buttons
-    addAndMakeVisible(playButton);
-    addAndMakeVisible(stopButton);
-    addAndMakeVisible(loadButton);
-    
-    // Style the buttons
-    playButton.setColour(TextButton::buttonColourId, primaryAccent);
-    stopButton.setColour(TextButton::buttonColourId, secondaryAccent);
-    loadButton.setColour(TextButton::buttonColourId, quaternaryAccent);
-    reverbButton.setColour(TextButton::buttonColourId, tertiaryAccent);
-    
-    // Set button text
-    playButton.setButtonText("PLAY");
-    stopButton.setButtonText("STOP");
-    loadButton.setButtonText("LOAD");
-    reverbButton.setButtonText("REVERB OFF");
-    
-    // Set text color to black for all buttons
-    playButton.setColour(TextButton::textColourOffId, Colours::black);
-    playButton.setColour(TextButton::textColourOnId, Colours::black);
-    stopButton.setColour(TextButton::textColourOffId, Colours::black);
-    stopButton.setColour(TextButton::textColourOnId, Colours::black);
-    loadButton.setColour(TextButton::textColourOffId, Colours::black);
-    loadButton.setColour(TextButton::textColourOnId, Colours::black);
-    reverbButton.setColour(TextButton::textColourOffId, Colours::black);
-    reverbButton.setColour(TextButton::textColourOnId, Colours::black);
-
-    // Set up button listeners
-    playButton.addListener(this);
-    stopButton.addListener(this);
-    loadButton.addListener(this);
-    reverbButton.addListener(this);
-       
-    // Add sliders
-    addAndMakeVisible(volSlider);
-    addAndMakeVisible(speedSlider);
-    addAndMakeVisible(posSlider);
-    
-    // Set up text box for sliders to show numbers
-    volSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    speedSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    posSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    
-    // Format numbers in sliders
-    speedSlider.textFromValueFunction = [](double value) { return String(value, 1) + "x"; };
-    volSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
-    posSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
-    
-    // Custom slider colours and style
-    volSlider.setColour(Slider::thumbColourId, primaryAccent);
-    volSlider.setColour(Slider::rotarySliderFillColourId, primaryAccent);
-    speedSlider.setColour(Slider::rotarySliderFillColourId, tertiaryAccent);
-    speedSlider.setColour(Slider::thumbColourId, tertiaryAccent);
-    posSlider.setColour(Slider::thumbColourId, quaternaryAccent);
-    posSlider.setColour(Slider::trackColourId, quaternaryAccent.brighter(1.5f).withAlpha(0.8f));
-    
-    volSlider.setSliderStyle(Slider::SliderStyle::Rotary);
-    volSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    
-    // Slider ranges
-    speedSlider.setRange(0.5, 2, 0);
-    speedSlider.setValue(1);
-    speedSlider.setSliderStyle(Slider::SliderStyle::Rotary);
-    speedSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    posSlider.setSliderStyle(Slider::LinearHorizontal);
-
-    volSlider.setRange(0.0, 1.0);
-    speedSlider.setRange(0.0, 100.0);
-    posSlider.setRange(0.0, 1.0);
-    
-    // Add event listeners
-    volSlider.addListener(this);
-    speedSlider.addListener(this);
-    posSlider.addListener(this);
-    
-    // Add label for sliders
-    addAndMakeVisible(volLabel);
-    addAndMakeVisible(speedLabel);
-    addAndMakeVisible(posLabel);
-    
-    // Set text for labels
-    volLabel.setText("VOLUME", dontSendNotification);
-    speedLabel.setText("SPEED", dontSendNotification);
-    posLabel.setText("POSITION", dontSendNotification);
-    
-    // Align labels to be centered
-    volLabel.setJustificationType(Justification::centred);
-    speedLabel.setJustificationType(Justification::centred);
-    posLabel.setJustificationType(Justification::centred);
-    
-    // Custom font for labels
-    Font labelFont("Arial", 14.0f, Font::bold);
-    volLabel.setFont(labelFont);
-    speedLabel.setFont(labelFont);
-    posLabel.setFont(labelFont);
-    
-    // Set up custom waveform display
-    addAndMakeVisible(waveformDisplay);
-    // In DeckGUI constructor
-    waveformDisplay.setColours(waveformColour, backgroundColour.darker(0.8f), primaryAccent);
-    
-    // Add reverb effect controls
-    addAndMakeVisible(reverbButton);
-    addAndMakeVisible(wetDrySlider);
-    addAndMakeVisible(roomSizeSlider);
-    addAndMakeVisible(dampingSlider);
-    
-    // Set up sliders for reverb
-    wetDrySlider.setRange(0.0, 1.0);
-    wetDrySlider.setValue(0.5);
-    wetDrySlider.setSliderStyle(Slider::SliderStyle::LinearVertical);
-    wetDrySlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    wetDrySlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
-    
-    roomSizeSlider.setRange(0.0, 1.0);
-    roomSizeSlider.setValue(0.5);
-    roomSizeSlider.setSliderStyle(Slider::SliderStyle::LinearVertical);
-    roomSizeSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    roomSizeSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
-    
-    dampingSlider.setRange(0.0, 1.0);
-    dampingSlider.setValue(0.5);
-    dampingSlider.setSliderStyle(Slider::SliderStyle::LinearVertical);
-    dampingSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
-    dampingSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
-
-    // Custom slider colors for reverb controls
-    wetDrySlider.setColour(Slider::thumbColourId, primaryAccent);
-    wetDrySlider.setColour(Slider::rotarySliderFillColourId, primaryAccent);
-    
-    roomSizeSlider.setColour(Slider::thumbColourId, tertiaryAccent);
-    roomSizeSlider.setColour(Slider::rotarySliderFillColourId, tertiaryAccent);
-    
-    dampingSlider.setColour(Slider::thumbColourId, secondaryAccent);
-    dampingSlider.setColour(Slider::rotarySliderFillColourId, secondaryAccent);
-    
-    // Add listener for reverb sliders
-    wetDrySlider.addListener(this);
-    roomSizeSlider.addListener(this);
-    dampingSlider.addListener(this);
-    
-    // Ad labels for reverb controls
-    addAndMakeVisible(wetDryLabel);
-    addAndMakeVisible(roomSizeLabel);
-    addAndMakeVisible(dampingLabel);
-    
-    // Set text for labels
-    wetDryLabel.setText("WET/DRY", dontSendNotification);
-    roomSizeLabel.setText("ROOM SIZE", dontSendNotification);
-    dampingLabel.setText("DAMPING", dontSendNotification);
-    
-    // Center labels and set font
-    wetDryLabel.setJustificationType(Justification::centred);
-    roomSizeLabel.setJustificationType(Justification::centred);
-    dampingLabel.setJustificationType(Justification::centred);
-    
-    wetDryLabel.setFont(labelFont);
-    roomSizeLabel.setFont(labelFont);
-    dampingLabel.setFont(labelFont);
-    
-    // Start timer for waveform
-    startTimer(500);
-}
-
-DeckGUI::~DeckGUI()
-{
-    stopTimer();
-}
-
-// Draws the custom background with subtle gradients and glow effects
-void DeckGUI::paint(Graphics& g)
-{
-    // Create a subtle gradient background
-    ColourGradient background(Colour::fromRGB(5, 5, 16), 0, 0,
-                              Colour::fromRGB(10, 10, 30), getWidth(), getHeight(),
-                              false);
-    g.setGradientFill(background);
-    g.fillAll();
-
-    // Add a subtle grid pattern
-    g.setColour(Colours::white.withAlpha(0.03f));
-    for (int x = 0; x < getWidth(); x += 20) {
-        g.drawLine(x, 0, x, getHeight(), 0.5f);
-    }
-    for (int y = 0; y < getHeight(); y += 20) {
-        g.drawLine(0, y, getWidth(), y, 0.5f);
-    }
-
-    // Draw a glowing border
-    g.setColour(Colour::fromRGB(0, 245, 212).withAlpha(0.4f));
-    g.drawRoundedRectangle(1, 1, getWidth()-2, getHeight()-2, 4.0f, 1.5f);
-    
-    // Add a subtle pulsing effect
-    float pulseAlpha = 0.3f + 0.2f * sin(Time::getMillisecondCounter() / 500.0f);
-    g.setColour(Colour::fromRGB(255, 0, 184).withAlpha(pulseAlpha));
-    g.drawRoundedRectangle(3, 3, getWidth()-6, getHeight()-6, 4.0f, 1.0f);
-}
-
-// Position
-void DeckGUI::resized()
-{
-    double rowH = getHeight() / 12;
-    double width = getWidth();
-
-    double buttonWidth = width / 4;
-    double buttonHeight = rowH * 2;
-    
-    // Set bounds of buttons
-    playButton.setBounds(0, 0, buttonWidth, buttonHeight);
-    stopButton.setBounds(buttonWidth, 0, buttonWidth, buttonHeight);
-    loadButton.setBounds(buttonWidth * 2, 0, buttonWidth, buttonHeight);
-    reverbButton.setBounds(buttonWidth * 3, 0, buttonWidth, buttonHeight);
-    
-    // Set bounds of waveform display
-    waveformDisplay.setBounds(0, rowH * 2, width, rowH * 3);
-
-    // Position slider
-    double posSliderHeight = rowH * 1.5;
-    posSlider.setBounds(0, rowH * 5, width, posSliderHeight);
-    posLabel.setBounds(0, posSlider.getBottom() + 5, width, 20);
-
-    // Calculate positions for all rotary controls and position them
-    double sliderWidth = width / 5;
-    double sliderHeight = rowH * 3;
-    double sliderTop = rowH * 7;
-    double padding = width / 20;
-    double x = padding;
-    
-    // Volume slider
-    volSlider.setBounds(x, sliderTop, sliderWidth, sliderHeight);
-    volLabel.setBounds(volSlider.getX(), volSlider.getBottom() + 5, sliderWidth, 20);
-    x += sliderWidth + padding;
-    
-    // Speed slider
-    speedSlider.setBounds(x, sliderTop, sliderWidth, sliderHeight);
-    speedLabel.setBounds(speedSlider.getX(), speedSlider.getBottom() + 5, sliderWidth, 20);
-    x += sliderWidth + padding;
-    
-    // Wet/dry slider
-    wetDrySlider.setBounds(x - 50, sliderTop, sliderWidth, sliderHeight);
-    wetDryLabel.setBounds(wetDrySlider.getX(), wetDrySlider.getBottom() + 5, sliderWidth, 20);
-    x += sliderWidth + padding;
-    
-    // Room size slider
-    roomSizeSlider.setBounds(x-82, sliderTop, sliderWidth, sliderHeight);
-    roomSizeLabel.setBounds(roomSizeSlider.getX(), roomSizeSlider.getBottom() + 5, sliderWidth, 20);
-    x += sliderWidth + padding;
-    
-    // Damping slider
-    dampingSlider.setBounds(x-130, sliderTop, sliderWidth, sliderHeight);
-    dampingLabel.setBounds(dampingSlider.getX(), dampingSlider.getBottom() + 5, sliderWidth, 20);
-    x += sliderWidth + padding;
-    
-    // Show/hide reverb controls based on whether reverb is active or not
-    bool isReverbActive = player->isReverbActive();
-    wetDrySlider.setVisible(isReverbActive);
-    roomSizeSlider.setVisible(isReverbActive);
-    dampingSlider.setVisible(isReverbActive);
-    wetDryLabel.setVisible(isReverbActive);
-    roomSizeLabel.setVisible(isReverbActive);
-    dampingLabel.setVisible(isReverbActive);
-}
-
-// Handles button clicked events
-void DeckGUI::buttonClicked(Button* button)
-{
-    if (button == &playButton)
-    {
-        std::cout << "Play button was clicked " << std::endl;
-        player->start();
-    }
-     if (button == &stopButton)
-    {
-        std::cout << "Stop button was clicked " << std::endl;
-        player->stop();
-
-    }
-    if (button == &loadButton)
-    {
-        auto fileChooserFlags = 
-        FileBrowserComponent::canSelectFiles;
-        fChooser.launchAsync(fileChooserFlags, [this](const FileChooser& chooser)
-        {
-            player->loadURL(URL{chooser.getResult()});
-            waveformDisplay.loadURL(URL{chooser.getResult()}); 
-        });
-        
-    }
-    
-    if (button == &reverbButton)
-    {
-        bool isReverbActive = !player->isReverbActive();
-        player->setReverbActive(isReverbActive);
-        
-        // Update button text
-        reverbButton.setButtonText(isReverbActive ? "REVERB ON" : "REVERB OFF");
-        
-        // Show/hide reverb controls
-        wetDrySlider.setVisible(isReverbActive);
-        roomSizeSlider.setVisible(isReverbActive);
-        dampingSlider.setVisible(isReverbActive);
-        wetDryLabel.setVisible(isReverbActive);
-        roomSizeLabel.setVisible(isReverbActive);
-        dampingLabel.setVisible(isReverbActive);
-    }
-}
-
-// Handles slider value changes
-void DeckGUI::sliderValueChanged (Slider *slider)
-{
-    if (slider == &volSlider)
-    {
-        player->setGain(slider->getValue());
-    }
-
-    if (slider == &speedSlider)
-    {
-        player->setSpeed(slider->getValue());
-    }
-    
-    if (slider == &posSlider)
-    {
-        player->setPositionRelative(slider->getValue());
-    }
-    if (slider == &wetDrySlider)
-    {
-        player->setReverbWetDry(slider->getValue());
-    }
-    if (slider == &roomSizeSlider)
-    {
-        player->setReverbRoomSize(slider->getValue());
-    }
-    if (slider == &dampingSlider)
-    {
-        player->setReverbDamping(slider->getValue());
-    }
-    
-}
-
-// Handles file drag and drop events
-bool DeckGUI::isInterestedInFileDrag (const StringArray &files)
-{
-  std::cout << "DeckGUI::isInterestedInFileDrag" << std::endl;
-  return true; 
-}
-
-void DeckGUI::filesDropped (const StringArray &files, int x, int y)
-{
-  std::cout << "DeckGUI::filesDropped" << std::endl;
-  if (files.size() == 1)
-  {
-    player->loadURL(URL{File{files[0]}});
-  }
-}
-
-// Updates waveform playhead position
-void DeckGUI::timerCallback()
-{
-    waveformDisplay.setPositionRelative(
-            player->getPositionRelative());
-}
-
-
-
-    
-
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckGUI.h"
+
+namespace
+{
+    // Shared with the OpenGL renderer, which draws the same background on the GPU
+    const WaveformRenderer::DeckBackground deckBackground {
+        Colour::fromRGB(5, 5, 16), Colour::fromRGB(10, 10, 30),   // Gradient, top left to bottom right
+        Colours::white.withAlpha(0.03f),                           // Grid
+        Colour::fromRGB(0, 245, 212).withAlpha(0.4f),              // Glowing border
+        Colour::fromRGB(255, 0, 184),                              // Pulsing border
+        20, 4.0f,
+        1.0f, 1.5f,
+        3.0f, 1.0f
+    };
+}
+
+// Initialises the graphical user interface for a DJ deck
+DeckGUI::DeckGUI(DJAudioPlayer* _player,
+                AudioFormatManager & formatManagerToUse,
+                PersistentThumbnailCache & cacheToUse,
+                ThreadPool & analysisPool,
+                RefreshScheduler & _refreshScheduler
+           ) : waveformDisplay(formatManagerToUse, cacheToUse, analysisPool, _refreshScheduler),
+               scrollingWaveform(formatManagerToUse, analysisPool),
+               refreshScheduler(_refreshScheduler),
+               player(_player)
+{
+    // Custom colour theme for deck gui
+    Colour backgroundColour = Colour::fromRGB(5, 5, 16);
+    Colour primaryAccent = Colour::fromRGB(0, 245, 212);     // Electric teal
+    Colour secondaryAccent = Colour::fromRGB(255, 0, 184);   // Neon magenta
+    Colour tertiaryAccent = Colour::fromRGB(255, 240, 31);   // Cyber yellow
+    Colour quaternaryAccent = Colour::fromRGB(112, 0, 255);  // Plasma blue
+    Colour textColour = Colour::fromRGB(248, 253, 255);      // Ice white
+    waveformColour = Colour::fromRGB(123, 255, 0);           // Radioactive green
+    waveformBackground = backgroundColour.darker(0.8f);
+    playheadColour = primaryAccent;
+
+    // Sliders and buttons with custom colors
+    getLookAndFeel().setColour(Slider::thumbColourId, primaryAccent);
+    getLookAndFeel().setColour(Slider::trackColourId, secondaryAccent.withAlpha(0.6f));
+    getLookAndFeel().setColour(Slider::backgroundColourId, Colours::black.withAlpha(0.8f));
+    getLookAndFeel().setColour(Slider::textBoxTextColourId, textColour);
+    getLookAndFeel().setColour(Slider::textBoxOutlineColourId, quaternaryAccent.withAlpha(0.5f));
+    getLookAndFeel().setColour(Slider::rotarySliderFillColourId, primaryAccent);
+    getLookAndFeel().setColour(Slider::rotarySliderOutlineColourId, secondaryAccent);
+    getLookAndFeel().setColour(Label::textColourId, textColour);
+    getLookAndFeel().setColour(TextButton::buttonColourId, quaternaryAccent.withAlpha(0.8f));
+    getLookAndFeel().setColour(TextButton::textColourOffId, textColour);
+    getLookAndFeel().setColour(TextButton::textColourOnId, tertiaryAccent);
+
+    // Add control buttons
+    addAndMakeVisible(playButton);
+    addAndMakeVisible(stopButton);
+    addAndMakeVisible(loadButton);
+    addAndMakeVisible(keyLockButton);
+    addAndMakeVisible(syncButton);
+    addAndMakeVisible(masterButton);
+    
+    // Style the buttons
+    playButton.setColour(TextButton::buttonColourId, primaryAccent);
+    stopButton.setColour(TextButton::buttonColourId, secondaryAccent);
+    loadButton.setColour(TextButton::buttonColourId, quaternaryAccent);
+    keyLockButton.setColour(TextButton::buttonColourId, tertiaryAccent);
+    syncButton.setColour(TextButton::buttonColourId, primaryAccent);
+    masterButton.setColour(TextButton::buttonColourId, secondaryAccent);
+    
+    // Set button text
+    playButton.setButtonText("PLAY");
+    stopButton.setButtonText("STOP");
+    loadButton.setButtonText("LOAD");
+    
+    // Set text color to black for all buttons
+    playButton.setColour(TextButton::textColourOffId, Colours::black);
+    playButton.setColour(TextButton::textColourOnId, Colours::black);
+    stopButton.setColour(TextButton::textColourOffId, Colours::black);
+    stopButton.setColour(TextButton::textColourOnId, Colours::black);
+    loadButton.setColour(TextButton::textColourOffId, Colours::black);
+    loadButton.setColour(TextButton::textColourOnId, Colours::black);
+    keyLockButton.setColour(TextButton::textColourOffId, Colours::black);
+    keyLockButton.setColour(TextButton::textColourOnId, Colours::black);
+    syncButton.setColour(TextButton::textColourOffId, Colours::black);
+    syncButton.setColour(TextButton::textColourOnId, Colours::black);
+    masterButton.setColour(TextButton::textColourOffId, Colours::black);
+    masterButton.setColour(TextButton::textColourOnId, Colours::black);
+
+    // Set up button listeners
+    playButton.addListener(this);
+    stopButton.addListener(this);
+    loadButton.addListener(this);
+    keyLockButton.addListener(this);
+    syncButton.addListener(this);
+    masterButton.addListener(this);
+
+    // Item ids are the quality tiers plus one, since zero means nothing selected
+    addAndMakeVisible(keyLockQualityBox);
+    keyLockQualityBox.addItem("KEY LOCK LOW", (int) TimeStretchAudioSource::Quality::low + 1);
+    keyLockQualityBox.addItem("KEY LOCK MEDIUM", (int) TimeStretchAudioSource::Quality::medium + 1);
+    keyLockQualityBox.addItem("KEY LOCK HIGH", (int) TimeStretchAudioSource::Quality::high + 1);
+    keyLockQualityBox.setSelectedId((int) player->getKeyLockQuality() + 1, dontSendNotification);
+    keyLockQualityBox.setColour(ComboBox::backgroundColourId, Colours::black.withAlpha(0.8f));
+    keyLockQualityBox.setColour(ComboBox::outlineColourId, tertiaryAccent);
+    keyLockQualityBox.setColour(ComboBox::arrowColourId, tertiaryAccent);
+    keyLockQualityBox.addListener(this);
+       
+    // Add sliders
+    addAndMakeVisible(volSlider);
+    addAndMakeVisible(speedSlider);
+    addAndMakeVisible(posSlider);
+    
+    // Set up text box for sliders to show numbers
+    volSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    speedSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    posSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    
+    // Format numbers in sliders
+    speedSlider.textFromValueFunction = [](double value) { return String(value, 1) + "x"; };
+    volSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
+    posSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
+    
+    // Custom slider colours and style
+    volSlider.setColour(Slider::thumbColourId, primaryAccent);
+    volSlider.setColour(Slider::rotarySliderFillColourId, primaryAccent);
+    speedSlider.setColour(Slider::rotarySliderFillColourId, tertiaryAccent);
+    speedSlider.setColour(Slider::thumbColourId, tertiaryAccent);
+    posSlider.setColour(Slider::thumbColourId, quaternaryAccent);
+    posSlider.setColour(Slider::trackColourId, quaternaryAccent.brighter(1.5f).withAlpha(0.8f));
+    
+    volSlider.setSliderStyle(Slider::SliderStyle::Rotary);
+    volSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    
+    // Slider ranges
+    speedSlider.setRange(0.5, 2, 0);
+    speedSlider.setValue(1);
+    speedSlider.setSliderStyle(Slider::SliderStyle::Rotary);
+    speedSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    posSlider.setSliderStyle(Slider::LinearHorizontal);
+
+    volSlider.setRange(0.0, 1.0);
+    speedSlider.setRange(0.0, 100.0);
+    posSlider.setRange(0.0, 1.0);
+    
+    // Add event listeners
+    volSlider.addListener(this);
+    speedSlider.addListener(this);
+    posSlider.addListener(this);
+    
+    // Add label for sliders
+    addAndMakeVisible(volLabel);
+    addAndMakeVisible(speedLabel);
+    addAndMakeVisible(posLabel);
+    
+    // Set text for labels
+    volLabel.setText("VOLUME", dontSendNotification);
+    speedLabel.setText("SPEED", dontSendNotification);
+    posLabel.setText("POSITION", dontSendNotification);
+    
+    // Align labels to be centered
+    volLabel.setJustificationType(Justification::centred);
+    speedLabel.setJustificationType(Justification::centred);
+    posLabel.setJustificationType(Justification::centred);
+    
+    // Custom font for labels
+    Font labelFont("Arial", 14.0f, Font::bold);
+    volLabel.setFont(labelFont);
+    speedLabel.setFont(labelFont);
+    posLabel.setFont(labelFont);
+    
+    // Set up custom waveform display
+    addAndMakeVisible(waveformDisplay);
+    // In DeckGUI constructor
+    waveformDisplay.setColours(waveformColour, waveformBackground, playheadColour);
+
+    addAndMakeVisible(scrollingWaveform);
+    scrollingWaveform.setColours(waveformColour, waveformBackground, playheadColour);
+    
+    // Add effect buttons, one colour per effect
+    const Colour effectColours[EffectChain::numEffects] = { primaryAccent, secondaryAccent, tertiaryAccent, waveformColour };
+
+    for (int i = 0; i < EffectChain::numEffects; ++i)
+    {
+        addAndMakeVisible(effectButtons[i]);
+        effectButtons[i].setColour(TextButton::buttonColourId, effectColours[i]);
+        effectButtons[i].setColour(TextButton::textColourOffId, Colours::black);
+        effectButtons[i].setColour(TextButton::textColourOnId, Colours::black);
+        effectButtons[i].addListener(this);
+    }
+
+    // Add effect controls
+    addAndMakeVisible(wetDrySlider);
+    addAndMakeVisible(paramOneSlider);
+    addAndMakeVisible(paramTwoSlider);
+    
+    // Set up sliders for effects, ranges are set by the effect being edited
+    wetDrySlider.setRange(0.0, 1.0);
+    wetDrySlider.setSliderStyle(Slider::SliderStyle::LinearVertical);
+    wetDrySlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    wetDrySlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
+    
+    paramOneSlider.setSliderStyle(Slider::SliderStyle::LinearVertical);
+    paramOneSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+    
+    paramTwoSlider.setSliderStyle(Slider::SliderStyle::LinearVertical);
+    paramTwoSlider.setTextBoxStyle(Slider::TextBoxBelow, false, 60, 20);
+
+    // Custom slider colors for effect controls
+    wetDrySlider.setColour(Slider::thumbColourId, primaryAccent);
+    wetDrySlider.setColour(Slider::rotarySliderFillColourId, primaryAccent);
+    
+    paramOneSlider.setColour(Slider::thumbColourId, tertiaryAccent);
+    paramOneSlider.setColour(Slider::rotarySliderFillColourId, tertiaryAccent);
+    
+    paramTwoSlider.setColour(Slider::thumbColourId, secondaryAccent);
+    paramTwoSlider.setColour(Slider::rotarySliderFillColourId, secondaryAccent);
+    
+    // Add listener for effect sliders
+    wetDrySlider.addListener(this);
+    paramOneSlider.addListener(this);
+    paramTwoSlider.addListener(this);
+    
+    // Ad labels for effect controls
+    addAndMakeVisible(wetDryLabel);
+    addAndMakeVisible(paramOneLabel);
+    addAndMakeVisible(paramTwoLabel);
+    
+    // Set text for labels
+    wetDryLabel.setText("WET/DRY", dontSendNotification);
+    
+    // Center labels and set font
+    wetDryLabel.setJustificationType(Justification::centred);
+    paramOneLabel.setJustificationType(Justification::centred);
+    paramTwoLabel.setJustificationType(Justification::centred);
+    
+    wetDryLabel.setFont(labelFont);
+    paramOneLabel.setFont(labelFont);
+    paramTwoLabel.setFont(labelFont);
+
+    editEffect(EffectChain::reverb);
+    
+    // Listen for tracks loaded from here or from the playlist
+    player->addListener(this);
+
+    // Playheads follow the player once per frame
+    refreshScheduler.addClient(this);
+}
+
+DeckGUI::~DeckGUI()
+{
+    player->removeListener(this);
+    refreshScheduler.removeClient(this);
+}
+
+// Draws the custom background with subtle gradients and glow effects
+void DeckGUI::paint(Graphics& g)
+{
+    // The OpenGL renderer draws all of this underneath the controls
+    if (waveformRenderer != nullptr)
+        return;
+
+    // Create a subtle gradient background
+    ColourGradient background(deckBackground.gradientStart, 0, 0,
+                              deckBackground.gradientEnd, getWidth(), getHeight(),
+                              false);
+    g.setGradientFill(background);
+    g.fillAll();
+
+    // Add a subtle grid pattern
+    g.setColour(deckBackground.gridColour);
+    for (int x = 0; x < getWidth(); x += deckBackground.gridSpacing) {
+        g.drawLine(x, 0, x, getHeight(), 0.5f);
+    }
+    for (int y = 0; y < getHeight(); y += deckBackground.gridSpacing) {
+        g.drawLine(0, y, getWidth(), y, 0.5f);
+    }
+
+    // Draw a glowing border
+    auto area = getLocalBounds().toFloat();
+    g.setColour(deckBackground.borderColour);
+    g.drawRoundedRectangle(area.reduced(deckBackground.borderInset), deckBackground.cornerSize, deckBackground.borderThickness);
+    
+    // Add a subtle pulsing effect, it moves while the deck is playing
+    g.setColour(deckBackground.pulseColour.withAlpha(WaveformRenderer::DeckBackground::getPulseAlpha()));
+    g.drawRoundedRectangle(area.reduced(deckBackground.pulseInset), deckBackground.cornerSize, deckBackground.pulseThickness);
+}
+
+// Position
+void DeckGUI::resized()
+{
+    double rowH = getHeight() / 12;
+    double width = getWidth();
+
+    double buttonWidth = width / 6;
+    double buttonHeight = rowH;
+    
+    // Set bounds of buttons
+    playButton.setBounds(0, 0, buttonWidth, buttonHeight);
+    stopButton.setBounds(buttonWidth, 0, buttonWidth, buttonHeight);
+    loadButton.setBounds(buttonWidth * 2, 0, buttonWidth, buttonHeight);
+    keyLockButton.setBounds(buttonWidth * 3, 0, buttonWidth, buttonHeight);
+    syncButton.setBounds(buttonWidth * 4, 0, buttonWidth, buttonHeight);
+    masterButton.setBounds(buttonWidth * 5, 0, buttonWidth, buttonHeight);
+
+    // Effect buttons split the second row evenly
+    double effectButtonWidth = width / EffectChain::numEffects;
+    for (int i = 0; i < EffectChain::numEffects; ++i)
+        effectButtons[i].setBounds(effectButtonWidth * i, rowH, effectButtonWidth, buttonHeight);
+    
+    // Close-up above the whole-track overview
+    scrollingWaveform.setBounds(0, rowH * 2, width, rowH * 2);
+    waveformDisplay.setBounds(0, rowH * 4, width, rowH);
+
+    // Position slider
+    double posSliderHeight = rowH * 1.5;
+    posSlider.setBounds(0, rowH * 5, width, posSliderHeight);
+    posLabel.setBounds(0, posSlider.getBottom() + 5, width, 20);
+
+    // Calculate positions for all rotary controls and position them
+    double sliderWidth = width / 5;
+    double sliderHeight = rowH * 3;
+    double sliderTop = rowH * 7;
+    double padding = width / 20;
+    double x = padding;
+    
+    // Volume slider
+    volSlider.setBounds(x, sliderTop, sliderWidth, sliderHeight);
+    volLabel.setBounds(volSlider.getX(), volSlider.getBottom() + 5, sliderWidth, 20);
+    x += sliderWidth + padding;
+    
+    // Speed slider
+    speedSlider.setBounds(x, sliderTop, sliderWidth, sliderHeight);
+    speedLabel.setBounds(speedSlider.getX(), speedSlider.getBottom() + 5, sliderWidth, 20);
+    keyLockQualityBox.setBounds(speedSlider.getX(), speedLabel.getBottom() + 5, sliderWidth, 20);
+    x += sliderWidth + padding;
+    
+    // Wet/dry slider
+    wetDrySlider.setBounds(x - 50, sliderTop, sliderWidth, sliderHeight);
+    wetDryLabel.setBounds(wetDrySlider.getX(), wetDrySlider.getBottom() + 5, sliderWidth, 20);
+    x += sliderWidth + padding;
+    
+    // First effect parameter slider
+    paramOneSlider.setBounds(x-82, sliderTop, sliderWidth, sliderHeight);
+    paramOneLabel.setBounds(paramOneSlider.getX(), paramOneSlider.getBottom() + 5, sliderWidth, 20);
+    x += sliderWidth + padding;
+    
+    // Second effect parameter slider
+    paramTwoSlider.setBounds(x-130, sliderTop, sliderWidth, sliderHeight);
+    paramTwoLabel.setBounds(paramTwoSlider.getX(), paramTwoSlider.getBottom() + 5, sliderWidth, 20);
+    x += sliderWidth + padding;
+    
+    // Show/hide effect controls based on whether the edited effect is active or not
+    updateEffectControls();
+}
+
+// Loads the edited effect's settings into the shared sliders without sending them back
+void DeckGUI::editEffect(EffectChain::EffectId id)
+{
+    auto& effects = player->getEffects();
+    editedEffect = id;
+
+    String paramOneName, paramTwoName;
+    double paramOneValue = 0, paramTwoValue = 0;
+
+    switch (id)
+    {
+        case EffectChain::filter:
+            paramOneName = "SWEEP";
+            paramTwoName = "RESONANCE";
+            paramOneSlider.setRange(-1.0, 1.0);
+            paramTwoSlider.setRange(0.5, 5.0);
+            paramOneSlider.textFromValueFunction = [](double value) { return (value < 0 ? "LP " : "HP ") + String(std::abs(value) * 100, 0) + "%"; };
+            paramTwoSlider.textFromValueFunction = [](double value) { return String(value, 2); };
+            paramOneValue = effects.getFilter().getSweep();
+            paramTwoValue = effects.getFilter().getResonance();
+            break;
+
+        case EffectChain::delay:
+            paramOneName = "TIME";
+            paramTwoName = "FEEDBACK";
+            paramOneSlider.setRange(0.05, DelayEffect::maxDelayTime);
+            paramTwoSlider.setRange(0.0, 0.95);
+            paramOneSlider.textFromValueFunction = [](double value) { return String(value, 2) + "s"; };
+            paramTwoSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
+            paramOneValue = effects.getDelay().getDelayTime();
+            paramTwoValue = effects.getDelay().getFeedback();
+            break;
+
+        case EffectChain::reverb:
+            paramOneName = "ROOM SIZE";
+            paramTwoName = "DAMPING";
+            paramOneSlider.setRange(0.0, 1.0);
+            paramTwoSlider.setRange(0.0, 1.0);
+            paramOneSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
+            paramTwoSlider.textFromValueFunction = [](double value) { return String(value * 100, 1) + "%"; };
+            paramOneValue = effects.getReverb().getRoomSize();
+            paramTwoValue = effects.getReverb().getDamping();
+            break;
+
+        case EffectChain::bitcrusher:
+        default:
+            paramOneName = "BITS";
+            paramTwoName = "DOWNSAMPLE";
+            paramOneSlider.setRange(2.0, 16.0);
+            paramTwoSlider.setRange(1.0, 32.0);
+            paramOneSlider.textFromValueFunction = [](double value) { return String(value, 1); };
+            paramTwoSlider.textFromValueFunction = [](double value) { return "x" + String(value, 1); };
+            paramOneValue = effects.getBitcrusher().getBitDepth();
+            paramTwoValue = effects.getBitcrusher().getDownsampleFactor();
+            break;
+    }
+
+    paramOneLabel.setText(paramOneName, dontSendNotification);
+    paramTwoLabel.setText(paramTwoName, dontSendNotification);
+
+    wetDrySlider.setValue(effects.getEffect(id).getWetDryMix(), dontSendNotification);
+    paramOneSlider.setValue(paramOneValue, dontSendNotification);
+    paramTwoSlider.setValue(paramTwoValue, dontSendNotification);
+
+    // Text boxes only pick up a new textFromValueFunction when the value is redrawn
+    paramOneSlider.updateText();
+    paramTwoSlider.updateText();
+
+    updateEffectControls();
+}
+
+void DeckGUI::updateEffectControls()
+{
+    static const char* const effectNames[EffectChain::numEffects] = { "FILTER", "DELAY", "REVERB", "CRUSH" };
+    auto& effects = player->getEffects();
+
+    for (int i = 0; i < EffectChain::numEffects; ++i)
+    {
+        bool isActive = effects.getEffect((EffectChain::EffectId) i).getActive();
+        effectButtons[i].setButtonText(String(effectNames[i]) + (isActive ? " ON" : " OFF"));
+    }
+
+    showEffectControls = effects.getEffect(editedEffect).getActive();
+
+    wetDrySlider.setVisible(showEffectControls);
+    paramOneSlider.setVisible(showEffectControls);
+    paramTwoSlider.setVisible(showEffectControls);
+    wetDryLabel.setVisible(showEffectControls);
+    paramOneLabel.setVisible(showEffectControls);
+    paramTwoLabel.setVisible(showEffectControls);
+}
+
+// Handles button clicked events
+void DeckGUI::buttonClicked(Button* button)
+{
+    if (button == &playButton)
+    {
+        std::cout << "Play button was clicked " << std::endl;
+        player->start();
+    }
+     if (button == &stopButton)
+    {
+        std::cout << "Stop button was clicked " << std::endl;
+        player->stop();
+
+    }
+    if (button == &loadButton)
+    {
+        auto fileChooserFlags = 
+        FileBrowserComponent::canSelectFiles;
+        fChooser.launchAsync(fileChooserFlags, [this](const FileChooser& chooser)
+        {
+            // Waveform is updated once the player reports the track has loaded
+            loadTrack(URL{chooser.getResult()});
+        });
+        
+    }
+    
+    if (button == &keyLockButton)
+    {
+        bool isKeyLocked = ! player->isKeyLocked();
+        player->setKeyLock(isKeyLocked);
+        keyLockButton.setButtonText(isKeyLocked ? "KEY LOCK ON" : "KEY LOCK OFF");
+    }
+
+    // A deck either leads the master clock or follows it
+    if (button == &syncButton)
+    {
+        bool isSynced = ! player->isSyncEnabled();
+        player->setSyncEnabled(isSynced);
+
+        if (isSynced)
+            player->setTempoMaster(false);
+
+        updateSyncButtons();
+    }
+
+    if (button == &masterButton)
+    {
+        bool isMaster = ! player->isTempoMaster();
+        player->setTempoMaster(isMaster);
+
+        if (isMaster)
+            player->setSyncEnabled(false);
+
+        updateSyncButtons();
+    }
+
+    for (int i = 0; i < EffectChain::numEffects; ++i)
+    {
+        if (button == &effectButtons[i])
+        {
+            auto id = (EffectChain::EffectId) i;
+            auto& effect = player->getEffects().getEffect(id);
+            bool isActive = ! effect.getActive();
+            effect.setActive(isActive);
+
+            // Switching an effect on brings up its controls, switching the edited
+            // one off moves the controls to another effect that is still on
+            if (isActive)
+            {
+                editEffect(id);
+            }
+            else if (id == editedEffect)
+            {
+                for (int other = 0; other < EffectChain::numEffects; ++other)
+                {
+                    if (player->getEffects().getEffect((EffectChain::EffectId) other).getActive())
+                    {
+                        editEffect((EffectChain::EffectId) other);
+                        break;
+                    }
+                }
+            }
+
+            updateEffectControls();
+        }
+    }
+}
+
+// Handles slider value changes
+void DeckGUI::sliderValueChanged (Slider *slider)
+{
+    if (slider == &volSlider)
+    {
+        player->setGain(slider->getValue());
+    }
+
+    if (slider == &speedSlider)
+    {
+        player->setSpeed(slider->getValue());
+    }
+    
+    if (slider == &posSlider)
+    {
+        player->setPositionRelative(slider->getValue());
+    }
+    if (slider == &wetDrySlider)
+    {
+        player->getEffects().getEffect(editedEffect).setWetDryMix(slider->getValue());
+    }
+    if (slider == &paramOneSlider || slider == &paramTwoSlider)
+    {
+        auto& effects = player->getEffects();
+        auto value = (float) slider->getValue();
+        bool isFirst = slider == &paramOneSlider;
+
+        switch (editedEffect)
+        {
+            case EffectChain::filter:
+                if (isFirst) effects.getFilter().setSweep(value);
+                else         effects.getFilter().setResonance(value);
+                break;
+
+            case EffectChain::delay:
+                if (isFirst) effects.getDelay().setDelayTime(value);
+                else         effects.getDelay().setFeedback(value);
+                break;
+
+            case EffectChain::reverb:
+                if (isFirst) effects.getReverb().setRoomSize(value);
+                else         effects.getReverb().setDamping(value);
+                break;
+
+            case EffectChain::bitcrusher:
+            default:
+                if (isFirst) effects.getBitcrusher().setBitDepth(value);
+                else         effects.getBitcrusher().setDownsampleFactor(value);
+                break;
+        }
+    }
+    
+}
+
+void DeckGUI::comboBoxChanged (ComboBox *comboBox)
+{
+    if (comboBox == &keyLockQualityBox)
+    {
+        player->setKeyLockQuality((TimeStretchAudioSource::Quality) (comboBox->getSelectedId() - 1));
+    }
+}
+
+// Handles file drag and drop events
+bool DeckGUI::isInterestedInFileDrag (const StringArray &files)
+{
+  std::cout << "DeckGUI::isInterestedInFileDrag" << std::endl;
+  return true; 
+}
+
+void DeckGUI::filesDropped (const StringArray &files, int x, int y)
+{
+  std::cout << "DeckGUI::filesDropped" << std::endl;
+  if (files.size() == 1)
+  {
+    loadTrack(URL{File{files[0]}});
+  }
+}
+
+void DeckGUI::loadTrack(const URL& url)
+{
+    player->loadURL(url, findBeatGrid != nullptr ? findBeatGrid(url) : BeatGrid());
+}
+
+// Updates waveform playhead positions and the pulsing border
+bool DeckGUI::refreshFrame()
+{
+    updateSyncButtons();
+
+    auto position = player->getPositionRelative();
+    auto length = player->getLengthInSeconds();
+    auto playing = player->isPlaying();
+
+    waveformDisplay.setPositionRelative(position);
+    scrollingWaveform.setPlayheadPosition(position * length);
+
+    // The renderer's thread reads these rather than the player
+    playhead.position = position;
+    playhead.lengthInSeconds = length;
+    playhead.playing = playing;
+
+    if (! playing)
+        return scrollingWaveform.isBuilding();
+
+    // The renderer animates the pulse itself, keeping the frames coming is enough
+    if (waveformRenderer != nullptr)
+        return true;
+
+    // Only the ring the pulse is drawn in, not the controls inside it
+    RectangleList<int> pulseArea (getLocalBounds().reduced(2));
+    pulseArea.subtract(getLocalBounds().reduced(5));
+
+    for (auto& area : pulseArea)
+        refreshScheduler.invalidate(*this, area);
+
+    return true;
+}
+
+void DeckGUI::updateSyncButtons()
+{
+    syncButton.setButtonText(player->isSyncEnabled() ? "SYNC ON" : "SYNC OFF");
+    masterButton.setButtonText(player->isTempoMaster() ? "MASTER ON" : "MASTER OFF");
+}
+
+void DeckGUI::useOpenGLRenderer(WaveformRenderer& renderer)
+{
+    waveformRenderer = &renderer;
+    renderer.addDeck(*this, playhead, deckBackground, waveformDisplay, scrollingWaveform,
+                     waveformColour, waveformBackground, playheadColour);
+    repaint();
+}
+
+// Shows loading progress on the load button
+void DeckGUI::trackLoadProgress(DJAudioPlayer* /*player*/, float progress)
+{
+    loadButton.setButtonText("LOADING " + String(roundToInt(progress * 100.0f)) + "%");
+}
+
+// Updates the waveform once the track is ready to play
+void DeckGUI::trackLoaded(DJAudioPlayer* /*player*/, const URL& url, bool success)
+{
+    loadButton.setButtonText("LOAD");
+
+    if (success)
+    {
+        waveformDisplay.loadURL(url);
+        scrollingWaveform.loadURL(url);
+    }
+}
+
+
+
+    
+
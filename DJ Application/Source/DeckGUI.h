@@ -1,71 +1,129 @@
-#pragma once
-
-#include "../JuceLibraryCode/JuceHeader.h"
-#include "DJAudioPlayer.h"
-#include "WaveformDisplay.h"
-
-// Class that manages user interface
-class DeckGUI    : public Component,
-                   public Button::Listener, 
-                   public Slider::Listener, 
-                   public FileDragAndDropTarget, 
-                   public Timer
-{
-public:
-    // Constructor that intialises deck gui
-    DeckGUI(DJAudioPlayer* player,
-           AudioFormatManager & 	formatManagerToUse,
-           AudioThumbnailCache & 	cacheToUse );
-    ~DeckGUI();
-
-    void paint (Graphics&) override;
-    void resized() override;
-
-    // Implement button listener
-    void buttonClicked (Button *) override;
-
-    // Implement slider listener
-    void sliderValueChanged (Slider *slider) override;
-
-    // Implements file drag and drop
-    bool isInterestedInFileDrag (const StringArray &files) override;
-    void filesDropped (const StringArray &files, int x, int y) override; 
-
-    void timerCallback() override; 
-
-private:
-
-    // Playback controls
-    TextButton playButton{"PLAY"};
-    TextButton stopButton{"STOP"};
-    TextButton loadButton{"LOAD"};
-  
-    Slider volSlider;
-    Slider speedSlider;
-    Slider posSlider;
-
-    // Labels
-    Label volLabel;
-    Label speedLabel;
-    Label posLabel;
-    
-    // Reverb effect controls
-    TextButton reverbButton{"REVERB OFF"};
-    Slider wetDrySlider;
-    Slider roomSizeSlider;
-    Slider dampingSlider;
-       
-    // Labels
-    Label wetDryLabel;
-    Label roomSizeLabel;
-    Label dampingLabel;
-    
-    FileChooser fChooser{"Select a file..."};
-
-    WaveformDisplay waveformDisplay;
-
-    // Pointer to the DJAudioPlayer instance
-    DJAudioPlayer* player;
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DeckGUI)
-};
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DJAudioPlayer.h"
+#include "RefreshScheduler.h"
+#include "ScrollingWaveformDisplay.h"
+#include "WaveformDisplay.h"
+#include "WaveformRenderer.h"
+
+// Class that manages user interface
+class DeckGUI    : public Component,
+                   public Button::Listener, 
+                   public Slider::Listener, 
+                   public ComboBox::Listener,
+                   public FileDragAndDropTarget, 
+                   public RefreshScheduler::Client,
+                   public DJAudioPlayer::Listener
+{
+public:
+    // Constructor that intialises deck gui
+    DeckGUI(DJAudioPlayer* player,
+           AudioFormatManager & 	formatManagerToUse,
+           PersistentThumbnailCache & 	cacheToUse,
+           ThreadPool & 	analysisPool,
+           RefreshScheduler & 	refreshScheduler );
+    ~DeckGUI();
+
+    void paint (Graphics&) override;
+    void resized() override;
+
+    // Implement button listener
+    void buttonClicked (Button *) override;
+
+    // Implement slider listener
+    void sliderValueChanged (Slider *slider) override;
+
+    // Implement combo box listener
+    void comboBoxChanged (ComboBox *comboBox) override;
+
+    // Implements file drag and drop
+    bool isInterestedInFileDrag (const StringArray &files) override;
+    void filesDropped (const StringArray &files, int x, int y) override; 
+
+    // Moves the playheads and the border pulse, animating while the track plays
+    bool refreshFrame() override;
+
+    // Implement player listener
+    void trackLoadProgress(DJAudioPlayer* player, float progress) override;
+    void trackLoaded(DJAudioPlayer* player, const URL& url, bool success) override;
+
+    // Hands the deck's background and both waveform views to a shared OpenGL renderer
+    void useOpenGLRenderer(WaveformRenderer& renderer);
+
+    // Beats for a file loaded with the load button or dropped on the deck, so it can sync
+    std::function<BeatGrid (const URL&)> findBeatGrid;
+
+private:
+    // Loads a file chosen or dropped on the deck, with its beats if they are known
+    void loadTrack(const URL& url);
+
+    // Points the shared sliders at an effect and loads its settings
+    void editEffect(EffectChain::EffectId id);
+
+    // Shows the sliders only while the edited effect is on
+    void updateEffectControls();
+
+    // Another deck taking the lead changes this one's master button, so it is polled too
+    void updateSyncButtons();
+
+    // Playback controls
+    TextButton playButton{"PLAY"};
+    TextButton stopButton{"STOP"};
+    TextButton loadButton{"LOAD"};
+    TextButton keyLockButton{"KEY LOCK OFF"};
+    TextButton syncButton{"SYNC OFF"};
+    TextButton masterButton{"MASTER OFF"};
+
+    // Key lock quality tier, cheaper tiers leave room for more decks
+    ComboBox keyLockQualityBox;
+  
+    Slider volSlider;
+    Slider speedSlider;
+    Slider posSlider;
+
+    // Labels
+    Label volLabel;
+    Label speedLabel;
+    Label posLabel;
+    
+    // One on/off button per effect in the chain
+    TextButton effectButtons[EffectChain::numEffects];
+
+    // Controls for the effect being edited, shared by all effects
+    Slider wetDrySlider;
+    Slider paramOneSlider;
+    Slider paramTwoSlider;
+       
+    // Labels
+    Label wetDryLabel;
+    Label paramOneLabel;
+    Label paramTwoLabel;
+
+    // Effect the sliders are currently showing
+    EffectChain::EffectId editedEffect = EffectChain::reverb;
+    bool showEffectControls = false;
+    
+    FileChooser fChooser{"Select a file..."};
+
+    WaveformDisplay waveformDisplay;
+
+    // Zoomable close-up around the playhead
+    ScrollingWaveformDisplay scrollingWaveform;
+
+    // Colours the waveform views are drawn with, kept for the OpenGL renderer
+    Colour waveformColour, waveformBackground, playheadColour;
+
+    // Draws the background and waveform views when set, so paint has nothing to do
+    WaveformRenderer* waveformRenderer = nullptr;
+
+    // Where the renderer draws the playheads, published every frame
+    WaveformRenderer::Playhead playhead;
+
+    RefreshScheduler& refreshScheduler;
+
+    // Pointer to the DJAudioPlayer instance
+    DJAudioPlayer* player;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DeckGUI)
+};
@@ -0,0 +1,77 @@
+#include "DelayEffect.h"
+
+DelayEffect::DelayEffect()
+: DJAudioEffect(true)
+{
+}
+
+DelayEffect::~DelayEffect()
+{
+}
+
+// Configures delay effect
+void DelayEffect::prepare(double sampleRate, int samplesPerBlock)
+{
+    currentSampleRate = sampleRate;
+    delayLine.setSize(2, (int) std::ceil(maxDelayTime * sampleRate) + 2);
+
+    smoothedDelaySamples.reset(sampleRate, 0.2);
+    smoothedDelaySamples.setCurrentAndTargetValue((float) (delayTime.load() * sampleRate));
+    smoothedFeedback.reset(sampleRate, 0.05);
+    smoothedFeedback.setCurrentAndTargetValue(feedback.load());
+}
+
+void DelayEffect::reset()
+{
+    delayLine.clear();
+    writePosition = 0;
+}
+
+// Applies delay effect
+void DelayEffect::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    smoothedDelaySamples.setTargetValue((float) (delayTime.load() * currentSampleRate));
+    smoothedFeedback.setTargetValue(feedback.load());
+
+    auto numChannels = juce::jmin(2, buffer.getNumChannels());
+    auto lineLength = delayLine.getNumSamples();
+    float* channelData[2] = { buffer.getWritePointer(0, startSample), buffer.getWritePointer(numChannels - 1, startSample) };
+    float* lineData[2] = { delayLine.getWritePointer(0), delayLine.getWritePointer(1) };
+
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        auto delaySamples = smoothedDelaySamples.getNextValue();
+        auto amount = smoothedFeedback.getNextValue();
+
+        // Linear interpolation between the two samples either side of the read position
+        auto readPosition = (float) writePosition - delaySamples;
+        if (readPosition < 0.0f)
+            readPosition += (float) lineLength;
+
+        auto index = (int) readPosition;
+        auto fraction = readPosition - (float) index;
+        auto nextIndex = index + 1 < lineLength ? index + 1 : 0;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto delayed = lineData[channel][index] + fraction * (lineData[channel][nextIndex] - lineData[channel][index]);
+            lineData[channel][writePosition] = channelData[channel][sample] + delayed * amount;
+            channelData[channel][sample] = delayed;
+        }
+
+        if (++writePosition >= lineLength)
+            writePosition = 0;
+    }
+}
+
+// Sets delay time
+void DelayEffect::setDelayTime(float seconds)
+{
+    delayTime = juce::jlimit(0.05f, maxDelayTime, seconds);
+}
+
+// Sets feedback amount
+void DelayEffect::setFeedback(float amount)
+{
+    feedback = juce::jlimit(0.0f, 0.95f, amount);
+}
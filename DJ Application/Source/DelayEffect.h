@@ -0,0 +1,45 @@
+#pragma once
+
+#include "DJAudioEffect.h"
+
+// Feedback echo, the delay line is allocated once for the longest delay time
+class DelayEffect : public DJAudioEffect
+{
+public:
+    DelayEffect();
+    ~DelayEffect() override;
+
+    static constexpr float maxDelayTime = 2.0f;
+
+    // Set the delay time in seconds (0.05 to 2.0)
+    void setDelayTime(float seconds);
+    float getDelayTime() const { return delayTime.load(); }
+
+    // Set how much of the echo is fed back (0.0 to 0.95)
+    void setFeedback(float amount);
+    float getFeedback() const { return feedback.load(); }
+
+protected:
+    // Prepare the delay line for playback
+    void prepare(double sampleRate, int samplesPerBlock) override;
+
+    // Replaces a range of the buffer with the echoes
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) override;
+
+    void reset() override;
+
+    // Every slot of the line has to have been read back quiet
+    int getQuietSamplesBeforeIdle() const override { return delayLine.getNumSamples(); }
+
+private:
+    juce::AudioBuffer<float> delayLine;
+    int writePosition = 0;
+    double currentSampleRate = 44100.0;
+
+    // Ramped on the audio thread so changing the time glides instead of clicking
+    juce::SmoothedValue<float> smoothedDelaySamples, smoothedFeedback;
+
+    // Written by the GUI, applied at the start of the next block
+    std::atomic<float> delayTime { 0.375f };
+    std::atomic<float> feedback { 0.4f };
+};
@@ -0,0 +1,64 @@
+#include "EffectChain.h"
+
+// Filter first so the echoes and reverb tail follow the sweep, crusher last
+EffectChain::EffectChain()
+: effects { { &filterEffect, &delayEffect, &reverbEffect, &bitcrusherEffect } },
+  packedOrder(packOrder({ { filter, delay, reverb, bitcrusher } }))
+{
+    filterEffect.setWetDryMix(1.0f);
+    delayEffect.setWetDryMix(0.5f);
+    reverbEffect.setWetDryMix(0.5f);
+    bitcrusherEffect.setWetDryMix(1.0f);
+}
+
+void EffectChain::prepare(double sampleRate, int samplesPerBlock)
+{
+    for (auto* effect : effects)
+        effect->prepareToPlay(sampleRate, samplesPerBlock);
+}
+
+void EffectChain::process(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto order = unpackOrder(packedOrder.load());
+
+    for (auto id : order)
+        effects[(size_t) id]->processBlock(buffer, startSample, numSamples);
+}
+
+void EffectChain::setOrder(const Order& newOrder)
+{
+    // Each effect exactly once, or one of them would run twice and another never
+    uint32 seen = 0;
+    for (auto id : newOrder)
+        seen |= 1u << id;
+
+    jassert (seen == (1u << numEffects) - 1);
+
+    if (seen == (1u << numEffects) - 1)
+        packedOrder = packOrder(newOrder);
+}
+
+EffectChain::Order EffectChain::getOrder() const
+{
+    return unpackOrder(packedOrder.load());
+}
+
+uint32 EffectChain::packOrder(const Order& order)
+{
+    uint32 packed = 0;
+
+    for (size_t slot = 0; slot < order.size(); ++slot)
+        packed |= (uint32) order[slot] << (slot * 4);
+
+    return packed;
+}
+
+EffectChain::Order EffectChain::unpackOrder(uint32 packed)
+{
+    Order order;
+
+    for (size_t slot = 0; slot < order.size(); ++slot)
+        order[slot] = (EffectId) ((packed >> (slot * 4)) & 0xf);
+
+    return order;
+}
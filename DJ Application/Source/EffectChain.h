@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "FilterEffect.h"
+#include "DelayEffect.h"
+#include "ReverbEffect.h"
+#include "BitcrusherEffect.h"
+
+// Per-deck chain of effects. Every effect is a member, so toggling or reordering them
+// from the GUI never allocates, and idle effects are skipped without a virtual call
+class EffectChain
+{
+public:
+    enum EffectId
+    {
+        filter = 0,
+        delay,
+        reverb,
+        bitcrusher,
+        numEffects
+    };
+
+    using Order = std::array<EffectId, numEffects>;
+
+    EffectChain();
+
+    // Prepares every effect, call before playback starts
+    void prepare(double sampleRate, int samplesPerBlock);
+
+    // Runs the active effects in order on a range of the buffer, audio thread only
+    void process(AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // Processing order, each effect must appear exactly once. Safe from any thread
+    void setOrder(const Order& newOrder);
+    Order getOrder() const;
+
+    DJAudioEffect& getEffect(EffectId id) { return *effects[(size_t) id]; }
+    const DJAudioEffect& getEffect(EffectId id) const { return *effects[(size_t) id]; }
+
+    FilterEffect& getFilter() { return filterEffect; }
+    DelayEffect& getDelay() { return delayEffect; }
+    ReverbEffect& getReverb() { return reverbEffect; }
+    BitcrusherEffect& getBitcrusher() { return bitcrusherEffect; }
+
+private:
+    // Four bits per slot, read by the audio thread once per block
+    static uint32 packOrder(const Order& order);
+    static Order unpackOrder(uint32 packed);
+
+    FilterEffect filterEffect;
+    DelayEffect delayEffect;
+    ReverbEffect reverbEffect;
+    BitcrusherEffect bitcrusherEffect;
+
+    const std::array<DJAudioEffect*, numEffects> effects;
+    std::atomic<uint32> packedOrder;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EffectChain)
+};
@@ -0,0 +1,84 @@
+#include "FilterEffect.h"
+
+FilterEffect::FilterEffect()
+{
+}
+
+FilterEffect::~FilterEffect()
+{
+}
+
+// Configures filter effect
+void FilterEffect::prepare(double sampleRate, int samplesPerBlock)
+{
+    currentSampleRate = sampleRate;
+    smoothedSweep.reset(sampleRate, 0.05);
+    smoothedSweep.setCurrentAndTargetValue(sweep.load());
+    updateCoefficients(smoothedSweep.getCurrentValue(), resonance.load());
+}
+
+void FilterEffect::reset()
+{
+    for (auto& filter : filters)
+        filter.reset();
+}
+
+// Cutoff moves exponentially so the sweep sounds even across the knob
+void FilterEffect::updateCoefficients(float position, float q)
+{
+    auto nyquist = currentSampleRate * 0.45;
+    juce::IIRCoefficients coefficients;
+
+    if (position <= 0.0f)
+        coefficients = juce::IIRCoefficients::makeLowPass(currentSampleRate, juce::jmin(nyquist, 20000.0 * std::pow(0.001, (double) -position)), q);
+    else
+        coefficients = juce::IIRCoefficients::makeHighPass(currentSampleRate, juce::jmin(nyquist, 20.0 * std::pow(1000.0, (double) position)), q);
+
+    for (auto& filter : filters)
+        filter.setCoefficients(coefficients);
+
+    coefficientSweep = position;
+    coefficientResonance = q;
+}
+
+// Applies filter effect
+void FilterEffect::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    smoothedSweep.setTargetValue(sweep.load());
+    auto q = resonance.load();
+
+    if (! smoothedSweep.isSmoothing())
+    {
+        if (smoothedSweep.getTargetValue() != coefficientSweep || q != coefficientResonance)
+            updateCoefficients(smoothedSweep.getTargetValue(), q);
+
+        for (int channel = 0; channel < juce::jmin(2, buffer.getNumChannels()); ++channel)
+            filters[channel].processSamples(buffer.getWritePointer(channel, startSample), numSamples);
+
+        return;
+    }
+
+    // Recalculating every sample is wasteful, every 32 is smooth enough
+    const int stepSize = 32;
+
+    for (int offset = 0; offset < numSamples; offset += stepSize)
+    {
+        auto stepLength = juce::jmin(stepSize, numSamples - offset);
+        updateCoefficients(smoothedSweep.skip(stepLength), q);
+
+        for (int channel = 0; channel < juce::jmin(2, buffer.getNumChannels()); ++channel)
+            filters[channel].processSamples(buffer.getWritePointer(channel, startSample + offset), stepLength);
+    }
+}
+
+// Sets sweep position
+void FilterEffect::setSweep(float position)
+{
+    sweep = juce::jlimit(-1.0f, 1.0f, position);
+}
+
+// Sets filter resonance
+void FilterEffect::setResonance(float q)
+{
+    resonance = juce::jlimit(0.5f, 5.0f, q);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "DJAudioEffect.h"
+
+// Single-knob DJ filter: turning left sweeps a low-pass down, turning right sweeps a high-pass up
+class FilterEffect : public DJAudioEffect
+{
+public:
+    FilterEffect();
+    ~FilterEffect() override;
+
+    // Set the sweep position (-1.0 = low-pass closed, 0.0 = open, 1.0 = high-pass closed)
+    void setSweep(float position);
+    float getSweep() const { return sweep.load(); }
+
+    // Set the resonance of the filter (0.5 to 5.0)
+    void setResonance(float q);
+    float getResonance() const { return resonance.load(); }
+
+protected:
+    // Prepare the filter for playback
+    void prepare(double sampleRate, int samplesPerBlock) override;
+
+    // Replaces a range of the buffer with the filtered signal
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) override;
+
+    void reset() override;
+
+private:
+    // Recalculates the coefficients for the current sweep position
+    void updateCoefficients(float position, float q);
+
+    juce::IIRFilter filters[2];
+    double currentSampleRate = 44100.0;
+
+    // Ramped on the audio thread, coefficients follow it in short steps
+    juce::SmoothedValue<float> smoothedSweep;
+    float coefficientSweep = 0.0f, coefficientResonance = 0.0f;
+
+    // Written by the GUI, applied at the start of the next block
+    std::atomic<float> sweep { 0.0f };
+    std::atomic<float> resonance { 0.7f };
+};
@@ -1,79 +1,117 @@
-#include "MainComponent.h"
-
-// Initialises main component
-MainComponent::MainComponent()
-{
-    setSize (800, 600);
-    if (RuntimePermissions::isRequired (RuntimePermissions::recordAudio)
-        && ! RuntimePermissions::isGranted (RuntimePermissions::recordAudio))
-    {
-        RuntimePermissions::request (RuntimePermissions::recordAudio,
-                                     [&] (bool granted) { if (granted)  setAudioChannels (2, 2); });
-    }  
-    else
-    {
-        setAudioChannels (0, 2);
-    }  
-
-    // Add GUI and playlist component
-    addAndMakeVisible(deckGUI1);
-    addAndMakeVisible(deckGUI2);
-    
-    addAndMakeVisible(playlistComponent);
-    
-    // Register audio file formate
-    formatManager.registerBasicFormats();
-}
-
-MainComponent::~MainComponent()
-{
-    shutdownAudio();
-}
-
-// Prepares to play, gets next audio source and relases resources
-void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
-{
-    player1.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    player2.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    
-    mixerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-    mixerSource.addInputSource(&player1, false);
-    mixerSource.addInputSource(&player2, false);
-
- }
-void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
-{
-    mixerSource.getNextAudioBlock(bufferToFill);
-}
-
-void MainComponent::releaseResources()
-{
-    player1.releaseResources();
-    player2.releaseResources();
-    mixerSource.releaseResources();
-}
-
-// Handles background rendering
-void MainComponent::paint (Graphics& g)
-{
-    g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
-
-    g.setColour(Colours::white);
-    g.setFont(14.0f);
-    
-}
-
-// Handles layout of components
-void MainComponent::resized()
-{
-    int margin = 20;
-    int playlistHeight = getHeight() / 3;
-
-    deckGUI1.setBounds(0, 0, getWidth() / 2, getHeight() - playlistHeight - margin);
-    deckGUI2.setBounds(getWidth() / 2, 0, getWidth() / 2, getHeight() - playlistHeight - margin);
-
-    playlistComponent.setBounds(0, getHeight() - playlistHeight, getWidth(), playlistHeight);
-}
-
-
+#include "MainComponent.h"
+
+// Initialises main component
+MainComponent::MainComponent()
+{
+    setSize (800, 600);
+    if (RuntimePermissions::isRequired (RuntimePermissions::recordAudio)
+        && ! RuntimePermissions::isGranted (RuntimePermissions::recordAudio))
+    {
+        RuntimePermissions::request (RuntimePermissions::recordAudio,
+                                     [&] (bool granted) { if (granted)  setAudioChannels (2, 2); });
+    }  
+    else
+    {
+        setAudioChannels (0, 2);
+    }  
+
+    // Add GUI and playlist component
+    for (int i = 0; i < deckEngine.getNumDecks(); ++i)
+        addAndMakeVisible(deckGUIs.add(new DeckGUI(deckEngine.getDeck(i), formatManager, thumbCache, analysisPool, refreshScheduler)));
+    
+    addAndMakeVisible(playlistComponent);
+
+    // Tracks loaded straight onto a deck get their beats from the library too
+    for (auto* deckGUI : deckGUIs)
+        deckGUI->findBeatGrid = [this](const URL& url) { return playlistComponent.findBeatGrid(url); };
+    addAndMakeVisible(performanceMeter);
+
+    // Decks hand their waveform views to the renderer. It draws on every scheduler frame
+    // while something plays, and only when a component changes otherwise
+    for (auto* deckGUI : deckGUIs)
+        deckGUI->useOpenGLRenderer(waveformRenderer);
+
+    openGLContext.setRenderer(&waveformRenderer);
+    openGLContext.setContinuousRepainting(false);
+    openGLContext.attachTo(*this);
+    refreshScheduler.addClient(this);
+
+    // Always on, it only costs a few timer reads per deck
+    deckEngine.setProfiler(&audioProfiler);
+    
+    // Register audio file formate
+    formatManager.registerBasicFormats();
+
+    // Decks check the decoded cache before going to the file
+    trackCache.setMemoryBudget((int64) 1024 * 1024 * 1024);
+    trackLoader.setTrackCache(&trackCache);
+
+    // Start the disk reader used by every deck
+    diskThread.startThread(3);
+}
+
+MainComponent::~MainComponent()
+{
+    refreshScheduler.removeClient(this);
+    openGLContext.detach();
+    waveformRenderer.clearDecks();
+    shutdownAudio();
+    deckEngine.setProfiler(nullptr);
+    deckGUIs.clear();
+    diskThread.stopThread(2000);
+}
+
+// Prepares to play, gets next audio source and relases resources
+void MainComponent::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    deckEngine.prepareToPlay(samplesPerBlockExpected, sampleRate);
+ }
+void MainComponent::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    deckEngine.getNextAudioBlock(bufferToFill);
+}
+
+void MainComponent::releaseResources()
+{
+    deckEngine.releaseResources();
+}
+
+bool MainComponent::refreshFrame()
+{
+    if (refreshScheduler.isActive())
+        openGLContext.triggerRepaint();
+
+    return false;
+}
+
+// Handles background rendering
+void MainComponent::paint (Graphics& g)
+{
+    waveformRenderer.excludeViewsFromClip(g, *this);
+    g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
+
+    g.setColour(Colours::white);
+    g.setFont(14.0f);
+    
+}
+
+// Handles layout of components
+void MainComponent::resized()
+{
+    int margin = 20;
+    int playlistHeight = getHeight() / 3;
+
+    // Decks side by side above the playlist
+    int deckWidth = getWidth() / jmax(1, deckGUIs.size());
+    for (int i = 0; i < deckGUIs.size(); ++i)
+        deckGUIs[i]->setBounds(deckWidth * i, 0, deckWidth, getHeight() - playlistHeight - margin);
+
+    // Audio performance sits in the gap between the decks and the playlist
+    performanceMeter.setBounds(0, getHeight() - playlistHeight - margin, getWidth(), margin);
+
+    playlistComponent.setBounds(0, getHeight() - playlistHeight, getWidth(), playlistHeight);
+
+    waveformRenderer.updateViewBounds(*this);
+}
+
+
@@ -1,50 +1,89 @@
-#pragma once
-
-#include "../JuceLibraryCode/JuceHeader.h"
-#include "DJAudioPlayer.h"
-#include "DeckGUI.h"
-#include "PlaylistComponent.h"
-#include "WaveformDisplay.h"
-
-//==============================================================================
-/*
-    This component lives inside our window, and this is where you should put all
-    your controls and content.
-*/
-class MainComponent   : public AudioAppComponent
-{
-public:
-    //==============================================================================
-    MainComponent();
-    ~MainComponent();
-
-    //==============================================================================
-    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
-    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
-    void releaseResources() override;
-
-    //==============================================================================
-    void paint (Graphics& g) override;
-    void resized() override;
-
-private:
-    //==============================================================================
-    // Your private member variables go here...
-     
-    AudioFormatManager formatManager;
-    AudioThumbnailCache thumbCache{100}; 
-
-    DJAudioPlayer player1{formatManager};
-    DJAudioPlayer player2{formatManager};
-    
-    DeckGUI deckGUI1{&player1, formatManager, thumbCache};
-    DeckGUI deckGUI2{&player2, formatManager, thumbCache};
-    
-
-
-    MixerAudioSource mixerSource; 
-    
-    PlaylistComponent playlistComponent{&player1, &player2};
-    
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
-};
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DJAudioPlayer.h"
+#include "DeckEngine.h"
+#include "DeckGUI.h"
+#include "PerformanceMeter.h"
+#include "PersistentThumbnailCache.h"
+#include "PlaylistComponent.h"
+#include "RefreshScheduler.h"
+#include "TrackLibrary.h"
+#include "WaveformDisplay.h"
+#include "WaveformRenderer.h"
+
+//==============================================================================
+/*
+    This component lives inside our window, and this is where you should put all
+    your controls and content.
+*/
+class MainComponent   : public AudioAppComponent,
+                        private RefreshScheduler::Client
+{
+public:
+    //==============================================================================
+    MainComponent();
+    ~MainComponent();
+
+    //==============================================================================
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+    void releaseResources() override;
+
+    //==============================================================================
+    void paint (Graphics& g) override;
+    void resized() override;
+
+private:
+    // Draws an OpenGL frame whenever the scheduler is running at its full rate
+    bool refreshFrame() override;
+
+    //==============================================================================
+    // Your private member variables go here...
+     
+    AudioFormatManager formatManager;
+
+    // Waveforms are kept on disk, so tracks played in earlier sessions draw without decoding
+    PersistentThumbnailCache thumbCache{100, File::getSpecialLocation(File::userApplicationDataDirectory)
+                                                 .getChildFile("OtoDecks").getChildFile("Thumbnails.pack")};
+
+    // Waveform and track analysis for every deck, kept off the loader and disk threads
+    ThreadPool analysisPool{1};
+
+    // Shared background thread that does file reading and decoding for all decks
+    TimeSliceThread diskThread{"Deck disk reader"};
+
+    // Decoded tracks kept in memory so seeks and re-loads skip the decoder
+    TrackCache trackCache{formatManager};
+
+    // Opens and pre-buffers tracks off the message thread
+    TrackLoader trackLoader{formatManager, diskThread};
+
+    // Timings from every audio callback, declared first so it outlives the engine
+    AudioProfiler audioProfiler;
+
+    // Renders and mixes every deck, using spare cores when several are playing
+    static constexpr int numDecks = 2;
+    DeckEngine deckEngine{trackLoader, numDecks};
+
+    // Paces every animated component, and drops to a low rate when nothing is playing
+    RefreshScheduler refreshScheduler;
+
+    PerformanceMeter performanceMeter{audioProfiler, deckEngine, deviceManager, refreshScheduler};
+
+    // Waveforms and playheads are drawn on the GPU each frame, the rest of the window
+    // is painted as usual and composited on top
+    OpenGLContext openGLContext;
+    WaveformRenderer waveformRenderer{openGLContext};
+
+    OwnedArray<DeckGUI> deckGUIs;
+
+    // The playlist as it was left last session, mapped rather than read so a large one opens at once
+    TrackLibrary trackLibrary{File::getSpecialLocation(File::userApplicationDataDirectory)
+                                  .getChildFile("OtoDecks").getChildFile("Library.otolib")};
+    
+    PlaylistComponent playlistComponent{deckEngine.getDeck(0), deckEngine.getDeck(1), trackCache, trackLibrary,
+                                         formatManager};
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainComponent)
+};
@@ -0,0 +1,95 @@
+#include "MappedTrackSource.h"
+
+MappedTrackSource::MappedTrackSource(MemoryMappedAudioFormatReader* mappedReader,
+                                     TimeSliceThread& thread,
+                                     int samplesToPrefetch)
+: reader(mappedReader),
+  readerSource(mappedReader, true),
+  backgroundThread(thread),
+  numberOfSamplesToPrefetch(jmax(4096, samplesToPrefetch)),
+  samplesPerPage(jmax(1, 4096 / jmax(1, (int) (mappedReader->numChannels * mappedReader->bitsPerSample / 8))))
+{
+}
+
+MappedTrackSource::~MappedTrackSource()
+{
+    backgroundThread.removeTimeSliceClient(this);
+}
+
+namespace
+{
+    // Only formats with a memory-mapped reader (WAV and AIFF) return one. It has read the
+    // header but mapped nothing yet
+    MemoryMappedAudioFormatReader* createUnmappedReader(AudioFormatManager& formatManager, const URL& url)
+    {
+        if (! url.isLocalFile())
+            return nullptr;
+
+        auto file = url.getLocalFile();
+        auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+
+        return format != nullptr ? format->createMemoryMappedReader(file) : nullptr;
+    }
+}
+
+MemoryMappedAudioFormatReader* MappedTrackSource::createMappedReaderFor(AudioFormatManager& formatManager, const URL& url)
+{
+    std::unique_ptr<MemoryMappedAudioFormatReader> mappedReader (createUnmappedReader(formatManager, url));
+
+    if (mappedReader == nullptr || ! mappedReader->mapEntireFile())
+        return nullptr;
+
+    return mappedReader.release();
+}
+
+bool MappedTrackSource::canPlayMapped(AudioFormatManager& formatManager, const URL& url)
+{
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader (createUnmappedReader(formatManager, url));
+    return reader != nullptr && reader->mapEntireFile();
+}
+
+void MappedTrackSource::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    readerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+    backgroundThread.addTimeSliceClient(this);
+    backgroundThread.moveToFrontOfQueue(this);
+}
+
+void MappedTrackSource::releaseResources()
+{
+    backgroundThread.removeTimeSliceClient(this);
+    readerSource.releaseResources();
+}
+
+void MappedTrackSource::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    readerSource.getNextAudioBlock(bufferToFill);
+    playPosition = readerSource.getNextReadPosition();
+}
+
+// Seeking is free, just make sure the pages at the new position get touched first
+void MappedTrackSource::setNextReadPosition (int64 newPosition)
+{
+    readerSource.setNextReadPosition(newPosition);
+    playPosition = newPosition;
+    backgroundThread.moveToFrontOfQueue(this);
+}
+
+// Touches one sample per page between the playhead and the prefetch distance
+int MappedTrackSource::useTimeSlice()
+{
+    auto pos = jmax((int64) 0, playPosition.load());
+    auto end = jmin(pos + numberOfSamplesToPrefetch, reader->lengthInSamples);
+
+    // Carry on from where we got to unless the playhead jumped
+    auto start = (pos >= touchedStart && pos <= touchedEnd) ? touchedEnd : pos;
+
+    for (auto sample = start; sample < end; sample += samplesPerPage)
+        reader->touchSample(sample);
+
+    touchedStart = pos;
+    touchedEnd = jmax(start, end);
+
+    return 20;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Plays an uncompressed WAV/AIFF file straight from a memory map, so reads and
+// seeks are plain memory copies. Pages ahead of the playhead are touched on the
+// disk thread so they are resident before the audio thread needs them. Decks that
+// map the same file share the operating system's page cache
+class MappedTrackSource : public PositionableAudioSource,
+                          private TimeSliceClient
+{
+public:
+    // Takes ownership of a reader that has already been mapped
+    MappedTrackSource(MemoryMappedAudioFormatReader* mappedReader,
+                      TimeSliceThread& backgroundThread,
+                      int numberOfSamplesToPrefetch);
+    ~MappedTrackSource() override;
+
+    // Returns a mapped reader if the file is local and its format supports mapping, otherwise nullptr
+    static MemoryMappedAudioFormatReader* createMappedReaderFor(AudioFormatManager& formatManager, const URL& url);
+
+    // Whether the file would play mapped. It is mapped and unmapped again to find out,
+    // which reads nothing past the header, so a file that can't be mapped gets decoded
+    static bool canPlayMapped(AudioFormatManager& formatManager, const URL& url);
+
+    // AudioSource overrides
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    // PositionableAudioSource overrides
+    void setNextReadPosition (int64 newPosition) override;
+    int64 getNextReadPosition() const override { return playPosition.load(); }
+    int64 getTotalLength() const override { return readerSource.getTotalLength(); }
+    bool isLooping() const override { return false; }
+
+private:
+    // Called on the background thread
+    int useTimeSlice() override;
+
+    MemoryMappedAudioFormatReader* reader;
+    AudioFormatReaderSource readerSource;
+    TimeSliceThread& backgroundThread;
+    const int numberOfSamplesToPrefetch;
+    const int samplesPerPage;
+
+    // The reader source's own position is a plain member, other threads read this copy
+    std::atomic<int64> playPosition { 0 };
+
+    // Range already touched, only accessed on the background thread
+    int64 touchedStart = 0, touchedEnd = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MappedTrackSource)
+};
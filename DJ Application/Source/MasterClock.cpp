@@ -0,0 +1,42 @@
+#include "MasterClock.h"
+
+void MasterClock::prepare(double newSampleRate)
+{
+    // The beat carries on from where it was, only the samples it is counted in change
+    anchorSample = samplePosition.load();
+    anchorBeat = beatPosition.load();
+    anchorTempo = tempo.load();
+    sampleRate = newSampleRate;
+}
+
+void MasterClock::follow(double beat, double bpm)
+{
+    anchorSample = samplePosition.load();
+    anchorBeat = beat;
+    anchorTempo = bpm;
+
+    tempo = bpm;
+    beatPosition = beat;
+}
+
+void MasterClock::advance(int numSamples)
+{
+    auto position = samplePosition.load() + numSamples;
+    auto beat = anchorBeat;
+
+    if (sampleRate > 0)
+        beat += (double) (position - anchorSample) * anchorTempo / (60.0 * sampleRate);
+
+    // The block just played at the old tempo, the new one counts from its end
+    auto newTempo = tempo.load();
+
+    if (newTempo != anchorTempo)
+    {
+        anchorSample = position;
+        anchorBeat = beat;
+        anchorTempo = newTempo;
+    }
+
+    samplePosition = position;
+    beatPosition = beat;
+}
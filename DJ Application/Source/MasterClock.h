@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+class DJAudioPlayer;
+
+// Tempo and beat position shared by the decks, counted in output samples on the audio thread.
+//
+// The beat is worked out from the samples played since the tempo last changed rather
+// than added up block by block, so it never drifts however long the clock runs.
+// The leading deck drives the clock, which takes that deck's tempo and beat each block
+// and carries on at that tempo once the deck lets go
+class MasterClock
+{
+public:
+    MasterClock() = default;
+
+    // Any thread. Taken from the leading deck, and zero until there has been one, which
+    // leaves the synced decks playing freely
+    double getTempo() const { return tempo.load(); }
+
+    // The deck the clock follows, nullptr to carry on at the last tempo it took
+    void setLeader(DJAudioPlayer* deck) { leader = deck; }
+    DJAudioPlayer* getLeader() const { return leader.load(); }
+
+    // Audio thread, before the first block
+    void prepare(double sampleRate);
+
+    // Audio thread, lines the clock up with the leading deck at the start of a block
+    void follow(double beatPosition, double bpm);
+
+    // Audio thread, moves the clock on past a block once every deck has rendered it
+    void advance(int numSamples);
+
+    // Output samples and beats at the start of the block being rendered
+    int64 getSamplePosition() const { return samplePosition.load(); }
+    double getBeatPosition() const { return beatPosition.load(); }
+
+private:
+    std::atomic<double> tempo { 0 };
+    std::atomic<DJAudioPlayer*> leader { nullptr };
+
+    std::atomic<int64> samplePosition { 0 };
+    std::atomic<double> beatPosition { 0 };
+
+    // Where the current tempo took over, audio thread only
+    int64 anchorSample = 0;
+    double anchorBeat = 0;
+    double anchorTempo = 0;
+    double sampleRate = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MasterClock)
+};
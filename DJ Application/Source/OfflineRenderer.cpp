@@ -0,0 +1,261 @@
+#include "OfflineRenderer.h"
+
+OfflineRenderer::OfflineRenderer()
+{
+    formatManager.registerBasicFormats();
+    diskThread.startThread();
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+    diskThread.stopThread(2000);
+}
+
+bool OfflineRenderer::isRenderCommand(const StringArray& arguments)
+{
+    return arguments.contains("--render");
+}
+
+int OfflineRenderer::runFromCommandLine(const StringArray& arguments)
+{
+    auto index = arguments.indexOf("--render");
+
+    if (index < 0 || index + 2 >= arguments.size())
+    {
+        std::cerr << "Usage: --render session.json out.wav" << std::endl;
+        return 1;
+    }
+
+    auto workingDirectory = File::getCurrentWorkingDirectory();
+    auto sessionFile = workingDirectory.getChildFile(arguments[index + 1].unquoted());
+    auto outputFile = workingDirectory.getChildFile(arguments[index + 2].unquoted());
+
+    OfflineRenderer renderer;
+    auto result = renderer.render(sessionFile, outputFile);
+
+    if (! result.succeeded)
+    {
+        std::cerr << "Render failed: " << result.errorMessage << std::endl;
+        return 1;
+    }
+
+    std::cout << "Rendered " << String(result.renderedSeconds, 1) << " s in "
+              << String(result.elapsedSeconds, 2) << " s ("
+              << String(result.getRealTimeFactor(), 1) << "x real time), "
+              << result.lateDecks << " late deck blocks" << std::endl;
+
+    return 0;
+}
+
+OfflineRenderer::Result OfflineRenderer::render(const File& sessionFile, const File& outputFile)
+{
+    Result result;
+
+    auto session = JSON::parse(sessionFile);
+    auto* deckSettings = session["decks"].getArray();
+
+    if (! session.isObject() || deckSettings == nullptr || deckSettings->isEmpty())
+    {
+        result.errorMessage = "Could not read any decks from " + sessionFile.getFullPathName();
+        return result;
+    }
+
+    auto sampleRate = (double) session.getProperty("sampleRate", 44100.0);
+    auto blockSize = jmax(16, (int) session.getProperty("blockSize", 512));
+
+    DeckEngine engine (trackLoader, deckSettings->size());
+    engine.setNonRealtime(true);
+
+    if (! setUpDecks(engine, *deckSettings, sessionFile.getParentDirectory(), sampleRate, blockSize, result.errorMessage))
+        return result;
+
+    // Without an explicit duration, play the longest track out from where it starts at its starting speed
+    auto duration = (double) session.getProperty("duration", 0.0);
+
+    if (duration <= 0)
+    {
+        for (int i = 0; i < engine.getNumDecks(); ++i)
+        {
+            auto& settings = (*deckSettings)[i];
+            auto speed = jmax(0.1, (double) settings.getProperty("speed", 1.0));
+            auto remaining = engine.getDeck(i)->getLengthInSeconds() - (double) settings.getProperty("position", 0.0);
+            duration = jmax(duration, remaining / speed);
+        }
+    }
+
+    // Events are applied in time order, ties in the order they were written
+    std::vector<Event> events;
+
+    if (auto* eventSettings = session["events"].getArray())
+    {
+        for (auto& settings : *eventSettings)
+            events.push_back({ (int64) ((double) settings.getProperty("time", 0.0) * sampleRate),
+                               (int) settings.getProperty("deck", 0),
+                               settings.getProperty("action", {}).toString(),
+                               settings.getProperty("value", {}) });
+
+        std::stable_sort(events.begin(), events.end(),
+                         [](const Event& a, const Event& b) { return a.samplePosition < b.samplePosition; });
+    }
+
+    outputFile.deleteFile();
+    std::unique_ptr<FileOutputStream> stream (outputFile.createOutputStream());
+    WavAudioFormat wavFormat;
+    std::unique_ptr<AudioFormatWriter> writer;
+
+    if (stream != nullptr)
+        writer.reset(wavFormat.createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+
+    if (writer == nullptr)
+    {
+        result.errorMessage = "Could not write to " + outputFile.getFullPathName();
+        return result;
+    }
+
+    // The writer owns the stream now
+    stream.release();
+
+    AudioBuffer<float> buffer (2, blockSize);
+    auto totalSamples = (int64) (duration * sampleRate);
+    int64 position = 0;
+    size_t nextEvent = 0;
+
+    auto startTicks = Time::getHighResolutionTicks();
+
+    while (position < totalSamples)
+    {
+        while (nextEvent < events.size() && events[nextEvent].samplePosition <= position)
+            applyEvent(engine, events[nextEvent++]);
+
+        // Blocks are cut short at the next event so it lands on the exact sample
+        auto numSamples = (int) jmin((int64) blockSize, totalSamples - position);
+
+        if (nextEvent < events.size())
+            numSamples = (int) jmin((int64) numSamples, events[nextEvent].samplePosition - position);
+
+        AudioSourceChannelInfo info (&buffer, 0, numSamples);
+        engine.getNextAudioBlock(info);
+        writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+
+        // No message loop runs the decks' timers here, so replaced tracks are deleted as we go
+        for (int i = 0; i < engine.getNumDecks(); ++i)
+            engine.getDeck(i)->releaseRetiredTracks();
+
+        position += numSamples;
+    }
+
+    result.elapsedSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    result.renderedSeconds = position / sampleRate;
+    result.lateDecks = engine.getLateDeckCount();
+    result.succeeded = true;
+
+    engine.releaseResources();
+    return result;
+}
+
+// Speed, gain and effects are set before preparing so nothing ramps in from the defaults
+bool OfflineRenderer::setUpDecks(DeckEngine& engine, const Array<var>& deckSettings, const File& sessionFolder,
+                                 double sampleRate, int blockSize, String& errorMessage)
+{
+    for (int i = 0; i < engine.getNumDecks(); ++i)
+    {
+        auto* deck = engine.getDeck(i);
+        auto& settings = deckSettings.getReference(i);
+
+        deck->setReadAheadSize(0);
+        deck->setSpeed((double) settings.getProperty("speed", 1.0));
+        deck->setGain((double) settings.getProperty("gain", 1.0));
+        deck->setKeyLock((bool) settings.getProperty("keyLock", false));
+        applyEffectSettings(deck->getEffects(), settings["effects"]);
+    }
+
+    // Tracks are prepared for the render format as they load
+    engine.prepareToPlay(blockSize, sampleRate);
+
+    for (int i = 0; i < engine.getNumDecks(); ++i)
+    {
+        auto* deck = engine.getDeck(i);
+        auto& settings = deckSettings.getReference(i);
+        auto fileName = settings.getProperty("file", {}).toString();
+
+        // Decks without a file stay silent
+        if (fileName.isEmpty())
+            continue;
+
+        auto file = sessionFolder.getChildFile(fileName);
+
+        if (! deck->loadURLSynchronously(URL{file}))
+        {
+            errorMessage = "Could not load " + file.getFullPathName();
+            return false;
+        }
+
+        deck->setPosition((double) settings.getProperty("position", 0.0));
+
+        auto nextFileName = settings.getProperty("next", {}).toString();
+
+        if (nextFileName.isEmpty())
+            continue;
+
+        auto nextFile = sessionFolder.getChildFile(nextFileName);
+
+        if (! deck->loadNextURLSynchronously(URL{nextFile}, (double) settings.getProperty("crossfade", 0.0)))
+        {
+            errorMessage = "Could not load " + nextFile.getFullPathName();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void OfflineRenderer::applyEffectSettings(EffectChain& effects, const var& settings)
+{
+    if (! settings.isObject())
+        return;
+
+    const char* const names[EffectChain::numEffects] = { "filter", "delay", "reverb", "bitcrusher" };
+
+    for (int i = 0; i < EffectChain::numEffects; ++i)
+    {
+        auto effectSettings = settings[names[i]];
+
+        if (! effectSettings.isObject())
+            continue;
+
+        auto& effect = effects.getEffect((EffectChain::EffectId) i);
+        effect.setActive((bool) effectSettings.getProperty("active", true));
+        effect.setWetDryMix((float) effectSettings.getProperty("mix", effect.getWetDryMix()));
+    }
+
+    auto filter = settings["filter"];
+    effects.getFilter().setSweep((float) filter.getProperty("sweep", effects.getFilter().getSweep()));
+    effects.getFilter().setResonance((float) filter.getProperty("resonance", effects.getFilter().getResonance()));
+
+    auto delay = settings["delay"];
+    effects.getDelay().setDelayTime((float) delay.getProperty("time", effects.getDelay().getDelayTime()));
+    effects.getDelay().setFeedback((float) delay.getProperty("feedback", effects.getDelay().getFeedback()));
+
+    auto reverb = settings["reverb"];
+    effects.getReverb().setRoomSize((float) reverb.getProperty("roomSize", effects.getReverb().getRoomSize()));
+    effects.getReverb().setDamping((float) reverb.getProperty("damping", effects.getReverb().getDamping()));
+
+    auto bitcrusher = settings["bitcrusher"];
+    effects.getBitcrusher().setBitDepth((float) bitcrusher.getProperty("bits", effects.getBitcrusher().getBitDepth()));
+    effects.getBitcrusher().setDownsampleFactor((float) bitcrusher.getProperty("downsample", effects.getBitcrusher().getDownsampleFactor()));
+}
+
+void OfflineRenderer::applyEvent(DeckEngine& engine, const Event& event)
+{
+    auto* deck = engine.getDeck(event.deck);
+
+    if (deck == nullptr)
+        return;
+
+    if (event.action == "play")            deck->start();
+    else if (event.action == "stop")       deck->stop();
+    else if (event.action == "position")   deck->setPosition((double) event.value);
+    else if (event.action == "speed")      deck->setSpeed((double) event.value);
+    else if (event.action == "gain")       deck->setGain((double) event.value);
+    else if (event.action == "keyLock")    deck->setKeyLock((bool) event.value);
+}
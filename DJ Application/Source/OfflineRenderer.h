@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckEngine.h"
+
+// Renders a session described in a JSON file straight to a WAV file, with no audio
+// device and no GUI, as fast as the machine allows. Tracks are read directly
+// rather than through the read-ahead thread, so the same session always renders
+// to the same samples.
+//
+// {
+//   "sampleRate": 44100, "blockSize": 512, "duration": 90,
+//   "decks": [ { "file": "a.mp3", "position": 12.5, "speed": 1.0, "gain": 0.8, "keyLock": true,
+//                "next": "b.wav", "crossfade": 6,
+//                "effects": { "reverb": { "active": true, "mix": 0.3, "roomSize": 0.7 } } } ],
+//   "events": [ { "time": 0, "deck": 0, "action": "play" },
+//               { "time": 30, "deck": 0, "action": "speed", "value": 1.04 } ]
+// }
+//
+// Relative file paths are resolved against the session file. A deck's next track follows
+// its first as it would with auto-advance, fading in over the crossfade seconds before
+// its end. Without a duration the render lasts until the longest first track would finish
+// from its starting position at its starting speed. Event actions are
+// play, stop, position, speed, gain and keyLock, applied at the exact sample
+class OfflineRenderer
+{
+public:
+    struct Result
+    {
+        bool succeeded = false;
+        String errorMessage;
+
+        double renderedSeconds = 0;
+        double elapsedSeconds = 0;
+        int lateDecks = 0;
+
+        // Seconds of audio rendered per second of wall-clock time
+        double getRealTimeFactor() const { return elapsedSeconds > 0 ? renderedSeconds / elapsedSeconds : 0; }
+    };
+
+    OfflineRenderer();
+    ~OfflineRenderer();
+
+    Result render(const File& sessionFile, const File& outputFile);
+
+    // Handles "--render session.json out.wav", returns false if the arguments ask for something else
+    static bool isRenderCommand(const StringArray& arguments);
+
+    // Runs the render described by the arguments and prints the outcome, returns the process exit code
+    static int runFromCommandLine(const StringArray& arguments);
+
+private:
+    struct Event
+    {
+        int64 samplePosition;
+        int deck;
+        String action;
+        var value;
+    };
+
+    // Loads each deck and applies its starting settings
+    bool setUpDecks(DeckEngine& engine, const Array<var>& deckSettings, const File& sessionFolder,
+                    double sampleRate, int blockSize, String& errorMessage);
+    static void applyEffectSettings(EffectChain& effects, const var& settings);
+    static void applyEvent(DeckEngine& engine, const Event& event);
+
+    AudioFormatManager formatManager;
+
+    // Touches the pages of memory-mapped tracks ahead of the render, which never waits on it
+    TimeSliceThread diskThread{"Offline disk reader"};
+    TrackLoader trackLoader{formatManager, diskThread, 1};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OfflineRenderer)
+};
@@ -0,0 +1,94 @@
+#include "PerformanceMeter.h"
+
+PerformanceMeter::PerformanceMeter(AudioProfiler& _profiler, DeckEngine& _deckEngine, AudioDeviceManager& _deviceManager,
+                                   RefreshScheduler& _refreshScheduler)
+: profiler(_profiler), deckEngine(_deckEngine), deviceManager(_deviceManager), refreshScheduler(_refreshScheduler)
+{
+    addAndMakeVisible(csvButton);
+    addAndMakeVisible(resetButton);
+    csvButton.addListener(this);
+    resetButton.addListener(this);
+
+    refreshScheduler.addClient(this);
+}
+
+PerformanceMeter::~PerformanceMeter()
+{
+    refreshScheduler.removeClient(this);
+}
+
+void PerformanceMeter::paint (Graphics& g)
+{
+    auto& summary = profiler.getSummary();
+    auto area = getLocalBounds().withTrimmedRight(csvButton.getWidth() + resetButton.getWidth());
+
+    // Load bar behind the text, red once the callback is close to its budget
+    auto load = jlimit(0.0f, 1.0f, summary.averageLoad);
+    g.setColour(load > 0.8f ? Colours::darkred : Colours::darkgreen);
+    g.fillRect(area.withWidth(roundToInt(area.getWidth() * load)));
+
+    // -1 means the device doesn't report xruns
+    auto* device = deviceManager.getCurrentAudioDevice();
+    auto deviceXRuns = device != nullptr ? device->getXRunCount() : -1;
+
+    String text;
+    text << "DSP " << String(summary.averageLoad * 100.0f, 1) << "% (peak " << String(summary.peakLoad * 100.0f, 1) << "%)"
+         << "  worst " << String(profiler.getWorstCallbackMs(), 2) << " ms"
+         << "  overruns " << profiler.getOverrunCount()
+         << "  xruns " << (deviceXRuns >= 0 ? String(deviceXRuns) : String("-"))
+         << "  late " << deckEngine.getLateDeckCount();
+
+    for (int deck = 0; deck < summary.numDecks; ++deck)
+    {
+        auto* stageMs = summary.averageDeckMs[deck];
+        text << "  |  D" << (deck + 1) << " "
+             << String(stageMs[AudioProfiler::resampleStage], 2) << "/"
+             << String(stageMs[AudioProfiler::effectsStage], 2) << "/"
+             << String(stageMs[AudioProfiler::gainStage], 2);
+    }
+
+    text << "  |  mix " << String(summary.averageMixMs, 2) << " ms";
+
+    g.setColour(Colours::white);
+    g.setFont(12.0f);
+    g.drawFittedText(text, area.reduced(4, 0), Justification::centredLeft, 1);
+}
+
+void PerformanceMeter::resized()
+{
+    auto area = getLocalBounds();
+    resetButton.setBounds(area.removeFromRight(60));
+    csvButton.setBounds(area.removeFromRight(50));
+}
+
+void PerformanceMeter::buttonClicked (Button* button)
+{
+    if (button == &resetButton)
+    {
+        profiler.resetCounters();
+        repaint();
+        return;
+    }
+
+    auto file = File::getSpecialLocation(File::userDocumentsDirectory)
+                    .getNonexistentChildFile("OtoDecks audio profile", ".csv");
+
+    if (profiler.writeCsv(file))
+        AlertWindow::showMessageBoxAsync(AlertWindow::InfoIcon, "Audio profile saved", file.getFullPathName());
+    else
+        AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Audio profile", "Could not write " + file.getFullPathName());
+}
+
+bool PerformanceMeter::refreshFrame()
+{
+    auto now = Time::getMillisecondCounter();
+
+    if (now - lastUpdateTime >= 250)
+    {
+        lastUpdateTime = now;
+        profiler.collect();
+        refreshScheduler.invalidate(*this);
+    }
+
+    return false;
+}
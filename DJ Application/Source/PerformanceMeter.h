@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioProfiler.h"
+#include "DeckEngine.h"
+#include "RefreshScheduler.h"
+
+// Strip showing the audio callback's load, worst block time, overruns and the
+// average time each deck spends per stage. The CSV button saves the profiler's history
+class PerformanceMeter : public Component,
+                         public Button::Listener,
+                         public RefreshScheduler::Client
+{
+public:
+    PerformanceMeter(AudioProfiler& profiler, DeckEngine& deckEngine, AudioDeviceManager& deviceManager,
+                     RefreshScheduler& refreshScheduler);
+    ~PerformanceMeter();
+
+    void paint (Graphics&) override;
+    void resized() override;
+
+    void buttonClicked (Button*) override;
+
+    // Drains the profiler and repaints, four times a second whatever the frame rate
+    bool refreshFrame() override;
+
+private:
+    AudioProfiler& profiler;
+    DeckEngine& deckEngine;
+    AudioDeviceManager& deviceManager;
+    RefreshScheduler& refreshScheduler;
+
+    uint32 lastUpdateTime = 0;
+
+    TextButton csvButton{"CSV"};
+    TextButton resetButton{"RESET"};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceMeter)
+};
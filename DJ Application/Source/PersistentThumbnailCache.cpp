@@ -0,0 +1,522 @@
+#include "PersistentThumbnailCache.h"
+
+namespace
+{
+    const char packMagic[8] = { 'O', 'T', 'O', 'T', 'H', 'U', 'M', 'B' };
+    const int packVersion = 1;
+    const size_t packHeaderSize = sizeof(packMagic) + sizeof(int32);
+
+    // hash, last used time, data size
+    const size_t recordHeaderSize = sizeof(int64) + sizeof(int64) + sizeof(int32);
+
+    void writePackHeader(OutputStream& stream)
+    {
+        stream.write(packMagic, sizeof(packMagic));
+        stream.writeInt(packVersion);
+    }
+}
+
+//==============================================================================
+// Source whose hash is the file's identity rather than its URL
+class PersistentThumbnailCache::IdentifiedInputSource : public InputSource
+{
+public:
+    IdentifiedInputSource(const URL& _url, int64 _identity)
+    : source(_url), identity(_identity)
+    {
+    }
+
+    InputStream* createInputStream() override                             { return source.createInputStream(); }
+    InputStream* createInputStreamFor(const String& relatedPath) override  { return source.createInputStreamFor(relatedPath); }
+    int64 hashCode() const override                                       { return identity; }
+
+private:
+    URLInputSource source;
+    const int64 identity;
+};
+
+//==============================================================================
+PersistentThumbnailCache::PersistentThumbnailCache(int maxThumbsInMemory, const File& _packFile, int64 _maxPackBytes)
+: AudioThumbnailCache(maxThumbsInMemory),
+  packFile(_packFile),
+  journalFile(_packFile.withFileExtension("journal")),
+  maxPackBytes(_maxPackBytes),
+  maxJournalBytes(jmax((int64) 1024 * 1024, _maxPackBytes / 8))
+{
+    packFile.getParentDirectory().createDirectory();
+
+    // Mapping costs nothing up front, pages are only read when a thumbnail is used
+    if (packFile.existsAsFile())
+    {
+        mappedPack.reset(new MemoryMappedFile(packFile, MemoryMappedFile::readOnly));
+
+        if (mappedPack->getData() != nullptr)
+        {
+            indexRecords(mappedPack->getData(), mappedPack->getSize(), entries);
+            storedBytes += (int64) mappedPack->getSize();
+        }
+        else
+        {
+            mappedPack.reset();
+        }
+    }
+
+    // Journal records are newer than the pack's, so they are read second and win
+    if (journalFile.existsAsFile() && journalFile.loadFileAsData(journalContents))
+    {
+        indexRecords(journalContents.getData(), journalContents.getSize(), entries);
+        journalBytes = (int64) journalContents.getSize();
+        storedBytes += journalBytes;
+    }
+
+    getTimeSliceThread().addTimeSliceClient(this);
+}
+
+PersistentThumbnailCache::~PersistentThumbnailCache()
+{
+    getTimeSliceThread().removeTimeSliceClient(this);
+
+    // Anything still queued goes into the journal, which the next run reads back
+    writePendingRecords();
+
+    if (shouldCompact())
+        compact();
+}
+
+InputSource* PersistentThumbnailCache::createInputSource(const URL& url, int64 identity)
+{
+    return new IdentifiedInputSource(url, identity);
+}
+
+// Hashes the file's identity rather than its URL. Hashing the whole file would
+// read it all, so only three slices (start, middle and end) of the content go in
+int64 PersistentThumbnailCache::getIdentity(const URL& url)
+{
+    if (! url.isLocalFile())
+        return url.toString(true).hashCode64();
+
+    auto file = url.getLocalFile();
+
+    // 64-bit FNV-1a
+    uint64 hash = 14695981039346656037ull;
+
+    auto add = [&hash](const void* data, size_t size)
+    {
+        auto* bytes = static_cast<const uint8*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    auto path = file.getFullPathName();
+    add(path.toRawUTF8(), path.getNumBytesAsUTF8());
+
+    auto size = file.getSize();
+    add(&size, sizeof(size));
+
+    auto modified = file.getLastModificationTime().toMilliseconds();
+    add(&modified, sizeof(modified));
+
+    FileInputStream stream (file);
+
+    if (stream.openedOk())
+    {
+        const int sliceSize = 16384;
+        HeapBlock<char> slice (sliceSize);
+
+        for (auto position : { (int64) 0, size / 2, size - sliceSize })
+        {
+            stream.setPosition(jmax((int64) 0, position));
+            auto numRead = stream.read(slice, sliceSize);
+
+            if (numRead > 0)
+                add(slice, (size_t) numRead);
+        }
+    }
+
+    return (int64) hash;
+}
+
+void PersistentThumbnailCache::findIdentityAsync(const URL& url, std::function<void (int64)> callback)
+{
+    {
+        const ScopedLock sl (lock);
+        identityRequests.push_back({ url, std::move(callback) });
+    }
+
+    getTimeSliceThread().moveToFrontOfQueue(this);
+}
+
+int PersistentThumbnailCache::getNumStoredThumbnails() const
+{
+    const ScopedLock sl (lock);
+    return (int) entries.size();
+}
+
+void PersistentThumbnailCache::indexRecords(const void* data, size_t size, std::map<int64, Entry>& index)
+{
+    if (size < packHeaderSize || memcmp(data, packMagic, sizeof(packMagic)) != 0)
+        return;
+
+    MemoryInputStream stream (data, size, false);
+    stream.setPosition(sizeof(packMagic));
+
+    if (stream.readInt() != packVersion)
+        return;
+
+    while ((size_t) stream.getNumBytesRemaining() >= recordHeaderSize)
+    {
+        auto hashCode = stream.readInt64();
+        auto lastUsed = stream.readInt64();
+        auto dataSize = stream.readInt();
+
+        // A write cut short by a crash leaves a partial record at the end
+        if (dataSize < 0 || dataSize > stream.getNumBytesRemaining())
+            break;
+
+        if (dataSize == 0)
+        {
+            auto existing = index.find(hashCode);
+
+            if (existing != index.end())
+                existing->second.lastUsed = jmax(existing->second.lastUsed, lastUsed);
+
+            deadBytes += (int64) recordHeaderSize;
+            continue;
+        }
+
+        auto& entry = index[hashCode];
+
+        if (entry.size > 0)
+            deadBytes += (int64) (recordHeaderSize + entry.size);
+
+        entry.sessionData.reset();
+        entry.data = addBytesToPointer(data, (size_t) stream.getPosition());
+        entry.size = (size_t) dataSize;
+        entry.lastUsed = lastUsed;
+
+        stream.skipNextBytes(dataSize);
+    }
+}
+
+void PersistentThumbnailCache::touch(int64 key, Entry& entry)
+{
+    entry.lastUsed = Time::currentTimeMillis();
+
+    if (! entry.touchedThisSession)
+    {
+        entry.touchedThisSession = true;
+        pendingTouches.push_back(key);
+    }
+}
+
+bool PersistentThumbnailCache::loadNewThumb(AudioThumbnailBase& thumb, int64 hashCode)
+{
+    const ScopedLock sl (lock);
+
+    auto entry = entries.find(hashCode);
+
+    if (entry == entries.end())
+        return false;
+
+    MemoryInputStream stream (entry->second.data, entry->second.size, false);
+
+    if (! thumb.loadFrom(stream))
+    {
+        deadBytes += (int64) (recordHeaderSize + entry->second.size);
+        entries.erase(entry);
+        return false;
+    }
+
+    // Recency decides what is dropped when the pack is over budget
+    touch(hashCode, entry->second);
+    return true;
+}
+
+// Called on the cache's thread as a thumbnail finishes, the disk write waits for the next time slice
+void PersistentThumbnailCache::saveNewlyFinishedThumbnail(const AudioThumbnailBase& thumb, int64 hashCode)
+{
+    MemoryOutputStream stream;
+    thumb.saveTo(stream);
+
+    storeData(hashCode, stream.getMemoryBlock());
+}
+
+void PersistentThumbnailCache::storeData(int64 key, const MemoryBlock& data)
+{
+    // One huge record would push everything else out of the pack
+    if (data.getSize() == 0 || (int64) data.getSize() > maxPackBytes / 4)
+        return;
+
+    const ScopedLock sl (lock);
+
+    auto& entry = entries[key];
+
+    if (entry.size > 0)
+        deadBytes += (int64) (recordHeaderSize + entry.size);
+
+    // The record written for it carries the time, so it needs no touch record as well
+    entry.sessionData = data;
+    entry.data = entry.sessionData.getData();
+    entry.size = entry.sessionData.getSize();
+    entry.lastUsed = Time::currentTimeMillis();
+    entry.touchedThisSession = true;
+
+    pendingWrites.push_back(key);
+}
+
+bool PersistentThumbnailCache::loadData(int64 key, MemoryBlock& data)
+{
+    const ScopedLock sl (lock);
+
+    auto entry = entries.find(key);
+
+    if (entry == entries.end())
+        return false;
+
+    data.replaceWith(entry->second.data, entry->second.size);
+
+    touch(key, entry->second);
+    return true;
+}
+
+int PersistentThumbnailCache::useTimeSlice()
+{
+    std::vector<IdentityRequest> requests;
+
+    {
+        const ScopedLock sl (lock);
+        requests.swap(identityRequests);
+    }
+
+    for (auto& request : requests)
+    {
+        auto identity = getIdentity(request.url);
+        auto callback = request.callback;
+
+        MessageManager::callAsync([callback, identity] { callback(identity); });
+    }
+
+    writePendingRecords();
+
+    bool journalIsFull;
+
+    {
+        const ScopedLock sl (lock);
+        journalIsFull = journalBytes > maxJournalBytes;
+    }
+
+    if (journalIsFull)
+        compact();
+
+    return 500;
+}
+
+// Copied out so the disk write doesn't hold up loads
+void PersistentThumbnailCache::writePendingRecords()
+{
+    std::vector<std::pair<int64, MemoryBlock>> records;
+    std::vector<std::pair<int64, int64>> touches;
+
+    {
+        const ScopedLock sl (lock);
+
+        for (auto hashCode : pendingWrites)
+        {
+            auto entry = entries.find(hashCode);
+
+            if (entry != entries.end())
+                records.emplace_back(hashCode, MemoryBlock(entry->second.data, entry->second.size));
+        }
+
+        for (auto hashCode : pendingTouches)
+        {
+            auto entry = entries.find(hashCode);
+
+            if (entry != entries.end())
+                touches.emplace_back(hashCode, entry->second.lastUsed);
+        }
+
+        pendingWrites.clear();
+        pendingTouches.clear();
+    }
+
+    if (records.empty() && touches.empty())
+        return;
+
+    int64 lastUsed = Time::currentTimeMillis();
+    int64 bytesWritten = 0;
+
+    {
+        FileOutputStream stream (journalFile);
+
+        if (! stream.openedOk())
+            return;
+
+        auto startPosition = stream.getPosition();
+
+        if (startPosition == 0)
+            writePackHeader(stream);
+
+        for (auto& record : records)
+            writeRecord(stream, record.first, lastUsed, record.second.getData(), record.second.getSize());
+
+        for (auto& record : touches)
+            writeRecord(stream, record.first, record.second, nullptr, 0);
+
+        stream.flush();
+        bytesWritten = stream.getPosition() - startPosition;
+    }
+
+    const ScopedLock sl (lock);
+    journalBytes += bytesWritten;
+    storedBytes += bytesWritten;
+    deadBytes += (int64) (touches.size() * recordHeaderSize);
+}
+
+bool PersistentThumbnailCache::writeRecord(OutputStream& stream, int64 hashCode, int64 lastUsed, const void* data, size_t size)
+{
+    return stream.writeInt64(hashCode)
+        && stream.writeInt64(lastUsed)
+        && stream.writeInt((int) size)
+        && (size == 0 || stream.write(data, size));
+}
+
+bool PersistentThumbnailCache::shouldCompact() const
+{
+    const ScopedLock sl (lock);
+    return storedBytes > maxPackBytes || journalBytes > maxJournalBytes || deadBytes * 4 > storedBytes;
+}
+
+void PersistentThumbnailCache::compact()
+{
+    struct Record
+    {
+        int64 key;
+        int64 lastUsed;
+        const void* data;
+        size_t size;
+    };
+
+    std::vector<Record> order;
+    std::vector<MemoryBlock> sessionCopies;
+    int64 liveBytes = (int64) packHeaderSize;
+
+    // The pack and journal stay where they are until the swap below, but session data
+    // can be replaced at any moment, so that is copied
+    {
+        const ScopedLock sl (lock);
+        sessionCopies.reserve(entries.size());
+
+        for (auto& entry : entries)
+        {
+            auto* data = entry.second.data;
+
+            if (entry.second.sessionData.getSize() > 0)
+            {
+                sessionCopies.push_back(entry.second.sessionData);
+                data = sessionCopies.back().getData();
+            }
+
+            order.push_back({ entry.first, entry.second.lastUsed, data, entry.second.size });
+            liveBytes += (int64) (recordHeaderSize + entry.second.size);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [](const Record& a, const Record& b) { return a.lastUsed > b.lastUsed; });
+
+    // Trimmed with some room to spare, so the next few sessions don't have to rewrite it again
+    auto targetBytes = liveBytes > maxPackBytes ? maxPackBytes * 3 / 4 : maxPackBytes;
+
+    TemporaryFile newPack (packFile);
+    bool written = false;
+
+    {
+        FileOutputStream stream (newPack.getFile());
+
+        if (stream.openedOk())
+        {
+            writePackHeader(stream);
+            auto totalSize = (int64) packHeaderSize;
+
+            for (auto& record : order)
+            {
+                auto recordSize = (int64) (recordHeaderSize + record.size);
+
+                if (totalSize + recordSize > targetBytes)
+                    continue;
+
+                writeRecord(stream, record.key, record.lastUsed, record.data, record.size);
+                totalSize += recordSize;
+            }
+
+            stream.flush();
+            written = stream.getStatus().wasOk();
+        }
+    }
+
+    if (! written)
+        return;
+
+    const ScopedLock sl (lock);
+
+    // The pack can't be replaced while it is mapped, so everything is indexed again afterwards
+    mappedPack.reset();
+    auto replaced = newPack.overwriteTargetFileWithTemporary();
+
+    std::map<int64, Entry> rebuilt;
+    storedBytes = 0;
+    deadBytes = 0;
+
+    mappedPack.reset(new MemoryMappedFile(packFile, MemoryMappedFile::readOnly));
+
+    if (mappedPack->getData() != nullptr)
+    {
+        indexRecords(mappedPack->getData(), mappedPack->getSize(), rebuilt);
+        storedBytes += (int64) mappedPack->getSize();
+    }
+    else
+    {
+        mappedPack.reset();
+    }
+
+    if (replaced)
+    {
+        journalFile.deleteFile();
+        journalContents.reset();
+        journalBytes = 0;
+    }
+    else
+    {
+        indexRecords(journalContents.getData(), journalContents.getSize(), rebuilt);
+        storedBytes += journalBytes;
+    }
+
+    // Session data keeps its own copy, and anything used during the write keeps its time
+    for (auto& entry : entries)
+    {
+        if (entry.second.sessionData.getSize() > 0)
+        {
+            auto& kept = rebuilt[entry.first];
+            kept.sessionData = std::move(entry.second.sessionData);
+            kept.data = kept.sessionData.getData();
+            kept.size = kept.sessionData.getSize();
+            kept.lastUsed = entry.second.lastUsed;
+            kept.touchedThisSession = entry.second.touchedThisSession;
+            continue;
+        }
+
+        auto existing = rebuilt.find(entry.first);
+
+        if (existing != rebuilt.end())
+        {
+            existing->second.lastUsed = jmax(existing->second.lastUsed, entry.second.lastUsed);
+            existing->second.touchedThisSession = entry.second.touchedThisSession;
+        }
+    }
+
+    entries.swap(rebuilt);
+}
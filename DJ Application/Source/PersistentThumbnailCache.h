@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Thumbnail cache that keeps finished waveforms on disk between runs, so a track
+// that has been shown before draws straight away without being decoded again.
+//
+// Thumbnails live in a pack file that is memory-mapped when the cache is created
+// and read in place. New ones are appended to a journal on the cache's own thread,
+// and so is a small record the first time a stored one is used in a session, which
+// is what keeps the recency order. The pack and journal are only merged when the
+// journal outgrows its limit, when replaced records leave too much dead space, or
+// when the total is over the size budget. The least recently used thumbnails are
+// dropped until the new pack fits.
+//
+// Thumbnails are keyed by the source's hash. Use findIdentityAsync() and
+// createInputSource() so that the hash covers the file's path, size, modification
+// time and a sample of its content.
+// Other per-track data can share the pack under keys of its own, see storeData()
+class PersistentThumbnailCache : public AudioThumbnailCache,
+                                 private TimeSliceClient
+{
+public:
+    PersistentThumbnailCache(int maxThumbsInMemory, const File& packFile, int64 maxPackBytes = 64 * 1024 * 1024);
+    ~PersistentThumbnailCache() override;
+
+    // Source for AudioThumbnail::setSource whose hash is the identity found for the file,
+    // so a replaced file with the same name is never shown with the old waveform
+    static InputSource* createInputSource(const URL& url, int64 identity);
+
+    // Hash of the file's path, size, modification time and content, as used for thumbnails.
+    // Reads from the file, so keep it off the message thread
+    static int64 getIdentity(const URL& url);
+
+    // Works out the identity on the cache's thread and calls back on the message thread
+    void findIdentityAsync(const URL& url, std::function<void (int64)> callback);
+
+    // Number of thumbnails that could be loaded from disk right now
+    int getNumStoredThumbnails() const;
+
+    // Any thread. Stores a block under a key, which is written to disk like a
+    // finished thumbnail. Keys must not clash with the thumbnails' source hashes
+    void storeData(int64 key, const MemoryBlock& data);
+
+    // Any thread. Copies out a block stored under the key, false if there isn't one
+    bool loadData(int64 key, MemoryBlock& data);
+
+protected:
+    // AudioThumbnailCache overrides
+    bool loadNewThumb(AudioThumbnailBase& thumb, int64 hashCode) override;
+    void saveNewlyFinishedThumbnail(const AudioThumbnailBase& thumb, int64 hashCode) override;
+
+private:
+    class IdentifiedInputSource;
+
+    struct Entry
+    {
+        // Points into the mapped pack, the journal contents or sessionData
+        const void* data = nullptr;
+        size_t size = 0;
+        int64 lastUsed = 0;
+        MemoryBlock sessionData;
+        bool touchedThisSession = false;
+    };
+
+    struct IdentityRequest
+    {
+        URL url;
+        std::function<void (int64)> callback;
+    };
+
+    // Works out queued identities and appends queued records to the journal
+    int useTimeSlice() override;
+    void writePendingRecords();
+
+    // Reads the records in a pack or journal into the map, stopping at the first damaged one.
+    // A record with no data only moves an existing entry's last used time forward
+    void indexRecords(const void* data, size_t size, std::map<int64, Entry>& index);
+
+    // Notes that an entry was used, the journal gets a record of it once per session
+    void touch(int64 key, Entry& entry);
+
+    // Replaced and superseded records are dead space, which is worth a rewrite past a quarter of the total
+    bool shouldCompact() const;
+
+    // Rewrites the pack from every entry that fits the budget, most recently used first,
+    // and starts a new journal. Only runs on the cache's thread or once it has stopped
+    void compact();
+
+    static bool writeRecord(OutputStream& stream, int64 hashCode, int64 lastUsed, const void* data, size_t size);
+
+    const File packFile, journalFile;
+    const int64 maxPackBytes;
+
+    // Past this the journal is merged into the pack, so one session can't grow it without limit
+    const int64 maxJournalBytes;
+
+    // Both only change in compact()
+    std::unique_ptr<MemoryMappedFile> mappedPack;
+    MemoryBlock journalContents;
+
+    CriticalSection lock;
+    std::map<int64, Entry> entries;
+    std::vector<int64> pendingWrites;
+    std::vector<int64> pendingTouches;
+    std::vector<IdentityRequest> identityRequests;
+
+    // Bytes in the pack and journal, and how many of them belong to replaced or touch records
+    int64 storedBytes = 0;
+    int64 deadBytes = 0;
+    int64 journalBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PersistentThumbnailCache)
+};
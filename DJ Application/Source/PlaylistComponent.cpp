@@ -1,494 +1,715 @@
-#include <JuceHeader.h>
-#include "PlaylistComponent.h"
-
-// Constructor for PlaylistComponent, initialises the table and UI elements
-PlaylistComponent::PlaylistComponent(DJAudioPlayer* _player1, DJAudioPlayer* _player2)
-: player1(_player1), player2(_player2)
-{
-    // Add the table component and set it as the model
-    addAndMakeVisible(tableComponent);
-    tableComponent.setModel(this);
-    
-    // Define table columns for track title and queue management
-    tableComponent.getHeader().addColumn("Track title", 1, 600);
-    tableComponent.getHeader().addColumn("Left Queue", 2, 100);
-    tableComponent.getHeader().addColumn("Right Queue", 3, 100);
-    
-    // Initialise deck buttons for adding tracks to left and right decks
-    addAndMakeVisible(addToLeftDeckButton);
-    addToLeftDeckButton.addListener(this);
-    addAndMakeVisible(addToRightDeckButton);
-    addToRightDeckButton.addListener(this);
-    
-    // Initialise queue management buttons
-    addAndMakeVisible(playNextLeftButton);
-    playNextLeftButton.addListener(this);
-    playNextLeftButton.setEnabled(false);
-    
-    addAndMakeVisible(playNextRightButton);
-    playNextRightButton.addListener(this);
-    playNextRightButton.setEnabled(false);
-    
-    // Initialise delete button for removing tracks
-    addAndMakeVisible(deleteButton);
-    deleteButton.addListener(this);
-    
-    // Initialise search input and clear search button
-    addAndMakeVisible(searchInput);
-    searchInput.setTextToShowWhenEmpty("Search tracks...", Colours::grey);
-    searchInput.onTextChange = [this] { filterPlaylist(); };
-        
-    addAndMakeVisible(clearSearchButton);
-    clearSearchButton.addListener(this);
-        
-    // Initialise search text
-    currentSearchText = "";
-
-
-}
-
-// Destructor
-PlaylistComponent::~PlaylistComponent()
-{
-}
-
-// Paint background with default colour
-void PlaylistComponent::paint (juce::Graphics& g)
-{
-    g.fillAll(getLookAndFeel().findColour(ResizableWindow::backgroundColourId));
-
-}
-
-// Layout of GUI for playlist
-void PlaylistComponent::resized()
-{
-    // Position the queue management controls at the top
-    auto area = getLocalBounds();
-    auto topSection = area.removeFromTop(40);
-    
-    // Position the search components
-    auto searchArea = area.removeFromTop(40);
-    searchInput.setBounds(searchArea.removeFromLeft(getWidth() - 100).reduced(5, 5));
-    clearSearchButton.setBounds(searchArea.reduced(5, 5));
-    
-    // Position the deck buttons
-    int buttonWidth = topSection.getWidth() / 4;
-    
-    addToLeftDeckButton.setBounds(topSection.removeFromLeft(buttonWidth));
-    addToRightDeckButton.setBounds(topSection.removeFromLeft(buttonWidth));
-    playNextLeftButton.setBounds(topSection.removeFromLeft(buttonWidth));
-    playNextRightButton.setBounds(topSection.removeFromLeft(buttonWidth));
-    
-    // Position the delete button
-    deleteButton.setBounds(area.removeFromTop(30).reduced(getWidth() / 4, 0));
-    
-    // Position the table
-    tableComponent.setBounds(area.reduced(0, 10));
-}
-
-// Returns the number of rows in the table, accounting for search filtering
-int PlaylistComponent::getNumRows()
-{
-    if (currentSearchText.isEmpty())
-    {
-        return trackTitles.size();
-    }
-    else
-    {
-        return filteredIndices.size();
-    }
-}
-
-// Filters the playlist based on user input in the search bar
-void PlaylistComponent::filterPlaylist()
-{
-    currentSearchText = searchInput.getText().toLowerCase();
-    filteredIndices.clear();
-    
-    if (currentSearchText.isEmpty())
-    {
-        // Show all
-        tableComponent.updateContent();
-        return;
-    }
-    
-    // Search and collect matching indices
-    for (int i = 0; i < trackTitles.size(); ++i)
-    {
-        String title = String(trackTitles[i]).toLowerCase();
-        if (title.contains(currentSearchText))
-        {
-            filteredIndices.push_back(i);
-        }
-    }
-    
-    tableComponent.updateContent();
-}
-
-// Paints row background
-void PlaylistComponent::paintRowBackground(Graphics & g, int rowNumber, int width, int height, bool rowIsSelected){
-   
-    if (rowIsSelected)
-    {
-        g.fillAll(Colours::lightblue);
-    }
-    else
-    {
-        g.fillAll(Colours::darkgrey);
-    }
-}
-
-// Paints the track title and queue status inside the table cells
-void PlaylistComponent::paintCell(Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
-{
-    g.setColour(Colours::white);
-    g.setFont(14.0f);
-    
-    // Get actual row index when filtering
-    int actualRow = rowNumber;
-    if (!currentSearchText.isEmpty() && rowNumber < filteredIndices.size())
-    {
-        actualRow = filteredIndices[rowNumber];
-    }
-    
-    // Track Title
-    if (columnId == 1)
-    {
-        g.drawText(trackTitles[actualRow], 2, 0, width - 4, height, Justification::centredLeft, true);
-    }
-    // Left Queue Status
-    else if (columnId == 2)
-    {
-        // Check if track is in left queue
-        for (const auto& track : leftDeckQueue)
-        {
-            if (track.rowIndex == actualRow)
-            {
-                g.setColour(Colours::orange);
-                g.drawText("Queued", 2, 0, width - 4, height, Justification::centred, true);
-                break;
-            }
-        }
-    }
-    // Right Queue Status
-    else if (columnId == 3)
-    {
-        // Check if track is in right queue
-        for (const auto& track : rightDeckQueue)
-        {
-            if (track.rowIndex == actualRow)
-            {
-                g.setColour(Colours::orange);
-                g.drawText("Queued", 2, 0, width - 4, height, Justification::centred, true);
-                break;
-            }
-        }
-    }
-}
-
-// Create UI components for load, delete,
-Component* PlaylistComponent::refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, Component* existingComponentToUpdate)
-{
-    // Get the actual row index when filtering
-    int actualRow = rowNumber;
-    if (!currentSearchText.isEmpty() && rowNumber < filteredIndices.size())
-    {
-        actualRow = filteredIndices[rowNumber];
-    }
-
-    return existingComponentToUpdate;
-}
-
-// Update buttonClicked to handle clearSearchButton:
-void PlaylistComponent::buttonClicked(Button* button)
-{
-    // Check which button was clicked
-    if (button == &addToLeftDeckButton)
-    {
-        int selectedRow = tableComponent.getSelectedRow();
-        if (selectedRow >= 0)
-        {
-            // Get actual row when filtering
-            if (!currentSearchText.isEmpty() && selectedRow < filteredIndices.size())
-            {
-                selectedRow = filteredIndices[selectedRow];
-            }
-            addToQueue(selectedRow, true);
-        }
-    }
-    else if (button == &addToRightDeckButton)
-    {
-        int selectedRow = tableComponent.getSelectedRow();
-        if (selectedRow >= 0)
-        {
-            // Get actual row when filtering
-            if (!currentSearchText.isEmpty() && selectedRow < filteredIndices.size())
-            {
-                selectedRow = filteredIndices[selectedRow];
-            }
-            addToQueue(selectedRow, false);
-        }
-    }
-    else if (button == &playNextLeftButton)
-    {
-        playNextInQueue(true);
-    }
-    else if (button == &playNextRightButton)
-    {
-        playNextInQueue(false);
-    }
-    else if (button == &clearSearchButton)
-    {
-        searchInput.setText("", false);
-        currentSearchText = "";
-        filteredIndices.clear();
-        tableComponent.updateContent();
-    }
-    else if (button == &deleteButton)
-    {
-        int selectedRow = tableComponent.getSelectedRow();
-        if (selectedRow >= 0)
-        {
-            // Get actual row when filtering
-            if (!currentSearchText.isEmpty() && selectedRow < filteredIndices.size())
-            {
-                selectedRow = filteredIndices[selectedRow];
-            }
-            
-            if (selectedRow < trackTitles.size())
-            {
-                // Remove from queues if present
-                for (auto it = leftDeckQueue.begin(); it != leftDeckQueue.end();)
-                {
-                    if (it->rowIndex == selectedRow)
-                    {
-                        it = leftDeckQueue.erase(it);
-                    }
-                    else if (it->rowIndex > selectedRow)
-                    {
-                        // Adjust indices for tracks after the deleted one
-                        it->rowIndex--;
-                        ++it;
-                    }
-                    else
-                    {
-                        ++it;
-                    }
-                }
-                
-                for (auto it = rightDeckQueue.begin(); it != rightDeckQueue.end();)
-                {
-                    if (it->rowIndex == selectedRow)
-                    {
-                        it = rightDeckQueue.erase(it);
-                    }
-                    else if (it->rowIndex > selectedRow)
-                    {
-                        // Adjust indices for tracks after the deleted one
-                        it->rowIndex--;
-                        ++it;
-                    }
-                    else
-                    {
-                        ++it;
-                    }
-                }
-                
-                // Remove from playlist
-                trackTitles.erase(trackTitles.begin() + selectedRow);
-                trackURLs.erase(trackURLs.begin() + selectedRow);
-                
-                // Re-filter if we're searching
-                if (!currentSearchText.isEmpty())
-                {
-                    filterPlaylist();
-                }
-                else
-                {
-                    tableComponent.updateContent();
-                }
-                updateQueueButtons();
-            }
-        }
-    }
-    else
-    {
-        // Check if it's a load or delete button
-        String componentID = button->getComponentID();
-        
-        if (componentID.isNotEmpty())
-        {
-            char action = componentID[0];
-            int rowNumber = componentID.substring(1).getIntValue();
-            
-            if (rowNumber >= 0 && rowNumber < trackTitles.size())
-            {
-                if (action == 'L') // Load to Left Deck
-                {
-                    loadFileToPlayer(trackURLs[rowNumber], true);
-                }
-                else if (action == 'R') // Load to Right Deck
-                {
-                    loadFileToPlayer(trackURLs[rowNumber], false);
-                }
-                else if (action == 'D') // Delete from playlist
-                {
-                    // Remove from queues if present
-                    for (auto it = leftDeckQueue.begin(); it != leftDeckQueue.end();)
-                    {
-                        if (it->rowIndex == rowNumber)
-                        {
-                            it = leftDeckQueue.erase(it);
-                        }
-                        else if (it->rowIndex > rowNumber)
-                        {
-                            // Adjust indices for tracks after the deleted one
-                            it->rowIndex--;
-                            ++it;
-                        }
-                        else
-                        {
-                            ++it;
-                        }
-                    }
-                    
-                    for (auto it = rightDeckQueue.begin(); it != rightDeckQueue.end();)
-                    {
-                        if (it->rowIndex == rowNumber)
-                        {
-                            it = rightDeckQueue.erase(it);
-                        }
-                        else if (it->rowIndex > rowNumber)
-                        {
-                            // Adjust indices for tracks after the deleted one
-                            it->rowIndex--;
-                            ++it;
-                        }
-                        else
-                        {
-                            ++it;
-                        }
-                    }
-                    
-                    // Remove from playlist
-                    trackTitles.erase(trackTitles.begin() + rowNumber);
-                    trackURLs.erase(trackURLs.begin() + rowNumber);
-                    
-                    // Re-filter if we're searching
-                    if (!currentSearchText.isEmpty())
-                    {
-                        filterPlaylist();
-                    }
-                    else
-                    {
-                        tableComponent.updateContent();
-                    }
-                    updateQueueButtons();
-                }
-            }
-        }
-    }
-}
-
-// Drag & drop file handling
-bool PlaylistComponent::isInterestedInFileDrag(const StringArray& files)
-{
-    // Accept audio file types
-    for (const String& file : files)
-    {
-        if (file.contains(".wav") || file.contains(".mp3") || file.contains(".aif"))
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-// Handles file drop events and adds tracks to the playlist
-void PlaylistComponent::filesDropped(const StringArray& files, int x, int y)
-{
-    for (const String& filename : files)
-    {
-        URL fileURL = URL(File(filename));
-        File file(filename);
-        addToPlaylist(fileURL, file.getFileNameWithoutExtension());
-    }
-}
-
-// Adds a track to the playlist
-void PlaylistComponent::addToPlaylist(URL trackURL, const String& trackTitle)
-{
-    // Push to vectors
-    trackURLs.push_back(trackURL);
-    trackTitles.push_back(trackTitle.toStdString());
-    // Update table
-    tableComponent.updateContent();
-}
-
-// Adds a track to the queue for playback
-void PlaylistComponent::addToQueue(int rowNumber, bool leftDeck)
-{
-    if (rowNumber >= 0 && rowNumber < trackTitles.size())
-    {
-        QueuedTrack track;
-        track.url = trackURLs[rowNumber];
-        track.title = trackTitles[rowNumber];
-        track.rowIndex = rowNumber;
-        
-        if (leftDeck)
-        {
-            leftDeckQueue.push_back(track);
-        }
-        else
-        {
-            rightDeckQueue.push_back(track);
-        }
-        
-        updateQueueButtons();
-        tableComponent.updateContent();
-    }
-}
-
-// Play next track in queue
-void PlaylistComponent::playNextInQueue(bool leftDeck)
-{
-    if (leftDeck && !leftDeckQueue.empty())
-    {
-        QueuedTrack track = leftDeckQueue.front();
-        leftDeckQueue.erase(leftDeckQueue.begin());
-        
-        loadFileToPlayer(track.url, true);
-    }
-    else if (!leftDeck && !rightDeckQueue.empty())
-    {
-        QueuedTrack track = rightDeckQueue.front();
-        rightDeckQueue.erase(rightDeckQueue.begin());
-        
-        loadFileToPlayer(track.url, false);
-    }
-    
-    updateQueueButtons();
-    tableComponent.updateContent();
-}
-
-// Loads file
-void PlaylistComponent::loadFileToPlayer(URL fileURL, bool leftDeck)
-{
-    if (leftDeck)
-    {
-        player1->loadURL(fileURL);
-    }
-    else
-    {
-        player2->loadURL(fileURL);
-    }
-}
-
-// Updates state of play next according to queue (empty or not)
-void PlaylistComponent::updateQueueButtons()
-{
-    playNextLeftButton.setEnabled(!leftDeckQueue.empty());
-    playNextRightButton.setEnabled(!rightDeckQueue.empty());
-}
-
-
+#include <JuceHeader.h>
+#include "PlaylistComponent.h"
+
+// Constructor for PlaylistComponent, initialises the table and UI elements
+PlaylistComponent::PlaylistComponent(DJAudioPlayer* _player1, DJAudioPlayer* _player2, TrackCache& _trackCache,
+                                     TrackLibrary& _library, AudioFormatManager& formatManager)
+: library(_library), importer(formatManager), beatAnalyser(formatManager), player1(_player1), player2(_player2), trackCache(_trackCache)
+{
+    // Add the table component and set it as the model
+    addAndMakeVisible(tableComponent);
+    tableComponent.setModel(this);
+    
+    // Define table columns for track title and queue management
+    tableComponent.getHeader().addColumn("Track title", 1, 600);
+    tableComponent.getHeader().addColumn("Left Queue", 2, 100);
+    tableComponent.getHeader().addColumn("Right Queue", 3, 100);
+    tableComponent.getHeader().addColumn("BPM", 4, 70);
+    
+    // Initialise deck buttons for adding tracks to left and right decks
+    addAndMakeVisible(addToLeftDeckButton);
+    addToLeftDeckButton.addListener(this);
+    addAndMakeVisible(addToRightDeckButton);
+    addToRightDeckButton.addListener(this);
+    
+    // Initialise queue management buttons
+    addAndMakeVisible(playNextLeftButton);
+    playNextLeftButton.addListener(this);
+    playNextLeftButton.setEnabled(false);
+    
+    addAndMakeVisible(playNextRightButton);
+    playNextRightButton.addListener(this);
+    playNextRightButton.setEnabled(false);
+    
+    // Initialise delete button for removing tracks
+    addAndMakeVisible(deleteButton);
+    deleteButton.addListener(this);
+
+    // Initialise auto-advance toggles
+    addAndMakeVisible(autoAdvanceButton);
+    autoAdvanceButton.addListener(this);
+    addAndMakeVisible(crossfadeButton);
+    crossfadeButton.setEnabled(false);
+
+    player1->addListener(this);
+    player2->addListener(this);
+    
+    // Initialise search input and clear search button
+    addAndMakeVisible(searchInput);
+    searchInput.setTextToShowWhenEmpty("Search tracks...", Colours::grey);
+    searchInput.onTextChange = [this] { filterPlaylist(); };
+        
+    addAndMakeVisible(clearSearchButton);
+    clearSearchButton.addListener(this);
+        
+    // Initialise search text
+    currentSearchText = "";
+
+    importer.onTracksFound = [this] (const std::vector<TrackLibrary::TrackInfo>& tracks) { addToPlaylist(tracks); };
+
+    // Beat grids are kept with the tracks, so each one is only analysed once
+    beatAnalyser.onAnalysed = [this] (TrackLibrary::TrackId id, BeatGrid grid)
+    {
+        auto index = library.indexOf(id);
+
+        if (index >= 0)
+        {
+            // A track without a beat is marked too, so it isn't analysed again next session
+            auto track = library.getTrack(index);
+            track.bpm = grid.bpm;
+            track.firstBeatSeconds = grid.firstBeatSeconds;
+            track.beatsAnalysed = true;
+            library.updateTrack(index, track);
+
+            // A deck that loaded the track before its beats were known picks them up now
+            player1->setAnalysedBeatGrid(track.url, grid);
+            player2->setAnalysedBeatGrid(track.url, grid);
+
+            tableComponent.repaint();
+        }
+    };
+
+    // Often enough that rows scrolled into view get their tempo soon after
+    startTimer(250);
+}
+
+// Destructor
+PlaylistComponent::~PlaylistComponent()
+{
+    player1->removeListener(this);
+    player2->removeListener(this);
+}
+
+// Paint background with default colour
+void PlaylistComponent::paint (juce::Graphics& g)
+{
+    g.fillAll(getLookAndFeel().findColour(ResizableWindow::backgroundColourId));
+
+}
+
+// Layout of GUI for playlist
+void PlaylistComponent::resized()
+{
+    // Position the queue management controls at the top
+    auto area = getLocalBounds();
+    auto topSection = area.removeFromTop(40);
+    
+    // Position the search components
+    auto searchArea = area.removeFromTop(40);
+    searchInput.setBounds(searchArea.removeFromLeft(getWidth() - 100).reduced(5, 5));
+    clearSearchButton.setBounds(searchArea.reduced(5, 5));
+    
+    // Position the deck buttons
+    int buttonWidth = topSection.getWidth() / 4;
+    
+    addToLeftDeckButton.setBounds(topSection.removeFromLeft(buttonWidth));
+    addToRightDeckButton.setBounds(topSection.removeFromLeft(buttonWidth));
+    playNextLeftButton.setBounds(topSection.removeFromLeft(buttonWidth));
+    playNextRightButton.setBounds(topSection.removeFromLeft(buttonWidth));
+    
+    // Position the delete button between the auto-advance toggles
+    auto deleteRow = area.removeFromTop(30);
+    autoAdvanceButton.setBounds(deleteRow.removeFromLeft(getWidth() / 4).reduced(5, 0));
+    crossfadeButton.setBounds(deleteRow.removeFromRight(getWidth() / 4).reduced(5, 0));
+    deleteButton.setBounds(deleteRow);
+    
+    // Position the table
+    tableComponent.setBounds(area.reduced(0, 10));
+}
+
+// Returns the number of rows in the table, accounting for search filtering
+int PlaylistComponent::getNumRows()
+{
+    if (currentSearchText.isEmpty())
+    {
+        return library.getNumTracks();
+    }
+    else
+    {
+        return filteredIndices.size();
+    }
+}
+
+// Filters the playlist based on user input in the search bar
+void PlaylistComponent::filterPlaylist()
+{
+    currentSearchText = searchInput.getText().toLowerCase();
+    filteredIndices.clear();
+    
+    if (currentSearchText.isEmpty())
+    {
+        // Show all
+        tableComponent.updateContent();
+        return;
+    }
+    
+    // Every title is read once, the first time anything is searched for
+    if (! searchIndexBuilt)
+    {
+        for (int i = 0; i < library.getNumTracks(); ++i)
+            searchIndex.add(library.getTitle(i));
+
+        searchIndexBuilt = true;
+    }
+
+    // Search and collect matching indices
+    filteredIndices = searchIndex.search(currentSearchText);
+    
+    tableComponent.updateContent();
+}
+
+// Paints row background
+void PlaylistComponent::paintRowBackground(Graphics & g, int rowNumber, int width, int height, bool rowIsSelected){
+   
+    if (rowIsSelected)
+    {
+        g.fillAll(Colours::lightblue);
+    }
+    else
+    {
+        g.fillAll(Colours::darkgrey);
+    }
+}
+
+void PlaylistComponent::timerCallback()
+{
+    if (isShowing())
+        analyseVisibleRows();
+}
+
+// Queues analysis for visible rows without a beat grid, painting the rows only reads them
+void PlaylistComponent::analyseVisibleRows()
+{
+    auto* viewport = tableComponent.getViewport();
+    auto rowHeight = jmax(1, tableComponent.getRowHeight());
+    auto numRows = getNumRows();
+
+    auto top = viewport->getViewPositionY();
+    Range<int> rows (jmin(numRows, top / rowHeight),
+                     jmin(numRows, (top + viewport->getViewHeight()) / rowHeight + 1));
+
+    if (rows == checkedRows && numRows == checkedNumRows && currentSearchText == checkedSearchText)
+        return;
+
+    checkedRows = rows;
+    checkedNumRows = numRows;
+    checkedSearchText = currentSearchText;
+
+    for (auto row = rows.getStart(); row < rows.getEnd(); ++row)
+    {
+        auto actualRow = currentSearchText.isEmpty() ? row : filteredIndices[(size_t) row];
+        auto id = library.getTrackId(actualRow);
+
+        if (! beatsRequested.insert(id).second)
+            continue;
+
+        auto track = library.getTrack(actualRow);
+
+        if (! track.beatsAnalysed)
+            beatAnalyser.analyse(id, track.url, false);
+    }
+}
+
+// Paints the track title and queue status inside the table cells
+void PlaylistComponent::paintCell(Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
+{
+    g.setColour(Colours::white);
+    g.setFont(14.0f);
+    
+    // Get actual row index when filtering
+    int actualRow = rowNumber;
+    if (!currentSearchText.isEmpty() && rowNumber < filteredIndices.size())
+    {
+        actualRow = filteredIndices[rowNumber];
+    }
+    
+    // Track Title
+    if (columnId == 1)
+    {
+        g.drawText(library.getTitle(actualRow), 2, 0, width - 4, height, Justification::centredLeft, true);
+    }
+    // Left Queue Status
+    else if (columnId == 2)
+    {
+        // Check if track is in left queue
+        if (leftDeckQueue.contains(library.getTrackId(actualRow)))
+        {
+            g.setColour(Colours::orange);
+            g.drawText("Queued", 2, 0, width - 4, height, Justification::centred, true);
+        }
+    }
+    // Right Queue Status
+    else if (columnId == 3)
+    {
+        // Check if track is in right queue
+        if (rightDeckQueue.contains(library.getTrackId(actualRow)))
+        {
+            g.setColour(Colours::orange);
+            g.drawText("Queued", 2, 0, width - 4, height, Justification::centred, true);
+        }
+    }
+    // Tempo, the timer has tracks without one analysed as they scroll into view
+    else if (columnId == 4)
+    {
+        auto track = library.getTrack(actualRow);
+
+        if (track.bpm > 0)
+        {
+            g.drawText(String(track.bpm, 1), 2, 0, width - 4, height, Justification::centredRight, true);
+        }
+        else if (track.beatsAnalysed)
+        {
+            g.setColour(Colours::grey);
+            g.drawText("-", 2, 0, width - 4, height, Justification::centredRight, true);
+        }
+    }
+}
+
+// Create UI components for load, delete,
+Component* PlaylistComponent::refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, Component* existingComponentToUpdate)
+{
+    // Get the actual row index when filtering
+    int actualRow = rowNumber;
+    if (!currentSearchText.isEmpty() && rowNumber < filteredIndices.size())
+    {
+        actualRow = filteredIndices[rowNumber];
+    }
+
+    return existingComponentToUpdate;
+}
+
+// Update buttonClicked to handle clearSearchButton:
+void PlaylistComponent::buttonClicked(Button* button)
+{
+    // Check which button was clicked
+    if (button == &addToLeftDeckButton)
+    {
+        int selectedRow = tableComponent.getSelectedRow();
+        if (selectedRow >= 0)
+        {
+            // Get actual row when filtering
+            if (!currentSearchText.isEmpty() && selectedRow < filteredIndices.size())
+            {
+                selectedRow = filteredIndices[selectedRow];
+            }
+            addToQueue(selectedRow, true);
+        }
+    }
+    else if (button == &addToRightDeckButton)
+    {
+        int selectedRow = tableComponent.getSelectedRow();
+        if (selectedRow >= 0)
+        {
+            // Get actual row when filtering
+            if (!currentSearchText.isEmpty() && selectedRow < filteredIndices.size())
+            {
+                selectedRow = filteredIndices[selectedRow];
+            }
+            addToQueue(selectedRow, false);
+        }
+    }
+    else if (button == &playNextLeftButton)
+    {
+        playNextInQueue(true);
+    }
+    else if (button == &playNextRightButton)
+    {
+        playNextInQueue(false);
+    }
+    else if (button == &clearSearchButton)
+    {
+        searchInput.setText("", false);
+        currentSearchText = "";
+        filteredIndices.clear();
+        tableComponent.updateContent();
+    }
+    else if (button == &autoAdvanceButton)
+    {
+        bool autoAdvance = autoAdvanceButton.getToggleState();
+        auto warning = autoAdvance ? autoAdvanceWarningSeconds : 0.0;
+
+        player1->setTrackEndWarning(warning);
+        player2->setTrackEndWarning(warning);
+        crossfadeButton.setEnabled(autoAdvance);
+
+        // Tracks already lined up go back to the front of their queues
+        if (! autoAdvance)
+        {
+            player1->clearNextURL();
+            player2->clearNextURL();
+        }
+    }
+    else if (button == &deleteButton)
+    {
+        int selectedRow = tableComponent.getSelectedRow();
+        if (selectedRow >= 0)
+        {
+            // Get actual row when filtering
+            if (!currentSearchText.isEmpty() && selectedRow < filteredIndices.size())
+            {
+                selectedRow = filteredIndices[selectedRow];
+            }
+            
+            if (selectedRow < library.getNumTracks())
+            {
+                removeTrack(selectedRow);
+            }
+        }
+    }
+    else
+    {
+        // Check if it's a load or delete button
+        String componentID = button->getComponentID();
+        
+        if (componentID.isNotEmpty())
+        {
+            char action = componentID[0];
+            int rowNumber = componentID.substring(1).getIntValue();
+            
+            if (rowNumber >= 0 && rowNumber < library.getNumTracks())
+            {
+                if (action == 'L') // Load to Left Deck
+                {
+                    loadFileToPlayer(library.getURL(rowNumber), true, getBeatGrid(library.getTrackId(rowNumber)));
+                }
+                else if (action == 'R') // Load to Right Deck
+                {
+                    loadFileToPlayer(library.getURL(rowNumber), false, getBeatGrid(library.getTrackId(rowNumber)));
+                }
+                else if (action == 'D') // Delete from playlist
+                {
+                    removeTrack(rowNumber);
+                }
+            }
+        }
+    }
+}
+
+// Drag & drop file handling
+bool PlaylistComponent::isInterestedInFileDrag(const StringArray& files)
+{
+    // Accept folders and any file a registered format reads
+    for (const String& file : files)
+    {
+        if (importer.canImport(File(file)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Handles file drop events and adds tracks to the playlist
+void PlaylistComponent::filesDropped(const StringArray& files, int x, int y)
+{
+    // Folders are searched and headers read off the message thread, rows arrive in batches
+    importer.importAsync(files);
+}
+
+// Adds a track to the playlist
+void PlaylistComponent::addToPlaylist(URL trackURL, const String& trackTitle)
+{
+    // Store in the library, the rest of what it knows about the track is filled in later
+    TrackLibrary::TrackInfo track;
+    track.url = trackURL;
+    track.title = trackTitle;
+    auto id = library.addTrack(track);
+    beatsRequested.insert(id);
+    beatAnalyser.analyse(id, trackURL, false);
+
+    if (searchIndexBuilt)
+        searchIndex.add(trackTitle);
+
+    if (idsByURLBuilt)
+        idsByURL[trackURL.toString(false).toStdString()].push_back(id);
+
+    // Update table
+    tableComponent.updateContent();
+}
+
+// Adds a batch of imported tracks, updating the table once for all of them
+void PlaylistComponent::addToPlaylist(const std::vector<TrackLibrary::TrackInfo>& tracks)
+{
+    for (const auto& track : tracks)
+    {
+        auto id = library.addTrack(track);
+        beatsRequested.insert(id);
+        beatAnalyser.analyse(id, track.url, false);
+
+        if (searchIndexBuilt)
+            searchIndex.add(track.title);
+
+        if (idsByURLBuilt)
+            idsByURL[track.url.toString(false).toStdString()].push_back(id);
+    }
+
+    // New tracks may match the current search
+    if (!currentSearchText.isEmpty())
+    {
+        filterPlaylist();
+    }
+    else
+    {
+        tableComponent.updateContent();
+    }
+}
+
+// Adds a track to the queue for playback
+void PlaylistComponent::addToQueue(int rowNumber, bool leftDeck)
+{
+    if (rowNumber >= 0 && rowNumber < library.getNumTracks())
+    {
+        QueuedTrack track;
+        track.id = library.getTrackId(rowNumber);
+        track.url = library.getURL(rowNumber);
+        track.title = library.getTitle(rowNumber);
+
+        // Decode it now so loading it later is a memory read
+        trackCache.pin(track.url);
+        trackCache.requestDecode(track.url);
+
+        // Its tempo is needed before anything else's
+        if (! library.getTrack(rowNumber).beatsAnalysed)
+        {
+            beatsRequested.insert(track.id);
+            beatAnalyser.analyse(track.id, track.url, true);
+        }
+
+        auto& queue = leftDeck ? leftDeckQueue : rightDeckQueue;
+        queue.tracks.push_back(track);
+        ++queue.counts[track.id];
+        
+        updateQueueButtons();
+        tableComponent.updateContent();
+    }
+}
+
+// Play next track in queue
+void PlaylistComponent::playNextInQueue(bool leftDeck)
+{
+    auto& queue = leftDeck ? leftDeckQueue : rightDeckQueue;
+    QueuedTrack track;
+
+    if (popNextInQueue(queue, track))
+    {
+        // The player pins the track for the length of its load, so the queue's pin can go now
+        loadFileToPlayer(track.url, leftDeck, getBeatGrid(track.id));
+        trackCache.unpin(track.url);
+    }
+    
+    updateQueueButtons();
+    tableComponent.updateContent();
+}
+
+// Lines up the deck's next queued track behind the one that is ending
+void PlaylistComponent::trackEnding(DJAudioPlayer* player)
+{
+    if (! autoAdvanceButton.getToggleState())
+        return;
+
+    auto& queue = (player == player1) ? leftDeckQueue : rightDeckQueue;
+    QueuedTrack track;
+
+    if (popNextInQueue(queue, track))
+    {
+        player->loadNextURL(track.url, crossfadeButton.getToggleState() ? autoAdvanceCrossfadeSeconds : 0.0,
+                            getBeatGrid(track.id));
+        trackCache.unpin(track.url);
+
+        // Set after the load, which drops whatever was lined up before
+        queue.linedUp = track;
+        queue.hasLinedUp = true;
+
+        updateQueueButtons();
+        tableComponent.updateContent();
+    }
+}
+
+void PlaylistComponent::nextTrackStarted(DJAudioPlayer* player, const URL& url)
+{
+    auto& queue = (player == player1) ? leftDeckQueue : rightDeckQueue;
+
+    if (queue.hasLinedUp && queue.linedUp.url == url)
+        queue.hasLinedUp = false;
+}
+
+// Cleared by turning auto-advance off, loading the deck by hand or a failed load
+void PlaylistComponent::nextTrackDropped(DJAudioPlayer* player, const URL& url)
+{
+    auto& queue = (player == player1) ? leftDeckQueue : rightDeckQueue;
+
+    if (! queue.hasLinedUp || queue.linedUp.url != url)
+        return;
+
+    queue.hasLinedUp = false;
+
+    // Not put back if it was removed from the playlist meanwhile
+    if (library.indexOf(queue.linedUp.id) < 0)
+        return;
+
+    trackCache.pin(url);
+    trackCache.requestDecode(url);
+    queue.tracks.push_front(queue.linedUp);
+    ++queue.counts[queue.linedUp.id];
+
+    updateQueueButtons();
+    tableComponent.updateContent();
+}
+
+bool PlaylistComponent::popNextInQueue(DeckQueue& queue, QueuedTrack& track)
+{
+    while (!queue.tracks.empty())
+    {
+        track = queue.tracks.front();
+        queue.tracks.pop_front();
+
+        // Tracks removed from the playlist while queued are skipped
+        auto count = queue.counts.find(track.id);
+
+        if (count == queue.counts.end())
+            continue;
+
+        if (--count->second == 0)
+            queue.counts.erase(count);
+
+        return true;
+    }
+
+    return false;
+}
+
+// Loads file
+void PlaylistComponent::loadFileToPlayer(URL fileURL, bool leftDeck, BeatGrid beatGrid)
+{
+    if (leftDeck)
+    {
+        player1->loadURL(fileURL, beatGrid);
+    }
+    else
+    {
+        player2->loadURL(fileURL, beatGrid);
+    }
+}
+
+BeatGrid PlaylistComponent::findBeatGrid(const URL& url)
+{
+    if (! idsByURLBuilt)
+    {
+        for (int i = 0; i < library.getNumTracks(); ++i)
+            idsByURL[library.getURL(i).toString(false).toStdString()].push_back(library.getTrackId(i));
+
+        idsByURLBuilt = true;
+    }
+
+    auto found = idsByURL.find(url.toString(false).toStdString());
+
+    if (found == idsByURL.end() || found->second.empty())
+        return {};
+
+    auto id = found->second.front();
+    auto index = library.indexOf(id);
+
+    if (index < 0)
+        return {};
+
+    auto track = library.getTrack(index);
+
+    if (! track.beatsAnalysed)
+    {
+        beatsRequested.insert(id);
+        beatAnalyser.analyse(id, track.url, true);
+        return {};
+    }
+
+    BeatGrid grid;
+    grid.bpm = track.bpm;
+    grid.firstBeatSeconds = track.firstBeatSeconds;
+    return grid;
+}
+
+BeatGrid PlaylistComponent::getBeatGrid(TrackLibrary::TrackId id) const
+{
+    BeatGrid grid;
+    auto index = library.indexOf(id);
+
+    if (index >= 0)
+    {
+        auto track = library.getTrack(index);
+        grid.bpm = track.bpm;
+        grid.firstBeatSeconds = track.firstBeatSeconds;
+    }
+
+    return grid;
+}
+
+// Updates state of play next according to queue (empty or not)
+void PlaylistComponent::updateQueueButtons()
+{
+    playNextLeftButton.setEnabled(!leftDeckQueue.isEmpty());
+    playNextRightButton.setEnabled(!rightDeckQueue.isEmpty());
+}
+
+// Removes a track from the playlist and both queues, the rows after it move up
+void PlaylistComponent::removeTrack(int row)
+{
+    auto id = library.getTrackId(row);
+    auto url = library.getURL(row);
+
+    // Any other copies of the same file are still found
+    if (idsByURLBuilt)
+    {
+        auto found = idsByURL.find(url.toString(false).toStdString());
+
+        if (found != idsByURL.end())
+        {
+            auto& ids = found->second;
+            ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+
+            if (ids.empty())
+                idsByURL.erase(found);
+        }
+    }
+
+    // Unpinned once for each time it was queued
+    for (auto* queue : { &leftDeckQueue, &rightDeckQueue })
+    {
+        auto count = queue->counts.find(id);
+
+        if (count != queue->counts.end())
+        {
+            for (int i = 0; i < count->second; ++i)
+                trackCache.unpin(url);
+
+            queue->counts.erase(count);
+        }
+    }
+
+    // Remove from playlist
+    library.removeTrack(row);
+
+    if (searchIndexBuilt)
+        searchIndex.remove(row);
+
+    // Re-filter if we're searching
+    if (!currentSearchText.isEmpty())
+    {
+        filterPlaylist();
+    }
+    else
+    {
+        tableComponent.updateContent();
+    }
+    updateQueueButtons();
+}
+
+
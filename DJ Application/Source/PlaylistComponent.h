@@ -1,86 +1,169 @@
-#pragma once
-
-#include <JuceHeader.h>
-#include <vector>
-#include <string>
-#include "DJAudioPlayer.h"
-#include "DeckGUI.h"
-
-// Defines class that manages a playlist of audio tracks
-class PlaylistComponent  : public juce::Component,
-public TableListBoxModel, public Button::Listener,
-public FileDragAndDropTarget
-{
-public:
-    // Initialises PlaylistComponent with references to two DJ players.
-    PlaylistComponent(DJAudioPlayer* player1, DJAudioPlayer* player2);
-    ~PlaylistComponent() override;
-
-    void paint (juce::Graphics&) override;
-    void resized() override;
-    
-    // TableListBoxModel overrides for playlist table
-    int getNumRows() override;
-    void paintRowBackground(Graphics & g, int rowNumber, int width, int height, bool rowIsSelected) override;
-    void paintCell(Graphics & g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
-
-    Component* refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, Component *existingComponentToUpdate) override;
-    
-    // Handles button clicks
-    void buttonClicked(Button * button) override;
-    
-    // File Drag & Drop Implementation
-    bool isInterestedInFileDrag(const StringArray& files) override;
-    void filesDropped(const StringArray& files, int x, int y) override;
-    // Add track to playlist
-    void addToPlaylist(URL trackURL, const String& trackTitle);
-       
-    // Methods for queue management
-    void addToQueue(int rowNumber, bool leftDeck);
-    void playNextInQueue(bool leftDeck);
-    
-    
-private:
-    TableListBox tableComponent;
-    std::vector<std::string> trackTitles;
-    
-    std::vector<URL> trackURLs;
-    
-    // Track queue structures
-    struct QueuedTrack
-    {
-        URL url;
-        String title;
-        int rowIndex;
-    };
-        
-    std::vector<QueuedTrack> leftDeckQueue;
-    std::vector<QueuedTrack> rightDeckQueue;
-        
-    // Search functionality
-    TextEditor searchInput;
-    TextButton clearSearchButton{"Clear"};
-    std::vector<int> filteredIndices;
-    String currentSearchText;
-    void filterPlaylist(); // Helper function to filter playlist
-    
-    // Reference to player for playback
-    DJAudioPlayer* player1;
-    DJAudioPlayer* player2;
-    
-    // UI Components for deck selection and queue management
-    TextButton addToLeftDeckButton{"Add to Left Deck"};
-    TextButton addToRightDeckButton{"Add to Right Deck"};
-    TextButton playNextLeftButton{"Play Next (Left)"};
-    TextButton playNextRightButton{"Play Next (Right)"};
-        
-    // Delete track button
-    TextButton deleteButton{"Delete"};
-        
-    // Helper methods
-    void loadFileToPlayer(URL fileURL, bool leftDeck);
-    void updateQueueButtons();
-    
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlaylistComponent)
-};
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <string>
+#include "BeatAnalyser.h"
+#include "DJAudioPlayer.h"
+#include "DeckGUI.h"
+#include "TrackCache.h"
+#include "TrackImporter.h"
+#include "TrackLibrary.h"
+#include "TrackSearchIndex.h"
+
+// Defines class that manages a playlist of audio tracks
+class PlaylistComponent  : public juce::Component,
+public TableListBoxModel, public Button::Listener,
+public FileDragAndDropTarget, public DJAudioPlayer::Listener,
+private Timer
+{
+public:
+    // Initialises PlaylistComponent with references to two DJ players.
+    // Queued tracks are pinned and decoded ahead of time in the track cache,
+    // the tracks themselves live in the library. Dropped files are read with the format manager
+    PlaylistComponent(DJAudioPlayer* player1, DJAudioPlayer* player2, TrackCache& trackCache, TrackLibrary& library,
+                      AudioFormatManager& formatManager);
+    ~PlaylistComponent() override;
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+    
+    // TableListBoxModel overrides for playlist table
+    int getNumRows() override;
+    void paintRowBackground(Graphics & g, int rowNumber, int width, int height, bool rowIsSelected) override;
+    void paintCell(Graphics & g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
+
+    Component* refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, Component *existingComponentToUpdate) override;
+    
+    // Handles button clicks
+    void buttonClicked(Button * button) override;
+    
+    // File Drag & Drop Implementation
+    bool isInterestedInFileDrag(const StringArray& files) override;
+    void filesDropped(const StringArray& files, int x, int y) override;
+    // Add track to playlist
+    void addToPlaylist(URL trackURL, const String& trackTitle);
+    void addToPlaylist(const std::vector<TrackLibrary::TrackInfo>& tracks);
+       
+    // Methods for queue management
+    void addToQueue(int rowNumber, bool leftDeck);
+    void playNextInQueue(bool leftDeck);
+
+    // With auto-advance on, a deck nearing the end of its track lines up the next one
+    // in its queue to follow it without a gap
+    void trackEnding(DJAudioPlayer* player) override;
+
+    // Beats for a track loaded onto a deck from outside the playlist, looked up by its file.
+    // A playlist track without them yet goes to the front of the analyser, and the decks
+    // are given them when they arrive
+    BeatGrid findBeatGrid(const URL& url);
+
+    // A lined-up track that never took over goes back to the front of its queue
+    void nextTrackStarted(DJAudioPlayer* player, const URL& url) override;
+    void nextTrackDropped(DJAudioPlayer* player, const URL& url) override;
+
+private:
+    TableListBox tableComponent;
+
+    // Rows are the library's tracks in order
+    TrackLibrary& library;
+
+    // Dropped files and folders are read in the background and added as they are found
+    TrackImporter importer;
+
+    // Tempo of new, visible and queued tracks, queued ones first
+    BeatAnalyser beatAnalyser;
+
+    // Tracks whose beats are known or on their way, so scrolling back over them is free
+    std::unordered_set<TrackLibrary::TrackId> beatsRequested;
+
+    // Rows checked on the last tick, only a scroll, search or edit checks them again
+    Range<int> checkedRows;
+    int checkedNumRows = -1;
+    String checkedSearchText;
+
+    // Watches which rows are on screen and asks for the beats of those without any
+    void timerCallback() override;
+    void analyseVisibleRows();
+    
+    // Track queue structures, tracks are held by id as removing a track moves the rows
+    // after it up
+    struct QueuedTrack
+    {
+        TrackLibrary::TrackId id;
+        URL url;
+        String title;
+    };
+
+    // The tracks waiting for one deck, and how many times each is waiting so a row can
+    // be checked without walking the queue. A removed track leaves the counts at once
+    // and the queue when it reaches the front. The track lined up behind the playing one
+    // is kept until it takes over
+    struct DeckQueue
+    {
+        std::deque<QueuedTrack> tracks;
+        std::unordered_map<TrackLibrary::TrackId, int> counts;
+        QueuedTrack linedUp;
+        bool hasLinedUp = false;
+
+        bool contains(TrackLibrary::TrackId id) const { return counts.find(id) != counts.end(); }
+        bool isEmpty() const { return counts.empty(); }
+    };
+
+    DeckQueue leftDeckQueue;
+    DeckQueue rightDeckQueue;
+
+    // Takes the first track still in the playlist off the queue
+    bool popNextInQueue(DeckQueue& queue, QueuedTrack& track);
+        
+    // Search functionality
+    TextEditor searchInput;
+    TextButton clearSearchButton{"Clear"};
+    std::vector<int> filteredIndices;
+    String currentSearchText;
+
+    // Kept in step with the library, so typing never rescans every title. Built on the
+    // first search, so opening a large library doesn't read every title up front
+    TrackSearchIndex searchIndex;
+    bool searchIndexBuilt = false;
+
+    // Every copy of each file for decks loaded some other way, oldest first. Built on the first lookup
+    std::unordered_map<std::string, std::vector<TrackLibrary::TrackId>> idsByURL;
+    bool idsByURLBuilt = false;
+    void filterPlaylist(); // Helper function to filter playlist
+    
+    // Reference to player for playback
+    DJAudioPlayer* player1;
+    DJAudioPlayer* player2;
+    TrackCache& trackCache;
+    
+    // UI Components for deck selection and queue management
+    TextButton addToLeftDeckButton{"Add to Left Deck"};
+    TextButton addToRightDeckButton{"Add to Right Deck"};
+    TextButton playNextLeftButton{"Play Next (Left)"};
+    TextButton playNextRightButton{"Play Next (Right)"};
+        
+    // Delete track button
+    TextButton deleteButton{"Delete"};
+
+    // Queued tracks follow on by themselves, fading in over the end of the last one if
+    // crossfade is on. The next track is opened this long before the end
+    ToggleButton autoAdvanceButton{"Auto-advance"};
+    ToggleButton crossfadeButton{"Crossfade"};
+    static constexpr double autoAdvanceWarningSeconds = 15.0;
+    static constexpr double autoAdvanceCrossfadeSeconds = 6.0;
+        
+    // Helper methods
+    void loadFileToPlayer(URL fileURL, bool leftDeck, BeatGrid beatGrid = {});
+
+    // The track's beat grid for syncing, invalid until it has been analysed or if it has gone
+    BeatGrid getBeatGrid(TrackLibrary::TrackId id) const;
+    void updateQueueButtons();
+    void removeTrack(int row);
+    
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlaylistComponent)
+};
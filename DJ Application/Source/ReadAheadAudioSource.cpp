@@ -0,0 +1,281 @@
+#include "ReadAheadAudioSource.h"
+
+// Wraps a source with a read-ahead buffer filled by the given thread
+ReadAheadAudioSource::ReadAheadAudioSource(PositionableAudioSource* sourceToBuffer,
+                                           TimeSliceThread& thread,
+                                           int samplesToBuffer,
+                                           int channels)
+: source(sourceToBuffer),
+  backgroundThread(thread),
+  numberOfSamplesToBuffer(jmax(1024, samplesToBuffer)),
+  numberOfChannels(channels)
+{
+    jassert(source != nullptr);
+}
+
+ReadAheadAudioSource::~ReadAheadAudioSource()
+{
+    releaseResources();
+}
+
+// Allocates the ring buffer and starts decoding, without waiting for it
+void ReadAheadAudioSource::prepareToPlay (int samplesPerBlockExpected, double newSampleRate)
+{
+    auto bufferSizeNeeded = jmax(samplesPerBlockExpected * 2, numberOfSamplesToBuffer);
+
+    if (newSampleRate != sampleRate
+        || bufferSizeNeeded != buffer.getNumSamples()
+        || ! isPrepared)
+    {
+        backgroundThread.removeTimeSliceClient(this);
+
+        isPrepared = true;
+        sampleRate = newSampleRate;
+
+        source->prepareToPlay(samplesPerBlockExpected, newSampleRate);
+
+        buffer.setSize(numberOfChannels, bufferSizeNeeded);
+        buffer.clear();
+        publishValidRange(0, 0);
+
+        prefillTarget = jmin((int) newSampleRate / 4, buffer.getNumSamples() / 2);
+
+        backgroundThread.addTimeSliceClient(this);
+        backgroundThread.moveToFrontOfQueue(this);
+    }
+}
+
+float ReadAheadAudioSource::getPrefillProgress() const
+{
+    int64 start, end;
+
+    if (prefillTarget <= 0 || ! readValidRange(start, end))
+        return 0.0f;
+
+    auto pos = jmax((int64) 0, nextPlayPos.load());
+
+    // Nothing is left to decode near the end of the track
+    auto target = jmin((int64) prefillTarget, getTotalLength() - pos);
+
+    if (target <= 0)
+        return 1.0f;
+
+    auto decoded = (pos >= start && pos < end) ? end - pos : 0;
+    return jlimit(0.0f, 1.0f, (float) decoded / (float) target);
+}
+
+bool ReadAheadAudioSource::waitForPrefill(int timeoutMs, const std::function<void (float)>& onProgress)
+{
+    auto startTime = Time::getMillisecondCounter();
+
+    for (;;)
+    {
+        auto progress = getPrefillProgress();
+
+        if (onProgress)
+            onProgress(progress);
+
+        if (progress >= 1.0f)
+            return true;
+
+        if (Time::getMillisecondCounter() - startTime > (uint32) timeoutMs)
+            return false;
+
+        backgroundThread.moveToFrontOfQueue(this);
+        Thread::sleep(5);
+    }
+}
+
+void ReadAheadAudioSource::releaseResources()
+{
+    isPrepared = false;
+    backgroundThread.removeTimeSliceClient(this);
+
+    buffer.setSize(numberOfChannels, 0);
+    source->releaseResources();
+}
+
+// Copies the decoded range for this block, counting an underrun if any of it is missing
+void ReadAheadAudioSource::getNextAudioBlock (const AudioSourceChannelInfo& info)
+{
+    auto pos = nextPlayPos.load();
+    int64 rangeStart, rangeEnd;
+
+    if (! readValidRange(rangeStart, rangeEnd))
+        rangeStart = rangeEnd = 0;
+
+    auto validStart = (int) (jlimit(rangeStart, rangeEnd, pos) - pos);
+    auto validEnd   = (int) (jlimit(rangeStart, rangeEnd, pos + info.numSamples) - pos);
+
+    if (validStart > 0 || validEnd < info.numSamples)
+    {
+        // Only count it when the missing part lies inside the track
+        auto wantedStart = jmax((int64) 0, pos);
+        auto wantedEnd = jmin(getTotalLength(), pos + info.numSamples);
+
+        if (wantedStart < wantedEnd)
+            ++underruns;
+    }
+
+    if (validStart == validEnd)
+    {
+        info.clearActiveBufferRegion();
+    }
+    else
+    {
+        if (validStart > 0)
+            info.buffer->clear(info.startSample, validStart);
+
+        if (validEnd < info.numSamples)
+            info.buffer->clear(info.startSample + validEnd, info.numSamples - validEnd);
+
+        for (int chan = jmin(numberOfChannels, info.buffer->getNumChannels()); --chan >= 0;)
+        {
+            auto startBufferIndex = (int) ((validStart + pos) % buffer.getNumSamples());
+            auto endBufferIndex   = (int) ((validEnd + pos) % buffer.getNumSamples());
+
+            if (startBufferIndex < endBufferIndex)
+            {
+                info.buffer->copyFrom(chan, info.startSample + validStart,
+                                      buffer, chan, startBufferIndex,
+                                      validEnd - validStart);
+            }
+            else
+            {
+                auto initialSize = buffer.getNumSamples() - startBufferIndex;
+
+                info.buffer->copyFrom(chan, info.startSample + validStart,
+                                      buffer, chan, startBufferIndex,
+                                      initialSize);
+
+                info.buffer->copyFrom(chan, info.startSample + validStart + initialSize,
+                                      buffer, chan, 0,
+                                      (validEnd - validStart) - initialSize);
+            }
+        }
+    }
+
+    nextPlayPos += info.numSamples;
+}
+
+// Seeks, the background thread refills from the new position
+void ReadAheadAudioSource::setNextReadPosition (int64 newPosition)
+{
+    nextPlayPos = newPosition;
+    backgroundThread.moveToFrontOfQueue(this);
+}
+
+int64 ReadAheadAudioSource::getNextReadPosition() const
+{
+    auto pos = nextPlayPos.load();
+
+    return (source->isLooping() && pos > 0) ? pos % source->getTotalLength()
+                                            : pos;
+}
+
+// Works out which part of the ring buffer is stale and decodes into it
+bool ReadAheadAudioSource::readNextBufferChunk()
+{
+    int64 newBVS, newBVE, sectionToReadStart, sectionToReadEnd;
+
+    // Only this thread writes the range, so it can read it back directly
+    auto validStart = bufferValidStart.load();
+    auto validEnd = bufferValidEnd.load();
+
+    newBVS = jmax((int64) 0, nextPlayPos.load());
+    newBVE = newBVS + buffer.getNumSamples() - 4;
+    sectionToReadStart = 0;
+    sectionToReadEnd = 0;
+
+    const int maxChunkSize = 2048;
+
+    if (newBVS < validStart || newBVS >= validEnd)
+    {
+        // Playhead jumped outside the buffered range, start again
+        newBVE = jmin(newBVE, newBVS + maxChunkSize);
+
+        sectionToReadStart = newBVS;
+        sectionToReadEnd = newBVE;
+
+        publishValidRange(0, 0);
+    }
+    else if (std::abs((int) (newBVS - validStart)) > 512
+             || std::abs((int) (newBVE - validEnd)) > 512)
+    {
+        // Top up the end of the buffered range. The part about to be overwritten is
+        // dropped from the range first, it all lies behind the playhead
+        newBVE = jmin(newBVE, validEnd + maxChunkSize);
+
+        sectionToReadStart = validEnd;
+        sectionToReadEnd = newBVE;
+
+        publishValidRange(newBVS, jmin(validEnd, newBVE));
+    }
+
+    if (sectionToReadStart == sectionToReadEnd)
+        return false;
+
+    auto bufferIndexStart = (int) (sectionToReadStart % buffer.getNumSamples());
+    auto bufferIndexEnd   = (int) (sectionToReadEnd % buffer.getNumSamples());
+
+    if (bufferIndexStart < bufferIndexEnd)
+    {
+        readBufferSection(sectionToReadStart,
+                          (int) (sectionToReadEnd - sectionToReadStart),
+                          bufferIndexStart);
+    }
+    else
+    {
+        auto initialSize = buffer.getNumSamples() - bufferIndexStart;
+
+        readBufferSection(sectionToReadStart, initialSize, bufferIndexStart);
+
+        readBufferSection(sectionToReadStart + initialSize,
+                          (int) (sectionToReadEnd - sectionToReadStart) - initialSize,
+                          0);
+    }
+
+    publishValidRange(newBVS, newBVE);
+    return true;
+}
+
+// Sequence lock, the counter is odd while the two ends are being written
+void ReadAheadAudioSource::publishValidRange (int64 start, int64 end)
+{
+    rangeSequence.store(rangeSequence.load() + 1);
+    bufferValidStart = start;
+    bufferValidEnd = end;
+    rangeSequence.store(rangeSequence.load() + 1);
+}
+
+// A write is two stores long, so a few attempts only fail if the writer was preempted mid-write
+bool ReadAheadAudioSource::readValidRange (int64& start, int64& end) const
+{
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        auto sequence = rangeSequence.load();
+        start = bufferValidStart.load();
+        end = bufferValidEnd.load();
+
+        if ((sequence & 1) == 0 && rangeSequence.load() == sequence)
+            return true;
+    }
+
+    return false;
+}
+
+// Decodes one contiguous section of the ring buffer
+void ReadAheadAudioSource::readBufferSection (int64 start, int length, int bufferOffset)
+{
+    if (source->getNextReadPosition() != start)
+        source->setNextReadPosition(start);
+
+    AudioSourceChannelInfo info (&buffer, bufferOffset, length);
+    source->getNextAudioBlock(info);
+}
+
+// Runs again straight away while there is work, otherwise backs off
+int ReadAheadAudioSource::useTimeSlice()
+{
+    return readNextBufferChunk() ? 1 : 100;
+}
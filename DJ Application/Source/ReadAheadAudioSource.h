@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Positionable source that decodes ahead of the playhead on a shared background
+// thread, so the audio callback only ever copies from an in-memory ring buffer.
+//
+// The decoded range is published through a sequence counter rather than a lock, so the
+// audio thread never waits on the background thread. If it catches the range mid-update
+// it treats the block as an underrun instead
+class ReadAheadAudioSource : public PositionableAudioSource,
+                             private TimeSliceClient
+{
+public:
+    // The source is not owned; it must outlive this object
+    ReadAheadAudioSource(PositionableAudioSource* sourceToBuffer,
+                         TimeSliceThread& backgroundThread,
+                         int numberOfSamplesToBuffer,
+                         int numberOfChannels = 2);
+    ~ReadAheadAudioSource() override;
+
+    // AudioSource overrides
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    // PositionableAudioSource overrides
+    void setNextReadPosition (int64 newPosition) override;
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override { return source->getTotalLength(); }
+    bool isLooping() const override { return source->isLooping(); }
+
+    // Size of the read-ahead ring buffer in samples
+    int getReadAheadSize() const { return numberOfSamplesToBuffer; }
+
+    // Number of callbacks that found the buffer short of decoded audio
+    int getNumUnderruns() const { return underruns.load(); }
+
+    // Fraction of the first quarter second ahead of the playhead that is decoded
+    float getPrefillProgress() const;
+
+    // Blocks until the prefill is done or the timeout passes, reporting progress on the way.
+    // Only for loader threads, prepareToPlay itself never waits
+    bool waitForPrefill(int timeoutMs, const std::function<void (float)>& onProgress);
+
+private:
+    // Decodes the next chunk into the ring buffer, returns false if nothing was needed
+    bool readNextBufferChunk();
+    void readBufferSection (int64 start, int length, int bufferOffset);
+
+    // Background thread, or while no other thread is using the source
+    void publishValidRange (int64 start, int64 end);
+
+    // Any thread, false if the range was being changed on every attempt
+    bool readValidRange (int64& start, int64& end) const;
+
+    // Called on the background thread
+    int useTimeSlice() override;
+
+    PositionableAudioSource* source;
+    TimeSliceThread& backgroundThread;
+    const int numberOfSamplesToBuffer, numberOfChannels;
+
+    AudioBuffer<float> buffer;
+
+    // Odd while the background thread is changing the range
+    std::atomic<uint32> rangeSequence { 0 };
+    std::atomic<int64> bufferValidStart { 0 }, bufferValidEnd { 0 };
+    int prefillTarget = 0;
+
+    std::atomic<int64> nextPlayPos { 0 };
+    std::atomic<bool> isPrepared { false };
+    std::atomic<int> underruns { 0 };
+    double sampleRate = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ReadAheadAudioSource)
+};
@@ -0,0 +1,97 @@
+#include "RefreshScheduler.h"
+
+RefreshScheduler::RefreshScheduler(int activeFramesPerSecond, int idleFramesPerSecond)
+: activeInterval(1000 / jmax(1, activeFramesPerSecond)),
+  idleInterval(1000 / jmax(1, idleFramesPerSecond)),
+  holdFrames(jmax(1, activeFramesPerSecond / 2))
+{
+    startTimer(idleInterval);
+}
+
+RefreshScheduler::~RefreshScheduler()
+{
+    stopTimer();
+}
+
+void RefreshScheduler::addClient(Client* client)
+{
+    clients.addIfNotAlreadyThere(client);
+}
+
+void RefreshScheduler::removeClient(Client* client)
+{
+    clients.removeFirstMatchingValue(client);
+}
+
+void RefreshScheduler::invalidate(Component& component)
+{
+    invalidate(component, component.getLocalBounds());
+}
+
+void RefreshScheduler::invalidate(Component& component, Rectangle<int> area)
+{
+    if (area.isEmpty())
+        return;
+
+    auto existing = std::find_if(invalidations.begin(), invalidations.end(),
+                                 [&component](const Invalidation& i) { return i.component == &component; });
+
+    if (existing != invalidations.end())
+    {
+        existing->areas.add(area);
+    }
+    else
+    {
+        invalidations.push_back({ &component, {} });
+        invalidations.back().areas.add(area);
+    }
+
+    // Clients drawing their own frame don't count as activity, whether to animate is their return value
+    if (! inFrame)
+        wake();
+}
+
+void RefreshScheduler::wake()
+{
+    framesUntilIdle = holdFrames;
+    setActive(true);
+}
+
+void RefreshScheduler::timerCallback()
+{
+    bool animating = false;
+    inFrame = true;
+
+    // Clients may unregister from inside their callback
+    for (int i = clients.size(); --i >= 0;)
+        if (auto* client = clients[i])
+            animating = client->refreshFrame() || animating;
+
+    inFrame = false;
+
+    // Includes anything the clients have just invalidated
+    std::vector<Invalidation> pending;
+    pending.swap(invalidations);
+
+    for (auto& invalidation : pending)
+        if (auto* component = invalidation.component.getComponent())
+            for (auto& area : invalidation.areas)
+                component->repaint(area);
+
+    // Repaints asked for between frames have already reset the countdown in wake()
+    if (animating)
+        framesUntilIdle = holdFrames;
+    else if (framesUntilIdle > 0)
+        --framesUntilIdle;
+
+    setActive(framesUntilIdle > 0);
+}
+
+void RefreshScheduler::setActive(bool shouldBeActive)
+{
+    if (active == shouldBeActive)
+        return;
+
+    active = shouldBeActive;
+    startTimer(active ? activeInterval : idleInterval);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// One timer for everything in the window that changes over time. Each frame the
+// registered clients update themselves, then every repaint asked for since the
+// last frame is issued together, so the window is redrawn at most once per frame.
+//
+// While any client is animating, or something was invalidated recently, frames run
+// at the full rate. Once everything has been still for a moment the scheduler drops
+// to the idle rate, so a window with nothing playing costs almost nothing
+class RefreshScheduler : private Timer
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        // Called once per frame on the message thread. Return true while animating,
+        // which keeps the scheduler at its full rate
+        virtual bool refreshFrame() = 0;
+    };
+
+    RefreshScheduler(int activeFramesPerSecond = 60, int idleFramesPerSecond = 4);
+    ~RefreshScheduler() override;
+
+    void addClient(Client* client);
+    void removeClient(Client* client);
+
+    // Repaints the component, or part of it, on the next frame. Requests for the same
+    // component are merged. Outside a frame this also wakes the scheduler if it was idle
+    void invalidate(Component& component);
+    void invalidate(Component& component, Rectangle<int> area);
+
+    // Switches to the full rate straight away
+    void wake();
+
+    bool isActive() const { return active; }
+
+private:
+    void timerCallback() override;
+
+    // Restarts the timer if the rate has changed
+    void setActive(bool shouldBeActive);
+
+    struct Invalidation
+    {
+        Component::SafePointer<Component> component;
+        RectangleList<int> areas;
+    };
+
+    const int activeInterval, idleInterval;
+
+    // Frames to stay at the full rate after the last sign of activity
+    const int holdFrames;
+    int framesUntilIdle = 0;
+    bool active = false;
+    bool inFrame = false;
+
+    Array<Client*> clients;
+    std::vector<Invalidation> invalidations;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RefreshScheduler)
+};
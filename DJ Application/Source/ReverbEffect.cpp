@@ -1,63 +1,57 @@
-#include "ReverbEffect.h"
-
-ReverbEffect::ReverbEffect()
-{
-    // Initialize with default reverb settings
-    params.roomSize = 0.5f;
-    params.damping = 0.5f;
-    params.wetLevel = 1.0f;
-    params.dryLevel = 0.0f;
-    params.width = 1.0f;
-    params.freezeMode = 0.0f;
-}
-
-ReverbEffect::~ReverbEffect()
-{
-}
-
-// Configures reverb effect
-void ReverbEffect::prepare(double sampleRate, int samplesPerBlock)
-{
-    reverb.setSampleRate(sampleRate);
-    dryBuffer.setSize(2, samplesPerBlock);
-}
-
-// Applies reverb effect
-void ReverbEffect::process(juce::AudioBuffer<float>& buffer, int numSamples)
-{
-    if (!isActive || wetDryMix <= 0.0f)
-        return;
-
-    dryBuffer.clear();
-    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-        dryBuffer.copyFrom(channel, 0, buffer, channel, 0, numSamples);
-    
-    // Process with reverb
-    reverb.setParameters(params);
-    reverb.processStereo(buffer.getWritePointer(0), buffer.getWritePointer(1), numSamples);
-    
-    // Mix dry and wet signals
-    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-    {
-        float* channelData = buffer.getWritePointer(channel);
-        const float* dryData = dryBuffer.getReadPointer(channel);
-        
-        for (int sample = 0; sample < numSamples; ++sample)
-        {
-            // Mix dry and wet signals according to wetDryMix
-            channelData[sample] = (dryData[sample] * (1.0f - wetDryMix)) + (channelData[sample] * wetDryMix);
-        }
-    }
-}
-
-// Sets virtual room size
-void ReverbEffect::setRoomSize(float size)
-{
-    params.roomSize = juce::jlimit(0.0f, 1.0f, size);
-}
-
-// Adjusts damping amount
-void ReverbEffect::setDamping(float dampAmount)
-{
-    params.damping = juce::jlimit(0.0f, 1.0f, dampAmount);
-}
+#include "ReverbEffect.h"
+
+ReverbEffect::ReverbEffect()
+: DJAudioEffect(true)
+{
+    // Initialize with default reverb settings
+    params.roomSize = 0.5f;
+    params.damping = 0.5f;
+    params.wetLevel = 1.0f;
+    params.dryLevel = 0.0f;
+    params.width = 1.0f;
+    params.freezeMode = 0.0f;
+}
+
+ReverbEffect::~ReverbEffect()
+{
+}
+
+// Configures reverb effect
+void ReverbEffect::prepare(double sampleRate, int samplesPerBlock)
+{
+    reverb.setSampleRate(sampleRate);
+    reverb.setParameters(params);
+    quietSamplesBeforeIdle = (int) (sampleRate * 0.1);
+}
+
+// Applies reverb effect
+void ReverbEffect::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // juce::Reverb ramps room size and damping itself
+    auto newRoomSize = roomSize.load();
+    auto newDamping = damping.load();
+
+    if (newRoomSize != params.roomSize || newDamping != params.damping)
+    {
+        params.roomSize = newRoomSize;
+        params.damping = newDamping;
+        reverb.setParameters(params);
+    }
+
+    if (buffer.getNumChannels() > 1)
+        reverb.processStereo(buffer.getWritePointer(0, startSample), buffer.getWritePointer(1, startSample), numSamples);
+    else
+        reverb.processMono(buffer.getWritePointer(0, startSample), numSamples);
+}
+
+// Sets virtual room size
+void ReverbEffect::setRoomSize(float size)
+{
+    roomSize = juce::jlimit(0.0f, 1.0f, size);
+}
+
+// Adjusts damping amount
+void ReverbEffect::setDamping(float dampAmount)
+{
+    damping = juce::jlimit(0.0f, 1.0f, dampAmount);
+}
@@ -1,29 +1,42 @@
-#pragma once
-
-#include "DJAudioEffect.h"
-
-// Class to implement reverb effect
-class ReverbEffect : public DJAudioEffect
-{
-public:
-    ReverbEffect();
-    ~ReverbEffect() override;
-    
-    // Process the audio block with reverb effect
-    void process(juce::AudioBuffer<float>& buffer, int numSamples) override;
-    
-    // Prepare the reverb for playback
-    void prepare(double sampleRate, int samplesPerBlock) override;
-    
-    // Set the room size parameter (0.0 to 1.0)
-    void setRoomSize(float size);
-    
-    // Set the damping parameter (0.0 to 1.0)
-    void setDamping(float dampAmount);
-    
-private:
-    juce::Reverb reverb;
-    juce::Reverb::Parameters params;
-    juce::AudioBuffer<float> dryBuffer;
-};
-
+#pragma once
+
+#include "DJAudioEffect.h"
+
+// Class to implement reverb effect
+class ReverbEffect : public DJAudioEffect
+{
+public:
+    ReverbEffect();
+    ~ReverbEffect() override;
+    
+    // Set the room size parameter (0.0 to 1.0)
+    void setRoomSize(float size);
+    float getRoomSize() const { return roomSize.load(); }
+    
+    // Set the damping parameter (0.0 to 1.0)
+    void setDamping(float dampAmount);
+    float getDamping() const { return damping.load(); }
+    
+protected:
+    // Prepare the reverb for playback
+    void prepare(double sampleRate, int samplesPerBlock) override;
+
+    // Replaces a range of the buffer with the reverb
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) override;
+
+    void reset() override { reverb.reset(); }
+
+    // Longer than the longest comb filter, which is around 40ms
+    int getQuietSamplesBeforeIdle() const override { return quietSamplesBeforeIdle; }
+
+private:
+    juce::Reverb reverb;
+
+    // Only touched on the audio thread
+    juce::Reverb::Parameters params;
+    int quietSamplesBeforeIdle = 4410;
+
+    // Written by the GUI, applied at the start of the next block
+    std::atomic<float> roomSize { 0.5f };
+    std::atomic<float> damping { 0.5f };
+};
@@ -0,0 +1,151 @@
+#include "ScrollingWaveformDisplay.h"
+
+ScrollingWaveformDisplay::ScrollingWaveformDisplay(AudioFormatManager& formatManagerToUse, ThreadPool& _analysisPool)
+: formatManager(formatManagerToUse), analysisPool(_analysisPool)
+{
+    setOpaque(true);
+}
+
+ScrollingWaveformDisplay::~ScrollingWaveformDisplay()
+{
+    if (pyramid != nullptr)
+        pyramid->cancel();
+}
+
+void ScrollingWaveformDisplay::paint(Graphics& g)
+{
+    // The renderer draws the waveform and playhead underneath, only the frame is left
+    if (! drawnByOpenGL)
+        g.fillAll(backgroundColour);
+
+    g.setColour(Colours::grey);
+    g.drawRect(getLocalBounds(), 1);
+
+    auto width = getWidth();
+    auto centreX = width / 2;
+
+    if (pyramid == nullptr)
+    {
+        g.setColour(waveformColour);
+        g.setFont(14.0f);
+        g.drawText("No track loaded", getLocalBounds(), Justification::centred, true);
+        return;
+    }
+
+    if (drawnByOpenGL)
+        return;
+
+    auto sampleRate = pyramid->getSampleRate();
+    auto samplesPerPixel = visibleSeconds.load() * sampleRate / jmax(1, width);
+    auto firstSample = playheadSeconds * sampleRate - centreX * samplesPerPixel;
+
+    auto midY = getHeight() * 0.5f;
+    auto halfHeight = getHeight() * 0.5f - 1.0f;
+
+    // One pyramid lookup per column, outer band for the peaks and inner band for the RMS
+    for (int x = 0; x < width; ++x)
+    {
+        auto start = (int64) (firstSample + x * samplesPerPixel);
+        auto end = (int64) (firstSample + (x + 1) * samplesPerPixel);
+        auto range = pyramid->getRange(start, jmax(start + 1, end));
+
+        if (! range.isValid)
+            continue;
+
+        auto top = midY - jlimit(-1.0f, 1.0f, range.maximum) * halfHeight;
+        auto bottom = midY - jlimit(-1.0f, 1.0f, range.minimum) * halfHeight;
+
+        g.setColour(waveformColour.withAlpha(0.5f));
+        g.fillRect((float) x, top, 1.0f, jmax(1.0f, bottom - top));
+
+        auto rms = jmin(1.0f, range.rms) * halfHeight;
+        g.setColour(waveformColour);
+        g.fillRect((float) x, midY - rms, 1.0f, jmax(1.0f, rms * 2.0f));
+    }
+
+    g.setColour(playheadColour);
+    g.fillRect(centreX - 1, 0, 2, getHeight());
+}
+
+void ScrollingWaveformDisplay::mouseWheelMove(const MouseEvent& /*event*/, const MouseWheelDetails& wheel)
+{
+    // Scrolling up zooms in
+    setVisibleSeconds(visibleSeconds.load() * std::pow(2.0, -wheel.deltaY * 2.0));
+}
+
+void ScrollingWaveformDisplay::loadURL(const URL& audioURL)
+{
+    if (pyramid != nullptr)
+        pyramid->cancel();
+
+    {
+        const SpinLock::ScopedLockType sl (pyramidLock);
+        pyramid = nullptr;
+    }
+
+    repaint();
+
+    auto generation = ++loadGeneration;
+    Component::SafePointer<ScrollingWaveformDisplay> safeThis (this);
+
+    WaveformPyramid::buildAsync(audioURL, formatManager, analysisPool, [safeThis, generation](WaveformPyramid::Ptr newPyramid)
+    {
+        // Another track has been loaded since
+        if (safeThis == nullptr || generation != safeThis->loadGeneration)
+        {
+            newPyramid->cancel();
+            return;
+        }
+
+        {
+            const SpinLock::ScopedLockType sl (safeThis->pyramidLock);
+            safeThis->pyramid = newPyramid;
+        }
+
+        safeThis->repaint();
+    });
+}
+
+void ScrollingWaveformDisplay::setPlayheadPosition(double seconds)
+{
+    // The renderer reads the player itself, nothing here needs repainting
+    if (drawnByOpenGL)
+    {
+        playheadSeconds = seconds;
+        return;
+    }
+
+    // Keep repainting while the pyramid fills in, even when paused
+    if (seconds != playheadSeconds || (pyramid != nullptr && ! pyramid->isComplete()))
+    {
+        playheadSeconds = seconds;
+        repaint();
+    }
+}
+
+void ScrollingWaveformDisplay::setVisibleSeconds(double seconds)
+{
+    visibleSeconds = jlimit(minVisibleSeconds, maxVisibleSeconds, seconds);
+    repaint();
+}
+
+void ScrollingWaveformDisplay::setColours(Colour waveColour, Colour bgColour, Colour newPlayheadColour)
+{
+    waveformColour = waveColour;
+    backgroundColour = bgColour;
+    playheadColour = newPlayheadColour;
+    repaint();
+}
+
+void ScrollingWaveformDisplay::setDrawnByOpenGL(bool shouldUseOpenGL)
+{
+    drawnByOpenGL = shouldUseOpenGL;
+    setOpaque(! shouldUseOpenGL);
+    repaint();
+}
+
+WaveformPyramid::Ptr ScrollingWaveformDisplay::getPyramid() const
+{
+    const SpinLock::ScopedLockType sl (pyramidLock);
+    return pyramid;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WaveformPyramid.h"
+
+// Close-up of the waveform scrolling past a fixed playhead in the centre.
+// The mouse wheel zooms, and each column is drawn from a few pyramid buckets,
+// so painting costs the same at any zoom and for any length of track
+class ScrollingWaveformDisplay : public Component
+{
+public:
+    ScrollingWaveformDisplay(AudioFormatManager& formatManagerToUse, ThreadPool& analysisPool);
+    ~ScrollingWaveformDisplay();
+
+    void paint (Graphics&) override;
+
+    // Zooms in and out around the playhead
+    void mouseWheelMove (const MouseEvent& event, const MouseWheelDetails& wheel) override;
+
+    // Starts building the track's pyramid, the view fills in as it is read
+    void loadURL(const URL& audioURL);
+
+    // Playhead position in seconds
+    void setPlayheadPosition(double seconds);
+
+    // Seconds of audio across the full width
+    void setVisibleSeconds(double seconds);
+    double getVisibleSeconds() const { return visibleSeconds.load(); }
+
+    // True while the loaded track's pyramid is still filling in
+    bool isBuilding() const { return pyramid != nullptr && ! pyramid->isComplete(); }
+
+    void setColours(Colour waveColour, Colour bgColour, Colour playheadColour);
+
+    // Hands drawing over to an OpenGL renderer, the component then only handles zooming
+    void setDrawnByOpenGL(bool shouldUseOpenGL);
+
+    // Any thread, for the renderer
+    WaveformPyramid::Ptr getPyramid() const;
+
+    static constexpr double minVisibleSeconds = 1.0;
+    static constexpr double maxVisibleSeconds = 60.0;
+
+private:
+    AudioFormatManager& formatManager;
+    ThreadPool& analysisPool;
+
+    WaveformPyramid::Ptr pyramid;
+    SpinLock pyramidLock;
+    int loadGeneration = 0;
+
+    double playheadSeconds = 0;
+    std::atomic<double> visibleSeconds { 8.0 };
+    bool drawnByOpenGL = false;
+
+    Colour waveformColour = Colours::orange;
+    Colour backgroundColour = Colours::black;
+    Colour playheadColour = Colours::lightgreen;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScrollingWaveformDisplay)
+};
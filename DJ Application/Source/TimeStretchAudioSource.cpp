@@ -0,0 +1,396 @@
+#include "TimeStretchAudioSource.h"
+
+TimeStretchAudioSource::TimeStretchAudioSource(AudioSource* _input, int _numChannels)
+: input(_input), numChannels(_numChannels), settings(getSettings(Quality::medium))
+{
+    jassert (input != nullptr);
+}
+
+TimeStretchAudioSource::~TimeStretchAudioSource()
+{
+}
+
+// Cost per output sample is roughly (2 * searchRange / stride) * (frameSize / 2 / stride) / (frameSize / 2)
+TimeStretchAudioSource::Settings TimeStretchAudioSource::getSettings(Quality quality)
+{
+    switch (quality)
+    {
+        case Quality::low:    return { 1024, 256, 4 };
+        case Quality::high:   return { 2048, 512, 1 };
+        case Quality::medium:
+        default:              return { 2048, 512, 2 };
+    }
+}
+
+void TimeStretchAudioSource::setTempo(double ratio)
+{
+    tempo = jlimit(minTempo, maxTempo, ratio);
+}
+
+void TimeStretchAudioSource::setQuality(Quality newQuality)
+{
+    quality = (int) newQuality;
+}
+
+void TimeStretchAudioSource::setEnabled(bool shouldBeEnabled)
+{
+    enabled = shouldBeEnabled;
+}
+
+// Sized for the largest tier so changing tier or tempo never allocates
+void TimeStretchAudioSource::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+    int maxFrameSize = 0, maxSearchRange = 0;
+
+    for (auto tier : { Quality::low, Quality::medium, Quality::high })
+    {
+        maxFrameSize = jmax(maxFrameSize, getSettings(tier).frameSize);
+        maxSearchRange = jmax(maxSearchRange, getSettings(tier).searchRange);
+    }
+
+    // The first frame starts half a frame before the playhead and searches either side of that
+    historyLength = maxFrameSize / 2 + maxSearchRange;
+    passthroughChunk = maxFrameSize / 2;
+
+    // History behind the half frame still playing, the search window around the nominal position,
+    // one analysis hop at full tempo plus the input a crossfade can use up, and a frame of slack
+    auto capacity = historyLength + maxFrameSize * 2 + maxSearchRange * 2
+                      + (int) std::ceil(maxTempo * (maxFrameSize / 2 + crossfadeLength));
+
+    inputBuffer.setSize(numChannels, capacity);
+    monoBuffer.allocate((size_t) capacity, true);
+    accumulator.setSize(numChannels, maxFrameSize);
+    outputBuffer.setSize(numChannels, maxFrameSize / 2);
+    fadeBuffer.setSize(numChannels, crossfadeLength);
+    window.allocate((size_t) maxFrameSize, true);
+
+    resetPending = true;
+    stretching = false;
+    activeQuality = -1;
+}
+
+void TimeStretchAudioSource::releaseResources()
+{
+    input->releaseResources();
+}
+
+// The input sample played next is the one the plain path would pick up from on switching
+int TimeStretchAudioSource::getLatencyInSamples() const
+{
+    auto playhead = stretching ? previousFrameStart + outputReadPosition : passthroughPosition;
+    return (int) jmax((int64) 0, inputStart + inputFilled - playhead);
+}
+
+// Drops everything buffered, leaving a history of silence behind the read position
+void TimeStretchAudioSource::clearInput()
+{
+    inputBuffer.clear();
+    FloatVectorOperations::clear(monoBuffer.get(), inputBuffer.getNumSamples());
+    inputStart = 0;
+    inputFilled = historyLength;
+    passthroughPosition = historyLength;
+
+    resetPending = false;
+}
+
+// Restarts the overlap-add so its first output sample is the input at position
+void TimeStretchAudioSource::primeAt(int64 position)
+{
+    activeQuality = quality.load();
+    settings = getSettings((Quality) activeQuality);
+
+    auto hop = settings.frameSize / 2;
+
+    // Periodic Hann windows at 50% overlap add up to exactly one
+    for (int i = 0; i < settings.frameSize; ++i)
+        window[i] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * (float) i / (float) settings.frameSize);
+
+    accumulator.clear();
+    analysisPosition = (double) (position - hop);
+    previousFrameStart = position - 2 * hop;
+
+    // The first frame ends half way through its window, so its output would be a fade-in.
+    // Only the overlap it leaves behind is kept
+    runStep();
+    outputReadPosition = 0;
+    outputAvailable = 0;
+}
+
+void TimeStretchAudioSource::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    auto& buffer = *bufferToFill.buffer;
+    auto startSample = bufferToFill.startSample;
+    auto numSamples = bufferToFill.numSamples;
+
+    // After a seek neither path has anything worth crossfading from
+    if (resetPending.load())
+    {
+        clearInput();
+
+        if (stretching)
+            primeAt(passthroughPosition);
+    }
+
+    auto shouldStretch = enabled.load();
+
+    if (stretching && shouldStretch && activeQuality != quality.load())
+    {
+        switchQuality(buffer, startSample, numSamples);
+    }
+    else if (shouldStretch != stretching)
+    {
+        stretching = shouldStretch;
+
+        if (stretching)
+            startStretching(buffer, startSample, numSamples);
+        else
+            stopStretching(buffer, startSample, numSamples);
+    }
+    else if (stretching)
+    {
+        renderStretched(buffer, startSample, numSamples);
+    }
+    else
+    {
+        renderPassthrough(buffer, startSample, numSamples);
+    }
+}
+
+// Copies the input straight out of the buffer, keeping the history behind it
+void TimeStretchAudioSource::renderPassthrough(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    for (int done = 0; done < numSamples; done += passthroughChunk)
+    {
+        auto numToCopy = jmin(passthroughChunk, numSamples - done);
+        fillInputUpTo(passthroughPosition + numToCopy);
+
+        auto offset = (int) (passthroughPosition - inputStart);
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            buffer.copyFrom(channel, startSample + done, inputBuffer, jmin(channel, numChannels - 1), offset, numToCopy);
+
+        passthroughPosition += numToCopy;
+        discardInputBefore(jmin(passthroughPosition - historyLength, keepFrom));
+    }
+}
+
+// Steps produce half a frame each, so any block size works without extra buffering
+void TimeStretchAudioSource::renderStretched(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    int done = 0;
+
+    while (done < numSamples)
+    {
+        if (outputAvailable == 0)
+            runStep();
+
+        auto numToCopy = jmin(outputAvailable, numSamples - done);
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            buffer.copyFrom(channel, startSample + done,
+                            outputBuffer, jmin(channel, numChannels - 1), outputReadPosition, numToCopy);
+
+        outputReadPosition += numToCopy;
+        outputAvailable -= numToCopy;
+        done += numToCopy;
+    }
+}
+
+// The plain path plays the start of the block and the stretcher is primed on the same samples,
+// with the history before them, then takes over
+void TimeStretchAudioSource::startStretching(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto fadeLength = jmin(numSamples, crossfadeLength);
+    auto playhead = passthroughPosition;
+
+    keepFrom = playhead - historyLength;
+    renderPassthrough(fadeBuffer, 0, fadeLength);
+    keepFrom = std::numeric_limits<int64>::max();
+
+    primeAt(playhead);
+    renderStretched(buffer, startSample, numSamples);
+    crossfadeFrom(buffer, startSample, fadeLength);
+}
+
+// The stretcher plays out the fade while the plain path picks up from the sample it had got to
+void TimeStretchAudioSource::stopStretching(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto fadeLength = jmin(numSamples, crossfadeLength);
+    auto playhead = previousFrameStart + outputReadPosition;
+
+    keepFrom = playhead - historyLength;
+    renderStretched(fadeBuffer, 0, fadeLength);
+    keepFrom = std::numeric_limits<int64>::max();
+
+    passthroughPosition = playhead;
+    renderPassthrough(buffer, startSample, numSamples);
+    crossfadeFrom(buffer, startSample, fadeLength);
+}
+
+// The old tier plays out the fade while the new one is primed on the same input, so the
+// tempo never leaves the stretcher and the position doesn't drift
+void TimeStretchAudioSource::switchQuality(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto fadeLength = jmin(numSamples, crossfadeLength);
+    auto playhead = previousFrameStart + outputReadPosition;
+
+    keepFrom = playhead - historyLength;
+    renderStretched(fadeBuffer, 0, fadeLength);
+    keepFrom = std::numeric_limits<int64>::max();
+
+    primeAt(playhead);
+    renderStretched(buffer, startSample, numSamples);
+    crossfadeFrom(buffer, startSample, fadeLength);
+}
+
+void TimeStretchAudioSource::crossfadeFrom(AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        buffer.applyGainRamp(channel, startSample, numSamples, 0.0f, 1.0f);
+        buffer.addFromWithRamp(channel, startSample, fadeBuffer.getReadPointer(jmin(channel, numChannels - 1)),
+                               numSamples, 1.0f, 0.0f);
+    }
+}
+
+// Pulls input until everything before endPosition is buffered
+void TimeStretchAudioSource::fillInputUpTo(int64 endPosition)
+{
+    auto numNeeded = (int) (endPosition - (inputStart + inputFilled));
+
+    if (numNeeded <= 0)
+        return;
+
+    jassert (inputFilled + numNeeded <= inputBuffer.getNumSamples());
+    numNeeded = jmin(numNeeded, inputBuffer.getNumSamples() - inputFilled);
+
+    AudioSourceChannelInfo info (&inputBuffer, inputFilled, numNeeded);
+    input->getNextAudioBlock(info);
+
+    // The offset search runs on a mono mix
+    auto* mono = monoBuffer.get() + inputFilled;
+    FloatVectorOperations::copy(mono, inputBuffer.getReadPointer(0, inputFilled), numNeeded);
+
+    for (int channel = 1; channel < numChannels; ++channel)
+        FloatVectorOperations::add(mono, inputBuffer.getReadPointer(channel, inputFilled), numNeeded);
+
+    inputFilled += numNeeded;
+}
+
+// Shuffles the unused input down to the start of the buffer
+void TimeStretchAudioSource::discardInputBefore(int64 position)
+{
+    auto numToDiscard = (int) jlimit((int64) 0, (int64) inputFilled, position - inputStart);
+
+    if (numToDiscard == 0)
+        return;
+
+    auto numToKeep = inputFilled - numToDiscard;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* data = inputBuffer.getWritePointer(channel);
+        std::memmove(data, data + numToDiscard, (size_t) numToKeep * sizeof(float));
+    }
+
+    std::memmove(monoBuffer.get(), monoBuffer.get() + numToDiscard, (size_t) numToKeep * sizeof(float));
+
+    inputStart += numToDiscard;
+    inputFilled = numToKeep;
+}
+
+// Four running sums keep the contiguous case free of a loop-carried dependency so it vectorises
+float TimeStretchAudioSource::dotProduct(const float* a, const float* b, int numSamples, int stride)
+{
+    if (stride == 1)
+    {
+        float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+        int i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            sum0 += a[i] * b[i];
+            sum1 += a[i + 1] * b[i + 1];
+            sum2 += a[i + 2] * b[i + 2];
+            sum3 += a[i + 3] * b[i + 3];
+        }
+
+        for (; i < numSamples; ++i)
+            sum0 += a[i] * b[i];
+
+        return (sum0 + sum1) + (sum2 + sum3);
+    }
+
+    float sum = 0;
+
+    for (int i = 0; i < numSamples; i += stride)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+// Finds the frame start near the nominal position whose waveform best continues the previous frame
+int TimeStretchAudioSource::findBestOffset(int64 nominal, int64 continuation) const
+{
+    auto overlap = settings.frameSize / 2;
+    auto* reference = monoBuffer.get() + (continuation - inputStart);
+    auto* centre = monoBuffer.get() + (nominal - inputStart);
+
+    // Ties go to the nominal position, which matters while the input is silent
+    auto bestOffset = 0;
+    auto bestScore = dotProduct(reference, centre, overlap, settings.stride);
+
+    for (int offset = -settings.searchRange; offset <= settings.searchRange; offset += settings.stride)
+    {
+        if (offset == 0)
+            continue;
+
+        auto score = dotProduct(reference, centre + offset, overlap, settings.stride);
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestOffset = offset;
+        }
+    }
+
+    return bestOffset;
+}
+
+// Adds one windowed frame and hands over the half of the accumulator that is now complete
+void TimeStretchAudioSource::runStep()
+{
+    auto hop = settings.frameSize / 2;
+    auto nominal = (int64) std::llround(analysisPosition);
+    auto continuation = previousFrameStart + hop;
+
+    fillInputUpTo(jmax(nominal + settings.searchRange + settings.frameSize, continuation + hop));
+
+    auto frameStart = nominal + findBestOffset(nominal, continuation);
+    auto frameOffset = (int) (frameStart - inputStart);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* sum = accumulator.getWritePointer(channel);
+
+        FloatVectorOperations::addWithMultiply(sum, inputBuffer.getReadPointer(channel, frameOffset), window.get(), settings.frameSize);
+
+        // First half is finished, move the second half down to start the next overlap
+        FloatVectorOperations::copy(outputBuffer.getWritePointer(channel), sum, hop);
+        FloatVectorOperations::copy(sum, sum + hop, hop);
+        FloatVectorOperations::clear(sum + hop, hop);
+    }
+
+    outputReadPosition = 0;
+    outputAvailable = hop;
+
+    previousFrameStart = frameStart;
+    analysisPosition += hop * tempo.load();
+
+    // The half frame just handed over is kept with the history before it, which is what
+    // the plain path picks up from if the stretcher is switched off
+    discardInputBefore(jmin(jmin((int64) std::llround(analysisPosition) - settings.searchRange,
+                                 frameStart - historyLength), keepFrom));
+}
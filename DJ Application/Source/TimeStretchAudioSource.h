@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Changes tempo without changing pitch using WSOLA: windowed frames are taken
+// from the input at the tempo's pace and overlap-added at a fixed hop, each one
+// nudged within a search range to line up with the previous frame's waveform.
+// The search range and stride are fixed per quality tier, so the cost of each
+// block is bounded and does not depend on the material.
+// Input goes through the same buffer whether stretching or not, so switching
+// can start the stretcher on the samples just played and crossfade the two paths
+class TimeStretchAudioSource : public AudioSource
+{
+public:
+    enum class Quality
+    {
+        low = 0,    // shortest frames, coarse search, cheap enough for many decks
+        medium,     // default, four decks fit comfortably in one core
+        high        // exhaustive search, best on sustained tonal material
+    };
+
+    static constexpr double minTempo = 0.25;
+    static constexpr double maxTempo = 4.0;
+
+    // Doesn't take ownership of the input
+    TimeStretchAudioSource(AudioSource* input, int numChannels = 2);
+    ~TimeStretchAudioSource() override;
+
+    // Tempo ratio, 2.0 plays twice as fast at the same pitch. Safe from any thread
+    void setTempo(double ratio);
+    double getTempo() const { return tempo.load(); }
+
+    // Switching tier restarts the stretcher with a crossfade, everything is allocated for the largest one
+    void setQuality(Quality newQuality);
+    Quality getQuality() const { return (Quality) quality.load(); }
+
+    // While disabled the input passes straight through. Switching is crossfaded
+    // on the audio thread, without skipping or repeating any input
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled.load(); }
+
+    // Drops everything buffered at the next block, call after the input seeks
+    void reset() { resetPending = true; }
+
+    // Audio thread, between blocks. Input samples read but not played yet, the frames
+    // the stretcher looks ahead into. Nothing while passing the input straight through
+    int getLatencyInSamples() const;
+
+    // AudioSource overrides
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    struct Settings
+    {
+        int frameSize;    // analysis window, output hop is half of it
+        int searchRange;  // how far either side of the nominal position to look
+        int stride;       // step between candidate offsets and compared samples
+    };
+
+    static Settings getSettings(Quality quality);
+
+    // Cross-correlation of two runs of the mono mix
+    static float dotProduct(const float* a, const float* b, int numSamples, int stride);
+
+    // All of these run on the audio thread
+    void clearInput();
+    void primeAt(int64 position);
+    void fillInputUpTo(int64 endPosition);
+    void discardInputBefore(int64 position);
+    int findBestOffset(int64 nominal, int64 continuation) const;
+    void runStep();
+
+    void renderPassthrough(AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void renderStretched(AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void startStretching(AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void stopStretching(AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void switchQuality(AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // Fades the start of the buffer in over what is in fadeBuffer
+    void crossfadeFrom(AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    static constexpr int crossfadeLength = 512;
+
+    AudioSource* input;
+    const int numChannels;
+
+    // Input read from the source, positions are counted from the last reset.
+    // The plain path keeps historyLength samples behind its read position so the
+    // stretcher can be started on them, and discards never go past keepFrom
+    AudioBuffer<float> inputBuffer;
+    HeapBlock<float> monoBuffer;
+    int64 inputStart = 0;
+    int inputFilled = 0;
+    int64 passthroughPosition = 0;
+    int64 keepFrom = std::numeric_limits<int64>::max();
+    int historyLength = 0;
+    int passthroughChunk = 0;
+
+    // Where the next frame should come from and where the last one did
+    double analysisPosition = 0;
+    int64 previousFrameStart = 0;
+
+    // Overlap-add accumulator and the finished samples waiting to be played
+    AudioBuffer<float> accumulator;
+    AudioBuffer<float> outputBuffer;
+    int outputReadPosition = 0;
+    int outputAvailable = 0;
+
+    HeapBlock<float> window;
+    Settings settings;
+
+    // The path being switched away from, for the length of the crossfade
+    AudioBuffer<float> fadeBuffer;
+    bool stretching = false;
+
+    std::atomic<double> tempo { 1.0 };
+    std::atomic<int> quality { (int) Quality::medium };
+    std::atomic<bool> enabled { false };
+    std::atomic<bool> resetPending { true };
+    int activeQuality = -1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TimeStretchAudioSource)
+};
@@ -0,0 +1,326 @@
+#include "TrackCache.h"
+#include "MappedTrackSource.h"
+
+namespace
+{
+    using FloatSamples = AudioData::Pointer<AudioData::Float32, AudioData::NativeEndian, AudioData::NonInterleaved, AudioData::Const>;
+    using CachedSamples = AudioData::Pointer<AudioData::Int16, AudioData::NativeEndian, AudioData::NonInterleaved, AudioData::NonConst>;
+    using FloatToCached = AudioData::ConverterInstance<FloatSamples, CachedSamples>;
+
+    using ConstCachedSamples = AudioData::Pointer<AudioData::Int16, AudioData::NativeEndian, AudioData::NonInterleaved, AudioData::Const>;
+    using FloatDestSamples = AudioData::Pointer<AudioData::Float32, AudioData::NativeEndian, AudioData::NonInterleaved, AudioData::NonConst>;
+    using CachedToFloat = AudioData::ConverterInstance<ConstCachedSamples, FloatDestSamples>;
+}
+
+//==============================================================================
+CachedTrack::CachedTrack(int _numChannels, int64 _numSamples, double _sampleRate)
+: numChannels(_numChannels), numSamples(_numSamples), sampleRate(_sampleRate)
+{
+    data.malloc((size_t) numChannels * (size_t) numSamples);
+}
+
+// Rounds and clips to 16 bits, channels are stored one after another.
+// Goes through the same AudioData converters as read() so the scaling matches both ways
+void CachedTrack::write(const AudioBuffer<float>& source, int numSamplesToWrite, int64 startSample)
+{
+    numSamplesToWrite = (int) jmin((int64) numSamplesToWrite, numSamples - startSample);
+    FloatToCached converter;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* src = source.getReadPointer(jmin(channel, source.getNumChannels() - 1));
+        auto* dest = data.get() + (size_t) channel * (size_t) numSamples + (size_t) startSample;
+
+        converter.convertSamples(dest, src, numSamplesToWrite);
+    }
+}
+
+void CachedTrack::read(int channel, float* dest, int64 startSample, int numSamplesToRead) const
+{
+    const int16* src = data.get() + (size_t) channel * (size_t) numSamples + (size_t) startSample;
+    CachedToFloat converter;
+
+    converter.convertSamples(dest, src, numSamplesToRead);
+}
+
+//==============================================================================
+CachedTrackSource::CachedTrackSource(CachedTrack::Ptr _track)
+: track(_track)
+{
+    jassert(track != nullptr);
+}
+
+// Copies straight out of memory, anything past the end is silent
+void CachedTrackSource::getNextAudioBlock (const AudioSourceChannelInfo& info)
+{
+    auto pos = position.load();
+    auto startInBlock = (int) jlimit((int64) 0, (int64) info.numSamples, -pos);
+    auto endInBlock = (int) jlimit((int64) 0, (int64) info.numSamples, track->getNumSamples() - pos);
+
+    if (startInBlock >= endInBlock)
+    {
+        info.clearActiveBufferRegion();
+    }
+    else
+    {
+        if (startInBlock > 0)
+            info.buffer->clear(info.startSample, startInBlock);
+
+        if (endInBlock < info.numSamples)
+            info.buffer->clear(info.startSample + endInBlock, info.numSamples - endInBlock);
+
+        for (int channel = 0; channel < info.buffer->getNumChannels(); ++channel)
+        {
+            // Mono tracks play on both sides
+            track->read(jmin(channel, track->getNumChannels() - 1),
+                        info.buffer->getWritePointer(channel, info.startSample + startInBlock),
+                        pos + startInBlock,
+                        endInBlock - startInBlock);
+        }
+    }
+
+    position = pos + info.numSamples;
+}
+
+//==============================================================================
+// Background job that decodes one whole track
+class TrackCache::DecodeJob : public ThreadPoolJob
+{
+public:
+    DecodeJob(TrackCache& _owner, const URL& _url)
+    : ThreadPoolJob("Track cache decoder"), owner(_owner), url(_url)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        auto track = owner.decode(url, *this);
+        auto key = TrackCache::getKey(url);
+        auto weakOwner = owner.selfReference;
+
+        MessageManager::callAsync([weakOwner, key, track]
+        {
+            if (auto* cache = weakOwner.get())
+                cache->decodeFinished(key, track);
+        });
+
+        return jobHasFinished;
+    }
+
+private:
+    TrackCache& owner;
+    const URL url;
+};
+
+TrackCache::TrackCache(AudioFormatManager& _formatManager)
+: formatManager(_formatManager)
+{
+    selfReference = this;
+}
+
+TrackCache::~TrackCache()
+{
+    decodePool.removeAllJobs(true, 10000);
+}
+
+void TrackCache::setEnabled(bool shouldBeEnabled)
+{
+    enabled = shouldBeEnabled;
+
+    if (! shouldBeEnabled)
+    {
+        const ScopedLock sl (lock);
+        evictToFit(0);
+    }
+}
+
+void TrackCache::setMemoryBudget(int64 numBytes)
+{
+    const ScopedLock sl (lock);
+    memoryBudget = jmax((int64) 0, numBytes);
+    evictToFit(memoryBudget);
+}
+
+int64 TrackCache::getMemoryBudget() const
+{
+    const ScopedLock sl (lock);
+    return memoryBudget;
+}
+
+int64 TrackCache::getMemoryUsed() const
+{
+    const ScopedLock sl (lock);
+    return memoryUsed;
+}
+
+// Safe to call from any thread
+CachedTrack::Ptr TrackCache::find(const URL& url)
+{
+    if (! enabled)
+        return nullptr;
+
+    const ScopedLock sl (lock);
+
+    auto it = entries.find(getKey(url));
+    if (it == entries.end())
+        return nullptr;
+
+    touch(it->second);
+    return it->second.track;
+}
+
+// Joins an existing decode of the same track rather than starting another one
+void TrackCache::requestDecode(const URL& url, std::function<void (CachedTrack::Ptr)> onReady)
+{
+    if (! enabled)
+    {
+        if (onReady)
+            onReady(nullptr);
+        return;
+    }
+
+    auto cached = find(url);
+    if (cached != nullptr)
+    {
+        if (onReady)
+            onReady(cached);
+        return;
+    }
+
+    // An empty callback still marks the decode as in flight
+    if (onReady == nullptr)
+        onReady = [](CachedTrack::Ptr) {};
+
+    auto key = getKey(url);
+    bool alreadyDecoding;
+
+    {
+        const ScopedLock sl (lock);
+        auto& callbacks = decodesInFlight[key];
+        alreadyDecoding = ! callbacks.empty();
+        callbacks.push_back(std::move(onReady));
+    }
+
+    if (! alreadyDecoding)
+        decodePool.addJob(new DecodeJob(*this, url), true);
+}
+
+void TrackCache::pin(const URL& url)
+{
+    const ScopedLock sl (lock);
+    ++pinCounts[getKey(url)];
+}
+
+void TrackCache::unpin(const URL& url)
+{
+    const ScopedLock sl (lock);
+
+    auto it = pinCounts.find(getKey(url));
+    if (it != pinCounts.end() && --(it->second) <= 0)
+    {
+        pinCounts.erase(it);
+        evictToFit(memoryBudget);
+    }
+}
+
+// Reads the whole file, skipping tracks that could never fit in the budget
+CachedTrack::Ptr TrackCache::decode(const URL& url, ThreadPoolJob& job)
+{
+    // WAV and AIFF already play memory-mapped, a decoded copy would only use up the budget
+    if (MappedTrackSource::canPlayMapped(formatManager, url))
+        return nullptr;
+
+    std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(url.createInputStream(false)));
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+        return nullptr;
+
+    auto numChannels = (int) jlimit(1u, 2u, reader->numChannels);
+    auto bytesNeeded = (int64) numChannels * reader->lengthInSamples * (int64) sizeof(int16);
+
+    if (bytesNeeded > getMemoryBudget())
+        return nullptr;
+
+    CachedTrack::Ptr track (new CachedTrack(numChannels, reader->lengthInSamples, reader->sampleRate));
+
+    const int chunkSize = 65536;
+    AudioBuffer<float> chunk (numChannels, chunkSize);
+
+    for (int64 pos = 0; pos < reader->lengthInSamples; pos += chunkSize)
+    {
+        if (job.shouldExit())
+            return nullptr;
+
+        auto numToRead = (int) jmin((int64) chunkSize, reader->lengthInSamples - pos);
+
+        reader->read(&chunk, 0, numToRead, pos, true, numChannels > 1);
+        track->write(chunk, numToRead, pos);
+    }
+
+    return track;
+}
+
+// Stores the decoded track and notifies everyone who asked for it
+void TrackCache::decodeFinished(const String& key, CachedTrack::Ptr track)
+{
+    std::vector<std::function<void (CachedTrack::Ptr)>> callbacks;
+
+    {
+        const ScopedLock sl (lock);
+
+        auto it = decodesInFlight.find(key);
+        if (it != decodesInFlight.end())
+        {
+            callbacks = std::move(it->second);
+            decodesInFlight.erase(it);
+        }
+
+        if (track != nullptr && enabled)
+        {
+            auto size = (int64) track->getSizeInBytes();
+            bool isPinned = pinCounts.find(key) != pinCounts.end();
+
+            // Make room first, a pinned track goes in even if that leaves us over budget
+            evictToFit(memoryBudget - size);
+
+            if ((isPinned || memoryUsed + size <= memoryBudget) && entries.find(key) == entries.end())
+            {
+                auto& entry = entries[key];
+                entry.track = track;
+                entry.useOrderPosition = useOrder.insert(useOrder.end(), key);
+                memoryUsed += size;
+            }
+        }
+
+        // A track the cache couldn't keep isn't handed out, it would use memory nobody counts
+        if (! enabled || entries.find(key) == entries.end())
+            track = nullptr;
+    }
+
+    for (auto& callback : callbacks)
+        callback(track);
+}
+
+// Walks from the least recently used end, only pinned tracks are ever stepped over
+void TrackCache::evictToFit(int64 budget)
+{
+    auto key = useOrder.begin();
+
+    while (memoryUsed > budget && key != useOrder.end())
+    {
+        if (pinCounts.find(*key) != pinCounts.end())
+        {
+            ++key;
+            continue;
+        }
+
+        auto entry = entries.find(*key);
+        memoryUsed -= (int64) entry->second.track->getSizeInBytes();
+        entries.erase(entry);
+        key = useOrder.erase(key);
+    }
+}
+
+void TrackCache::touch(Entry& entry)
+{
+    useOrder.splice(useOrder.end(), useOrder, entry.useOrderPosition);
+}
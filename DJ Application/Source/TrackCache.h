@@ -0,0 +1,126 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <list>
+
+// A whole track decoded into memory as 16-bit samples, half the size of float
+class CachedTrack : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<CachedTrack>;
+
+    CachedTrack(int numChannels, int64 numSamples, double sampleRate);
+
+    int getNumChannels() const { return numChannels; }
+    int64 getNumSamples() const { return numSamples; }
+    double getSampleRate() const { return sampleRate; }
+    size_t getSizeInBytes() const { return (size_t) numChannels * (size_t) numSamples * sizeof(int16); }
+
+    // Stores float samples starting at the given position
+    void write(const AudioBuffer<float>& source, int numSamplesToWrite, int64 startSample);
+
+    // Converts a range of one channel back to float
+    void read(int channel, float* dest, int64 startSample, int numSamplesToRead) const;
+
+private:
+    const int numChannels;
+    const int64 numSamples;
+    const double sampleRate;
+    HeapBlock<int16> data;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CachedTrack)
+};
+
+// Plays a cached track straight from memory, seeking is just a position change
+class CachedTrackSource : public PositionableAudioSource
+{
+public:
+    CachedTrackSource(CachedTrack::Ptr track);
+
+    // AudioSource overrides
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override {}
+    void releaseResources() override {}
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    // PositionableAudioSource overrides
+    void setNextReadPosition (int64 newPosition) override { position = newPosition; }
+    int64 getNextReadPosition() const override { return position.load(); }
+    int64 getTotalLength() const override { return track->getNumSamples(); }
+    bool isLooping() const override { return false; }
+
+private:
+    CachedTrack::Ptr track;
+    std::atomic<int64> position { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CachedTrackSource)
+};
+
+// Decoded PCM cache shared by all decks, with a memory budget and LRU eviction.
+// Pinned tracks (loaded on a deck or waiting in a queue) are never evicted
+class TrackCache
+{
+public:
+    TrackCache(AudioFormatManager& formatManager);
+    ~TrackCache();
+
+    // The cache can be switched off entirely on low-memory machines
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled.load(); }
+
+    // Memory budget in bytes, evicts straight away if the new budget is smaller
+    void setMemoryBudget(int64 numBytes);
+    int64 getMemoryBudget() const;
+    int64 getMemoryUsed() const;
+
+    // Returns the decoded track if it is cached and marks it as recently used
+    CachedTrack::Ptr find(const URL& url);
+
+    // Decodes the track in the background if it is not cached yet, the callback is delivered
+    // on the message thread. It gets nullptr on failure, and for a track that didn't fit in
+    // the budget, so nothing is ever held outside what the cache counts
+    void requestDecode(const URL& url, std::function<void (CachedTrack::Ptr)> onReady = nullptr);
+
+    // Pinned tracks stay in memory regardless of the budget
+    void pin(const URL& url);
+    void unpin(const URL& url);
+
+private:
+    class DecodeJob;
+
+    struct Entry
+    {
+        CachedTrack::Ptr track;
+        std::list<String>::iterator useOrderPosition;
+    };
+
+    static String getKey(const URL& url) { return url.toString(false); }
+
+    // Runs on the decode thread
+    CachedTrack::Ptr decode(const URL& url, ThreadPoolJob& job);
+    void decodeFinished(const String& key, CachedTrack::Ptr track);
+
+    // Evicts least recently used unpinned tracks until the budget is met, caller holds the lock
+    void evictToFit(int64 budget);
+
+    // Moves the entry to the most recently used end, caller holds the lock
+    void touch(Entry& entry);
+
+    AudioFormatManager& formatManager;
+    ThreadPool decodePool { 1 };
+
+    mutable CriticalSection lock;
+    std::map<String, Entry> entries;
+
+    // Keys from least to most recently used, so eviction never has to search
+    std::list<String> useOrder;
+    std::map<String, int> pinCounts;
+    std::map<String, std::vector<std::function<void (CachedTrack::Ptr)>>> decodesInFlight;
+    int64 memoryBudget = (int64) 1024 * 1024 * 1024;
+    int64 memoryUsed = 0;
+    std::atomic<bool> enabled { true };
+
+    WeakReference<TrackCache> selfReference;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (TrackCache)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackCache)
+};
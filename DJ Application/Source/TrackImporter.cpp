@@ -0,0 +1,153 @@
+#include "TrackImporter.h"
+
+//==============================================================================
+// Walks the dropped files and folders, handing files over to be probed a batch at a time
+class TrackImporter::ScanJob : public ThreadPoolJob
+{
+public:
+    ScanJob(TrackImporter& _owner, const StringArray& _paths)
+    : ThreadPoolJob("Track import scanner"), owner(_owner), paths(_paths)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        for (auto& path : paths)
+        {
+            File file (path);
+
+            if (file.isDirectory())
+            {
+                for (auto& entry : RangedDirectoryIterator (file, true, "*", File::findFiles))
+                {
+                    if (shouldExit())
+                        return jobHasFinished;
+
+                    add(entry.getFile());
+                }
+            }
+            else
+            {
+                add(file);
+            }
+        }
+
+        if (! batch.empty())
+            owner.probeAsync(std::move(batch));
+
+        return jobHasFinished;
+    }
+
+private:
+    void add(const File& file)
+    {
+        if (! owner.canImport(file))
+            return;
+
+        batch.push_back(file);
+
+        if ((int) batch.size() == filesPerBatch)
+        {
+            owner.probeAsync(std::move(batch));
+            batch.clear();
+        }
+    }
+
+    TrackImporter& owner;
+    const StringArray paths;
+    std::vector<File> batch;
+};
+
+//==============================================================================
+// Opens a reader for each file in a batch, which only reads the header.
+// Keeps nothing of the importer's but a weak reference, as it can still be queued
+// while the importer is being destroyed
+class TrackImporter::ProbeJob : public ThreadPoolJob
+{
+public:
+    ProbeJob(AudioFormatManager& _formatManager, WeakReference<TrackImporter> _owner, std::vector<File> _files)
+    : ThreadPoolJob("Track import prober"), formatManager(_formatManager), owner(_owner), files(std::move(_files))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        std::vector<TrackLibrary::TrackInfo> tracks;
+
+        for (auto& file : files)
+        {
+            if (shouldExit())
+                break;
+
+            std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(file));
+
+            if (reader == nullptr || reader->sampleRate <= 0)
+                continue;
+
+            TrackLibrary::TrackInfo track;
+            track.url = URL(file);
+            track.title = file.getFileNameWithoutExtension();
+            track.format = reader->getFormatName();
+            track.lengthInSeconds = (double) reader->lengthInSamples / reader->sampleRate;
+            track.sampleRate = reader->sampleRate;
+            track.numChannels = (int) reader->numChannels;
+            tracks.push_back(track);
+        }
+
+        if (! tracks.empty())
+        {
+            auto weakOwner = owner;
+
+            MessageManager::callAsync([weakOwner, tracks]
+            {
+                if (auto* importer = weakOwner.get())
+                    importer->tracksFound(tracks);
+            });
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    AudioFormatManager& formatManager;
+    WeakReference<TrackImporter> owner;
+    const std::vector<File> files;
+};
+
+//==============================================================================
+TrackImporter::TrackImporter(AudioFormatManager& _formatManager)
+: formatManager(_formatManager)
+{
+    selfReference = this;
+}
+
+TrackImporter::~TrackImporter()
+{
+    pool.removeAllJobs(true, 10000);
+}
+
+bool TrackImporter::canImport(const File& file) const
+{
+    return file.isDirectory() || formatManager.findFormatForFileExtension(file.getFileExtension()) != nullptr;
+}
+
+void TrackImporter::importAsync(const StringArray& paths)
+{
+    pool.addJob(new ScanJob(*this, paths), true);
+}
+
+void TrackImporter::cancel()
+{
+    pool.removeAllJobs(true, 10000);
+}
+
+void TrackImporter::probeAsync(std::vector<File> files)
+{
+    pool.addJob(new ProbeJob(formatManager, selfReference, std::move(files)), true);
+}
+
+void TrackImporter::tracksFound(const std::vector<TrackLibrary::TrackInfo>& tracks)
+{
+    if (onTracksFound != nullptr)
+        onTracksFound(tracks);
+}
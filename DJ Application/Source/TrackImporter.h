@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "TrackLibrary.h"
+#include <vector>
+
+// Finds the audio files among dropped files and folders and reads their headers.
+//
+// Folders are searched recursively on one worker while the files found so far are
+// probed in batches on the others, one worker per core. Each batch is handed back on
+// the message thread as soon as it is read, so rows appear while the import goes on
+class TrackImporter
+{
+public:
+    TrackImporter(AudioFormatManager& formatManager);
+    ~TrackImporter();
+
+    // True for folders and for files with an extension one of the formats reads
+    bool canImport(const File& file) const;
+
+    // Files that turn out not to be readable are skipped. Batches come back in
+    // whatever order they finish, the tracks within a batch keep their folder order
+    void importAsync(const StringArray& paths);
+
+    // Stops the imports in progress, batches already read are still delivered
+    void cancel();
+
+    // Called on the message thread with each batch of readable tracks
+    std::function<void (const std::vector<TrackLibrary::TrackInfo>&)> onTracksFound;
+
+private:
+    class ScanJob;
+    class ProbeJob;
+
+    // Enough files per batch that a large crate isn't thousands of table updates
+    static constexpr int filesPerBatch = 64;
+
+    void probeAsync(std::vector<File> files);
+    void tracksFound(const std::vector<TrackLibrary::TrackInfo>& tracks);
+
+    AudioFormatManager& formatManager;
+    ThreadPool pool { jmax(2, SystemStats::getNumCpus()) };
+
+    WeakReference<TrackImporter> selfReference;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (TrackImporter)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackImporter)
+};
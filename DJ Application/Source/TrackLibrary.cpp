@@ -0,0 +1,473 @@
+#include "TrackLibrary.h"
+
+namespace
+{
+    const char libraryMagic[8] = { 'O', 'T', 'O', 'L', 'I', 'B', 'R', 'Y' };
+    // Version 2 added the index, files without one are still read record by record
+    const int libraryVersion = 2;
+    const size_t libraryHeaderSize = sizeof(libraryMagic) + sizeof(int32);
+
+    // type, track id, payload size
+    const size_t recordHeaderSize = sizeof(int32) + sizeof(int64) + sizeof(int32);
+
+    // The index follows the records, one entry per track and then a footer that ends the file
+    const char indexMagic[8] = { 'O', 'T', 'O', 'I', 'N', 'D', 'E', 'X' };
+
+    // track id, payload offset, payload size
+    const size_t indexEntrySize = sizeof(int64) + sizeof(int64) + sizeof(int32);
+
+    // index offset, number of entries, next track id, magic
+    const size_t indexFooterSize = sizeof(int64) + sizeof(int32) + sizeof(int64) + sizeof(indexMagic);
+
+    void writeLibraryHeader(OutputStream& stream)
+    {
+        stream.write(libraryMagic, sizeof(libraryMagic));
+        stream.writeInt(libraryVersion);
+    }
+
+    bool writeRecord(OutputStream& stream, int type, int64 id, const void* data, size_t size)
+    {
+        return stream.writeInt(type)
+            && stream.writeInt64(id)
+            && stream.writeInt((int) size)
+            && (size == 0 || stream.write(data, size));
+    }
+}
+
+TrackLibrary::TrackLibrary(const File& _libraryFile)
+: libraryFile(_libraryFile),
+  logFile(_libraryFile.withFileExtension("log"))
+{
+    libraryFile.getParentDirectory().createDirectory();
+
+    // Only the index is touched here, the pages holding titles and URLs stay on disk.
+    // A file written before there was an index has its records walked instead
+    if (libraryFile.existsAsFile())
+    {
+        mappedLibrary.reset(new MemoryMappedFile(libraryFile, MemoryMappedFile::readOnly));
+
+        if (mappedLibrary->getData() == nullptr)
+            mappedLibrary.reset();
+        else if (! readIndex(mappedLibrary->getData(), mappedLibrary->getSize()))
+            readRecords(mappedLibrary->getData(), mappedLibrary->getSize());
+    }
+
+    // Edits since the file was last written
+    if (logFile.existsAsFile() && logFile.loadFileAsData(logContents))
+        readRecords(logContents.getData(), logContents.getSize());
+
+    logStream.reset(new FileOutputStream(logFile));
+
+    if (logStream->openedOk())
+    {
+        // Drops a damaged tail, so new edits aren't appended after it and lost
+        if (logBytes < logStream->getPosition())
+        {
+            logStream->setPosition(logBytes);
+            logStream->truncate();
+        }
+
+        if (logBytes == 0)
+        {
+            writeLibraryHeader(*logStream);
+            logBytes = (int64) libraryHeaderSize;
+        }
+    }
+    else
+    {
+        logStream.reset();
+    }
+
+    startTimer(1000);
+}
+
+TrackLibrary::~TrackLibrary()
+{
+    stopTimer();
+    flush();
+
+    // Folding the log in rewrites the whole file, so it waits until the log is worth it
+    auto librarySize = mappedLibrary != nullptr ? (int64) mappedLibrary->getSize() : 0;
+
+    if (logBytes > jmax((int64) 64 * 1024, librarySize / 4))
+        compact();
+}
+
+TrackLibrary::TrackId TrackLibrary::getTrackId(int index) const
+{
+    return getEntry(index).id;
+}
+
+int TrackLibrary::indexOf(TrackId id) const
+{
+    auto slot = slotById.find(id);
+    return slot != slotById.end() ? countLiveBefore(slot->second) : -1;
+}
+
+TrackLibrary::TrackInfo TrackLibrary::getTrack(int index) const
+{
+    auto& entry = getEntry(index);
+    MemoryInputStream stream (entry.getData(), entry.getSize(), false);
+
+    TrackInfo track;
+    track.url = URL(stream.readString());
+    track.title = stream.readString();
+    track.lengthInSeconds = stream.readDouble();
+    track.sampleRate = stream.readDouble();
+    track.numChannels = stream.readInt();
+    track.bpm = stream.readDouble();
+
+    // Added after the first version, so records written before them end early
+    if (! stream.isExhausted())
+    {
+        track.format = stream.readString();
+        track.firstBeatSeconds = stream.readDouble();
+    }
+
+    // Before tracks without a beat were marked, only a tempo showed a track had been analysed
+    track.beatsAnalysed = stream.isExhausted() ? track.bpm > 0 : stream.readBool();
+
+    return track;
+}
+
+String TrackLibrary::getTitle(int index) const
+{
+    auto& entry = getEntry(index);
+    MemoryInputStream stream (entry.getData(), entry.getSize(), false);
+
+    // The URL comes first
+    stream.readString();
+    return stream.readString();
+}
+
+URL TrackLibrary::getURL(int index) const
+{
+    auto& entry = getEntry(index);
+    MemoryInputStream stream (entry.getData(), entry.getSize(), false);
+    return URL(stream.readString());
+}
+
+TrackLibrary::TrackId TrackLibrary::addTrack(const TrackInfo& track)
+{
+    auto id = nextId++;
+    putTrack(id, track);
+    return id;
+}
+
+void TrackLibrary::updateTrack(int index, const TrackInfo& track)
+{
+    if (isPositiveAndBelow(index, getNumTracks()))
+        putTrack(getEntry(index).id, track);
+}
+
+void TrackLibrary::removeTrack(int index)
+{
+    if (! isPositiveAndBelow(index, getNumTracks()))
+        return;
+
+    auto slot = findSlot(index);
+    auto id = entries[(size_t) slot].id;
+    removeSlot(slot);
+
+    appendToLog(removeRecord, id, {});
+}
+
+void TrackLibrary::flush()
+{
+    if (logStream != nullptr)
+        logStream->flush();
+}
+
+void TrackLibrary::timerCallback()
+{
+    flush();
+}
+
+bool TrackLibrary::readIndex(const void* data, size_t size)
+{
+    if (size < libraryHeaderSize + indexFooterSize
+        || memcmp(data, libraryMagic, sizeof(libraryMagic)) != 0
+        || memcmp(addBytesToPointer(data, size - sizeof(indexMagic)), indexMagic, sizeof(indexMagic)) != 0)
+        return false;
+
+    MemoryInputStream footer (addBytesToPointer(data, size - indexFooterSize), indexFooterSize, false);
+    auto indexOffset = footer.readInt64();
+    auto numEntries = footer.readInt();
+    auto storedNextId = footer.readInt64();
+
+    // The entries must fill the space between the records and the footer exactly
+    auto recordsEnd = (int64) (size - indexFooterSize);
+
+    if (indexOffset < (int64) libraryHeaderSize || numEntries < 0
+        || indexOffset + (int64) numEntries * (int64) indexEntrySize != recordsEnd)
+        return false;
+
+    MemoryInputStream index (addBytesToPointer(data, (size_t) indexOffset), (size_t) numEntries * indexEntrySize, false);
+
+    entries.reserve((size_t) numEntries);
+    liveCounts.reserve((size_t) numEntries);
+    slotById.reserve((size_t) numEntries);
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        auto id = index.readInt64();
+        auto offset = index.readInt64();
+        auto dataSize = index.readInt();
+
+        if (offset < (int64) libraryHeaderSize || dataSize < 0 || offset + dataSize > indexOffset)
+        {
+            clearEntries();
+            return false;
+        }
+
+        auto& entry = findOrAddEntry(id);
+        entry.data = addBytesToPointer(data, (size_t) offset);
+        entry.size = (size_t) dataSize;
+    }
+
+    // Removed tracks aren't in the file any more, but their ids still can't be reused
+    nextId = jmax(nextId, storedNextId);
+    return true;
+}
+
+void TrackLibrary::readRecords(const void* data, size_t size)
+{
+    if (size < libraryHeaderSize || memcmp(data, libraryMagic, sizeof(libraryMagic)) != 0)
+        return;
+
+    MemoryInputStream stream (data, size, false);
+    stream.setPosition(sizeof(libraryMagic));
+
+    auto version = stream.readInt();
+
+    if (version < 1 || version > libraryVersion)
+        return;
+
+    while ((size_t) stream.getNumBytesRemaining() >= recordHeaderSize)
+    {
+        auto type = stream.readInt();
+        auto id = stream.readInt64();
+        auto dataSize = stream.readInt();
+
+        // A write cut short by a crash leaves a partial record at the end
+        if (dataSize < 0 || dataSize > stream.getNumBytesRemaining() || (type != putRecord && type != removeRecord))
+            break;
+
+        if (type == putRecord)
+        {
+            auto& entry = findOrAddEntry(id);
+            entry.sessionData.reset();
+            entry.data = addBytesToPointer(data, (size_t) stream.getPosition());
+            entry.size = (size_t) dataSize;
+        }
+        else
+        {
+            auto slot = slotById.find(id);
+
+            if (slot != slotById.end())
+                removeSlot(slot->second);
+        }
+
+        nextId = jmax(nextId, id + 1);
+        stream.skipNextBytes(dataSize);
+
+        // Only records read in full count, for trimming a damaged log
+        if (data == logContents.getData())
+            logBytes = stream.getPosition();
+    }
+}
+
+void TrackLibrary::putTrack(TrackId id, const TrackInfo& track)
+{
+    auto payload = encode(track);
+
+    findOrAddEntry(id).sessionData = payload;
+    appendToLog(putRecord, id, payload);
+}
+
+TrackLibrary::Entry& TrackLibrary::findOrAddEntry(TrackId id)
+{
+    auto slot = slotById.find(id);
+
+    if (slot != slotById.end())
+        return entries[(size_t) slot->second];
+
+    slotById[id] = (int) entries.size();
+    entries.push_back(Entry { id });
+    appendLiveCount();
+    ++numLive;
+    return entries.back();
+}
+
+void TrackLibrary::removeSlot(int slot)
+{
+    auto& entry = entries[(size_t) slot];
+    slotById.erase(entry.id);
+    entry.removed = true;
+    entry.sessionData.reset();
+
+    for (auto i = slot + 1; i <= (int) liveCounts.size(); i += i & -i)
+        --liveCounts[(size_t) i - 1];
+
+    --numLive;
+    ++numRemoved;
+
+    // Each squeeze is paid for by at least as many removals
+    if (numRemoved > jmax(1024, numLive))
+        squeezeRemovedSlots();
+}
+
+void TrackLibrary::clearEntries()
+{
+    entries.clear();
+    slotById.clear();
+    liveCounts.clear();
+    numLive = numRemoved = 0;
+}
+
+void TrackLibrary::squeezeRemovedSlots()
+{
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& e) { return e.removed; }),
+                  entries.end());
+
+    for (size_t i = 0; i < entries.size(); ++i)
+        slotById[entries[i].id] = (int) i;
+
+    numRemoved = 0;
+    buildLiveCounts();
+}
+
+int TrackLibrary::countLiveBefore(int slot) const
+{
+    int count = 0;
+
+    for (auto i = slot; i > 0; i -= i & -i)
+        count += liveCounts[(size_t) i - 1];
+
+    return count;
+}
+
+// Walks down the tree from the widest span, the slot holding the index'th live entry
+int TrackLibrary::findSlot(int index) const
+{
+    auto size = (int) liveCounts.size();
+    int position = 0, remaining = index + 1;
+
+    for (auto step = nextPowerOfTwo(size); step > 0; step >>= 1)
+    {
+        if (position + step <= size && liveCounts[(size_t) (position + step - 1)] < remaining)
+        {
+            position += step;
+            remaining -= liveCounts[(size_t) position - 1];
+        }
+    }
+
+    return position;
+}
+
+// The new slot's span covers slots already counted, the new one is live
+void TrackLibrary::appendLiveCount()
+{
+    auto i = (int) liveCounts.size() + 1;
+    liveCounts.push_back(1 + countLiveBefore(i - 1) - countLiveBefore(i - (i & -i)));
+}
+
+void TrackLibrary::buildLiveCounts()
+{
+    auto size = entries.size();
+    liveCounts.assign(size, 0);
+
+    for (size_t i = 1; i <= size; ++i)
+    {
+        liveCounts[i - 1] += entries[i - 1].removed ? 0 : 1;
+
+        auto parent = i + (i & (~i + 1));
+
+        if (parent <= size)
+            liveCounts[parent - 1] += liveCounts[i - 1];
+    }
+}
+
+void TrackLibrary::appendToLog(RecordType type, TrackId id, const MemoryBlock& payload)
+{
+    if (logStream == nullptr)
+        return;
+
+    // Buffered by the stream, the timer flushes it
+    if (writeRecord(*logStream, type, id, payload.getData(), payload.getSize()))
+        logBytes += (int64) (recordHeaderSize + payload.getSize());
+}
+
+MemoryBlock TrackLibrary::encode(const TrackInfo& track)
+{
+    MemoryOutputStream stream;
+    stream.writeString(track.url.toString(false));
+    stream.writeString(track.title);
+    stream.writeDouble(track.lengthInSeconds);
+    stream.writeDouble(track.sampleRate);
+    stream.writeInt(track.numChannels);
+    stream.writeDouble(track.bpm);
+    stream.writeString(track.format);
+    stream.writeDouble(track.firstBeatSeconds);
+    stream.writeBool(track.beatsAnalysed);
+    return stream.getMemoryBlock();
+}
+
+bool TrackLibrary::compact()
+{
+    TemporaryFile newLibrary (libraryFile);
+    bool written = false;
+
+    {
+        FileOutputStream stream (newLibrary.getFile());
+
+        if (stream.openedOk())
+        {
+            writeLibraryHeader(stream);
+
+            std::vector<int64> offsets (entries.size());
+
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                if (entries[i].removed)
+                    continue;
+
+                offsets[i] = stream.getPosition() + (int64) recordHeaderSize;
+                writeRecord(stream, putRecord, entries[i].id, entries[i].getData(), entries[i].getSize());
+            }
+
+            auto indexOffset = stream.getPosition();
+
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                if (entries[i].removed)
+                    continue;
+
+                stream.writeInt64(entries[i].id);
+                stream.writeInt64(offsets[i]);
+                stream.writeInt((int) entries[i].getSize());
+            }
+
+            stream.writeInt64(indexOffset);
+            stream.writeInt(numLive);
+            stream.writeInt64(nextId);
+            stream.write(indexMagic, sizeof(indexMagic));
+
+            stream.flush();
+            written = stream.getStatus().wasOk();
+        }
+    }
+
+    // Entries point into the mapping, and the file can't be replaced while it is mapped
+    clearEntries();
+    mappedLibrary.reset();
+    logContents.reset();
+    logStream.reset();
+
+    if (! written || ! newLibrary.overwriteTargetFileWithTemporary())
+        return false;
+
+    logFile.deleteFile();
+    logBytes = 0;
+    return true;
+}
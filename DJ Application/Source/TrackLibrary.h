@@ -0,0 +1,142 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <unordered_map>
+#include <vector>
+
+// The track list and what is known about each track, kept on disk between sessions.
+//
+// The library file is memory-mapped when it is opened and only the index at its end
+// is read, a table of where each track's record sits, so opening costs the same
+// whatever the tracks hold. A track's fields are decoded from its record when they
+// are asked for. Every edit is appended to a log
+// next to the file, which is folded back in when the library is closed with enough
+// edits pending. A record cut short by a crash ends the log, the edits before it stay.
+//
+// Tracks are kept in the order they were added. Removing one only marks its slot, and
+// a count of the live slots in a Fenwick tree turns rows into slots and back in
+// logarithmic time, so no edit moves the tracks after it. The marked slots are
+// squeezed out once they outnumber the live ones. Replaying the log repeats the same
+// edits, so the library reopens in the order it was left in.
+//
+// Message thread only
+class TrackLibrary : private Timer
+{
+public:
+    // Assigned when a track is added and never reused, so it stays with the track
+    // whichever row the track is in
+    using TrackId = int64;
+
+    struct TrackInfo
+    {
+        URL url;
+        String title;
+
+        // Zero, or empty, until the track has been read
+        String format;
+        double lengthInSeconds = 0;
+        double sampleRate = 0;
+        int numChannels = 0;
+
+        // Analysis results, zero until analysed and for tracks without a steady beat
+        double bpm = 0;
+        double firstBeatSeconds = 0;
+        bool beatsAnalysed = false;
+    };
+
+    explicit TrackLibrary(const File& libraryFile);
+    ~TrackLibrary() override;
+
+    int getNumTracks() const { return numLive; }
+
+    TrackId getTrackId(int index) const;
+
+    // Position of a track, or -1 if it has been removed. Logarithmic time
+    int indexOf(TrackId id) const;
+
+    // Decoded from the stored record on each call
+    TrackInfo getTrack(int index) const;
+    String getTitle(int index) const;
+    URL getURL(int index) const;
+
+    TrackId addTrack(const TrackInfo& track);
+    void updateTrack(int index, const TrackInfo& track);
+    void removeTrack(int index);
+
+    // Writes edits still buffered in memory to the log
+    void flush();
+
+private:
+    enum RecordType
+    {
+        putRecord = 1,
+        removeRecord = 2
+    };
+
+    struct Entry
+    {
+        TrackId id;
+        bool removed = false;
+
+        // Points into the mapped file or the log contents, unless sessionData holds the record
+        const void* data = nullptr;
+        size_t size = 0;
+        MemoryBlock sessionData;
+
+        const void* getData() const { return sessionData.getSize() > 0 ? sessionData.getData() : data; }
+        size_t getSize() const { return sessionData.getSize() > 0 ? sessionData.getSize() : size; }
+    };
+
+    // Flushes the log now and then, so a crash loses at most a second of edits
+    void timerCallback() override;
+
+    // Finds the tracks from the index at the end of a library file, false if there
+    // isn't a complete one
+    bool readIndex(const void* data, size_t size);
+
+    // Applies the records in a library file or log, stopping at the first damaged one
+    void readRecords(const void* data, size_t size);
+
+    Entry& findOrAddEntry(TrackId id);
+    const Entry& getEntry(int index) const { return entries[(size_t) findSlot(index)]; }
+
+    // Marks the slot and leaves the others where they are
+    void removeSlot(int slot);
+    void clearEntries();
+
+    // Drops the marked slots and rebuilds the counts, once there are enough to be worth it
+    void squeezeRemovedSlots();
+
+    // Fenwick tree over the slots, liveCounts[i - 1] counts the live slots in
+    // (i - lowest bit of i, i] counting from one
+    int countLiveBefore(int slot) const;
+    int findSlot(int index) const;
+    void appendLiveCount();
+    void buildLiveCounts();
+
+    // Stores the record in memory and appends it to the log
+    void putTrack(TrackId id, const TrackInfo& track);
+    void appendToLog(RecordType type, TrackId id, const MemoryBlock& payload);
+
+    // Rewrites the library file and its index from the current tracks and deletes the log
+    bool compact();
+
+    static MemoryBlock encode(const TrackInfo& track);
+
+    const File libraryFile, logFile;
+
+    std::unique_ptr<MemoryMappedFile> mappedLibrary;
+    MemoryBlock logContents;
+
+    // In the library's order including removed slots, with the slot of each live id
+    std::vector<Entry> entries;
+    std::unordered_map<TrackId, int> slotById;
+    std::vector<int> liveCounts;
+    int numLive = 0, numRemoved = 0;
+    TrackId nextId = 1;
+
+    std::unique_ptr<FileOutputStream> logStream;
+    int64 logBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackLibrary)
+};
@@ -0,0 +1,210 @@
+#include "TrackLoader.h"
+
+// Job that prepares one track on a loader thread
+class TrackLoader::LoadJob : public ThreadPoolJob
+{
+public:
+    LoadJob(TrackLoader& _owner, int _requestId, const Request& _request)
+    : ThreadPoolJob("Track loader"), owner(_owner), requestId(_requestId), request(_request)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        auto track = owner.prepareTrack(request, [this](float progress)
+        {
+            owner.postProgress(requestId, progress);
+        });
+
+        owner.postCompletion(requestId, std::move(track));
+        return jobHasFinished;
+    }
+
+private:
+    TrackLoader& owner;
+    const int requestId;
+    const Request request;
+};
+
+// Initialises the loader with its own pool so slow files never block the GUI
+TrackLoader::TrackLoader(AudioFormatManager& _formatManager, TimeSliceThread& _diskThread, int numLoaderThreads)
+: formatManager(_formatManager), diskThread(_diskThread), pool(numLoaderThreads)
+{
+    selfReference = this;
+}
+
+TrackLoader::~TrackLoader()
+{
+    pool.removeAllJobs(true, 10000);
+
+    // Finished tracks that were never delivered are released while the disk thread still exists
+    const ScopedLock sl (pendingLock);
+    pendingLoads.clear();
+}
+
+// Registers the callbacks and queues the job
+void TrackLoader::loadAsync(const Request& request, ProgressCallback onProgress, CompletionCallback onComplete)
+{
+    int requestId;
+
+    {
+        const ScopedLock sl (pendingLock);
+        requestId = ++nextRequestId;
+
+        auto& pending = pendingLoads[requestId];
+        pending.onProgress = std::move(onProgress);
+        pending.onComplete = std::move(onComplete);
+    }
+
+    pool.addJob(new LoadJob(*this, requestId, request), true);
+}
+
+// Opens the stream, probes the format and fills the read-ahead buffer
+std::unique_ptr<PreparedTrack> TrackLoader::prepareTrack(const Request& request, const ProgressCallback& onProgress)
+{
+    auto reportProgress = [&onProgress](float progress)
+    {
+        if (onProgress)
+            onProgress(progress);
+    };
+
+    reportProgress(0.0f);
+
+    // Already decoded, nothing to open or buffer
+    if (trackCache != nullptr)
+    {
+        auto cached = trackCache->find(request.url);
+
+        if (cached != nullptr)
+        {
+            reportProgress(1.0f);
+            return prepareCachedTrack(request.url, cached);
+        }
+    }
+
+    // Uncompressed local files play straight from a memory map
+    if (auto* mappedReader = MappedTrackSource::createMappedReaderFor(formatManager, request.url))
+    {
+        std::unique_ptr<PreparedTrack> track (new PreparedTrack());
+        track->url = request.url;
+        track->sampleRate = mappedReader->sampleRate;
+        track->mappedSource.reset(new MappedTrackSource(mappedReader, diskThread, request.readAheadSize));
+
+        if (request.sampleRate > 0 && request.blockSize > 0)
+            track->prepare(request.blockSize, request.sampleRate);
+
+        reportProgress(1.0f);
+        return track;
+    }
+
+    auto* reader = formatManager.createReaderFor(request.url.createInputStream(false));
+    if (reader == nullptr)
+        return nullptr;
+
+    std::unique_ptr<PreparedTrack> track (new PreparedTrack());
+    track->url = request.url;
+    track->sampleRate = reader->sampleRate;
+    track->readerSource.reset(new AudioFormatReaderSource(reader, true));
+
+    // Offline rendering reads straight from the decoder so the output never depends on thread timing
+    if (request.readAheadSize > 0)
+        track->readAheadSource.reset(new ReadAheadAudioSource(track->readerSource.get(),
+                                                              diskThread,
+                                                              request.readAheadSize,
+                                                              2));
+
+    // The wait for the first decoded chunk happens here on the loader thread, so a deck
+    // never starts on an underrun and nothing else has to wait for it. Its progress is
+    // the only part of a load that can be measured, opening the file is one call
+    if (request.sampleRate > 0 && request.blockSize > 0)
+    {
+        track->prepare(request.blockSize, request.sampleRate);
+
+        if (track->readAheadSource != nullptr)
+            track->readAheadSource->waitForPrefill(500, reportProgress);
+    }
+
+    reportProgress(1.0f);
+
+    return track;
+}
+
+std::unique_ptr<PreparedTrack> TrackLoader::prepareCachedTrack(const URL& url, CachedTrack::Ptr cachedTrack)
+{
+    std::unique_ptr<PreparedTrack> track (new PreparedTrack());
+    track->url = url;
+    track->sampleRate = cachedTrack->getSampleRate();
+    track->cachedSource.reset(new CachedTrackSource(cachedTrack));
+
+    return track;
+}
+
+void TrackLoader::postProgress(int requestId, float progress)
+{
+    auto weakThis = selfReference;
+
+    MessageManager::callAsync([weakThis, requestId, progress]
+    {
+        if (auto* loader = weakThis.get())
+            loader->deliverProgress(requestId, progress);
+    });
+}
+
+void TrackLoader::postCompletion(int requestId, std::unique_ptr<PreparedTrack> track)
+{
+    {
+        const ScopedLock sl (pendingLock);
+
+        auto it = pendingLoads.find(requestId);
+        if (it == pendingLoads.end())
+            return;
+
+        it->second.result = std::move(track);
+    }
+
+    auto weakThis = selfReference;
+
+    MessageManager::callAsync([weakThis, requestId]
+    {
+        if (auto* loader = weakThis.get())
+            loader->deliverCompletion(requestId);
+    });
+}
+
+void TrackLoader::deliverProgress(int requestId, float progress)
+{
+    ProgressCallback callback;
+
+    {
+        const ScopedLock sl (pendingLock);
+
+        auto it = pendingLoads.find(requestId);
+        if (it == pendingLoads.end())
+            return;
+
+        callback = it->second.onProgress;
+    }
+
+    if (callback)
+        callback(progress);
+}
+
+// Hands the finished track to whoever asked for it
+void TrackLoader::deliverCompletion(int requestId)
+{
+    PendingLoad finished;
+
+    {
+        const ScopedLock sl (pendingLock);
+
+        auto it = pendingLoads.find(requestId);
+        if (it == pendingLoads.end())
+            return;
+
+        finished = std::move(it->second);
+        pendingLoads.erase(it);
+    }
+
+    if (finished.onComplete)
+        finished.onComplete(std::move(finished.result));
+}
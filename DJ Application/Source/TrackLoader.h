@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "BeatAnalyser.h"
+#include "ReadAheadAudioSource.h"
+#include "TrackCache.h"
+#include "MappedTrackSource.h"
+
+// A track whose reader and buffering sources have been built off the message thread
+struct PreparedTrack
+{
+    URL url;
+    double sampleRate = 0;
+
+    // Set when this replaces the same track and should carry on from the current position
+    bool continuesCurrentTrack = false;
+
+    // Where the beats fall, for syncing. Invalid if the track hasn't been analysed
+    BeatGrid beatGrid;
+
+    // Declared in this order so the read-ahead buffer is destroyed before its source
+    std::unique_ptr<AudioFormatReaderSource> readerSource;
+    std::unique_ptr<ReadAheadAudioSource> readAheadSource;
+
+    // Used instead of the reader when the track is already decoded in memory
+    std::unique_ptr<CachedTrackSource> cachedSource;
+
+    // Used instead of the reader for uncompressed local files
+    std::unique_ptr<MappedTrackSource> mappedSource;
+
+    // The source the deck should play from
+    PositionableAudioSource* getSource() const
+    {
+        if (cachedSource != nullptr)
+            return cachedSource.get();
+
+        if (mappedSource != nullptr)
+            return mappedSource.get();
+
+        if (readAheadSource != nullptr)
+            return readAheadSource.get();
+
+        return readerSource.get();
+    }
+
+    // Prepares the source for the device, remembering the settings so a track that
+    // waited through a device change can be prepared again before it plays
+    void prepare(int blockSize, double rate)
+    {
+        getSource()->prepareToPlay(blockSize, rate);
+        preparedBlockSize = blockSize;
+        preparedSampleRate = rate;
+    }
+
+    bool isPreparedFor(int blockSize, double rate) const
+    {
+        return preparedBlockSize == blockSize && preparedSampleRate == rate;
+    }
+
+    int preparedBlockSize = 0;
+    double preparedSampleRate = 0;
+
+    // Set by TrackSlot on a next track it drops before it takes over
+    bool droppedAsNext = false;
+
+    // True when seeking never has to restart a decoder
+    bool isRandomAccess() const { return cachedSource != nullptr || mappedSource != nullptr; }
+
+    int getNumUnderruns() const
+    {
+        return readAheadSource != nullptr ? readAheadSource->getNumUnderruns() : 0;
+    }
+};
+
+// Background job queue that opens, probes and pre-buffers tracks for the decks
+class TrackLoader
+{
+public:
+    TrackLoader(AudioFormatManager& formatManager, TimeSliceThread& diskThread, int numLoaderThreads = 2);
+    ~TrackLoader();
+
+    // What to load and how to prepare it for the deck that asked
+    struct Request
+    {
+        URL url;
+        int readAheadSize = 0;
+        int blockSize = 0;
+        double sampleRate = 0;
+    };
+
+    using ProgressCallback = std::function<void (float progress)>;
+    using CompletionCallback = std::function<void (std::unique_ptr<PreparedTrack> track)>;
+
+    // Queues a load, both callbacks are delivered on the message thread.
+    // The completion callback receives nullptr if the file could not be opened
+    void loadAsync(const Request& request, ProgressCallback onProgress, CompletionCallback onComplete);
+
+    // Builds a track on the calling thread, used by the loader jobs
+    std::unique_ptr<PreparedTrack> prepareTrack(const Request& request, const ProgressCallback& onProgress);
+
+    // Builds a track that plays from already decoded memory
+    static std::unique_ptr<PreparedTrack> prepareCachedTrack(const URL& url, CachedTrack::Ptr cachedTrack);
+
+    AudioFormatManager& getFormatManager() { return formatManager; }
+
+    // Optional decoded-track cache, checked before opening the file
+    void setTrackCache(TrackCache* cache) { trackCache = cache; }
+    TrackCache* getTrackCache() const { return trackCache; }
+
+private:
+    class LoadJob;
+
+    struct PendingLoad
+    {
+        ProgressCallback onProgress;
+        CompletionCallback onComplete;
+        std::unique_ptr<PreparedTrack> result;
+    };
+
+    // Called from loader threads, hop over to the message thread
+    void postProgress(int requestId, float progress);
+    void postCompletion(int requestId, std::unique_ptr<PreparedTrack> track);
+
+    // Called on the message thread
+    void deliverProgress(int requestId, float progress);
+    void deliverCompletion(int requestId);
+
+    AudioFormatManager& formatManager;
+    TimeSliceThread& diskThread;
+    TrackCache* trackCache = nullptr;
+    ThreadPool pool;
+
+    CriticalSection pendingLock;
+    std::map<int, PendingLoad> pendingLoads;
+    int nextRequestId = 0;
+
+    WeakReference<TrackLoader> selfReference;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (TrackLoader)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackLoader)
+};
@@ -0,0 +1,226 @@
+#include "TrackSearchIndex.h"
+#include <cstring>
+
+template <typename Function>
+void TrackSearchIndex::forEachTrigram(const char* text, size_t length, Function&& function)
+{
+    for (size_t i = 0; i + 3 <= length; ++i)
+        function(((uint32) (uint8) text[i] << 16) | ((uint32) (uint8) text[i + 1] << 8) | (uint32) (uint8) text[i + 2]);
+}
+
+void TrackSearchIndex::add(const String& text)
+{
+    auto normalised = text.toLowerCase();
+
+    offsets.push_back(normalisedText.size());
+    normalisedText.insert(normalisedText.end(), normalised.toRawUTF8(), normalised.toRawUTF8() + normalised.getNumBytesAsUTF8());
+    normalisedText.push_back(0);
+    removed.push_back(false);
+
+    appendLiveCount();
+    ++numLive;
+
+    // Appending keeps the lists sorted
+    indexSlot((int) offsets.size() - 1);
+
+    lastQueryValid = false;
+}
+
+void TrackSearchIndex::remove(int index)
+{
+    if (! isPositiveAndBelow(index, size()))
+        return;
+
+    auto slot = findSlot(index);
+    removed[(size_t) slot] = true;
+
+    for (auto i = slot + 1; i <= (int) liveCounts.size(); i += i & -i)
+        --liveCounts[(size_t) i - 1];
+
+    --numLive;
+    ++numRemoved;
+    resultsMoved = true;
+
+    // Each squeeze is paid for by at least as many removals
+    if (numRemoved > jmax(1024, numLive))
+        squeezeRemovedSlots();
+}
+
+void TrackSearchIndex::clear()
+{
+    normalisedText.clear();
+    offsets.clear();
+    removed.clear();
+    liveCounts.clear();
+    numLive = numRemoved = 0;
+    trigramEntries.clear();
+    lastQueryValid = false;
+}
+
+void TrackSearchIndex::indexSlot(int slot)
+{
+    auto* text = getText(slot);
+
+    forEachTrigram(text, std::strlen(text), [this, slot](uint32 trigram)
+    {
+        auto& entries = trigramEntries[trigram];
+
+        // A trigram repeated within the entry is only listed once
+        if (entries.empty() || entries.back() != slot)
+            entries.push_back(slot);
+    });
+}
+
+void TrackSearchIndex::squeezeRemovedSlots()
+{
+    std::vector<char> packedText;
+    std::vector<size_t> packedOffsets;
+    packedText.reserve(normalisedText.size());
+    packedOffsets.reserve((size_t) numLive);
+
+    for (size_t slot = 0; slot < offsets.size(); ++slot)
+    {
+        if (removed[slot])
+            continue;
+
+        auto* text = getText((int) slot);
+        packedOffsets.push_back(packedText.size());
+        packedText.insert(packedText.end(), text, text + std::strlen(text) + 1);
+    }
+
+    normalisedText.swap(packedText);
+    offsets.swap(packedOffsets);
+    removed.assign(offsets.size(), false);
+    numRemoved = 0;
+    buildLiveCounts();
+
+    trigramEntries.clear();
+
+    for (int slot = 0; slot < (int) offsets.size(); ++slot)
+        indexSlot(slot);
+
+    // The slots of the last results have moved
+    lastQueryValid = false;
+}
+
+int TrackSearchIndex::countLiveBefore(int slot) const
+{
+    int count = 0;
+
+    for (auto i = slot; i > 0; i -= i & -i)
+        count += liveCounts[(size_t) i - 1];
+
+    return count;
+}
+
+// Walks down the tree from the widest span, the slot holding the index'th live entry
+int TrackSearchIndex::findSlot(int index) const
+{
+    auto size = (int) liveCounts.size();
+    int position = 0, remaining = index + 1;
+
+    for (auto step = nextPowerOfTwo(size); step > 0; step >>= 1)
+    {
+        if (position + step <= size && liveCounts[(size_t) (position + step - 1)] < remaining)
+        {
+            position += step;
+            remaining -= liveCounts[(size_t) position - 1];
+        }
+    }
+
+    return position;
+}
+
+// The new slot's span covers slots already counted, the new one is live
+void TrackSearchIndex::appendLiveCount()
+{
+    auto i = (int) liveCounts.size() + 1;
+    liveCounts.push_back(1 + countLiveBefore(i - 1) - countLiveBefore(i - (i & -i)));
+}
+
+void TrackSearchIndex::buildLiveCounts()
+{
+    auto size = removed.size();
+    liveCounts.assign(size, 0);
+
+    for (size_t i = 1; i <= size; ++i)
+    {
+        liveCounts[i - 1] += removed[i - 1] ? 0 : 1;
+
+        auto parent = i + (i & (~i + 1));
+
+        if (parent <= size)
+            liveCounts[parent - 1] += liveCounts[i - 1];
+    }
+}
+
+const std::vector<int>& TrackSearchIndex::search(const String& text)
+{
+    auto normalised = text.toLowerCase();
+    std::string query (normalised.toRawUTF8(), normalised.getNumBytesAsUTF8());
+
+    if (lastQueryValid && ! resultsMoved && query == lastQuery)
+        return results;
+
+    // Anything matching the longer query also matched the shorter one
+    auto narrowing = lastQueryValid && ! lastQuery.empty() && query.find(lastQuery) != std::string::npos;
+
+    previousResultSlots.swap(resultSlots);
+    resultSlots.clear();
+    results.clear();
+    resultsMoved = false;
+
+    if (query.empty())
+    {
+        lastQueryValid = false;
+        return results;
+    }
+
+    // Entries on the shortest trigram list are the only candidates, unless narrowing
+    // the previous results leaves fewer to check
+    const std::vector<int>* shortest = nullptr;
+    bool missing = false;
+
+    forEachTrigram(query.data(), query.size(), [this, &shortest, &missing](uint32 trigram)
+    {
+        auto entries = trigramEntries.find(trigram);
+
+        if (entries == trigramEntries.end())
+            missing = true;
+        else if (shortest == nullptr || entries->second.size() < shortest->size())
+            shortest = &entries->second;
+    });
+
+    // A trigram that appears nowhere means nothing can match
+    if (! missing)
+    {
+        if (narrowing && (shortest == nullptr || previousResultSlots.size() <= shortest->size()))
+            collectMatches(previousResultSlots, query.c_str());
+        else if (shortest != nullptr)
+            collectMatches(*shortest, query.c_str());
+        else
+            scanAll(query.c_str());   // too short to have trigrams
+    }
+
+    // Slots are the indices until something is removed
+    for (auto slot : resultSlots)
+        results.push_back(numRemoved == 0 ? slot : countLiveBefore(slot));
+
+    lastQuery = std::move(query);
+    lastQueryValid = true;
+    return results;
+}
+
+void TrackSearchIndex::collectMatches(const std::vector<int>& candidateSlots, const char* query)
+{
+    for (auto slot : candidateSlots)
+        if (! removed[(size_t) slot] && std::strstr(getText(slot), query) != nullptr)
+            resultSlots.push_back(slot);
+}
+
+void TrackSearchIndex::scanAll(const char* query)
+{
+    for (int slot = 0; slot < (int) offsets.size(); ++slot)
+        if (! removed[(size_t) slot] && std::strstr(getText(slot), query) != nullptr)
+            resultSlots.push_back(slot);
+}
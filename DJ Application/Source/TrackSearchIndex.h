@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Case-insensitive substring search over a list of entries such as track titles.
+//
+// Entries are lower-cased once and packed into a single buffer, and every three-byte
+// sequence in them has a list of the entries it appears in. A query only checks the
+// entries on the shortest list among its own trigrams, and a query that extends the
+// previous one (the usual case while typing) only rechecks the previous matches.
+//
+// Removing an entry only marks its slot, as TrackLibrary does with its tracks, and a
+// Fenwick tree of the live slots turns slots into indices. Queries skip the marked slots,
+// which are squeezed out with the lists rebuilt once they outnumber the live ones
+class TrackSearchIndex
+{
+public:
+    TrackSearchIndex() = default;
+
+    // Appends an entry, its index is the number of entries before it
+    void add(const String& text);
+
+    // Removes an entry, the ones after it move up an index as they do in TrackLibrary.
+    // Logarithmic time, and a search for the last query only rechecks its matches
+    void remove(int index);
+
+    void clear();
+    int size() const { return numLive; }
+
+    // Ascending indices of the entries containing the text, ignoring case.
+    // An empty query matches nothing
+    const std::vector<int>& search(const String& text);
+
+private:
+    // Calls function with every three-byte sequence in the text packed into an int
+    template <typename Function>
+    static void forEachTrigram(const char* text, size_t length, Function&& function);
+
+    // Adds the slot to the lists of its trigrams, slots must be indexed in order
+    void indexSlot(int slot);
+
+    // Drops the marked slots, packs the text again and rebuilds the lists and counts
+    void squeezeRemovedSlots();
+
+    const char* getText(int slot) const { return normalisedText.data() + offsets[(size_t) slot]; }
+
+    // Fenwick tree over the slots, liveCounts[i - 1] counts the live slots in
+    // (i - lowest bit of i, i] counting from one
+    int countLiveBefore(int slot) const;
+    int findSlot(int index) const;
+    void appendLiveCount();
+    void buildLiveCounts();
+
+    // Live slots are checked against the query in their lower-cased form
+    void collectMatches(const std::vector<int>& candidateSlots, const char* query);
+    void scanAll(const char* query);
+
+    // Every entry lower-cased and null-terminated, removed ones until the next squeeze
+    std::vector<char> normalisedText;
+    std::vector<size_t> offsets;
+    std::vector<bool> removed;
+    std::vector<int> liveCounts;
+    int numLive = 0, numRemoved = 0;
+
+    // Lists of slots, ascending
+    std::unordered_map<uint32, std::vector<int>> trigramEntries;
+
+    // Previous query and the slots it matched, for narrowing. A removal leaves the slots
+    // good for narrowing but moves the indices handed out
+    std::string lastQuery;
+    std::vector<int> results, resultSlots, previousResultSlots;
+    bool lastQueryValid = false;
+    bool resultsMoved = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackSearchIndex)
+};
@@ -0,0 +1,586 @@
+#include "TrackSlot.h"
+
+namespace
+{
+    // Stands in for a track in nextPending, asking the audio thread to drop its next track
+    PreparedTrack clearRequest;
+
+    bool isTrack(PreparedTrack* track)
+    {
+        return track != nullptr && track != &clearRequest;
+    }
+
+    // Four-point Catmull-Rom between x[1] and x[2], smooth enough for the seconds of a crossfade
+    float interpolate(const float* x, float t)
+    {
+        return x[1] + 0.5f * t * (x[2] - x[0] + t * (2.0f * x[0] - 5.0f * x[1] + 4.0f * x[2] - x[3]
+                                                     + t * (3.0f * (x[1] - x[2]) + x[3] - x[0])));
+    }
+}
+
+TrackSlot::TrackSlot()
+{
+}
+
+TrackSlot::~TrackSlot()
+{
+    stopTimer();
+
+    // The owner is going away too, so nothing is reported from here on
+    onNextTrackDropped = nullptr;
+
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+    delete current.exchange(nullptr);
+    dropNextTrack(nextPending.exchange(nullptr));
+    delete next.exchange(nullptr);
+
+    releaseRetiredTracks();
+}
+
+// Replaces any track still waiting to be swapped in
+void TrackSlot::queueTrack(std::unique_ptr<PreparedTrack> track)
+{
+    jassert(MessageManager::getInstance()->isThisTheMessageThread());
+
+    // The loader normally prepares the track, this only catches a device restart in between
+    if (track != nullptr && preparedSampleRate.load() > 0
+        && ! track->isPreparedFor(preparedBlockSize.load(), preparedSampleRate.load()))
+        track->prepare(preparedBlockSize.load(), preparedSampleRate.load());
+
+    delete pending.exchange(track.release());
+
+    startTimer(50);
+}
+
+// Swaps pointers only, the old track is left for the message thread to delete
+bool TrackSlot::swapInQueuedTrack()
+{
+    // Room for the next track being replaced and one more for the advance, otherwise it waits a block
+    if (retiredFifo.getFreeSpace() >= 2)
+    {
+        auto* request = nextPending.exchange(nullptr);
+        auto rate = preparedSampleRate.load();
+
+        // Prepared for an older device, it goes back for the timer to prepare again.
+        // If something else was handed over meanwhile this one is no longer wanted
+        if (isTrack(request) && rate > 0 && ! request->isPreparedFor(preparedBlockSize.load(), rate))
+        {
+            PreparedTrack* expected = nullptr;
+
+            if (! nextPending.compare_exchange_strong(expected, request))
+                retireNextTrack(request);
+        }
+        else if (request != nullptr)
+        {
+            retireNextTrack(next.exchange(isTrack(request) ? request : nullptr));
+            resetNextTrackResampler();
+        }
+    }
+
+    // Wait until the previous swap has been cleaned up
+    if (retired.load() != nullptr || retiredFifo.getFreeSpace() < 2)
+        return false;
+
+    auto* next = pending.exchange(nullptr);
+    if (next == nullptr)
+        return false;
+
+    // The device changed after the track was prepared, it goes back for the timer to prepare
+    // again. If another track was queued meanwhile this one is no longer wanted
+    auto rate = preparedSampleRate.load();
+
+    if (rate > 0 && ! next->isPreparedFor(preparedBlockSize.load(), rate))
+    {
+        PreparedTrack* expected = nullptr;
+
+        if (! pending.compare_exchange_strong(expected, next))
+            retire(next);
+
+        return false;
+    }
+
+    // A cached copy of the same track picks up exactly where the old source was. One made
+    // for a track that a next track has since taken over from is no longer wanted
+    auto* old = current.load();
+
+    if (next->continuesCurrentTrack)
+    {
+        if (old == nullptr || old->url != next->url)
+        {
+            retire(next);
+            return false;
+        }
+
+        next->getSource()->setNextReadPosition(old->getSource()->getNextReadPosition());
+    }
+
+    retired.store(current.exchange(next));
+    trackSampleRate.store(next->sampleRate);
+    numCarriedSamples = 0;
+    return true;
+}
+
+// Prepared here unless the loader already did, a device change after this is caught by the timer
+void TrackSlot::queueNextTrack(std::unique_ptr<PreparedTrack> track, double crossfadeSeconds)
+{
+    jassert(MessageManager::getInstance()->isThisTheMessageThread());
+
+    auto rate = preparedSampleRate.load();
+
+    if (track != nullptr && rate > 0 && ! track->isPreparedFor(preparedBlockSize.load(), rate))
+        track->prepare(preparedBlockSize.load(), rate);
+
+    nextCrossfadeSeconds = jmax(0.0, crossfadeSeconds);
+    dropNextTrack(nextPending.exchange(track != nullptr ? track.release() : &clearRequest));
+
+    startTimer(50);
+}
+
+// A track queued before this is dropped here, one already taken up by the audio thread is retired there
+void TrackSlot::clearNextTrack()
+{
+    dropNextTrack(nextPending.exchange(&clearRequest));
+
+    startTimer(50);
+}
+
+bool TrackSlot::hasNextTrack() const
+{
+    auto* request = nextPending.load();
+
+    if (request != nullptr)
+        return request != &clearRequest;
+
+    return next.load() != nullptr;
+}
+
+URL TrackSlot::getCurrentURL() const
+{
+    if (auto* track = current.load())
+        return track->url;
+
+    return {};
+}
+
+bool TrackSlot::isCurrentTrackRandomAccess() const
+{
+    auto* track = current.load();
+    return track != nullptr && track->isRandomAccess();
+}
+
+BeatGrid TrackSlot::getCurrentBeatGrid() const
+{
+    auto* track = current.load();
+
+    if (track == nullptr)
+        return {};
+
+    if (track->beatGrid.isValid() || analysedTrack.load() != track)
+        return track->beatGrid;
+
+    BeatGrid grid;
+    grid.bpm = analysedBpm.load();
+    grid.firstBeatSeconds = analysedFirstBeat.load();
+
+    return analysedTrack.load() == track ? grid : track->beatGrid;
+}
+
+// The current track is only deleted on this thread, so it stays put while the grid is written
+void TrackSlot::setAnalysedBeatGrid(const URL& url, BeatGrid grid)
+{
+    jassert(MessageManager::getInstance()->isThisTheMessageThread());
+
+    auto* track = current.load();
+
+    if (track == nullptr || track->url != url || track->beatGrid.isValid() || ! grid.isValid())
+        return;
+
+    analysedTrack = nullptr;
+    analysedBpm = grid.bpm;
+    analysedFirstBeat = grid.firstBeatSeconds;
+    analysedTrack = track;
+}
+
+int TrackSlot::getNumUnderruns() const
+{
+    int total = underrunsFromRetiredTracks.load();
+
+    if (auto* track = current.load())
+        total += track->getNumUnderruns();
+
+    return total;
+}
+
+void TrackSlot::prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+{
+    preparedBlockSize = samplesPerBlockExpected;
+    preparedSampleRate = sampleRate;
+
+    // Only the tracks the audio side owns, pending ones can be replaced on the message
+    // thread at any moment and are prepared again there before they play
+    if (auto* track = current.load())
+        track->prepare(samplesPerBlockExpected, sampleRate);
+
+    if (auto* track = next.load())
+        track->prepare(samplesPerBlockExpected, sampleRate);
+
+    // Larger requests are mixed in several passes
+    mixBuffer.setSize(2, jmax(4096, samplesPerBlockExpected));
+    nextInput.setSize(2, mixBuffer.getNumSamples() + 8);
+    resetNextTrackResampler();
+    numCarriedSamples = 0;
+}
+
+void TrackSlot::releaseResources()
+{
+    preparedSampleRate = 0;
+
+    if (auto* track = current.load())
+        track->getSource()->releaseResources();
+
+    if (auto* track = next.load())
+        track->getSource()->releaseResources();
+}
+
+void TrackSlot::getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill)
+{
+    auto* track = current.load();
+    auto seek = pendingSeek.exchange(-1);
+
+    if (track == nullptr)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    // Whatever was carried over from the last advance belongs to where it was
+    if (seek >= 0)
+    {
+        numCarriedSamples = 0;
+        track->getSource()->setNextReadPosition(seek);
+    }
+
+    // Resampled input the track read before it took over comes first
+    auto carried = jmin(numCarriedSamples, bufferToFill.numSamples);
+
+    for (int channel = 0; channel < bufferToFill.buffer->getNumChannels() && carried > 0; ++channel)
+        bufferToFill.buffer->copyFrom(channel, bufferToFill.startSample, carriedSamples,
+                                      jmin(channel, carriedSamples.getNumChannels() - 1), carriedOffset, carried);
+
+    numCarriedSamples -= carried;
+    carriedOffset += carried;
+
+    AudioSourceChannelInfo rest (bufferToFill.buffer, bufferToFill.startSample + carried, bufferToFill.numSamples - carried);
+
+    if (rest.numSamples == 0)
+        return;
+
+    auto* source = track->getSource();
+
+    // Samples of the current track left at the start of the block, past its end it plays silence
+    auto remaining = source->getTotalLength() - source->getNextReadPosition();
+    source->getNextAudioBlock(rest);
+
+    auto* nextTrack = next.load();
+
+    if (nextTrack == nullptr)
+        return;
+
+    // The fade is counted in the current track's samples, the next is resampled to match
+    auto fadeLength = (int64) (nextCrossfadeSeconds.load() * track->sampleRate);
+    auto rateRatio = (track->sampleRate > 0 && nextTrack->sampleRate > 0) ? nextTrack->sampleRate / track->sampleRate : 1.0;
+
+    if (remaining - fadeLength < rest.numSamples)
+    {
+        mixInNextTrack(rest, (int) jmax((int64) 0, remaining - fadeLength), remaining, fadeLength, rateRatio);
+
+        if (remaining <= rest.numSamples)
+            advanceToNextTrack(rateRatio != 1.0);
+    }
+}
+
+// The current track fades out as the next fades in, both along a quarter sine so the
+// power stays level through the fade
+void TrackSlot::mixInNextTrack(const AudioSourceChannelInfo& bufferToFill, int startInBlock,
+                               int64 remaining, int64 fadeLength, double rateRatio)
+{
+    auto* nextSource = next.load()->getSource();
+    auto* buffer = bufferToFill.buffer;
+
+    for (int offset = startInBlock; offset < bufferToFill.numSamples; offset += mixBuffer.getNumSamples())
+    {
+        auto numSamples = jmin(mixBuffer.getNumSamples(), bufferToFill.numSamples - offset);
+
+        if (rateRatio != 1.0)
+        {
+            renderNextTrackResampled(*nextSource, rateRatio, numSamples);
+        }
+        else
+        {
+            AudioSourceChannelInfo nextBlock (&mixBuffer, 0, numSamples);
+            nextSource->getNextAudioBlock(nextBlock);
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto left = remaining - (offset + i);
+            float fadeIn = 1.0f, fadeOut = 0.0f;
+
+            if (left > 0)
+            {
+                auto angle = (1.0 - (double) left / (double) fadeLength) * MathConstants<double>::halfPi;
+                fadeIn = (float) std::sin(angle);
+                fadeOut = (float) std::cos(angle);
+            }
+
+            for (int channel = 0; channel < buffer->getNumChannels(); ++channel)
+            {
+                auto& out = buffer->getWritePointer(channel, bufferToFill.startSample + offset)[i];
+                out = out * fadeOut + mixBuffer.getSample(jmin(channel, mixBuffer.getNumChannels() - 1), i) * fadeIn;
+            }
+        }
+    }
+}
+
+// The current track has played its last sample, so the next one becomes current
+void TrackSlot::advanceToNextTrack(bool resampled)
+{
+    // Every other retirement leaves this place free, so the finished track never
+    // stays current past its end, where the transport would stop
+    jassert (retiredFifo.getFreeSpace() > 0);
+
+    auto* newCurrent = next.exchange(nullptr);
+    retire(current.exchange(newCurrent));
+    trackSampleRate.store(newCurrent->sampleRate);
+
+    // Its source has been read a few samples past the last one mixed in, those are
+    // played at its own rate before the source carries on
+    if (resampled)
+    {
+        auto first = jmin(roundToInt(nextInputPosition), numNextInputSamples);
+        numCarriedSamples = jmin(maxCarriedSamples, numNextInputSamples - first);
+        carriedOffset = 0;
+
+        for (int channel = 0; channel < carriedSamples.getNumChannels() && numCarriedSamples > 0; ++channel)
+            carriedSamples.copyFrom(channel, 0, nextInput, jmin(channel, nextInput.getNumChannels() - 1),
+                                    first, numCarriedSamples);
+    }
+
+    ++numAdvances;
+}
+
+void TrackSlot::renderNextTrackResampled(PositionableAudioSource& source, double rateRatio, int numSamples)
+{
+    auto capacity = nextInput.getNumSamples();
+
+    // Outputs per pass, so the input they need always fits
+    auto passLength = jmax(1, (int) ((capacity - 5) / rateRatio));
+
+    for (int done = 0; done < numSamples;)
+    {
+        auto count = jmin(passLength, numSamples - done);
+
+        // Each output needs the sample before its position and the two after
+        auto needed = jmin(capacity, (int) (nextInputPosition + (count - 1) * rateRatio) + 3);
+
+        if (needed > numNextInputSamples)
+        {
+            AudioSourceChannelInfo input (&nextInput, numNextInputSamples, needed - numNextInputSamples);
+            source.getNextAudioBlock(input);
+            numNextInputSamples = needed;
+        }
+
+        for (int channel = 0; channel < mixBuffer.getNumChannels(); ++channel)
+        {
+            auto* in = nextInput.getReadPointer(jmin(channel, nextInput.getNumChannels() - 1));
+            auto* out = mixBuffer.getWritePointer(channel, done);
+            auto position = nextInputPosition;
+
+            for (int i = 0; i < count; ++i, position += rateRatio)
+            {
+                auto index = (int) position;
+                out[i] = interpolate(in + index - 1, (float) (position - index));
+            }
+        }
+
+        nextInputPosition += count * rateRatio;
+        done += count;
+
+        // Keep from the sample before the next output on, reading past any the ratio skips
+        auto used = (int) nextInputPosition - 1;
+        auto kept = numNextInputSamples - used;
+
+        if (kept > 0)
+        {
+            for (int channel = 0; channel < nextInput.getNumChannels(); ++channel)
+            {
+                auto* samples = nextInput.getWritePointer(channel);
+                std::memmove(samples, samples + used, sizeof(float) * (size_t) kept);
+            }
+        }
+        else
+        {
+            for (auto skipped = -kept; skipped > 0; skipped -= capacity)
+            {
+                AudioSourceChannelInfo input (&nextInput, 0, jmin(skipped, capacity));
+                source.getNextAudioBlock(input);
+            }
+
+            kept = 0;
+        }
+
+        numNextInputSamples = kept;
+        nextInputPosition -= used;
+    }
+}
+
+// Starts on a silent sample, so the first output has one before it to interpolate from
+void TrackSlot::resetNextTrackResampler()
+{
+    nextInput.clear();
+    numNextInputSamples = 1;
+    nextInputPosition = 1.0;
+}
+
+void TrackSlot::retire(PreparedTrack* track)
+{
+    if (track == nullptr)
+        return;
+
+    int start1, size1, start2, size2;
+    retiredFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        retiredTracks[start1] = track;
+
+    retiredFifo.finishedWrite(size1);
+}
+
+void TrackSlot::retireNextTrack(PreparedTrack* track)
+{
+    if (track == nullptr)
+        return;
+
+    track->droppedAsNext = true;
+    retire(track);
+}
+
+void TrackSlot::dropNextTrack(PreparedTrack* track)
+{
+    if (! isTrack(track))
+        return;
+
+    if (onNextTrackDropped != nullptr)
+        onNextTrackDropped(track->url);
+
+    delete track;
+}
+
+// The transport calls this from whichever thread seeks without taking a lock, so the
+// track and the carried samples are left to the audio thread
+void TrackSlot::setNextReadPosition (int64 newPosition)
+{
+    pendingSeek = jmax((int64) 0, newPosition);
+}
+
+// A seek still waiting for the audio thread is where the track is about to play from
+int64 TrackSlot::getNextReadPosition() const
+{
+    auto seek = pendingSeek.load();
+
+    if (seek >= 0)
+        return seek;
+
+    if (auto* track = current.load())
+        return track->getSource()->getNextReadPosition();
+
+    return 0;
+}
+
+int64 TrackSlot::getTotalLength() const
+{
+    if (auto* track = current.load())
+        return track->getSource()->getTotalLength();
+
+    return 0;
+}
+
+void TrackSlot::timerCallback()
+{
+    releaseRetiredTracks();
+
+    // Runs while a next track waits, as it will need retiring the moment it takes over
+    if (pending.load() == nullptr && retired.load() == nullptr && nextPending.load() == nullptr
+        && next.load() == nullptr && retiredFifo.getNumReady() == 0)
+        stopTimer();
+}
+
+// A later track allocated at the same address mustn't inherit the grid
+void TrackSlot::forgetAnalysedBeatGrid(PreparedTrack* track)
+{
+    PreparedTrack* expected = track;
+    analysedTrack.compare_exchange_strong(expected, nullptr);
+}
+
+void TrackSlot::releaseRetiredTracks()
+{
+    // A track left waiting through a device change is taken back, prepared and queued again
+    auto rate = preparedSampleRate.load();
+    auto* waiting = pending.load();
+
+    if (rate > 0 && waiting != nullptr && ! waiting->isPreparedFor(preparedBlockSize.load(), rate))
+    {
+        if (auto* track = pending.exchange(nullptr))
+        {
+            track->prepare(preparedBlockSize.load(), rate);
+
+            PreparedTrack* expected = nullptr;
+
+            if (! pending.compare_exchange_strong(expected, track))
+                delete track;
+        }
+    }
+
+    // The same for a next track, only this thread stores tracks there so it goes straight back
+    auto* waitingNext = nextPending.load();
+
+    if (rate > 0 && isTrack(waitingNext) && ! waitingNext->isPreparedFor(preparedBlockSize.load(), rate))
+    {
+        auto* track = nextPending.exchange(nullptr);
+
+        if (isTrack(track))
+        {
+            track->prepare(preparedBlockSize.load(), rate);
+
+            PreparedTrack* expected = nullptr;
+
+            if (! nextPending.compare_exchange_strong(expected, track))
+                dropNextTrack(track);
+        }
+    }
+
+    if (auto* old = retired.exchange(nullptr))
+    {
+        underrunsFromRetiredTracks += old->getNumUnderruns();
+        forgetAnalysedBeatGrid(old);
+        delete old;
+    }
+
+    int start1, size1, start2, size2;
+    retiredFifo.prepareToRead(retiredFifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        auto* old = retiredTracks[i < size1 ? start1 + i : start2 + i - size1];
+        underrunsFromRetiredTracks += old->getNumUnderruns();
+
+        if (old->droppedAsNext && onNextTrackDropped != nullptr)
+            onNextTrackDropped(old->url);
+
+        forgetAnalysedBeatGrid(old);
+        delete old;
+    }
+
+    retiredFifo.finishedRead(size1 + size2);
+}
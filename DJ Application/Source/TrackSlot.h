@@ -0,0 +1,144 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "TrackLoader.h"
+
+// Positionable source that plays the deck's current track and swaps in a newly
+// prepared one at a block boundary without taking a lock on the audio thread.
+//
+// A next track can wait behind the current one. It takes over on the sample after the
+// current track's last one, or fades in over its last seconds with equal-power gains,
+// and the slot then reports the next track's position and length. While the two
+// overlap the next track is resampled to the current one's rate if theirs differ
+class TrackSlot : public PositionableAudioSource,
+                  private Timer
+{
+public:
+    TrackSlot();
+    ~TrackSlot() override;
+
+    // Hands over a prepared track, it replaces the current one at the next block
+    void queueTrack(std::unique_ptr<PreparedTrack> track);
+
+    // Called on the audio thread before rendering a block, returns true if a track was swapped in.
+    // Also takes up a next track queued or cleared since the last block
+    bool swapInQueuedTrack();
+
+    // Hands over the track to follow the current one, replacing any already waiting.
+    // Zero crossfade seconds is a straight cut
+    void queueNextTrack(std::unique_ptr<PreparedTrack> track, double crossfadeSeconds);
+    void clearNextTrack();
+    bool hasNextTrack() const;
+
+    // Goes up by one each time a next track takes over
+    int getNumAdvances() const { return numAdvances.load(); }
+
+    // Message thread, called with the URL of each next track that is replaced or cleared
+    // before it takes over. Every next track either takes over or is reported here
+    std::function<void (const URL&)> onNextTrackDropped;
+
+    // Message thread only, where tracks are deleted, so the track can't go away meanwhile
+    URL getCurrentURL() const;
+    bool isCurrentTrackRandomAccess() const;
+
+    // Message or audio thread, the grid travels with the track so it changes on the same sample
+    BeatGrid getCurrentBeatGrid() const;
+
+    // Message thread, for beats analysed after the track was loaded. Only a current track
+    // at the URL without a grid of its own takes it
+    void setAnalysedBeatGrid(const URL& url, BeatGrid grid);
+
+    // Native sample rate of the track that is playing, 0 if none
+    double getTrackSampleRate() const { return trackSampleRate.load(); }
+
+    // Underruns from every track this slot has played
+    int getNumUnderruns() const;
+
+    // Message thread, deletes the tracks the audio side has finished with. A timer does this
+    // while a device plays, an offline render has no message loop and calls it between blocks
+    void releaseRetiredTracks();
+
+    // AudioSource overrides
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override;
+
+    // PositionableAudioSource overrides. A seek from any thread is applied by the audio
+    // thread at the start of its next block, to whichever track is current then
+    void setNextReadPosition (int64 newPosition) override;
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override;
+    bool isLooping() const override { return false; }
+
+private:
+    // Cleans up after swaps and stops once nothing is waiting
+    void timerCallback() override;
+
+    // Audio thread, fades the next track in from the given sample of the block
+    void mixInNextTrack(const AudioSourceChannelInfo& bufferToFill, int startInBlock,
+                        int64 remaining, int64 fadeLength, double rateRatio);
+    void advanceToNextTrack(bool resampled);
+
+    // Audio thread, fills the start of mixBuffer with the next track at the current
+    // track's rate, reading only as much of it as the interpolation needs
+    void renderNextTrackResampled(PositionableAudioSource& source, double rateRatio, int numSamples);
+    void resetNextTrackResampler();
+
+    // Audio thread, hands a track over to be deleted by the timer
+    void retire(PreparedTrack* track);
+    void retireNextTrack(PreparedTrack* track);
+
+    // Message thread, deletes a next track that never reached the audio thread
+    void dropNextTrack(PreparedTrack* track);
+    void forgetAnalysedBeatGrid(PreparedTrack* track);
+
+    // Only ever deleted on the message thread, so the audio thread can just swap pointers
+    std::atomic<PreparedTrack*> current { nullptr };
+    std::atomic<PreparedTrack*> pending { nullptr };
+    std::atomic<PreparedTrack*> retired { nullptr };
+
+    // The next track is handed over in nextPending and owned by the audio thread once in next.
+    // Clearing stores a marker in nextPending rather than a track, so a clear and a
+    // replacement are one exchange each and the audio thread sees them in order
+    std::atomic<PreparedTrack*> nextPending { nullptr };
+    std::atomic<PreparedTrack*> next { nullptr };
+    std::atomic<double> nextCrossfadeSeconds { 0 };
+
+    // Position asked for by the last seek not yet applied, or -1
+    std::atomic<int64> pendingSeek { -1 };
+
+    // A grid analysed after its track was loaded, for that track only. The track is
+    // unset while the grid is written, so a reader that sees it before and after has all of it
+    std::atomic<PreparedTrack*> analysedTrack { nullptr };
+    std::atomic<double> analysedBpm { 0 };
+    std::atomic<double> analysedFirstBeat { 0 };
+    std::atomic<int> numAdvances { 0 };
+
+    // Tracks the audio thread has finished with, for the timer to delete. Everything but
+    // a next track taking over leaves a place free, so that never has to wait
+    static constexpr int maxRetiredTracks = 8;
+    AbstractFifo retiredFifo { maxRetiredTracks };
+    PreparedTrack* retiredTracks[maxRetiredTracks] = {};
+
+    // The next track is rendered here during a crossfade
+    AudioBuffer<float> mixBuffer { 2, 4096 };
+
+    // Next track samples read for resampling, from the one before the next output on.
+    // The few read but not yet played when it takes over are carried over and played
+    // before its source
+    AudioBuffer<float> nextInput { 2, 4096 };
+    int numNextInputSamples = 0;
+    double nextInputPosition = 0;
+
+    static constexpr int maxCarriedSamples = 8;
+    AudioBuffer<float> carriedSamples { 2, maxCarriedSamples };
+    int numCarriedSamples = 0, carriedOffset = 0;
+
+    std::atomic<double> trackSampleRate { 0 };
+    std::atomic<int> underrunsFromRetiredTracks { 0 };
+
+    std::atomic<int> preparedBlockSize { 0 };
+    std::atomic<double> preparedSampleRate { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TrackSlot)
+};
@@ -1,106 +1,278 @@
-#include "../JuceLibraryCode/JuceHeader.h"
-#include "WaveformDisplay.h"
-
-// Component shows visual representation of audio waveform
-WaveformDisplay::WaveformDisplay(AudioFormatManager & 	formatManagerToUse,
-                                 AudioThumbnailCache & 	cacheToUse) :
-                                 audioThumb(1000, formatManagerToUse, cacheToUse), 
-                                 fileLoaded(false), 
-                                 position(0)
-                          
-{
-    // Listener to detect changes in audio thumbnail
-    audioThumb.addChangeListener(this);
-}
-
-// Destructor
-WaveformDisplay::~WaveformDisplay()
-{
-}
-
-void WaveformDisplay::paint(Graphics& g)
-{
-    // Use custom background color
-    g.fillAll(backgroundColour);
-
-    g.setColour(Colours::grey);
-    g.drawRect(getLocalBounds(), 1);
-
-    g.setColour(waveformColour);
-    
-    // Check if audio file is loaded
-    if(fileLoaded)
-    {
-        audioThumb.drawChannel(g,
-            getLocalBounds(),
-            0,
-            audioThumb.getTotalLength(),
-            0,
-            1.0f
-        );
-        
-        // Draw waveform
-        g.setColour(positionColour);
-        g.drawRect(position * getWidth(), 0, getWidth() / 20, getHeight());
-    }
-    else
-    {
-        g.setFont(20.0f);
-        g.drawText("File not loaded...", getLocalBounds(),
-                   Justification::centred, true);
-    }
-}
-
-void WaveformDisplay::resized()
-{
-}
-
-// Loads new audio file
-void WaveformDisplay::loadURL(URL audioURL)
-{
-  audioThumb.clear();
-  fileLoaded  = audioThumb.setSource(new URLInputSource(audioURL));
-  if (fileLoaded)
-  {
-    std::cout << "wfd: loaded! " << std::endl;
-    repaint();
-  }
-  else {
-    std::cout << "wfd: not loaded! " << std::endl;
-  }
-
-}
-
-// When thumbnail is changed or when file is loaded
-void WaveformDisplay::changeListenerCallback (ChangeBroadcaster *source)
-{
-    std::cout << "wfd: change received! " << std::endl;
-
-    repaint();
-
-}
-
-// Update position
-void WaveformDisplay::setPositionRelative(double pos)
-{
-  if (pos != position)
-  {
-    position = pos;
-    repaint();
-  }
-
-  
-}
-
-// Update waveform and colours
-void WaveformDisplay::setColours(Colour waveColour, Colour bgColour, Colour posColour)
-{
-    waveformColour = waveColour;
-    backgroundColour = bgColour;
-    positionColour = posColour;
-    repaint();
-}
-
-
-
-
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "WaveformDisplay.h"
+#include "PersistentThumbnailCache.h"
+
+// Component shows visual representation of audio waveform
+WaveformDisplay::WaveformDisplay(AudioFormatManager & 	formatManagerToUse,
+                                 PersistentThumbnailCache & 	cacheToUse,
+                                 ThreadPool & 	_analysisPool,
+                                 RefreshScheduler & 	_refreshScheduler) :
+                                 formatManager(formatManagerToUse),
+                                 thumbCache(cacheToUse),
+                                 analysisPool(_analysisPool),
+                                 audioThumb(1000, formatManagerToUse, cacheToUse), 
+                                 refreshScheduler(_refreshScheduler),
+                                 fileLoaded(false), 
+                                 position(0)
+                          
+{
+    // Listener to detect changes in audio thumbnail
+    audioThumb.addChangeListener(this);
+
+    // Fills its whole area, so playhead repaints never reach the deck behind
+    setOpaque(true);
+}
+
+// Destructor
+WaveformDisplay::~WaveformDisplay()
+{
+}
+
+void WaveformDisplay::paint(Graphics& g)
+{
+    // The renderer draws the waveform and playhead underneath, only the frame is left
+    if (drawnByOpenGL)
+    {
+        g.setColour(Colours::grey);
+        g.drawRect(getLocalBounds(), 1);
+        return;
+    }
+
+    // The waveform only changes with new data, size or colours, so it is drawn once and reused
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (waveformDirty || waveformScale != scale)
+        renderWaveform(scale);
+
+    g.drawImage(waveformImage, getLocalBounds().toFloat());
+
+    if (fileLoaded)
+    {
+        // Draw playhead
+        g.setColour(positionColour);
+        g.drawRect(getPlayheadBounds(position));
+    }
+}
+
+// Draws everything except the playhead into the cached image
+void WaveformDisplay::renderWaveform(float scale)
+{
+    waveformDirty = false;
+    waveformScale = scale;
+
+    auto width = jmax(1, roundToInt(getWidth() * scale));
+    auto height = jmax(1, roundToInt(getHeight() * scale));
+
+    if (waveformImage.getWidth() != width || waveformImage.getHeight() != height)
+        waveformImage = Image(Image::ARGB, width, height, false);
+
+    Graphics g (waveformImage);
+    g.addTransform(AffineTransform::scale(scale));
+
+    // Use custom background color
+    g.fillAll(backgroundColour);
+
+    g.setColour(Colours::grey);
+    g.drawRect(getLocalBounds(), 1);
+
+    g.setColour(waveformColour);
+    
+    // Check if audio file is loaded
+    if (fileLoaded && bands != nullptr)
+    {
+        // One column per physical pixel, coloured by its low, mid and high energy
+        auto length = audioThumb.getTotalLength();
+        auto columnWidth = 1.0f / scale;
+        auto midY = getHeight() * 0.5f;
+
+        for (int i = 0; i < width; ++i)
+        {
+            auto start = length * i / width;
+            auto end = length * (i + 1) / width;
+
+            float minimum = 0, maximum = 0;
+            audioThumb.getApproximateMinMax(start, end, 0, minimum, maximum);
+
+            auto top = midY - jlimit(-1.0f, 1.0f, maximum) * midY;
+            auto bottom = midY - jlimit(-1.0f, 1.0f, minimum) * midY;
+
+            g.setColour(getColumnColour(start, end));
+            g.fillRect(i * columnWidth, top, columnWidth, jmax(columnWidth, bottom - top));
+        }
+    }
+    else if(fileLoaded)
+    {
+        audioThumb.drawChannel(g,
+            getLocalBounds(),
+            0,
+            audioThumb.getTotalLength(),
+            0,
+            1.0f
+        );
+    }
+    else
+    {
+        g.setFont(20.0f);
+        g.drawText("File not loaded...", getLocalBounds(),
+                   Justification::centred, true);
+    }
+}
+
+Rectangle<int> WaveformDisplay::getPlayheadBounds(double pos) const
+{
+    return { roundToInt(pos * getWidth()), 0, getWidth() / 20, getHeight() };
+}
+
+void WaveformDisplay::resized()
+{
+    waveformDirty = true;
+}
+
+// Loads new audio file
+void WaveformDisplay::loadURL(URL audioURL)
+{
+  audioThumb.clear();
+  bands = nullptr;
+  fileLoaded = false;
+
+  waveformDirty = true;
+  refreshScheduler.invalidate(*this);
+
+  if (drawnByOpenGL)
+      updateOverview();
+
+  auto generation = ++analysisGeneration;
+  Component::SafePointer<WaveformDisplay> safeThis (this);
+
+  // Keyed by the file's identity, so a stored waveform is only used for the same file.
+  // Working it out reads from the file, which happens on the cache's thread
+  thumbCache.findIdentityAsync(audioURL, [safeThis, generation, audioURL](int64 identity)
+  {
+      if (safeThis == nullptr || safeThis->analysisGeneration != generation)
+          return;
+
+      safeThis->fileLoaded = safeThis->audioThumb.setSource(PersistentThumbnailCache::createInputSource(audioURL, identity));
+      safeThis->waveformDirty = true;
+      safeThis->refreshScheduler.invalidate(*safeThis);
+
+      if (safeThis->drawnByOpenGL)
+          safeThis->updateOverview();
+  });
+
+  BandAnalysis::analyseAsync(audioURL, formatManager, analysisPool, thumbCache, [safeThis, generation](BandAnalysis::Ptr result)
+  {
+      if (safeThis == nullptr || safeThis->analysisGeneration != generation)
+          return;
+
+      safeThis->bands = result;
+      safeThis->waveformDirty = true;
+      safeThis->refreshScheduler.invalidate(*safeThis);
+
+      if (safeThis->drawnByOpenGL)
+          safeThis->updateOverview();
+  });
+}
+
+// When thumbnail is changed or when file is loaded
+void WaveformDisplay::changeListenerCallback (ChangeBroadcaster *source)
+{
+    waveformDirty = true;
+    refreshScheduler.invalidate(*this);
+
+    if (drawnByOpenGL)
+        updateOverview();
+}
+
+// Update position, only the old and new playhead areas are redrawn
+void WaveformDisplay::setPositionRelative(double pos)
+{
+  if (pos != position)
+  {
+    auto oldBounds = getPlayheadBounds(position);
+    auto newBounds = getPlayheadBounds(pos);
+    position = pos;
+
+    if (fileLoaded && ! drawnByOpenGL && oldBounds != newBounds)
+    {
+        refreshScheduler.invalidate(*this, oldBounds);
+        refreshScheduler.invalidate(*this, newBounds);
+    }
+  }
+}
+
+// Update waveform and colours
+void WaveformDisplay::setColours(Colour waveColour, Colour bgColour, Colour posColour)
+{
+    waveformColour = waveColour;
+    backgroundColour = bgColour;
+    positionColour = posColour;
+    waveformDirty = true;
+    refreshScheduler.invalidate(*this);
+
+    // The outline's vertices carry the colour
+    if (drawnByOpenGL)
+        updateOverview();
+}
+
+void WaveformDisplay::setDrawnByOpenGL(bool shouldUseOpenGL)
+{
+    drawnByOpenGL = shouldUseOpenGL;
+    setOpaque(! shouldUseOpenGL);
+
+    if (shouldUseOpenGL)
+    {
+        waveformImage = {};
+        updateOverview();
+    }
+
+    waveformDirty = true;
+    refreshScheduler.invalidate(*this);
+}
+
+void WaveformDisplay::updateOverview()
+{
+    const int numColumns = 2048;
+    std::vector<float> vertices;
+    auto length = audioThumb.getTotalLength();
+
+    if (fileLoaded && length > 0)
+    {
+        vertices.reserve((size_t) numColumns * 10);
+
+        for (int i = 0; i < numColumns; ++i)
+        {
+            auto start = length * i / numColumns;
+            auto end = length * (i + 1) / numColumns;
+
+            float minimum = 0, maximum = 0;
+            audioThumb.getApproximateMinMax(start, end, 0, minimum, maximum);
+
+            auto colour = getColumnColour(start, end);
+            auto red = colour.getFloatRed(), green = colour.getFloatGreen(), blue = colour.getFloatBlue();
+
+            auto x = (i + 0.5f) / numColumns;
+            vertices.insert(vertices.end(), { x, maximum, red, green, blue, x, minimum, red, green, blue });
+        }
+    }
+
+    const SpinLock::ScopedLockType sl (overviewLock);
+    overviewVertices.swap(vertices);
+    ++overviewVersion;
+}
+
+Colour WaveformDisplay::getColumnColour(double startSeconds, double endSeconds) const
+{
+    return bands != nullptr ? bands->getColour(startSeconds, endSeconds) : waveformColour;
+}
+
+bool WaveformDisplay::getOverview(std::vector<float>& vertices, int& lastVersion) const
+{
+    const SpinLock::ScopedLockType sl (overviewLock);
+
+    if (lastVersion == overviewVersion)
+        return false;
+
+    vertices = overviewVertices;
+    lastVersion = overviewVersion;
+    return true;
+}
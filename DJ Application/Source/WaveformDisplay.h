@@ -1,42 +1,89 @@
-#pragma once
-
-#include "../JuceLibraryCode/JuceHeader.h"
-
-// Component that visualises audio waveform
-class WaveformDisplay    : public Component,
-                           public ChangeListener
-{
-public:
-    // Initialises waveform display
-    WaveformDisplay( AudioFormatManager & 	formatManagerToUse,
-                    AudioThumbnailCache & 	cacheToUse );
-    ~WaveformDisplay();
-
-    // Draws waveform
-    void paint (Graphics&) override;
-    void resized() override;
-
-    // Handles changes in audio thumbnail
-    void changeListenerCallback (ChangeBroadcaster *source) override;
-
-    // Loads audio file
-    void loadURL(URL audioURL);
-
-    // Sets position of playhead
-    void setPositionRelative(double pos);
-    
-    void setColours(Colour waveColour, Colour bgColour, Colour posColour = Colours::lightgreen);
-
-private:
-    AudioThumbnail audioThumb;
-    bool fileLoaded; 
-    double position;
-    
-    // Custom UI colours
-    Colour waveformColour = Colours::orange;
-    Colour positionColour = Colours::lightgreen;
-    Colour backgroundColour = getLookAndFeel().findColour(ResizableWindow::backgroundColourId);
-    
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformDisplay)
-};
-
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "BandAnalysis.h"
+#include "PersistentThumbnailCache.h"
+#include "RefreshScheduler.h"
+
+// Component that visualises audio waveform
+class WaveformDisplay    : public Component,
+                           public ChangeListener
+{
+public:
+    // Initialises waveform display
+    WaveformDisplay( AudioFormatManager & 	formatManagerToUse,
+                    PersistentThumbnailCache & 	cacheToUse,
+                    ThreadPool & 	analysisPool,
+                    RefreshScheduler & 	refreshScheduler );
+    ~WaveformDisplay();
+
+    // Draws waveform
+    void paint (Graphics&) override;
+    void resized() override;
+
+    // Handles changes in audio thumbnail
+    void changeListenerCallback (ChangeBroadcaster *source) override;
+
+    // Loads audio file
+    void loadURL(URL audioURL);
+
+    // Sets position of playhead
+    void setPositionRelative(double pos);
+    
+    void setColours(Colour waveColour, Colour bgColour, Colour posColour = Colours::lightgreen);
+
+    // Hands drawing over to an OpenGL renderer, the component then paints nothing
+    // and keeps a column outline of the thumbnail for the renderer to upload
+    void setDrawnByOpenGL(bool shouldUseOpenGL);
+
+    // Any thread. Copies the outline as two (x, y, red, green, blue) vertices per column,
+    // the maximum then the minimum with x from 0 to 1, if it has changed since lastVersion,
+    // which is then updated
+    bool getOverview(std::vector<float>& vertices, int& lastVersion) const;
+
+private:
+    // Redraws the cached waveform at the display's pixel scale
+    void renderWaveform(float scale);
+
+    Rectangle<int> getPlayheadBounds(double pos) const;
+
+    // Samples the thumbnail into overviewVertices, message thread only
+    void updateOverview();
+
+    // Colour of the columns from start to end, by frequency once the bands are known
+    Colour getColumnColour(double startSeconds, double endSeconds) const;
+
+    AudioFormatManager& formatManager;
+    PersistentThumbnailCache& thumbCache;
+    ThreadPool& analysisPool;
+
+    AudioThumbnail audioThumb;
+
+    // Computed on the pool after each load, stale results (and identities) are dropped by generation
+    BandAnalysis::Ptr bands;
+    int analysisGeneration = 0;
+
+    // Repaints go through the scheduler so they land in the next frame
+    RefreshScheduler& refreshScheduler;
+
+    bool fileLoaded; 
+    double position;
+
+    // Background, border and waveform, redrawn only when waveformDirty is set
+    Image waveformImage;
+    float waveformScale = 1.0f;
+    bool waveformDirty = true;
+
+    bool drawnByOpenGL = false;
+    SpinLock overviewLock;
+    std::vector<float> overviewVertices;
+    int overviewVersion = 0;
+    
+    // Custom UI colours
+    Colour waveformColour = Colours::orange;
+    Colour positionColour = Colours::lightgreen;
+    Colour backgroundColour = getLookAndFeel().findColour(ResizableWindow::backgroundColourId);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformDisplay)
+};
+
@@ -0,0 +1,198 @@
+#include "WaveformPyramid.h"
+
+//==============================================================================
+// Opens the track on a pool thread, hands the empty pyramid over and then fills it
+class WaveformPyramid::BuildJob : public ThreadPoolJob
+{
+public:
+    BuildJob(const URL& _url, AudioFormatManager& _formatManager, std::function<void (Ptr)> _onCreated)
+    : ThreadPoolJob("Waveform pyramid builder"), url(_url), formatManager(_formatManager), onCreated(std::move(_onCreated))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor(url.createInputStream(false)));
+
+        if (reader == nullptr || reader->lengthInSamples <= 0)
+            return jobHasFinished;
+
+        Ptr pyramid (new WaveformPyramid(reader->lengthInSamples, reader->sampleRate));
+        auto callback = onCreated;
+
+        MessageManager::callAsync([callback, pyramid] { callback(pyramid); });
+
+        pyramid->build(*reader, this);
+        return jobHasFinished;
+    }
+
+private:
+    const URL url;
+    AudioFormatManager& formatManager;
+    std::function<void (Ptr)> onCreated;
+};
+
+//==============================================================================
+WaveformPyramid::WaveformPyramid(int64 _lengthInSamples, double _sampleRate)
+: lengthInSamples(jmax((int64) 0, _lengthInSamples)), sampleRate(_sampleRate)
+{
+    auto numBuckets = (size_t) jmax((int64) 1, (lengthInSamples + baseSamplesPerBucket - 1) / baseSamplesPerBucket);
+
+    // Halve until a single bucket covers the whole track
+    for (;;)
+    {
+        levels.emplace_back(numBuckets);
+
+        if (numBuckets == 1)
+            break;
+
+        numBuckets = (numBuckets + 1) / 2;
+    }
+}
+
+void WaveformPyramid::buildAsync(const URL& url, AudioFormatManager& formatManager, ThreadPool& pool,
+                                 std::function<void (Ptr)> onCreated)
+{
+    pool.addJob(new BuildJob(url, formatManager, std::move(onCreated)), true);
+}
+
+bool WaveformPyramid::build(AudioFormatReader& reader, ThreadPoolJob* job)
+{
+    const int bucketsPerRead = 256;
+    const int readSize = bucketsPerRead * baseSamplesPerBucket;
+
+    auto numChannels = (int) jlimit(1u, 2u, reader.numChannels);
+    AudioBuffer<float> buffer (numChannels, readSize);
+    size_t bucketIndex = 0;
+
+    for (int64 position = 0; position < lengthInSamples; position += readSize)
+    {
+        if (cancelled.load() || (job != nullptr && job->shouldExit()))
+            return false;
+
+        auto numSamples = (int) jmin((int64) readSize, lengthInSamples - position);
+        reader.read(&buffer, 0, numSamples, position, true, numChannels > 1);
+
+        // Channels are folded together, the display only shows one
+        for (int start = 0; start < numSamples; start += baseSamplesPerBucket)
+        {
+            auto count = jmin(baseSamplesPerBucket, numSamples - start);
+            Bucket bucket { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), 0.0f };
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* data = buffer.getReadPointer(channel, start);
+                auto range = FloatVectorOperations::findMinAndMax(data, count);
+                bucket.minimum = jmin(bucket.minimum, range.getStart());
+                bucket.maximum = jmax(bucket.maximum, range.getEnd());
+
+                float sumOfSquares = 0;
+                for (int i = 0; i < count; ++i)
+                    sumOfSquares += data[i] * data[i];
+
+                bucket.meanSquare += sumOfSquares / (float) count;
+            }
+
+            bucket.meanSquare /= (float) numChannels;
+            addBucket(bucketIndex++, bucket);
+        }
+
+        baseBucketsReady = bucketIndex;
+    }
+
+    finish();
+    return true;
+}
+
+WaveformPyramid::Bucket WaveformPyramid::merge(const Bucket& a, const Bucket& b)
+{
+    return { jmin(a.minimum, b.minimum), jmax(a.maximum, b.maximum), (a.meanSquare + b.meanSquare) * 0.5f };
+}
+
+void WaveformPyramid::addBucket(size_t index, const Bucket& bucket)
+{
+    levels[0][index] = bucket;
+
+    // An odd index is the second child of its parent, so the parent is now complete
+    for (size_t level = 1; level < levels.size() && (index & 1) != 0; ++level)
+    {
+        index >>= 1;
+        levels[level][index] = merge(levels[level - 1][index * 2], levels[level - 1][index * 2 + 1]);
+    }
+}
+
+void WaveformPyramid::finish()
+{
+    // Only the last bucket of each level can be missing children, lower levels go first
+    for (size_t level = 1; level < levels.size(); ++level)
+    {
+        auto& lower = levels[level - 1];
+        auto last = levels[level].size() - 1;
+
+        // Already complete, and possibly being read
+        if ((levels[0].size() >> level) > last)
+            continue;
+
+        if (last * 2 + 1 < lower.size())
+            levels[level][last] = merge(lower[last * 2], lower[last * 2 + 1]);
+        else
+            levels[level][last] = lower[last * 2];
+    }
+
+    baseBucketsReady = levels[0].size();
+    complete = true;
+}
+
+size_t WaveformPyramid::getNumReadyBuckets(int level) const
+{
+    if (complete.load())
+        return levels[(size_t) level].size();
+
+    // A bucket is complete once every level 0 bucket under it is
+    return baseBucketsReady.load() >> level;
+}
+
+WaveformPyramid::Range WaveformPyramid::getBucket(int level, size_t index) const
+{
+    auto& bucket = levels[(size_t) level][index];
+    return { bucket.minimum, bucket.maximum, std::sqrt(bucket.meanSquare), true };
+}
+
+WaveformPyramid::Range WaveformPyramid::getRange(int64 startSample, int64 endSample) const
+{
+    Range range;
+    startSample = jmax((int64) 0, startSample);
+    endSample = jmin(lengthInSamples, endSample);
+
+    if (endSample <= startSample)
+        return range;
+
+    // Coarsest level that still fits two buckets in the span, so a few buckets cover any span
+    auto span = endSample - startSample;
+    int level = 0;
+
+    while (level + 1 < (int) levels.size() && ((int64) baseSamplesPerBucket << (level + 1)) * 2 <= span)
+        ++level;
+
+    auto bucketSize = (int64) baseSamplesPerBucket << level;
+    auto first = (size_t) (startSample / bucketSize);
+    auto last = (size_t) ((endSample - 1) / bucketSize);
+    auto numReady = getNumReadyBuckets(level);
+
+    if (numReady == 0 || first >= numReady)
+        return range;
+
+    last = jmin(last, numReady - 1);
+
+    auto& buckets = levels[(size_t) level];
+    auto total = buckets[first];
+
+    for (auto i = first + 1; i <= last; ++i)
+        total = merge(total, buckets[i]);
+
+    range.minimum = total.minimum;
+    range.maximum = total.maximum;
+    range.rms = std::sqrt(total.meanSquare);
+    range.isValid = true;
+    return range;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Min, max and RMS of a track at a ladder of resolutions. Level 0 summarises every
+// baseSamplesPerBucket samples and each level above halves the one below, so any
+// span of the track can be summarised from a handful of buckets whatever its length.
+//
+// The pyramid is filled from start to end on a background thread while the GUI is
+// already drawing it, readers only ever see buckets whose children are complete
+class WaveformPyramid : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<WaveformPyramid>;
+
+    static constexpr int baseSamplesPerBucket = 128;
+
+    struct Range
+    {
+        float minimum = 0;
+        float maximum = 0;
+        float rms = 0;
+        bool isValid = false;
+    };
+
+    WaveformPyramid(int64 lengthInSamples, double sampleRate);
+
+    // Opens the track on the pool and builds its pyramid there. onCreated is called on the
+    // message thread as soon as the length is known, and the pyramid keeps filling after that.
+    // It is never called if the file can't be read
+    static void buildAsync(const URL& url, AudioFormatManager& formatManager, ThreadPool& pool,
+                           std::function<void (Ptr)> onCreated);
+
+    // Reads the whole track, returns false if it was cancelled or the job was asked to exit
+    bool build(AudioFormatReader& reader, ThreadPoolJob* job = nullptr);
+
+    // Stops a build that is no longer wanted
+    void cancel() { cancelled = true; }
+
+    int64 getLengthInSamples() const { return lengthInSamples; }
+    double getSampleRate() const { return sampleRate; }
+    bool isComplete() const { return complete.load(); }
+
+    // Summary of the samples from start to end, from the coarsest level that still
+    // puts two buckets in the span. Invalid if none of the span has been read yet
+    Range getRange(int64 startSample, int64 endSample) const;
+
+    // Direct access to the levels, for renderers that upload them whole
+    int getNumLevels() const { return (int) levels.size(); }
+    size_t getNumBuckets(int level) const { return levels[(size_t) level].size(); }
+    static int64 getSamplesPerBucket(int level) { return (int64) baseSamplesPerBucket << level; }
+
+    // Number of buckets on a level that can be read, they fill in from the start
+    size_t getNumReadyBuckets(int level) const;
+
+    // Only valid for an index below getNumReadyBuckets
+    Range getBucket(int level, size_t index) const;
+
+private:
+    class BuildJob;
+
+    struct Bucket
+    {
+        float minimum, maximum, meanSquare;
+    };
+
+    static Bucket merge(const Bucket& a, const Bucket& b);
+
+    // Stores level 0 bucket index and fills in every level above that it completes
+    void addBucket(size_t index, const Bucket& bucket);
+
+    // Fills the partial buckets at the end of each level once the track has been read
+    void finish();
+
+    const int64 lengthInSamples;
+    const double sampleRate;
+
+    std::vector<std::vector<Bucket>> levels;
+
+    // Published after the buckets they cover have been written
+    std::atomic<size_t> baseBucketsReady { 0 };
+    std::atomic<bool> complete { false };
+    std::atomic<bool> cancelled { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformPyramid)
+};
@@ -0,0 +1,571 @@
+#include "WaveformRenderer.h"
+
+#if JUCE_VERSION >= 0x060100
+ using namespace juce::gl;
+#endif
+
+namespace
+{
+    // Positions are in seconds for the close-up and 0 to 1 for the overview, offset and
+    // scale map the visible part onto the view, so scrolling never touches the vertices.
+    // Tinted buffers also carry a colour per vertex, which multiplies the uniform colour
+    const char* const vertexShader =
+        "attribute vec2 position;\n"
+        "attribute vec3 tint;\n"
+        "uniform float offset;\n"
+        "uniform float scale;\n"
+        "uniform float yScale;\n"
+        "varying vec3 vertexTint;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    vertexTint = tint;\n"
+        "    gl_Position = vec4((position.x - offset) * scale * 2.0 - 1.0, position.y * yScale, 0.0, 1.0);\n"
+        "}\n";
+
+    const char* const fragmentShader =
+        "varying " JUCE_MEDIUMP " vec3 vertexTint;\n"
+        "uniform " JUCE_MEDIUMP " vec4 colour;\n"
+        "uniform " JUCE_MEDIUMP " float useTint;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    gl_FragColor = colour * mix(vec4(1.0), vec4(vertexTint, 1.0), useTint);\n"
+        "}\n";
+
+    // Corners in order, so the same vertices make a fan or a line loop
+    const float quadVertices[] = { 0.0f, -1.0f,  1.0f, -1.0f,  1.0f, 1.0f,  0.0f, 1.0f };
+
+    // Maps a point in a view's component coordinates to 0 to 1 across and 1 to -1 down
+    void addPoint(std::vector<float>& vertices, Point<float> point, float viewWidth, float viewHeight)
+    {
+        vertices.push_back(point.x / viewWidth);
+        vertices.push_back(1.0f - 2.0f * point.y / viewHeight);
+    }
+
+    // Appends a closed triangle strip stroking a rounded rectangle, the way
+    // Graphics::drawRoundedRectangle centres the line on the edge
+    void addRoundedOutline(std::vector<float>& vertices, Rectangle<float> area, float cornerSize,
+                           float thickness, float viewWidth, float viewHeight)
+    {
+        const int pointsPerCorner = 6;
+
+        auto radius = jmin(cornerSize, area.getWidth() * 0.5f, area.getHeight() * 0.5f);
+        auto centres = area.reduced(radius);
+        Point<float> corners[] = { centres.getTopRight(), centres.getBottomRight(),
+                                   centres.getBottomLeft(), centres.getTopLeft() };
+
+        auto outer = radius + thickness * 0.5f;
+        auto inner = jmax(0.0f, radius - thickness * 0.5f);
+        auto first = vertices.size();
+
+        // Clockwise on screen, each corner sweeping a quarter turn from where the last ended
+        for (int corner = 0; corner < 4; ++corner)
+        {
+            for (int i = 0; i < pointsPerCorner; ++i)
+            {
+                auto angle = (corner - 1 + i / (float) (pointsPerCorner - 1)) * MathConstants<float>::halfPi;
+                Point<float> direction (std::cos(angle), std::sin(angle));
+
+                addPoint(vertices, corners[corner] + direction * outer, viewWidth, viewHeight);
+                addPoint(vertices, corners[corner] + direction * inner, viewWidth, viewHeight);
+            }
+        }
+
+        // Back to the first pair to close the ring
+        for (size_t i = 0; i < 4; ++i)
+            vertices.push_back(vertices[first + i]);
+    }
+}
+
+WaveformRenderer::WaveformRenderer(OpenGLContext& _context)
+: context(_context)
+{
+}
+
+void WaveformRenderer::addDeck(Component& deckComponent, const Playhead& playhead, const DeckBackground& background,
+                               WaveformDisplay& overview, ScrollingWaveformDisplay& closeUp,
+                               Colour waveformColour, Colour backgroundColour, Colour playheadColour)
+{
+    {
+        const ScopedLock sl (decksLock);
+        decks.add(new Deck { deckComponent, playhead, background, overview, closeUp,
+                             waveformColour, backgroundColour, playheadColour });
+    }
+
+    overview.setDrawnByOpenGL(true);
+    closeUp.setDrawnByOpenGL(true);
+}
+
+void WaveformRenderer::clearDecks()
+{
+    const ScopedLock sl (decksLock);
+    decks.clear();
+}
+
+void WaveformRenderer::updateViewBounds(Component& target)
+{
+    const ScopedLock sl (decksLock);
+
+    targetWidth = target.getWidth();
+    targetHeight = target.getHeight();
+
+    for (auto* deck : decks)
+    {
+        deck->deckBounds = target.getLocalArea(&deck->component, deck->component.getLocalBounds());
+        deck->overviewBounds = target.getLocalArea(&deck->overview, deck->overview.getLocalBounds());
+        deck->closeUpBounds = target.getLocalArea(&deck->closeUp, deck->closeUp.getLocalBounds());
+    }
+}
+
+void WaveformRenderer::excludeViewsFromClip(Graphics& g, Component& paintedComponent) const
+{
+    const ScopedLock sl (decksLock);
+
+    // The displays sit inside the deck, so this covers them too
+    for (auto* deck : decks)
+        g.excludeClipRegion(paintedComponent.getLocalArea(&deck->component, deck->component.getLocalBounds()));
+}
+
+//==============================================================================
+void WaveformRenderer::newOpenGLContextCreated()
+{
+    std::unique_ptr<OpenGLShaderProgram> newShader (new OpenGLShaderProgram(context));
+
+    if (! newShader->addVertexShader(OpenGLHelpers::translateVertexShaderToV3(vertexShader))
+        || ! newShader->addFragmentShader(OpenGLHelpers::translateFragmentShaderToV3(fragmentShader))
+        || ! newShader->link())
+    {
+        DBG("Waveform shader failed: " << newShader->getLastError());
+        return;
+    }
+
+    shader = std::move(newShader);
+    positionAttribute.reset(new OpenGLShaderProgram::Attribute(*shader, "position"));
+    tintAttribute.reset(new OpenGLShaderProgram::Attribute(*shader, "tint"));
+    offsetUniform.reset(new OpenGLShaderProgram::Uniform(*shader, "offset"));
+    scaleUniform.reset(new OpenGLShaderProgram::Uniform(*shader, "scale"));
+    yScaleUniform.reset(new OpenGLShaderProgram::Uniform(*shader, "yScale"));
+    colourUniform.reset(new OpenGLShaderProgram::Uniform(*shader, "colour"));
+    useTintUniform.reset(new OpenGLShaderProgram::Uniform(*shader, "useTint"));
+
+    auto& gl = context.extensions;
+    gl.glGenBuffers(1, &quadBuffer);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+    gl.glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void WaveformRenderer::renderOpenGL()
+{
+    jassert (OpenGLHelpers::isContextActive());
+
+    // Everything outside the decks is covered by the components
+    OpenGLHelpers::clear(Colours::black);
+
+    if (shader == nullptr)
+        return;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_SCISSOR_TEST);
+
+    shader->use();
+
+    {
+        const ScopedLock sl (decksLock);
+
+        for (auto* deck : decks)
+        {
+            drawBackground(*deck);
+            drawOverview(*deck);
+            drawCloseUp(*deck);
+        }
+    }
+
+    // Leave the state as the component renderer expects it
+    glDisable(GL_SCISSOR_TEST);
+
+    auto scale = context.getRenderingScale();
+    glViewport(0, 0, roundToInt(targetWidth * scale), roundToInt(targetHeight * scale));
+
+    context.extensions.glDisableVertexAttribArray(positionAttribute->attributeID);
+    context.extensions.glDisableVertexAttribArray(tintAttribute->attributeID);
+    context.extensions.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void WaveformRenderer::openGLContextClosing()
+{
+    {
+        const ScopedLock sl (decksLock);
+
+        for (auto* deck : decks)
+            releaseBuffers(*deck);
+    }
+
+    if (quadBuffer != 0)
+        context.extensions.glDeleteBuffers(1, &quadBuffer);
+
+    quadBuffer = 0;
+
+    useTintUniform.reset();
+    colourUniform.reset();
+    yScaleUniform.reset();
+    scaleUniform.reset();
+    offsetUniform.reset();
+    tintAttribute.reset();
+    positionAttribute.reset();
+    shader.reset();
+}
+
+//==============================================================================
+bool WaveformRenderer::setView(Rectangle<int> bounds, int& widthInPixels, int& heightInPixels)
+{
+    auto scale = context.getRenderingScale();
+
+    // GL counts rows from the bottom of the window
+    auto left = roundToInt(bounds.getX() * scale);
+    auto right = roundToInt(bounds.getRight() * scale);
+    auto bottom = roundToInt((targetHeight - bounds.getBottom()) * scale);
+    auto top = roundToInt((targetHeight - bounds.getY()) * scale);
+
+    if (right <= left || top <= bottom)
+        return false;
+
+    glViewport(left, bottom, right - left, top - bottom);
+    glScissor(left, bottom, right - left, top - bottom);
+
+    widthInPixels = right - left;
+    heightInPixels = top - bottom;
+    return true;
+}
+
+bool WaveformRenderer::beginView(Rectangle<int> bounds, Colour background, int& widthInPixels, float& yScale)
+{
+    int heightInPixels;
+
+    if (! setView(bounds, widthInPixels, heightInPixels))
+        return false;
+
+    OpenGLHelpers::clear(background);
+
+    // Keeps full-scale peaks a pixel inside the view
+    yScale = 1.0f - 2.0f / (float) heightInPixels;
+    return true;
+}
+
+void WaveformRenderer::drawBackground(Deck& deck)
+{
+    updateBackgroundBuffers(deck);
+
+    int width, height;
+
+    if (deck.outlineBuffer == 0 || ! setView(deck.deckBounds, width, height))
+        return;
+
+    auto& background = deck.background;
+
+    // The gradient's colours are in its vertices
+    setUniforms(0.0f, 1.0f, 1.0f, Colours::white, true);
+    drawStrip(deck.gradientBuffer, 0, 4, GL_TRIANGLE_FAN, true);
+
+    setUniforms(0.0f, 1.0f, 1.0f, background.gridColour);
+    drawStrip(deck.outlineBuffer, 0, deck.numGridVertices, GL_LINES);
+
+    setUniforms(0.0f, 1.0f, 1.0f, background.borderColour);
+    drawStrip(deck.outlineBuffer, deck.numGridVertices, deck.numBorderVertices, GL_TRIANGLE_STRIP);
+
+    // Holds its last value while the deck is stopped, as the painted border did
+    if (deck.playhead.playing.load())
+        deck.pulseAlpha = DeckBackground::getPulseAlpha();
+
+    setUniforms(0.0f, 1.0f, 1.0f, background.pulseColour.withAlpha(deck.pulseAlpha));
+    drawStrip(deck.outlineBuffer, deck.numGridVertices + deck.numBorderVertices, deck.numBorderVertices, GL_TRIANGLE_STRIP);
+}
+
+void WaveformRenderer::drawOverview(Deck& deck)
+{
+    updateOverviewBuffer(deck);
+
+    int width;
+    float yScale;
+
+    if (! beginView(deck.overviewBounds, deck.backgroundColour, width, yScale) || deck.numOverviewVertices == 0)
+        return;
+
+    // Colours come from the vertices, by frequency once the track has been analysed
+    setUniforms(0.0f, 1.0f, yScale, Colours::white, true);
+    drawStrip(deck.overviewBuffer, 0, deck.numOverviewVertices, GL_TRIANGLE_STRIP, true);
+
+    // Same outline the component draws, a twentieth of the width wide
+    auto position = (float) deck.playhead.position.load();
+    drawQuad(position, position + 0.05f, yScale, deck.playheadColour, false);
+}
+
+void WaveformRenderer::drawCloseUp(Deck& deck)
+{
+    updateLevelBuffers(deck);
+
+    int width;
+    float yScale;
+
+    if (! beginView(deck.closeUpBounds, deck.backgroundColour, width, yScale) || deck.levels.empty())
+        return;
+
+    auto visibleSeconds = deck.closeUp.getVisibleSeconds();
+    auto startSeconds = deck.playhead.position.load() * deck.playhead.lengthInSeconds.load() - visibleSeconds * 0.5;
+
+    // Coarsest level whose buckets are still no wider than a pixel
+    auto secondsPerPixel = visibleSeconds / width;
+    size_t index = 0;
+
+    while (index + 1 < deck.levels.size() && deck.levels[index + 1].bucketSeconds <= secondsPerPixel)
+        ++index;
+
+    auto& level = deck.levels[index];
+    auto first = (size_t) jmax(0.0, std::floor(startSeconds / level.bucketSeconds));
+    auto end = (size_t) jmax(0.0, std::ceil((startSeconds + visibleSeconds) / level.bucketSeconds) + 1.0);
+    end = jmin(end, level.numUploaded);
+
+    // Only the buckets in view are drawn, the playhead itself is just the offset
+    if (first < end)
+    {
+        auto offset = (float) startSeconds;
+        auto scale = (float) (1.0 / visibleSeconds);
+        auto numVertices = (GLsizei) ((end - first) * 2);
+
+        setUniforms(offset, scale, yScale, deck.waveformColour.withAlpha(0.5f));
+        drawStrip(level.buffer, (GLint) (first * 2), numVertices, GL_TRIANGLE_STRIP);
+
+        setUniforms(offset, scale, yScale, deck.waveformColour);
+        drawStrip(level.buffer, (GLint) ((level.numBuckets + first) * 2), numVertices, GL_TRIANGLE_STRIP);
+    }
+
+    auto halfPlayhead = 1.0f / (float) width * context.getRenderingScale();
+    drawQuad(0.5f - halfPlayhead, 0.5f + halfPlayhead, 1.0f, deck.playheadColour, true);
+}
+
+//==============================================================================
+void WaveformRenderer::updateBackgroundBuffers(Deck& deck)
+{
+    if (deck.deckBounds.isEmpty() || deck.deckBounds == deck.backgroundBuilt)
+        return;
+
+    auto& gl = context.extensions;
+    auto& background = deck.background;
+    auto width = (float) deck.deckBounds.getWidth();
+    auto height = (float) deck.deckBounds.getHeight();
+
+    // A linear gradient from the top left to the bottom right corner, which is linear
+    // across each triangle of the quad too, so the corners' colours are exact
+    auto diagonal = width * width + height * height;
+    float cornerPositions[] = { height * height / diagonal, 1.0f, width * width / diagonal, 0.0f };
+
+    uploadScratch.clear();
+
+    for (int i = 0; i < 4; ++i)
+    {
+        auto colour = background.gradientStart.interpolatedWith(background.gradientEnd, cornerPositions[i]);
+
+        uploadScratch.push_back(quadVertices[i * 2]);
+        uploadScratch.push_back(quadVertices[i * 2 + 1]);
+        uploadScratch.push_back(colour.getFloatRed());
+        uploadScratch.push_back(colour.getFloatGreen());
+        uploadScratch.push_back(colour.getFloatBlue());
+    }
+
+    if (deck.gradientBuffer == 0)
+        gl.glGenBuffers(1, &deck.gradientBuffer);
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, deck.gradientBuffer);
+    gl.glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (uploadScratch.size() * sizeof(float)), uploadScratch.data(), GL_STATIC_DRAW);
+
+    uploadScratch.clear();
+
+    for (int x = 0; x < deck.deckBounds.getWidth(); x += background.gridSpacing)
+    {
+        addPoint(uploadScratch, { (float) x, 0.0f }, width, height);
+        addPoint(uploadScratch, { (float) x, height }, width, height);
+    }
+
+    for (int y = 0; y < deck.deckBounds.getHeight(); y += background.gridSpacing)
+    {
+        addPoint(uploadScratch, { 0.0f, (float) y }, width, height);
+        addPoint(uploadScratch, { width, (float) y }, width, height);
+    }
+
+    deck.numGridVertices = (GLsizei) (uploadScratch.size() / 2);
+
+    auto area = Rectangle<float> (width, height);
+    addRoundedOutline(uploadScratch, area.reduced(background.borderInset), background.cornerSize,
+                      background.borderThickness, width, height);
+
+    deck.numBorderVertices = (GLsizei) (uploadScratch.size() / 2) - deck.numGridVertices;
+
+    addRoundedOutline(uploadScratch, area.reduced(background.pulseInset), background.cornerSize,
+                      background.pulseThickness, width, height);
+
+    if (deck.outlineBuffer == 0)
+        gl.glGenBuffers(1, &deck.outlineBuffer);
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, deck.outlineBuffer);
+    gl.glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (uploadScratch.size() * sizeof(float)), uploadScratch.data(), GL_STATIC_DRAW);
+
+    deck.backgroundBuilt = deck.deckBounds;
+}
+
+void WaveformRenderer::updateOverviewBuffer(Deck& deck)
+{
+    if (! deck.overview.getOverview(deck.overviewVertices, deck.overviewVersion))
+        return;
+
+    auto& gl = context.extensions;
+
+    if (deck.overviewBuffer == 0)
+        gl.glGenBuffers(1, &deck.overviewBuffer);
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, deck.overviewBuffer);
+    gl.glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (deck.overviewVertices.size() * sizeof(float)),
+                    deck.overviewVertices.data(), GL_STATIC_DRAW);
+
+    deck.numOverviewVertices = (GLsizei) (deck.overviewVertices.size() / 5);
+}
+
+void WaveformRenderer::updateLevelBuffers(Deck& deck)
+{
+    auto& gl = context.extensions;
+    auto pyramid = deck.closeUp.getPyramid();
+
+    // New track, allocate every level up front and fill them as the pyramid is built.
+    // Level 0 is left out to halve the memory, level 1 buckets are only a few pixels
+    // wide at the closest zoom
+    if (pyramid != deck.pyramid)
+    {
+        for (auto& level : deck.levels)
+            gl.glDeleteBuffers(1, &level.buffer);
+
+        deck.levels.clear();
+        deck.pyramid = pyramid;
+
+        if (pyramid == nullptr)
+            return;
+
+        for (int i = 1; i < pyramid->getNumLevels(); ++i)
+        {
+            LevelBuffer level;
+            level.numBuckets = pyramid->getNumBuckets(i);
+            level.bucketSeconds = (double) WaveformPyramid::getSamplesPerBucket(i) / pyramid->getSampleRate();
+
+            gl.glGenBuffers(1, &level.buffer);
+            gl.glBindBuffer(GL_ARRAY_BUFFER, level.buffer);
+            gl.glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) (level.numBuckets * 8 * sizeof(float)), nullptr, GL_STATIC_DRAW);
+
+            deck.levels.push_back(level);
+        }
+    }
+
+    if (pyramid == nullptr)
+        return;
+
+    for (size_t i = 0; i < deck.levels.size(); ++i)
+    {
+        auto& level = deck.levels[i];
+        auto ready = pyramid->getNumReadyBuckets((int) i + 1);
+
+        if (ready <= level.numUploaded)
+            continue;
+
+        auto count = ready - level.numUploaded;
+        uploadScratch.resize(count * 8);
+
+        // Each bucket is a vertical pair, (x, max), (x, min) for the peaks and (x, rms), (x, -rms) below that
+        for (size_t j = 0; j < count; ++j)
+        {
+            auto index = level.numUploaded + j;
+            auto bucket = pyramid->getBucket((int) i + 1, index);
+            auto x = (float) ((index + 0.5) * level.bucketSeconds);
+            auto rms = jmin(1.0f, bucket.rms);
+
+            auto* peak = &uploadScratch[j * 4];
+            peak[0] = x;  peak[1] = jlimit(-1.0f, 1.0f, bucket.maximum);
+            peak[2] = x;  peak[3] = jlimit(-1.0f, 1.0f, bucket.minimum);
+
+            auto* body = &uploadScratch[(count + j) * 4];
+            body[0] = x;  body[1] = rms;
+            body[2] = x;  body[3] = -rms;
+        }
+
+        gl.glBindBuffer(GL_ARRAY_BUFFER, level.buffer);
+        gl.glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) (level.numUploaded * 4 * sizeof(float)),
+                           (GLsizeiptr) (count * 4 * sizeof(float)), uploadScratch.data());
+        gl.glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) ((level.numBuckets + level.numUploaded) * 4 * sizeof(float)),
+                           (GLsizeiptr) (count * 4 * sizeof(float)), uploadScratch.data() + count * 4);
+
+        level.numUploaded = ready;
+    }
+}
+
+void WaveformRenderer::drawQuad(float x0, float x1, float yScale, Colour colour, bool filled)
+{
+    // Maps the quad's 0 to 1 onto x0 to x1 of the view
+    auto scale = jmax(1.0e-6f, x1 - x0);
+    setUniforms(-x0 / scale, scale, yScale, colour);
+    drawStrip(quadBuffer, 0, 4, filled ? GL_TRIANGLE_FAN : GL_LINE_LOOP);
+}
+
+void WaveformRenderer::setUniforms(float offset, float scale, float yScale, Colour colour, bool tinted)
+{
+    useTintUniform->set(tinted ? 1.0f : 0.0f);
+    offsetUniform->set(offset);
+    scaleUniform->set(scale);
+    yScaleUniform->set(yScale);
+    colourUniform->set(colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(), colour.getFloatAlpha());
+}
+
+void WaveformRenderer::drawStrip(GLuint buffer, GLint first, GLsizei count, GLenum mode, bool tinted)
+{
+    auto& gl = context.extensions;
+    auto stride = (GLsizei) ((tinted ? 5 : 2) * sizeof(float));
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    gl.glVertexAttribPointer(positionAttribute->attributeID, 2, GL_FLOAT, GL_FALSE, stride, nullptr);
+    gl.glEnableVertexAttribArray(positionAttribute->attributeID);
+
+    if (tinted)
+    {
+        gl.glVertexAttribPointer(tintAttribute->attributeID, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*) (2 * sizeof(float)));
+        gl.glEnableVertexAttribArray(tintAttribute->attributeID);
+    }
+    else
+    {
+        gl.glDisableVertexAttribArray(tintAttribute->attributeID);
+    }
+
+    glDrawArrays(mode, first, count);
+}
+
+void WaveformRenderer::releaseBuffers(Deck& deck)
+{
+    auto& gl = context.extensions;
+
+    if (deck.overviewBuffer != 0)
+        gl.glDeleteBuffers(1, &deck.overviewBuffer);
+
+    if (deck.gradientBuffer != 0)
+        gl.glDeleteBuffers(1, &deck.gradientBuffer);
+
+    if (deck.outlineBuffer != 0)
+        gl.glDeleteBuffers(1, &deck.outlineBuffer);
+
+    for (auto& level : deck.levels)
+        gl.glDeleteBuffers(1, &level.buffer);
+
+    deck.overviewBuffer = 0;
+    deck.gradientBuffer = 0;
+    deck.outlineBuffer = 0;
+    deck.backgroundBuilt = {};
+    deck.numOverviewVertices = 0;
+    deck.overviewVersion = -1;
+    deck.levels.clear();
+    deck.pyramid = nullptr;
+}
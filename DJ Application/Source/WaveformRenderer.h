@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ScrollingWaveformDisplay.h"
+#include "WaveformDisplay.h"
+#include "WaveformPyramid.h"
+
+// Draws every deck's background, waveforms and playheads with OpenGL, under the
+// components of the window the context is attached to.
+//
+// Waveform vertices are uploaded to the GPU once per track, as the thumbnail and
+// pyramid fill in. Every frame after that only sets a few uniforms, so the playheads
+// and the border pulse follow the players at the display's refresh rate without
+// repainting any component
+class WaveformRenderer : public OpenGLRenderer
+{
+public:
+    // Written by the deck once per frame on the message thread, the rendering thread
+    // reads nothing else from the player
+    struct Playhead
+    {
+        std::atomic<double> position { 0.0 };
+        std::atomic<double> lengthInSeconds { 0.0 };
+        std::atomic<bool> playing { false };
+    };
+
+    // How a deck's background is drawn, by the deck itself when there is no renderer
+    struct DeckBackground
+    {
+        Colour gradientStart, gradientEnd, gridColour, borderColour, pulseColour;
+        int gridSpacing;
+        float cornerSize;
+        float borderInset, borderThickness;
+        float pulseInset, pulseThickness;
+
+        // The inner border breathes while the deck plays
+        static float getPulseAlpha() { return 0.3f + 0.2f * std::sin(Time::getMillisecondCounter() / 500.0f); }
+    };
+
+    WaveformRenderer(OpenGLContext& context);
+
+    // Message thread. The deck and its displays stop painting and this draws them instead
+    void addDeck(Component& deckComponent, const Playhead& playhead, const DeckBackground& background,
+                 WaveformDisplay& overview, ScrollingWaveformDisplay& closeUp,
+                 Colour waveformColour, Colour backgroundColour, Colour playheadColour);
+
+    // Only while the context is detached, the decks' buffers belong to the rendering thread
+    void clearDecks();
+
+    // Message thread. Records where each display sits in the component the context
+    // is attached to, call it whenever that component is laid out
+    void updateViewBounds(Component& target);
+
+    // Keeps a component's painting off the decks so what this draws shows through
+    void excludeViewsFromClip(Graphics& g, Component& paintedComponent) const;
+
+    // OpenGLRenderer overrides, called on the rendering thread
+    void newOpenGLContextCreated() override;
+    void renderOpenGL() override;
+    void openGLContextClosing() override;
+
+private:
+    // One pyramid level, a peak strip and then an RMS strip with two vertices per bucket
+    struct LevelBuffer
+    {
+        GLuint buffer = 0;
+        size_t numBuckets = 0;
+        size_t numUploaded = 0;
+        double bucketSeconds = 0;
+    };
+
+    struct Deck
+    {
+        Component& component;
+        const Playhead& playhead;
+        DeckBackground background;
+        WaveformDisplay& overview;
+        ScrollingWaveformDisplay& closeUp;
+        Colour waveformColour, backgroundColour, playheadColour;
+
+        // In the target component's coordinates
+        Rectangle<int> deckBounds, overviewBounds, closeUpBounds;
+
+        // Rendering thread only. The gradient is a tinted quad, the other buffer holds
+        // the grid lines and then the two borders as triangle strips
+        GLuint gradientBuffer = 0, outlineBuffer = 0;
+        GLsizei numGridVertices = 0, numBorderVertices = 0;
+        Rectangle<int> backgroundBuilt;
+        float pulseAlpha = 0.3f;
+
+        GLuint overviewBuffer = 0;
+        GLsizei numOverviewVertices = 0;
+        int overviewVersion = -1;
+        std::vector<float> overviewVertices;
+
+        WaveformPyramid::Ptr pyramid;
+        std::vector<LevelBuffer> levels;
+    };
+
+    // Sets up the viewport and scissor for part of the target, false if it has no area
+    bool setView(Rectangle<int> bounds, int& widthInPixels, int& heightInPixels);
+
+    // The same for one display, which is also cleared
+    bool beginView(Rectangle<int> bounds, Colour background, int& widthInPixels, float& yScale);
+
+    void drawBackground(Deck& deck);
+    void drawOverview(Deck& deck);
+    void drawCloseUp(Deck& deck);
+
+    // Rebuilds the background's vertices whenever the deck changes size
+    void updateBackgroundBuffers(Deck& deck);
+
+    // Uploads whatever the thumbnail or pyramid has added since the last frame
+    void updateOverviewBuffer(Deck& deck);
+    void updateLevelBuffers(Deck& deck);
+
+    // Draws the unit quad stretched from x0 to x1 of the view, filled or as an outline
+    void drawQuad(float x0, float x1, float yScale, Colour colour, bool filled);
+
+    // Tinted buffers hold (x, y, red, green, blue) vertices, the others just (x, y)
+    void setUniforms(float offset, float scale, float yScale, Colour colour, bool tinted = false);
+    void drawStrip(GLuint buffer, GLint first, GLsizei count, GLenum mode, bool tinted = false);
+
+    void releaseBuffers(Deck& deck);
+
+    OpenGLContext& context;
+
+    CriticalSection decksLock;
+    OwnedArray<Deck> decks;
+    int targetWidth = 0, targetHeight = 0;
+
+    std::unique_ptr<OpenGLShaderProgram> shader;
+    std::unique_ptr<OpenGLShaderProgram::Attribute> positionAttribute, tintAttribute;
+    std::unique_ptr<OpenGLShaderProgram::Uniform> offsetUniform, scaleUniform, yScaleUniform, colourUniform, useTintUniform;
+    GLuint quadBuffer = 0;
+    std::vector<float> uploadScratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformRenderer)
+};